@@ -0,0 +1,716 @@
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "CompactTable_priv.hpp"
+#include "HashTable.hpp"
+#include "PerfectHash_priv.hpp"
+#include "TableExpiry_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The number of entry slots a brand new table allocates.
+static constexpr size_t k_initial_capacity = 16;
+
+// The number of key bytes a brand new string-key table allocates.
+static constexpr size_t k_initial_arena_capacity = 256;
+
+// Grows the table (ie, increase the number of buckets) if its load
+// factor has become too high.  Uses the same policy as the chained table.
+static void MaybeResize(CompactTable* ct);
+
+// Makes room for at least one more entry in the links and entries arrays.
+static void MaybeGrow(CompactTable* ct);
+
+// Makes room for at least len more bytes at the end of the arena.
+static void MaybeGrowArena(CompactTable* ct, size_t len);
+
+// Rewrites the arena so that it holds only the bytes of current keys, in
+// entry order, with at least "spare" bytes free at the end.
+static void CompactArena(CompactTable* ct, size_t spare);
+
+static HTKey_t PackStringKey(size_t offset, size_t len) {
+  return reinterpret_cast<HTKey_t>((offset << k_ct_key_len_bits) | len);
+}
+
+static size_t StringKeyOffset(HTKey_t packed) {
+  return reinterpret_cast<uint64_t>(packed) >> k_ct_key_len_bits;
+}
+
+static size_t StringKeyLen(HTKey_t packed) {
+  return reinterpret_cast<uint64_t>(packed) & k_ct_max_key_len;
+}
+
+// The tag stored in an entry's link: the bits of the hash that are not
+// (typically) used to select the bucket.
+static uint32_t HashTag(HTHash_t hash) {
+  return static_cast<uint32_t>(hash >> 32);
+}
+
+static size_t HashKeyToBucketNum(CompactTable* ct, HTHash_t hash) {
+  return hash % ct->num_buckets;
+}
+
+// Returns true iff p points into the snapshot mapping, and therefore must
+// not be passed to delete[].  (An empty array may sit right at its end.)
+static bool IsMapped(CompactTable* ct, const void* p) {
+  const char* base = static_cast<const char*>(ct->map_base);
+  const char* ptr = static_cast<const char*>(p);
+  return base != nullptr && ptr >= base && ptr <= base + ct->map_bytes;
+}
+
+// Returns true iff entry idx holds key.
+static bool KeyMatches(CompactTable* ct, uint32_t idx, HTKey_t key) {
+  if (!ct->string_keys) {
+    return ct->key_cmp_fn(ct->entries[idx].key, key);
+  }
+
+  const HTStringKey_t* skey = static_cast<const HTStringKey_t*>(key);
+  const HTKey_t packed = ct->entries[idx].key;
+  return StringKeyLen(packed) == skey->len &&
+         (skey->len == 0 || memcmp(ct->arena + StringKeyOffset(packed),
+                                   skey->bytes, skey->len) == 0);
+}
+
+// Looks for key in a frozen table: the only entry it can be is the one in
+// its hash's slot.
+static uint32_t FindFrozenIndex(CompactTable* ct, HTHash_t hash, HTKey_t key) {
+  if (ct->num_elements == 0) {
+    return k_ct_nil;
+  }
+  const uint32_t idx = static_cast<uint32_t>(PerfectHash_Slot(ct->mph, hash));
+  if (ct->entries[idx].hash == hash && KeyMatches(ct, idx, key)) {
+    return idx;
+  }
+  return k_ct_nil;
+}
+
+// Looks for key in its chain.  On success, returns the entry's index and,
+// if prev_ptr is non-nullptr, a pointer to the index that refers to it
+// (either the bucket head or the predecessor's link).  Returns k_ct_nil
+// if the key is not present.  (Frozen tables are read-only, so they never
+// need prev_ptr.)
+static uint32_t FindIndex(CompactTable* ct,
+                          HTHash_t hash,
+                          HTKey_t key,
+                          uint32_t** prev_ptr) {
+  if (ct->mph != nullptr) {
+    return FindFrozenIndex(ct, hash, key);
+  }
+  const uint32_t tag = HashTag(hash);
+  uint32_t* ref = &ct->heads[HashKeyToBucketNum(ct, hash)];
+
+  while (*ref != k_ct_nil) {
+    const uint32_t idx = *ref;
+    if (ct->links[idx].tag == tag && ct->entries[idx].hash == hash &&
+        KeyMatches(ct, idx, key)) {
+      if (prev_ptr != nullptr) {
+        *prev_ptr = ref;
+      }
+      return idx;
+    }
+    ref = &ct->links[idx].next;
+  }
+  return k_ct_nil;
+}
+
+// Takes entry idx off an ordered table's order list.
+static void Unorder(CompactTable* ct, uint32_t idx) {
+  const CTOrder link = ct->order[idx];
+  if (link.prev != k_ct_nil) {
+    ct->order[link.prev].next = link.next;
+  } else {
+    ct->order_head = link.next;
+  }
+  if (link.next != k_ct_nil) {
+    ct->order[link.next].prev = link.prev;
+  } else {
+    ct->order_tail = link.prev;
+  }
+}
+
+// Puts entry idx on the end of an ordered table's order list.
+static void OrderAtTail(CompactTable* ct, uint32_t idx) {
+  ct->order[idx].prev = ct->order_tail;
+  ct->order[idx].next = k_ct_nil;
+  if (ct->order_tail != k_ct_nil) {
+    ct->order[ct->order_tail].next = idx;
+  } else {
+    ct->order_head = idx;
+  }
+  ct->order_tail = idx;
+}
+
+// Returns true iff entries a and b hold equal keys.
+static bool EntryKeysMatch(CompactTable* ct, uint32_t a, uint32_t b) {
+  const HTKeyValue_t* ea = &ct->entries[a];
+  const HTKeyValue_t* eb = &ct->entries[b];
+  if (ea->hash != eb->hash) {
+    return false;
+  }
+  if (!ct->string_keys) {
+    return ct->key_cmp_fn(ea->key, eb->key);
+  }
+  const size_t len = StringKeyLen(ea->key);
+  return StringKeyLen(eb->key) == len &&
+         (len == 0 || memcmp(ct->arena + StringKeyOffset(ea->key),
+                             ct->arena + StringKeyOffset(eb->key), len) == 0);
+}
+
+// Appends a (key,value) to the entries, which must have room for it, and
+// links it into its chain where ref (the bucket head or a link) points.
+static void AppendAt(CompactTable* ct, HTKeyValue_t newkeyvalue,
+                     uint32_t* ref);
+
+// Rebuilds every chain from scratch by walking the dense entry array.
+static void Rechain(CompactTable* ct) {
+  for (size_t i = 0; i < ct->num_buckets; i++) {
+    ct->heads[i] = k_ct_nil;
+  }
+  for (size_t i = 0; i < ct->num_elements; i++) {
+    const size_t bucket = HashKeyToBucketNum(ct, ct->entries[i].hash);
+    ct->links[i].next = ct->heads[bucket];
+    ct->heads[bucket] = static_cast<uint32_t>(i);
+  }
+}
+
+// Rebuilds every chain of a multimap over a new heads array by walking the
+// old chains in order, appending each entry to its new chain.  A run's
+// entries all move to the same bucket, so they stay together.
+static void RechainRuns(CompactTable* ct,
+                        const uint32_t* old_heads,
+                        size_t old_num_buckets) {
+  uint32_t* tails = new uint32_t[ct->num_buckets];
+  for (size_t i = 0; i < ct->num_buckets; i++) {
+    ct->heads[i] = k_ct_nil;
+  }
+  for (size_t b = 0; b < old_num_buckets; b++) {
+    uint32_t idx = old_heads[b];
+    while (idx != k_ct_nil) {
+      const uint32_t next = ct->links[idx].next;
+      const size_t bucket = HashKeyToBucketNum(ct, ct->entries[idx].hash);
+      ct->links[idx].next = k_ct_nil;
+      if (ct->heads[bucket] == k_ct_nil) {
+        ct->heads[bucket] = idx;
+      } else {
+        ct->links[tails[bucket]].next = idx;
+      }
+      tails[bucket] = idx;
+      idx = next;
+    }
+  }
+  delete[] tails;
+}
+
+// Removes entry idx, which ref (the bucket head or its predecessor's link)
+// refers to.
+static void RemoveIndex(CompactTable* ct, uint32_t idx, uint32_t* ref) {
+  // Unlink the entry from its chain.  A string key's bytes stay behind in
+  // the arena until it is next compacted.
+  if (ct->string_keys) {
+    ct->arena_live -= StringKeyLen(ct->entries[idx].key);
+  }
+  *ref = ct->links[idx].next;
+  if (ct->order != nullptr) {
+    Unorder(ct, idx);
+  }
+  ct->num_elements--;
+
+  // Keep the entries dense: move the last entry into the vacated slot, and
+  // repoint whichever index referred to the last entry.
+  const uint32_t last = static_cast<uint32_t>(ct->num_elements);
+  if (idx != last) {
+    uint32_t* last_ref =
+        &ct->heads[HashKeyToBucketNum(ct, ct->entries[last].hash)];
+    while (*last_ref != last) {
+      last_ref = &ct->links[*last_ref].next;
+    }
+    *last_ref = idx;
+    ct->entries[idx] = ct->entries[last];
+    ct->links[idx] = ct->links[last];
+    if (ct->timers != nullptr) {
+      ct->timers[idx] = ct->timers[last];
+      if (ct->timers[idx] != nullptr) {
+        ct->timers[idx]->index = idx;
+      }
+    }
+    if (ct->order != nullptr) {
+      // Repoint the moved entry's neighbours in order, too.
+      const CTOrder link = ct->order[last];
+      ct->order[idx] = link;
+      if (link.prev != k_ct_nil) {
+        ct->order[link.prev].next = idx;
+      } else {
+        ct->order_head = idx;
+      }
+      if (link.next != k_ct_nil) {
+        ct->order[link.next].prev = idx;
+      } else {
+        ct->order_tail = idx;
+      }
+    }
+  }
+  if (ct->timers != nullptr) {
+    ct->timers[last] = nullptr;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompactTable implementation.
+
+CompactTable* CompactTable_New(size_t num_buckets,
+                               KeyCmpFnPtr key_compare_function) {
+  CompactTable* ct = new CompactTable{};
+
+  ct->num_buckets = num_buckets;
+  ct->num_elements = 0;
+  ct->capacity = k_initial_capacity;
+  ct->heads = new uint32_t[num_buckets];
+  for (size_t i = 0; i < num_buckets; i++) {
+    ct->heads[i] = k_ct_nil;
+  }
+  ct->links = new CTLink[ct->capacity];
+  ct->entries = new HTKeyValue_t[ct->capacity];
+  ct->key_cmp_fn = key_compare_function;
+  ct->string_keys = false;
+  ct->arena = nullptr;
+  ct->order_head = k_ct_nil;
+  ct->order_tail = k_ct_nil;
+
+  return ct;
+}
+
+CompactTable* CompactTable_NewStringKeys(size_t num_buckets) {
+  CompactTable* ct = CompactTable_New(num_buckets, nullptr);
+
+  ct->string_keys = true;
+  ct->arena_capacity = k_initial_arena_capacity;
+  ct->arena = new char[ct->arena_capacity];
+  ct->arena_used = 0;
+  ct->arena_live = 0;
+
+  return ct;
+}
+
+void CompactTable_Delete(CompactTable* table,
+                         KeyValueFreeFnPtr kv_free_function) {
+  // The entries are dense, so there's no need to walk the chains.  A
+  // string-key table owns its keys, so it may have nothing to visit at all.
+  if (kv_free_function != nullptr) {
+    HTStringKey_t key_view;
+    HTKeyValue_t kv;
+    for (size_t i = 0; i < table->num_elements; i++) {
+      CompactTable_GetEntry(table, i, &key_view, &kv);
+      kv_free_function(kv);
+    }
+  }
+
+  if (!IsMapped(table, table->heads)) {
+    delete[] table->heads;
+  }
+  if (!IsMapped(table, table->links)) {
+    delete[] table->links;
+  }
+  if (!IsMapped(table, table->entries)) {
+    delete[] table->entries;
+  }
+  if (!IsMapped(table, table->arena)) {
+    delete[] table->arena;
+  }
+  delete[] table->timers;
+  delete[] table->order;
+  if (table->mph != nullptr) {
+    if (!IsMapped(table, table->mph->pilots)) {
+      delete[] table->mph->pilots;
+    }
+    if (!IsMapped(table, table->mph->remap)) {
+      delete[] table->mph->remap;
+    }
+    delete table->mph;
+  }
+  if (table->map_base != nullptr) {
+    munmap(table->map_base, table->map_bytes);
+  }
+  delete table;
+}
+
+bool CompactTable_Insert(CompactTable* table,
+                         HTKeyValue_t newkeyvalue,
+                         HTKeyValue_t* oldkeyvalue) {
+  if (table->read_only) {
+    return false;
+  }
+  MaybeResize(table);
+
+  // A multimap always adds a new entry, at the front of its key's run.
+  if (table->multimap) {
+    MaybeGrow(table);  // first, so that ref stays valid
+    uint32_t* ref = nullptr;
+    if (FindIndex(table, newkeyvalue.hash, newkeyvalue.key, &ref) ==
+        k_ct_nil) {
+      ref = &table->heads[HashKeyToBucketNum(table, newkeyvalue.hash)];
+    }
+    AppendAt(table, newkeyvalue, ref);
+    return false;
+  }
+
+  // Replace in place if the key is already present.
+  const uint32_t idx =
+      FindIndex(table, newkeyvalue.hash, newkeyvalue.key, nullptr);
+  if (idx != k_ct_nil) {
+    *oldkeyvalue = table->entries[idx];
+    if (table->string_keys) {
+      // Keep the table's copy of the (equal) key.
+      oldkeyvalue->key = newkeyvalue.key;
+      table->entries[idx].value = newkeyvalue.value;
+    } else {
+      table->entries[idx] = newkeyvalue;
+    }
+    CompactTable_Touch(table, idx);
+    return true;
+  }
+
+  // Otherwise append a new entry and push it onto the front of its chain.
+  CompactTable_Append(table, newkeyvalue);
+  return false;
+}
+
+void CompactTable_Append(CompactTable* table, HTKeyValue_t newkeyvalue) {
+  MaybeGrow(table);
+  AppendAt(table, newkeyvalue,
+           &table->heads[HashKeyToBucketNum(table, newkeyvalue.hash)]);
+}
+
+static void AppendAt(CompactTable* table, HTKeyValue_t newkeyvalue,
+                     uint32_t* ref) {
+  const uint32_t newidx = static_cast<uint32_t>(table->num_elements);
+  table->entries[newidx] = newkeyvalue;
+  if (table->string_keys) {
+    // Copy the key's bytes onto the end of the arena.
+    const HTStringKey_t* skey =
+        static_cast<const HTStringKey_t*>(newkeyvalue.key);
+    MaybeGrowArena(table, skey->len);
+    if (skey->len > 0) {
+      memcpy(table->arena + table->arena_used, skey->bytes, skey->len);
+    }
+    table->entries[newidx].key = PackStringKey(table->arena_used, skey->len);
+    table->arena_used += skey->len;
+    table->arena_live += skey->len;
+  }
+  table->links[newidx].tag = HashTag(newkeyvalue.hash);
+  table->links[newidx].next = *ref;
+  *ref = newidx;
+  if (table->order != nullptr) {
+    OrderAtTail(table, newidx);
+  }
+  table->num_elements++;
+}
+
+bool CompactTable_Find(CompactTable* table,
+                       HTHash_t hash,
+                       HTKey_t key,
+                       HTKeyValue_t* keyvalue) {
+  const uint32_t idx = FindIndex(table, hash, key, nullptr);
+  if (idx == k_ct_nil) {
+    return false;
+  }
+  *keyvalue = table->entries[idx];
+  if (table->string_keys) {
+    keyvalue->key = key;
+  }
+  CompactTable_Touch(table, idx);
+  return true;
+}
+
+bool CompactTable_Remove(CompactTable* table,
+                         HTHash_t hash,
+                         HTKey_t key,
+                         HTKeyValue_t* keyvalue) {
+  if (table->read_only) {
+    return false;
+  }
+
+  uint32_t* ref = nullptr;
+  const uint32_t idx = FindIndex(table, hash, key, &ref);
+  if (idx == k_ct_nil) {
+    return false;
+  }
+  *keyvalue = table->entries[idx];
+  if (table->string_keys) {
+    keyvalue->key = key;
+  }
+  RemoveIndex(table, idx, ref);
+  return true;
+}
+
+void CompactTable_RemoveAt(CompactTable* table,
+                           uint32_t idx,
+                           HTStringKey_t* key_view,
+                           HTKeyValue_t* keyvalue) {
+  CompactTable_GetEntry(table, idx, key_view, keyvalue);
+  uint32_t* ref =
+      &table->heads[HashKeyToBucketNum(table, table->entries[idx].hash)];
+  while (*ref != idx) {
+    ref = &table->links[*ref].next;
+  }
+  RemoveIndex(table, idx, ref);
+}
+
+uint32_t CompactTable_IndexOf(CompactTable* table,
+                              HTHash_t hash,
+                              HTKey_t key) {
+  return FindIndex(table, hash, key, nullptr);
+}
+
+uint32_t CompactTable_NextInRun(CompactTable* table, uint32_t idx) {
+  if (table->mph != nullptr) {
+    return k_ct_nil;  // keys are unique, and there are no chains
+  }
+  const uint32_t next = table->links[idx].next;
+  if (next == k_ct_nil || table->links[next].tag != table->links[idx].tag ||
+      !EntryKeysMatch(table, idx, next)) {
+    return k_ct_nil;
+  }
+  return next;
+}
+
+void CompactTable_EnableOrder(CompactTable* table, bool access_order) {
+  table->order = new CTOrder[table->capacity];
+  table->order_head = k_ct_nil;
+  table->order_tail = k_ct_nil;
+  table->access_order = access_order;
+  for (size_t i = 0; i < table->num_elements; i++) {
+    OrderAtTail(table, static_cast<uint32_t>(i));
+  }
+}
+
+void CompactTable_Touch(CompactTable* table, uint32_t idx) {
+  if (table->access_order && table->order_tail != idx) {
+    Unorder(table, idx);
+    OrderAtTail(table, idx);
+  }
+}
+
+void CompactTable_GetEntry(CompactTable* table,
+                           size_t idx,
+                           HTStringKey_t* key_view,
+                           HTKeyValue_t* keyvalue) {
+  *keyvalue = table->entries[idx];
+  if (table->string_keys) {
+    key_view->bytes = table->arena + StringKeyOffset(keyvalue->key);
+    key_view->len = StringKeyLen(keyvalue->key);
+    keyvalue->key = key_view;
+  }
+}
+
+bool CompactTable_Freeze(CompactTable* table) {
+  if (table->mph != nullptr || table->multimap || table->order != nullptr ||
+      table->timers != nullptr) {
+    return false;
+  }
+
+  const size_t n = table->num_elements;
+  HTHash_t* hashes = new HTHash_t[n];
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = table->entries[i].hash;
+  }
+  CTPerfectHash* mph = new CTPerfectHash{};
+  const bool built = PerfectHash_Build(hashes, n, mph);
+  delete[] hashes;
+  if (!built) {
+    delete mph;
+    return false;
+  }
+
+  // Move every entry to its slot.  A string-key table's keys are copied
+  // into a fresh arena in slot order, leaving any garbage behind.
+  HTKeyValue_t* entries = new HTKeyValue_t[n];
+  for (size_t i = 0; i < n; i++) {
+    entries[PerfectHash_Slot(mph, table->entries[i].hash)] = table->entries[i];
+  }
+  char* arena = nullptr;
+  if (table->string_keys) {
+    arena = new char[table->arena_live];
+    size_t used = 0;
+    for (size_t i = 0; i < n; i++) {
+      const HTKey_t packed = entries[i].key;
+      const size_t len = StringKeyLen(packed);
+      memcpy(arena + used, table->arena + StringKeyOffset(packed), len);
+      entries[i].key = PackStringKey(used, len);
+      used += len;
+    }
+  }
+
+  // Nothing refers to the old arrays any more, or to the snapshot mapping
+  // if they were in one.
+  if (!IsMapped(table, table->heads)) {
+    delete[] table->heads;
+  }
+  if (!IsMapped(table, table->links)) {
+    delete[] table->links;
+  }
+  if (!IsMapped(table, table->entries)) {
+    delete[] table->entries;
+  }
+  if (!IsMapped(table, table->arena)) {
+    delete[] table->arena;
+  }
+  if (table->map_base != nullptr) {
+    munmap(table->map_base, table->map_bytes);
+    table->map_base = nullptr;
+    table->map_bytes = 0;
+  }
+  table->num_buckets = 0;
+  table->capacity = n;
+  table->heads = nullptr;
+  table->links = nullptr;
+  table->entries = entries;
+  table->arena = arena;
+  table->arena_used = table->arena_live;
+  table->arena_capacity = table->arena_live;
+  table->read_only = true;
+  table->mph = mph;
+  return true;
+}
+
+size_t CompactTable_MemoryBytes(CompactTable* table) {
+  if (table->mph != nullptr) {
+    return sizeof(CompactTable) + PerfectHash_MemoryBytes(table->mph) +
+           table->num_elements * sizeof(HTKeyValue_t) + table->arena_capacity;
+  }
+  return sizeof(CompactTable) + table->num_buckets * sizeof(uint32_t) +
+         table->capacity * (sizeof(CTLink) + sizeof(HTKeyValue_t)) +
+         table->arena_capacity +
+         (table->timers != nullptr ? table->capacity * sizeof(HTTimer*) : 0) +
+         (table->order != nullptr ? table->capacity * sizeof(CTOrder) : 0);
+}
+
+static void MaybeResize(CompactTable* ct) {
+  // Resize if the load factor is > 3.
+  if (ct->num_elements < 3 * ct->num_buckets) {
+    return;
+  }
+
+  // Since chains are made of indices, not pointers, resizing only needs a
+  // new head array; the entries themselves stay exactly where they are.
+  uint32_t* old_heads = ct->heads;
+  const size_t old_num_buckets = ct->num_buckets;
+  ct->num_buckets *= 9;
+  ct->heads = new uint32_t[ct->num_buckets];
+  if (ct->multimap) {
+    RechainRuns(ct, old_heads, old_num_buckets);
+  } else {
+    Rechain(ct);
+  }
+  if (!IsMapped(ct, old_heads)) {
+    delete[] old_heads;
+  }
+
+  // This is also a convenient time to squeeze removed keys out of the arena.
+  if (ct->string_keys && ct->arena_live < ct->arena_used) {
+    CompactArena(ct, 0);
+  }
+}
+
+static void MaybeGrow(CompactTable* ct) {
+  if (ct->num_elements < ct->capacity) {
+    return;
+  }
+
+  // (A table opened from a snapshot may start out with no spare room at
+  // all, or even no room.)
+  size_t newcap = ct->capacity * 2;
+  if (newcap < k_initial_capacity) {
+    newcap = k_initial_capacity;
+  }
+  if (newcap > k_ct_max_elements) {
+    newcap = k_ct_max_elements;
+  }
+  CTLink* links = new CTLink[newcap];
+  HTKeyValue_t* entries = new HTKeyValue_t[newcap];
+  memcpy(links, ct->links, ct->num_elements * sizeof(CTLink));
+  memcpy(entries, ct->entries, ct->num_elements * sizeof(HTKeyValue_t));
+  if (!IsMapped(ct, ct->links)) {
+    delete[] ct->links;
+  }
+  if (!IsMapped(ct, ct->entries)) {
+    delete[] ct->entries;
+  }
+  ct->links = links;
+  ct->entries = entries;
+  if (ct->timers != nullptr) {
+    HTTimer** timers = new HTTimer*[newcap]();
+    memcpy(timers, ct->timers, ct->num_elements * sizeof(HTTimer*));
+    delete[] ct->timers;
+    ct->timers = timers;
+  }
+  if (ct->order != nullptr) {
+    CTOrder* order = new CTOrder[newcap];
+    memcpy(order, ct->order, ct->num_elements * sizeof(CTOrder));
+    delete[] ct->order;
+    ct->order = order;
+  }
+  ct->capacity = newcap;
+}
+
+static void MaybeGrowArena(CompactTable* ct, size_t len) {
+  if (ct->arena_used + len <= ct->arena_capacity) {
+    return;
+  }
+
+  // If at least half of the arena is garbage, compacting it in place of
+  // growing it keeps churn from inflating the arena without bound.
+  if (ct->arena_live <= ct->arena_used / 2 &&
+      ct->arena_live + len <= ct->arena_capacity) {
+    CompactArena(ct, len);
+    return;
+  }
+
+  size_t newcap = ct->arena_capacity * 2;
+  if (newcap < k_initial_arena_capacity) {
+    newcap = k_initial_arena_capacity;
+  }
+  while (newcap < ct->arena_used + len) {
+    newcap *= 2;
+  }
+  char* arena = new char[newcap];
+  memcpy(arena, ct->arena, ct->arena_used);
+  if (!IsMapped(ct, ct->arena)) {
+    delete[] ct->arena;
+  }
+  ct->arena = arena;
+  ct->arena_capacity = newcap;
+}
+
+static void CompactArena(CompactTable* ct, size_t spare) {
+  size_t newcap = ct->arena_capacity;
+  if (newcap < k_initial_arena_capacity) {
+    newcap = k_initial_arena_capacity;
+  }
+  while (newcap < ct->arena_live + spare) {
+    newcap *= 2;
+  }
+
+  // Copy the live keys over in entry order, which is also the order an
+  // iterator visits them in (unless the table is ordered).
+  char* arena = new char[newcap];
+  size_t used = 0;
+  for (size_t i = 0; i < ct->num_elements; i++) {
+    const HTKey_t packed = ct->entries[i].key;
+    const size_t len = StringKeyLen(packed);
+    memcpy(arena + used, ct->arena + StringKeyOffset(packed), len);
+    ct->entries[i].key = PackStringKey(used, len);
+    used += len;
+  }
+
+  if (!IsMapped(ct, ct->arena)) {
+    delete[] ct->arena;
+  }
+  ct->arena = arena;
+  ct->arena_used = used;
+  ct->arena_capacity = newcap;
+}
@@ -0,0 +1,182 @@
+#ifndef COMPACTTABLE_PRIV_HPP_
+#define COMPACTTABLE_PRIV_HPP_
+
+#include <cstdint>  // for uint32_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for the compact storage mode of
+// our HashTable implementation (see HashTable_NewCompact).
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The index used to terminate a chain and to mark an empty bucket.
+static constexpr uint32_t k_ct_nil = UINT32_MAX;
+
+// The largest number of elements a compact table can hold.
+static constexpr size_t k_ct_max_elements = k_ct_nil;
+
+// In a string-key table, each entry's key field holds the offset of the
+// key's bytes within the arena in its upper 40 bits, and their length in
+// its lower 24 bits.
+static constexpr int k_ct_key_len_bits = 24;
+static constexpr size_t k_ct_max_key_len = (1ULL << k_ct_key_len_bits) - 1;
+
+// A chain link.
+//
+// Links live in their own array, parallel to the entry array, so walking a
+// chain only touches 8 bytes per element until a hash tag matches.
+typedef struct ct_link {
+  uint32_t next;  // index of the next entry in this chain, or k_ct_nil
+  uint32_t tag;   // the upper 32 bits of the entry's hash
+} CTLink;
+
+// A link in an ordered table's iteration order.
+//
+// Like chain links, these live in an array parallel to the entries, and
+// refer to entries by index.
+typedef struct ct_order {
+  uint32_t prev;  // index of the entry before this one, or k_ct_nil
+  uint32_t next;  // index of the entry after this one, or k_ct_nil
+} CTOrder;
+
+struct ht_timer;  // an entry's expiry timer; see TableExpiry_priv.hpp
+struct ct_mph;    // a frozen table's perfect hash; see PerfectHash_priv.hpp
+
+// The compact table.
+//
+// All elements live densely packed in entries[0, num_elements), so there
+// are no holes to skip when iterating.  Removing an element moves the last
+// entry into the vacated slot.  Buckets and chains refer to entries by
+// 32-bit index rather than by pointer.
+//
+// A string-key table additionally owns an arena holding the bytes of its
+// keys, which are compared with memcmp instead of key_cmp_fn.  Removing a
+// key leaves its bytes behind as garbage until the arena is compacted.
+//
+// In a multimap (see HashTable_EnableMultimap), entries with equal keys
+// sit next to each other in their chain, as a "run".  Resizing rebuilds
+// the chains in a way that keeps each run together.
+//
+// A table with expiry enabled (see HashTable_EnableExpiry) also keeps an
+// array of timer pointers parallel to its entries, which moves with them.
+// Likewise, an ordered table (see HashTable_EnableOrder) threads its
+// entries onto a doubly-linked order list through a parallel array of
+// CTOrders, from order_head to order_tail.
+//
+// A frozen table (see HashTable_Freeze) has no buckets or chains at all:
+// its entries sit in the slots its perfect hash gives their hashes, and a
+// string-key table's arena holds exactly their keys' bytes, in slot order.
+// It is read-only for good.
+//
+// A table opened from a snapshot (see TableImage_priv.hpp) starts out with
+// its arrays pointing into a private file mapping.  Arrays are only ever
+// replaced by heap copies, never freed, while they lie inside the mapping.
+typedef struct ct {
+  size_t num_buckets;        // # of buckets in this table
+  size_t num_elements;       // # of elements currently in this table
+  size_t capacity;           // # of slots allocated in links and entries
+  uint32_t* heads;           // per-bucket index of the first entry
+  CTLink* links;             // per-entry chain links
+  HTKeyValue_t* entries;     // per-entry (hash,key,value)s
+  KeyCmpFnPtr key_cmp_fn;    // to check for key collisions
+  bool string_keys;          // are keys stored in the arena?
+  char* arena;               // key bytes, or nullptr
+  size_t arena_used;         // # of bytes appended to the arena
+  size_t arena_capacity;     // # of bytes allocated for the arena
+  size_t arena_live;         // # of arena bytes belonging to current keys
+  void* map_base;            // the snapshot mapping, or nullptr
+  size_t map_bytes;          // the length of the snapshot mapping
+  bool read_only;            // refuse all mutations?
+  bool multimap;             // may several entries hold equal keys?
+  struct ht_timer** timers;  // per-entry expiry timers, or nullptr
+  CTOrder* order;            // per-entry order links, or nullptr
+  uint32_t order_head;       // the first entry in order, or k_ct_nil
+  uint32_t order_tail;       // the last entry in order, or k_ct_nil
+  bool access_order;         // do finds and replacements move entries?
+  struct ct_mph* mph;        // the perfect hash, if frozen, or nullptr
+} CompactTable;
+
+// Allocate and return a new, empty compact table; num_buckets must be
+// greater than zero.
+CompactTable* CompactTable_New(size_t num_buckets,
+                               KeyCmpFnPtr key_compare_function);
+
+// Allocate and return a new, empty string-key compact table; num_buckets
+// must be greater than zero.
+CompactTable* CompactTable_NewStringKeys(size_t num_buckets);
+
+// Deallocate a compact table, invoking kv_free_function (if non-nullptr)
+// on each element.
+void CompactTable_Delete(CompactTable* table,
+                         KeyValueFreeFnPtr kv_free_function);
+
+// Appends a (key,value) whose key is known not to be in the table yet,
+// without ever resizing the table.  For a string-key table, the key must
+// point to an HTStringKey_t.  Used to build snapshots of chained tables.
+void CompactTable_Append(CompactTable* table, HTKeyValue_t keyvalue);
+
+// These have the same contract as HashTable_Insert, HashTable_Find and
+// HashTable_Remove respectively.  In a multimap, insert adds the new entry
+// at the front of its key's run.
+bool CompactTable_Insert(CompactTable* table,
+                         HTKeyValue_t newkeyvalue,
+                         HTKeyValue_t* oldkeyvalue);
+bool CompactTable_Find(CompactTable* table,
+                       HTHash_t hash,
+                       HTKey_t key,
+                       HTKeyValue_t* keyvalue);
+bool CompactTable_Remove(CompactTable* table,
+                         HTHash_t hash,
+                         HTKey_t key,
+                         HTKeyValue_t* keyvalue);
+
+// Removes entry idx, returning it as CompactTable_GetEntry would.  The
+// bytes of a string key stay valid until the table next resizes.
+void CompactTable_RemoveAt(CompactTable* table,
+                           uint32_t idx,
+                           HTStringKey_t* key_view,
+                           HTKeyValue_t* keyvalue);
+
+// Returns the index of the entry holding key, or k_ct_nil if there is
+// none.
+uint32_t CompactTable_IndexOf(CompactTable* table,
+                              HTHash_t hash,
+                              HTKey_t key);
+
+// Returns the entry after idx in idx's run (that is, the next entry in its
+// chain, if that holds an equal key), or k_ct_nil if idx is the last.
+uint32_t CompactTable_NextInRun(CompactTable* table, uint32_t idx);
+
+// Starts keeping the table's entries in order, threading any it already
+// has in index order.  If access_order is true, finding or replacing an
+// entry moves it to the end of the order.
+void CompactTable_EnableOrder(CompactTable* table, bool access_order);
+
+// Moves entry idx to the end of the order if the table is kept in access
+// order; otherwise does nothing.
+void CompactTable_Touch(CompactTable* table, uint32_t idx);
+
+// Copies entry idx into keyvalue.  For a string-key table, keyvalue->key is
+// set to key_view, which is filled in to describe the table's copy of the
+// key.
+void CompactTable_GetEntry(CompactTable* table,
+                           size_t idx,
+                           HTStringKey_t* key_view,
+                           HTKeyValue_t* keyvalue);
+
+// Rebuilds the table in frozen form, over a perfect hash of its entries'
+// hashes.  Returns false, leaving the table as it was, if it is already
+// frozen, is a multimap, is ordered, has expiry enabled, or holds two
+// entries with equal hashes.
+bool CompactTable_Freeze(CompactTable* table);
+
+// Returns the number of bytes allocated for the table's own bookkeeping,
+// not counting anything the keys or values point to.
+size_t CompactTable_MemoryBytes(CompactTable* table);
+
+#endif  // COMPACTTABLE_PRIV_HPP_
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "ConcurrentQueue.hpp"
+#include "ConcurrentQueue_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Hazard pointers.
+//
+// Every queue shares one list of hazard records.  A popped node is
+// "retired" onto the popping thread's record, and once enough have piled up
+// the thread frees every retired node that no record has published.
+//
+
+// The list of records; records are only ever pushed onto its front.
+static std::atomic<CQHazardRecord*> g_hazard_records{nullptr};
+static std::atomic<size_t> g_num_hazard_records{0};
+
+// Owns the calling thread's record, and gives it back when the thread
+// exits.  Its retired nodes stay with the record for the next owner.
+struct HazardOwner {
+  CQHazardRecord* record = nullptr;
+  ~HazardOwner() {
+    if (record != nullptr) {
+      for (auto& hazard : record->hazards) {
+        hazard.store(nullptr);
+      }
+      record->active.store(false);
+    }
+  }
+};
+static thread_local HazardOwner g_hazard_owner;
+
+// Returns the calling thread's record, claiming one if need be.
+static CQHazardRecord* MyRecord() {
+  if (g_hazard_owner.record != nullptr) {
+    return g_hazard_owner.record;
+  }
+
+  // Reuse a record a thread has given back, if there is one...
+  for (CQHazardRecord* rec = g_hazard_records.load(); rec != nullptr;
+       rec = rec->next) {
+    bool active = false;
+    if (!rec->active.load(std::memory_order_relaxed) &&
+        rec->active.compare_exchange_strong(active, true)) {
+      g_hazard_owner.record = rec;
+      return rec;
+    }
+  }
+
+  // ...or else add a new one.
+  CQHazardRecord* rec = new CQHazardRecord();
+  for (auto& hazard : rec->hazards) {
+    hazard.store(nullptr, std::memory_order_relaxed);
+  }
+  rec->active.store(true, std::memory_order_relaxed);
+  rec->next = g_hazard_records.load();
+  while (!g_hazard_records.compare_exchange_weak(rec->next, rec)) {
+  }
+  g_num_hazard_records.fetch_add(1);
+  g_hazard_owner.record = rec;
+  return rec;
+}
+
+// Publishes the node that "from" points to in hazard slot i, and returns
+// it.  Re-reads "from" after publishing, so that the node returned was still
+// linked in (and so not yet retired) at a time when the hazard was visible.
+static CQNode* Protect(CQHazardRecord* rec,
+                       int i,
+                       const std::atomic<CQNode*>& from) {
+  CQNode* node = from.load();
+  while (true) {
+    rec->hazards[i].store(node);
+    CQNode* again = from.load();
+    if (again == node) {
+      return node;
+    }
+    node = again;
+  }
+}
+
+// Clears all of rec's hazard slots.
+static void ClearHazards(CQHazardRecord* rec) {
+  for (auto& hazard : rec->hazards) {
+    hazard.store(nullptr, std::memory_order_release);
+  }
+}
+
+// Frees each of rec's retired nodes that no thread has published.
+static void Scan(CQHazardRecord* rec) {
+  std::vector<CQNode*> published;
+  for (CQHazardRecord* other = g_hazard_records.load(); other != nullptr;
+       other = other->next) {
+    for (auto& hazard : other->hazards) {
+      CQNode* node = hazard.load();
+      if (node != nullptr) {
+        published.push_back(node);
+      }
+    }
+  }
+  std::sort(published.begin(), published.end());
+
+  size_t kept = 0;
+  for (CQNode* node : rec->retired) {
+    if (std::binary_search(published.begin(), published.end(), node)) {
+      rec->retired[kept++] = node;
+    } else {
+      delete node;
+    }
+  }
+  rec->retired.resize(kept);
+}
+
+// Retires a node that has been unlinked from its queue.  Scans once the
+// retired nodes outnumber the hazards by enough that each scan frees at
+// least as many nodes as it has to look at hazards.
+static void Retire(CQHazardRecord* rec, CQNode* node) {
+  rec->retired.push_back(node);
+  const size_t threshold = 2 * k_cq_hazards * g_num_hazard_records.load() + 64;
+  if (rec->retired.size() >= threshold) {
+    Scan(rec);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ConcurrentQueue implementation.
+
+static CQNode* NewNode(LLPayload_t payload) {
+  CQNode* node = new CQNode;
+  node->payload = payload;
+  node->next.store(nullptr, std::memory_order_relaxed);
+  return node;
+}
+
+ConcurrentQueue* ConcurrentQueue_New() {
+  ConcurrentQueue* queue = new ConcurrentQueue();
+  CQNode* dummy = NewNode(nullptr);
+  queue->head.store(dummy);
+  queue->tail.store(dummy);
+  return queue;
+}
+
+void ConcurrentQueue_Delete(ConcurrentQueue* queue,
+                            LLPayloadFreeFnPtr payload_free_function) {
+  CQNode* node = queue->head.load();
+  CQNode* next = node->next.load();
+  delete node;
+  for (node = next; node != nullptr; node = next) {
+    next = node->next.load();
+    payload_free_function(node->payload);
+    delete node;
+  }
+  delete queue;
+}
+
+void ConcurrentQueue_Append(ConcurrentQueue* queue, LLPayload_t payload) {
+  ConcurrentQueue_AppendMany(queue, &payload, 1);
+}
+
+void ConcurrentQueue_AppendMany(ConcurrentQueue* queue,
+                                const LLPayload_t* payloads,
+                                size_t num_payloads) {
+  if (num_payloads == 0) {
+    return;
+  }
+
+  // Build the chain of new nodes privately.
+  CQNode* first = NewNode(payloads[0]);
+  CQNode* last = first;
+  for (size_t i = 1; i < num_payloads; i++) {
+    CQNode* node = NewNode(payloads[i]);
+    last->next.store(node, std::memory_order_relaxed);
+    last = node;
+  }
+
+  CQHazardRecord* rec = MyRecord();
+  while (true) {
+    CQNode* tail = Protect(rec, 0, queue->tail);
+    CQNode* next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      // tail is lagging; help swing it forward, then try again.
+      queue->tail.compare_exchange_strong(tail, next);
+      continue;
+    }
+    if (tail->next.compare_exchange_weak(next, first,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+      // Linked in.  Swing tail to the end of the chain; if this fails,
+      // someone has already helped it along.
+      queue->tail.compare_exchange_strong(tail, last);
+      break;
+    }
+  }
+  ClearHazards(rec);
+}
+
+bool ConcurrentQueue_Pop(ConcurrentQueue* queue, LLPayload_t* payload_ptr) {
+  return ConcurrentQueue_PopMany(queue, payload_ptr, 1) == 1;
+}
+
+size_t ConcurrentQueue_PopMany(ConcurrentQueue* queue,
+                               LLPayload_t* payloads,
+                               size_t max_payloads) {
+  if (max_payloads == 0) {
+    return 0;
+  }
+
+  CQHazardRecord* rec = MyRecord();
+  while (true) {
+    CQNode* head = Protect(rec, 0, queue->head);
+
+    // Walk forward from head hand over hand, alternating between hazard
+    // slots 1 and 2, and copy out the payloads we pass.  Each node is safe
+    // to read once it is published and head is seen to be unchanged: it
+    // can't have been retired while head still came before it.
+    CQNode* last = head;
+    size_t count = 0;
+    bool raced = false;
+    while (count < max_payloads) {
+      CQNode* next = last->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        break;
+      }
+      rec->hazards[1 + count % 2].store(next);
+      if (queue->head.load() != head) {
+        raced = true;
+        break;
+      }
+
+      // Never let head pass tail: help tail over any node we pass.
+      CQNode* tail = last;
+      queue->tail.compare_exchange_strong(tail, next);
+
+      payloads[count++] = next->payload;
+      last = next;
+    }
+    if (raced) {
+      continue;
+    }
+    if (count == 0) {
+      ClearHazards(rec);
+      return 0;
+    }
+
+    // Unlink the nodes we walked past; "last" becomes the new dummy.
+    CQNode* expected = head;
+    if (!queue->head.compare_exchange_strong(expected, last)) {
+      continue;
+    }
+    ClearHazards(rec);
+    for (CQNode* node = head; node != last;) {
+      CQNode* next = node->next.load(std::memory_order_relaxed);
+      Retire(rec, node);
+      node = next;
+    }
+    return count;
+  }
+}
+
+size_t ConcurrentQueue_NumRetired() {
+  size_t num_retired = 0;
+  for (CQHazardRecord* rec = g_hazard_records.load(); rec != nullptr;
+       rec = rec->next) {
+    num_retired += rec->retired.size();
+  }
+  return num_retired;
+}
@@ -0,0 +1,61 @@
+#ifndef CONCURRENTQUEUE_HPP_
+#define CONCURRENTQUEUE_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./LinkedList.hpp"  // for LLPayload_t and LLPayloadFreeFnPtr
+
+///////////////////////////////////////////////////////////////////////////////
+// A ConcurrentQueue is a FIFO queue of payloads that any number of threads
+// may append to and pop from at once, without locks.
+//
+// It fills the role of a LinkedList used as a work queue (LinkedList_Append
+// at one end, LinkedList_Pop at the other) behind a mutex, but threads never
+// wait for one another: an operation delayed part-way through is finished
+// off by whichever thread runs into it.
+//
+// It is a Michael-Scott queue: a singly-linked list of nodes whose head is
+// a "dummy" node, with the head and tail each swung forward by a
+// compare-and-swap.  Nodes that have been popped are freed only once no
+// thread can still be looking at them, which is tracked with hazard
+// pointers.
+typedef struct cq ConcurrentQueue;
+
+// Allocate and return a new, empty queue.  The caller takes responsibility
+// for eventually calling ConcurrentQueue_Delete.
+ConcurrentQueue* ConcurrentQueue_New();
+
+// Free a queue, invoking payload_free_function on each payload still in it.
+// No other thread may be using the queue.
+void ConcurrentQueue_Delete(ConcurrentQueue* queue,
+                            LLPayloadFreeFnPtr payload_free_function);
+
+// Add a payload to the tail of the queue.
+void ConcurrentQueue_Append(ConcurrentQueue* queue, LLPayload_t payload);
+
+// Add num_payloads payloads to the tail of the queue, in order.  They are
+// linked in with a single compare-and-swap, so they stay contiguous in the
+// queue and other threads see either none or all of them.
+void ConcurrentQueue_AppendMany(ConcurrentQueue* queue,
+                                const LLPayload_t* payloads,
+                                size_t num_payloads);
+
+// Remove the payload at the head of the queue, returning it through
+// payload_ptr.
+//
+// Returns:
+// - false if the queue was empty.
+// - true if a payload was removed.
+bool ConcurrentQueue_Pop(ConcurrentQueue* queue, LLPayload_t* payload_ptr);
+
+// Remove up to max_payloads payloads from the head of the queue, in order,
+// into the array "payloads".  They are unlinked with a single
+// compare-and-swap.
+//
+// Returns:
+// - the number of payloads removed; 0 if the queue was empty.
+size_t ConcurrentQueue_PopMany(ConcurrentQueue* queue,
+                               LLPayload_t* payloads,
+                               size_t max_payloads);
+
+#endif  // CONCURRENTQUEUE_HPP_
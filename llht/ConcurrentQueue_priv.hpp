@@ -0,0 +1,57 @@
+#ifndef CONCURRENTQUEUE_PRIV_HPP_
+#define CONCURRENTQUEUE_PRIV_HPP_
+
+#include <atomic>   // for std::atomic
+#include <cstddef>  // for size_t
+#include <vector>   // for std::vector
+
+#include "./ConcurrentQueue.hpp"  // for ConcurrentQueue
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our ConcurrentQueue
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// A single node within a queue.  Like a LinkedListNode, but singly linked,
+// and the link is atomic.  The payload is written before the node is linked
+// in and read before it is unlinked, so it needs no synchronization of its
+// own.
+typedef struct cq_node {
+  LLPayload_t payload;                // customer-supplied payload pointer
+  std::atomic<struct cq_node*> next;  // next node in queue, or nullptr
+} CQNode;
+
+// The entire queue.  head is a dummy node: the payloads in the queue are
+// those of the nodes after it.  tail is the last node, or lags at most a
+// node or so behind it while an append is in flight; it never falls behind
+// head.  The two are kept on separate cache lines so that appending and
+// popping threads don't contend for one.
+typedef struct cq {
+  alignas(64) std::atomic<CQNode*> head;
+  alignas(64) std::atomic<CQNode*> tail;
+} ConcurrentQueue;
+
+// The number of hazard pointers each thread has: one for the node at the
+// head (or tail), plus two to walk forward from it hand over hand.
+static constexpr int k_cq_hazards = 3;
+
+// A thread's hazard pointers.  A thread publishes in hazards[] the nodes it
+// is about to look at; no node is freed while it is published.  Records are
+// shared by every queue, are never freed, and are handed from thread to
+// thread: each thread claims one (via "active") the first time it needs
+// one, and gives it back when it exits.
+typedef struct cq_hazard_record {
+  std::atomic<CQNode*> hazards[k_cq_hazards];
+  std::atomic<bool> active;         // is a thread using this record?
+  struct cq_hazard_record* next;    // next record; set before publishing
+  std::vector<CQNode*> retired;     // unlinked nodes waiting to be freed
+} CQHazardRecord;
+
+// Returns the number of nodes retired by threads so far but not yet freed;
+// not thread-safe.  For tests.
+size_t ConcurrentQueue_NumRetired();
+
+#endif  // CONCURRENTQUEUE_PRIV_HPP_
@@ -0,0 +1,175 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "CompactTable_priv.hpp"
+#include "GroupBy.hpp"
+#include "GroupBy_priv.hpp"
+#include "HashTable.hpp"
+#include "WorkStealing.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The state shared by the slices and partitions of a group-by.  tables
+// holds a row of num_parts tables per slice.
+typedef struct {
+  const HTKeyValue_t* records;
+  size_t n;
+  size_t num_slices;
+  size_t num_parts;
+  int radix_bits;
+  KeyCmpFnPtr key_cmp_fn;
+  GBCombineFnPtr combine_fn;
+  GBEmitFnPtr emit_fn;
+  void* arg;
+  CompactTable** tables;
+  std::atomic<size_t> num_groups;
+} GroupByPass;
+
+static CompactTable** TablesOf(GroupByPass* pass, size_t slice) {
+  return &pass->tables[slice * pass->num_parts];
+}
+
+// Runs fn over [0, n) on pool, or on this thread if pool is nullptr.
+static void ForEach(ForkJoinPool* pool, size_t n, FJRangeFnPtr fn, void* arg) {
+  if (pool == nullptr) {
+    fn(0, n, arg);
+  } else {
+    ForkJoinPool_ParallelFor(pool, 0, n, 1, fn, arg);
+  }
+}
+
+// Aggregates each slice's records into the slice's own tables.
+static void AggregateSlices(size_t begin, size_t end, void* arg) {
+  GroupByPass* pass = static_cast<GroupByPass*>(arg);
+  for (size_t s = begin; s < end; s++) {
+    CompactTable** tables = TablesOf(pass, s);
+    for (size_t p = 0; p < pass->num_parts; p++) {
+      tables[p] = CompactTable_New(k_gb_initial_buckets, pass->key_cmp_fn);
+    }
+    const size_t first = pass->n * s / pass->num_slices;
+    const size_t last = pass->n * (s + 1) / pass->num_slices;
+    for (size_t i = first; i < last; i++) {
+      const HTKeyValue_t& record = pass->records[i];
+      GroupBy_Aggregate(
+          tables[GroupBy_PartitionOf(record.hash, pass->radix_bits)], record,
+          pass->combine_fn);
+    }
+  }
+}
+
+// Merges every slice's table for each partition into the biggest of them,
+// and emits the partition's groups straight out of its entries.
+static void MergePartitions(size_t begin, size_t end, void* arg) {
+  GroupByPass* pass = static_cast<GroupByPass*>(arg);
+  size_t num_groups = 0;
+  for (size_t p = begin; p < end; p++) {
+    size_t biggest = 0;
+    for (size_t s = 1; s < pass->num_slices; s++) {
+      if (TablesOf(pass, s)[p]->num_elements >
+          TablesOf(pass, biggest)[p]->num_elements) {
+        biggest = s;
+      }
+    }
+    CompactTable* merged = TablesOf(pass, biggest)[p];
+    for (size_t s = 0; s < pass->num_slices; s++) {
+      CompactTable* table = TablesOf(pass, s)[p];
+      if (s == biggest) {
+        continue;
+      }
+      for (size_t i = 0; i < table->num_elements; i++) {
+        GroupBy_Aggregate(merged, table->entries[i], pass->combine_fn);
+      }
+      CompactTable_Delete(table, nullptr);
+    }
+
+    for (size_t i = 0; i < merged->num_elements; i += k_gb_emit_batch) {
+      const size_t count = (merged->num_elements - i > k_gb_emit_batch)
+                               ? k_gb_emit_batch
+                               : merged->num_elements - i;
+      pass->emit_fn(&merged->entries[i], count, pass->arg);
+    }
+    num_groups += merged->num_elements;
+    CompactTable_Delete(merged, nullptr);
+  }
+  pass->num_groups.fetch_add(num_groups, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GroupBy implementation.
+
+int GroupBy_PickRadixBits(int num_threads) {
+  if (num_threads <= 1) {
+    return 0;
+  }
+  const size_t wanted =
+      static_cast<size_t>(num_threads) * k_gb_partitions_per_thread;
+  int bits = 0;
+  while (bits < k_gb_max_radix_bits &&
+         (static_cast<size_t>(1) << bits) < wanted) {
+    bits++;
+  }
+  return bits;
+}
+
+void GroupBy_Aggregate(CompactTable* table,
+                       HTKeyValue_t record,
+                       GBCombineFnPtr combine_function) {
+  // Most records belong to a group the table already has, so look the key
+  // up on its own first, and only insert (looking it up again) if it's new.
+  const uint32_t idx = CompactTable_IndexOf(table, record.hash, record.key);
+  if (idx != k_ct_nil) {
+    table->entries[idx].value =
+        combine_function(table->entries[idx].value, record.value);
+    return;
+  }
+  HTKeyValue_t old;
+  CompactTable_Insert(table, record, &old);
+}
+
+size_t GroupBy_Run(const HTKeyValue_t* records,
+                   size_t num_records,
+                   KeyCmpFnPtr key_compare_function,
+                   GBCombineFnPtr combine_function,
+                   const GBOptions_t* options,
+                   GBEmitFnPtr emit_function,
+                   void* arg) {
+  if (num_records == 0) {
+    return 0;
+  }
+  ForkJoinPool* pool = (options != nullptr) ? options->pool : nullptr;
+  const int num_threads = (pool != nullptr) ? ForkJoinPool_NumThreads(pool)
+                                            : 1;
+  int radix_bits = (options != nullptr) ? options->radix_bits : 0;
+  if (radix_bits <= 0) {
+    radix_bits = GroupBy_PickRadixBits(num_threads);
+  } else if (radix_bits > k_gb_max_radix_bits) {
+    radix_bits = k_gb_max_radix_bits;
+  }
+
+  // A slice per thread, though a thread that finishes early may steal
+  // another's slice before it starts.
+  GroupByPass pass;
+  pass.records = records;
+  pass.n = num_records;
+  pass.num_slices = static_cast<size_t>(num_threads);
+  if (pass.num_slices > num_records) {
+    pass.num_slices = num_records;
+  }
+  pass.num_parts = static_cast<size_t>(1) << radix_bits;
+  pass.radix_bits = radix_bits;
+  pass.key_cmp_fn = key_compare_function;
+  pass.combine_fn = combine_function;
+  pass.emit_fn = emit_function;
+  pass.arg = arg;
+  pass.tables = new CompactTable*[pass.num_slices * pass.num_parts];
+  pass.num_groups.store(0, std::memory_order_relaxed);
+
+  ForEach(pool, pass.num_slices, &AggregateSlices, &pass);
+  ForEach(pool, pass.num_parts, &MergePartitions, &pass);
+
+  delete[] pass.tables;
+  return pass.num_groups.load(std::memory_order_relaxed);
+}
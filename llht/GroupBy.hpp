@@ -0,0 +1,74 @@
+#ifndef GROUPBY_HPP_
+#define GROUPBY_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"     // for HTKeyValue_t and KeyCmpFnPtr
+#include "./WorkStealing.hpp"  // for ForkJoinPool
+
+///////////////////////////////////////////////////////////////////////////////
+// A group-by aggregates a set of records (HTKeyValue_ts) by key: all the
+// records with equal keys are combined into a single "group".
+//
+// Doing that with HashTable_Find then HashTable_Insert per record looks
+// every key up twice, on a single thread.  GroupBy_Run instead gives each
+// of a pool's threads a slice of the records to aggregate on its own,
+// into tables of its own, so that threads never contend.  Each thread's
+// groups are split between partitions by the high bits of their hashes,
+// with a compact table per partition.  Once every slice is done, the
+// threads' tables for each partition are merged, partitions in parallel.
+//
+// A record's value is combined into its group's value in place, so
+// aggregates that fit in a value slot (counts, sums of small integers,
+// minimums and so on) take no allocation at all.
+
+// Combines value into the value of its group, acc, and returns the result.
+// It must be associative and commutative, since records are combined in no
+// particular order, and groups are combined with one another when they are
+// merged.  It may be called from several threads at once.
+typedef HTValue_t (*GBCombineFnPtr)(HTValue_t acc, HTValue_t value);
+
+// Receives a batch of groups, which are only valid during the call.  Each
+// group's key is that of one of its records, and its value is all of their
+// values combined.  Unless the group-by runs on a single thread, it may be
+// called from several threads at once.
+typedef void (*GBEmitFnPtr)(const HTKeyValue_t* groups,
+                            size_t num_groups,
+                            void* arg);
+
+// How to run a group-by.
+typedef struct {
+  ForkJoinPool* pool;  // runs slices and merges in parallel; may be nullptr
+  int radix_bits;      // log2 of the # of partitions, up to 12; 0 picks
+} GBOptions_t;
+
+// Aggregates records by key, handing every group to emit_function, in
+// batches.  Records are in the same group if their hashes are equal and
+// key_compare_function says their keys are.  The first record of a group
+// that a thread comes across gives the group its starting value, and every
+// other record's value is combined into it with combine_function.  Groups
+// come out in no particular order.
+//
+// For example, counting records by key is a group-by of records whose
+// values are all 1, combined by adding them up.
+//
+// Arguments:
+// - records, num_records: the records to aggregate.
+// - key_compare_function: a function pointer to compare two keys; see
+//   HashTable_New.  It may be called from several threads at once.
+// - combine_function: combines values.
+// - options: how to run the group-by, or nullptr to run it on the calling
+//   thread.
+// - emit_function: receives the groups.
+// - arg: passed through to emit_function.
+//
+// Returns the number of groups emitted.
+size_t GroupBy_Run(const HTKeyValue_t* records,
+                   size_t num_records,
+                   KeyCmpFnPtr key_compare_function,
+                   GBCombineFnPtr combine_function,
+                   const GBOptions_t* options,
+                   GBEmitFnPtr emit_function,
+                   void* arg);
+
+#endif  // GROUPBY_HPP_
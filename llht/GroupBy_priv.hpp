@@ -0,0 +1,51 @@
+#ifndef GROUPBY_PRIV_HPP_
+#define GROUPBY_PRIV_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./CompactTable_priv.hpp"  // for CompactTable
+#include "./GroupBy.hpp"
+#include "./HashTable.hpp"          // for HTKeyValue_t and HTHash_t
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our GroupBy
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// When picking the number of partitions, aim for this many per thread, so
+// that the merges balance out between threads even if some partitions
+// hold more groups than others.
+static constexpr size_t k_gb_partitions_per_thread = 4;
+
+// The most partitions a group-by uses, as log2.
+static constexpr int k_gb_max_radix_bits = 12;
+
+// The number of buckets each partition's table starts out with; they grow
+// as usual.
+static constexpr size_t k_gb_initial_buckets = 16;
+
+// Groups are handed to the emit function this many at a time.
+static constexpr size_t k_gb_emit_batch = 256;
+
+// Returns the number of radix bits GroupBy_Run picks for num_threads
+// threads.  A single thread needs no partitions, since there is nothing
+// to merge.
+int GroupBy_PickRadixBits(int num_threads);
+
+// Returns the partition a hash falls in.
+static inline size_t GroupBy_PartitionOf(HTHash_t hash, int radix_bits) {
+  // Compact tables pick buckets with the low bits of the hash, so the
+  // partitions are picked with the high bits.
+  return radix_bits == 0 ? 0 : hash >> (64 - radix_bits);
+}
+
+// Combines a record into table: adds it if its key is new, or combines its
+// value into the existing entry's, in place.
+void GroupBy_Aggregate(CompactTable* table,
+                       HTKeyValue_t record,
+                       GBCombineFnPtr combine_function);
+
+#endif  // GROUPBY_PRIV_HPP_
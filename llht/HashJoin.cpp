@@ -0,0 +1,253 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "CompactTable_priv.hpp"
+#include "HashJoin.hpp"
+#include "HashJoin_priv.hpp"
+#include "HashTable.hpp"
+#include "WorkStealing.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The state shared by the chunks of a partitioning pass.  counts holds a
+// row of num_parts counters per chunk: first each partition's number of
+// records in the chunk, then where the chunk's first record for it goes.
+typedef struct {
+  const HTKeyValue_t* records;
+  size_t n;
+  size_t num_chunks;
+  size_t num_parts;
+  int radix_bits;
+  size_t* counts;
+  HTKeyValue_t* rows;
+} PartitionPass;
+
+static size_t ChunkStart(const PartitionPass* pass, size_t chunk) {
+  return pass->n * chunk / pass->num_chunks;
+}
+
+static void HistogramChunks(size_t begin, size_t end, void* arg) {
+  PartitionPass* pass = static_cast<PartitionPass*>(arg);
+  for (size_t c = begin; c < end; c++) {
+    size_t* counts = &pass->counts[c * pass->num_parts];
+    for (size_t i = ChunkStart(pass, c); i < ChunkStart(pass, c + 1); i++) {
+      counts[HashJoin_PartitionOf(pass->records[i].hash, pass->radix_bits)]++;
+    }
+  }
+}
+
+static void ScatterChunks(size_t begin, size_t end, void* arg) {
+  PartitionPass* pass = static_cast<PartitionPass*>(arg);
+  for (size_t c = begin; c < end; c++) {
+    size_t* cursors = &pass->counts[c * pass->num_parts];
+    for (size_t i = ChunkStart(pass, c); i < ChunkStart(pass, c + 1); i++) {
+      const HTKeyValue_t& record = pass->records[i];
+      pass->rows[cursors[HashJoin_PartitionOf(record.hash,
+                                              pass->radix_bits)]++] = record;
+    }
+  }
+}
+
+// Runs fn over [0, n) on pool, or on this thread if pool is nullptr.
+static void ForEach(ForkJoinPool* pool, size_t n, FJRangeFnPtr fn, void* arg) {
+  if (pool == nullptr) {
+    fn(0, n, arg);
+  } else {
+    ForkJoinPool_ParallelFor(pool, 0, n, 1, fn, arg);
+  }
+}
+
+// The state shared by the partitions of a join.
+typedef struct {
+  HJPartitions build;
+  HJPartitions probe;
+  KeyCmpFnPtr key_cmp_fn;
+  HJEmitFnPtr emit_fn;
+  void* arg;
+  std::atomic<size_t> num_matches;
+} JoinPass;
+
+// Buffers matches on their way to the emit function.
+typedef struct {
+  HJMatch_t matches[k_hj_emit_batch];
+  size_t num_buffered;
+  size_t num_emitted;
+} Emitter;
+
+static void Flush(JoinPass* pass, Emitter* emitter) {
+  if (emitter->num_buffered > 0) {
+    pass->emit_fn(emitter->matches, emitter->num_buffered, pass->arg);
+    emitter->num_emitted += emitter->num_buffered;
+    emitter->num_buffered = 0;
+  }
+}
+
+static void Emit(JoinPass* pass,
+                 Emitter* emitter,
+                 const HTKeyValue_t& build,
+                 const HTKeyValue_t& probe) {
+  emitter->matches[emitter->num_buffered++] = HJMatch_t{build, probe};
+  if (emitter->num_buffered == k_hj_emit_batch) {
+    Flush(pass, emitter);
+  }
+}
+
+// Joins partition p of the build side with partition p of the probe side.
+static void JoinPartition(JoinPass* pass, size_t p, Emitter* emitter) {
+  const HTKeyValue_t* build = pass->build.rows;
+  const HTKeyValue_t* probe = pass->probe.rows;
+  const size_t build_begin = pass->build.starts[p];
+  const size_t build_end = pass->build.starts[p + 1];
+  const size_t probe_begin = pass->probe.starts[p];
+  const size_t probe_end = pass->probe.starts[p + 1];
+  if (build_begin == build_end || probe_begin == probe_end) {
+    return;
+  }
+
+  CompactTable* ct = CompactTable_New(build_end - build_begin,
+                                      pass->key_cmp_fn);
+  ct->multimap = true;
+  HTKeyValue_t old;
+  for (size_t i = build_begin; i < build_end; i++) {
+    CompactTable_Insert(ct, build[i], &old);
+  }
+
+  // Each lookup is a chain of dependent loads (bucket head, then chain
+  // links and entries), so a batch of probes first has its bucket heads
+  // loaded, then its first links and entries, and only then is looked
+  // up, by which time most of what the lookups need is in cache.
+  for (size_t batch = probe_begin; batch < probe_end;
+       batch += k_hj_probe_batch) {
+    const size_t batch_end = (probe_end - batch > k_hj_probe_batch)
+                                 ? batch + k_hj_probe_batch
+                                 : probe_end;
+    for (size_t i = batch; i < batch_end; i++) {
+      __builtin_prefetch(&ct->heads[probe[i].hash % ct->num_buckets]);
+    }
+    for (size_t i = batch; i < batch_end; i++) {
+      const uint32_t head = ct->heads[probe[i].hash % ct->num_buckets];
+      if (head != k_ct_nil) {
+        __builtin_prefetch(&ct->links[head]);
+        __builtin_prefetch(&ct->entries[head]);
+      }
+    }
+    for (size_t i = batch; i < batch_end; i++) {
+      for (uint32_t idx = CompactTable_IndexOf(ct, probe[i].hash,
+                                               probe[i].key);
+           idx != k_ct_nil; idx = CompactTable_NextInRun(ct, idx)) {
+        Emit(pass, emitter, ct->entries[idx], probe[i]);
+      }
+    }
+  }
+  CompactTable_Delete(ct, nullptr);
+}
+
+static void JoinPartitions(size_t begin, size_t end, void* arg) {
+  JoinPass* pass = static_cast<JoinPass*>(arg);
+  Emitter emitter;
+  emitter.num_buffered = 0;
+  emitter.num_emitted = 0;
+  for (size_t p = begin; p < end; p++) {
+    JoinPartition(pass, p, &emitter);
+  }
+  Flush(pass, &emitter);
+  pass->num_matches.fetch_add(emitter.num_emitted, std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashJoin implementation.
+
+int HashJoin_PickRadixBits(size_t num_build) {
+  int bits = 0;
+  while (bits < k_hj_max_radix_bits &&
+         (num_build >> bits) > k_hj_partition_rows) {
+    bits++;
+  }
+  return bits;
+}
+
+void HashJoin_Partition(const HTKeyValue_t* records,
+                        size_t n,
+                        int radix_bits,
+                        ForkJoinPool* pool,
+                        HJPartitions* out) {
+  PartitionPass pass;
+  pass.records = records;
+  pass.n = n;
+  pass.num_chunks = n / k_hj_min_chunk_rows;
+  if (pass.num_chunks > k_hj_max_chunks) {
+    pass.num_chunks = k_hj_max_chunks;
+  } else if (pass.num_chunks == 0) {
+    pass.num_chunks = 1;
+  }
+  pass.num_parts = static_cast<size_t>(1) << radix_bits;
+  pass.radix_bits = radix_bits;
+  pass.counts = new size_t[pass.num_chunks * pass.num_parts]();
+  pass.rows = new HTKeyValue_t[n];
+
+  // Count each chunk's records per partition, then turn the counts into
+  // offsets: partition by partition, and chunk by chunk within each, so
+  // that every chunk scatters into a region of its own.
+  ForEach(pool, pass.num_chunks, &HistogramChunks, &pass);
+  out->starts = new size_t[pass.num_parts + 1];
+  size_t offset = 0;
+  for (size_t p = 0; p < pass.num_parts; p++) {
+    out->starts[p] = offset;
+    for (size_t c = 0; c < pass.num_chunks; c++) {
+      const size_t count = pass.counts[c * pass.num_parts + p];
+      pass.counts[c * pass.num_parts + p] = offset;
+      offset += count;
+    }
+  }
+  out->starts[pass.num_parts] = offset;
+  ForEach(pool, pass.num_chunks, &ScatterChunks, &pass);
+
+  delete[] pass.counts;
+  out->rows = pass.rows;
+  out->radix_bits = radix_bits;
+}
+
+void HashJoin_FreePartitions(HJPartitions* partitions) {
+  delete[] partitions->rows;
+  delete[] partitions->starts;
+  partitions->rows = nullptr;
+  partitions->starts = nullptr;
+}
+
+size_t HashJoin_Run(const HTKeyValue_t* build,
+                    size_t num_build,
+                    const HTKeyValue_t* probe,
+                    size_t num_probe,
+                    KeyCmpFnPtr key_compare_function,
+                    const HJOptions_t* options,
+                    HJEmitFnPtr emit_function,
+                    void* arg) {
+  if (num_build == 0 || num_probe == 0) {
+    return 0;
+  }
+  ForkJoinPool* pool = (options != nullptr) ? options->pool : nullptr;
+  int radix_bits = (options != nullptr) ? options->radix_bits : 0;
+  if (radix_bits <= 0) {
+    radix_bits = HashJoin_PickRadixBits(num_build);
+  } else if (radix_bits > k_hj_max_radix_bits) {
+    radix_bits = k_hj_max_radix_bits;
+  }
+
+  JoinPass pass;
+  pass.key_cmp_fn = key_compare_function;
+  pass.emit_fn = emit_function;
+  pass.arg = arg;
+  pass.num_matches.store(0, std::memory_order_relaxed);
+  HashJoin_Partition(build, num_build, radix_bits, pool, &pass.build);
+  HashJoin_Partition(probe, num_probe, radix_bits, pool, &pass.probe);
+
+  ForEach(pool, static_cast<size_t>(1) << radix_bits, &JoinPartitions,
+          &pass);
+
+  HashJoin_FreePartitions(&pass.build);
+  HashJoin_FreePartitions(&pass.probe);
+  return pass.num_matches.load(std::memory_order_relaxed);
+}
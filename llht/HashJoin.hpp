@@ -0,0 +1,73 @@
+#ifndef HASHJOIN_HPP_
+#define HASHJOIN_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"     // for HTKeyValue_t and KeyCmpFnPtr
+#include "./WorkStealing.hpp"  // for ForkJoinPool
+
+///////////////////////////////////////////////////////////////////////////////
+// A hash join matches up two sets of records (HTKeyValue_ts) by key.
+//
+// Building one HashTable over the whole "build" side and looking up every
+// record of the "probe" side in it is simple, but once the table is bigger
+// than the caches, nearly every lookup misses all the way to memory, one
+// lookup at a time.  HashJoin_Run instead first splits both sides into
+// partitions by the high bits of their hashes (a "radix" partitioning),
+// so that matching records always land in the same partition.  It then
+// joins each partition separately: it builds a small multimap compact
+// table from its build records, which fits in cache, and probes it in
+// batches, prefetching each batch's buckets and chains before looking
+// any of them up.  Partitions are independent, so they are joined in
+// parallel when a ForkJoinPool is supplied.
+//
+// Both sides are copied while they are partitioned, so the join needs
+// about as much memory again as its inputs.
+
+// A match: a build record and a probe record with equal keys.
+typedef struct {
+  HTKeyValue_t build;
+  HTKeyValue_t probe;
+} HJMatch_t;
+
+// Receives a batch of matches, which are only valid during the call.
+// Unless the join runs on a single thread, it may be called from several
+// threads at once.
+typedef void (*HJEmitFnPtr)(const HJMatch_t* matches,
+                            size_t num_matches,
+                            void* arg);
+
+// How to run a join.
+typedef struct {
+  ForkJoinPool* pool;  // runs partitions in parallel; may be nullptr
+  int radix_bits;      // log2 of the # of partitions, up to 12; 0 picks
+} HJOptions_t;
+
+// Joins build with probe, handing every pair of records with equal keys to
+// emit_function, in batches.  Records match if their hashes are equal and
+// key_compare_function says their keys are; every build record matching a
+// probe record is emitted with it, so keys may repeat on either side.
+// Matches come out in no particular order.
+//
+// Arguments:
+// - build, num_build: the build side, which is the one held in tables
+//   and so should be the smaller side.
+// - probe, num_probe: the probe side.
+// - key_compare_function: a function pointer to compare two keys; see
+//   HashTable_New.  It may be called from several threads at once.
+// - options: how to run the join, or nullptr to run it on the calling
+//   thread with a number of partitions picked from num_build.
+// - emit_function: receives the matches.
+// - arg: passed through to emit_function.
+//
+// Returns the number of matches emitted.
+size_t HashJoin_Run(const HTKeyValue_t* build,
+                    size_t num_build,
+                    const HTKeyValue_t* probe,
+                    size_t num_probe,
+                    KeyCmpFnPtr key_compare_function,
+                    const HJOptions_t* options,
+                    HJEmitFnPtr emit_function,
+                    void* arg);
+
+#endif  // HASHJOIN_HPP_
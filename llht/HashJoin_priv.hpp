@@ -0,0 +1,69 @@
+#ifndef HASHJOIN_PRIV_HPP_
+#define HASHJOIN_PRIV_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./HashJoin.hpp"
+#include "./HashTable.hpp"     // for HTKeyValue_t and HTHash_t
+#include "./WorkStealing.hpp"  // for ForkJoinPool
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our HashJoin
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// When picking the number of partitions, aim for about this many build
+// records per partition, so that each partition's table (about 40 bytes
+// per record) fits in a core's L2 cache.
+static constexpr size_t k_hj_partition_rows = 8192;
+
+// The most partitions the join picks, as log2.  Scattering records over
+// more partitions than this in one pass thrashes the TLB.
+static constexpr int k_hj_max_radix_bits = 12;
+
+// Partitioning splits its input into up to this many chunks, each of which
+// is histogrammed and scattered on its own, but no smaller than this many
+// records.
+static constexpr size_t k_hj_max_chunks = 64;
+static constexpr size_t k_hj_min_chunk_rows = 16384;
+
+// Probes are looked up this many at a time, after prefetching for all of
+// them.
+static constexpr size_t k_hj_probe_batch = 16;
+
+// Matches are handed to the emit function this many at a time.
+static constexpr size_t k_hj_emit_batch = 256;
+
+// A side of the join, partitioned: partition p's records are
+// rows[starts[p], starts[p + 1]).
+typedef struct {
+  HTKeyValue_t* rows;  // the records, grouped by partition
+  size_t* starts;      // 2^radix_bits + 1 offsets into rows
+  int radix_bits;      // log2 of the # of partitions
+} HJPartitions;
+
+// Returns the number of radix bits HashJoin_Run picks for a build side of
+// num_build records.
+int HashJoin_PickRadixBits(size_t num_build);
+
+// Returns the partition a hash falls in.
+static inline size_t HashJoin_PartitionOf(HTHash_t hash, int radix_bits) {
+  // Compact tables pick buckets with the low bits of the hash, so the
+  // partitions are picked with the high bits.
+  return radix_bits == 0 ? 0 : hash >> (64 - radix_bits);
+}
+
+// Partitions n records into out, on pool's threads if pool isn't nullptr.
+// The caller frees the result with HashJoin_FreePartitions.
+void HashJoin_Partition(const HTKeyValue_t* records,
+                        size_t n,
+                        int radix_bits,
+                        ForkJoinPool* pool,
+                        HJPartitions* out);
+
+void HashJoin_FreePartitions(HJPartitions* partitions);
+
+#endif  // HASHJOIN_PRIV_HPP_
@@ -1,9 +1,17 @@
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <utility>
 
 #include "HashTable.hpp"
 #include "HashTable_priv.hpp"
 #include "LinkedList.hpp"
+#include "LinkedList_priv.hpp"
+#include "TableDelta_priv.hpp"
+#include "TableExpiry_priv.hpp"
+#include "TableImage_priv.hpp"
+#include "TableLog_priv.hpp"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Internal helper functions.
@@ -14,17 +22,204 @@ static constexpr size_t k_invalid_index = -1;
 // factor has become too high.
 static void MaybeResize(HashTable* ht);
 
+// Insert and remove without logging; the bodies of HashTable_Insert and
+// HashTable_Remove.
+static bool InsertUnlogged(HashTable* table,
+                           HTKeyValue_t newkeyvalue,
+                           HTKeyValue_t* oldkeyvalue);
+static bool RemoveUnlogged(HashTable* table,
+                           HTHash_t hash,
+                           HTKey_t key,
+                           HTKeyValue_t* keyvalue);
+
 // Implemented for you
 static size_t HashKeyToBucketNum(HashTable* ht, HTHash_t hash) {
   return hash % ht->num_buckets;
 }
 
+// Returns the number of buckets the table currently has, whichever mode
+// it's in.
+static size_t NumBuckets(HashTable* ht) {
+  return ht->compact != nullptr ? ht->compact->num_buckets : ht->num_buckets;
+}
+
+// (Re)allocates a dirty map's bits to cover num_buckets buckets, all clean.
+static void ResizeDirtyMap(HTDirtyMap* dirty, size_t num_buckets) {
+  delete[] dirty->bits;
+  dirty->num_ranges = ((num_buckets - 1) >> dirty->range_shift) + 1;
+  dirty->bits = new uint64_t[(dirty->num_ranges + 63) / 64]();
+}
+
+// Marks every range of a tracked table as clean.
+static void ClearDirty(HTDirtyMap* dirty) {
+  memset(dirty->bits, 0, (dirty->num_ranges + 63) / 64 * sizeof(uint64_t));
+  dirty->all = false;
+}
+
+// Records a modification to bucket, if the table is tracked.  This is on
+// the insert path, so it's kept to a test and a single or.
+static void MarkDirty(HashTable* ht, size_t bucket) {
+  HTDirtyMap* dirty = ht->dirty;
+  if (dirty != nullptr) {
+    const size_t range = bucket >> dirty->range_shift;
+    dirty->bits[range / 64] |= static_cast<uint64_t>(1) << (range % 64);
+  }
+}
+
+// Records that the table has just been resized, if it is tracked.
+static void MarkAllDirty(HashTable* ht) {
+  if (ht->dirty != nullptr) {
+    ResizeDirtyMap(ht->dirty, NumBuckets(ht));
+    ht->dirty->all = true;
+  }
+}
+
 // Deallocation functions that do nothing.  Useful if we want to deallocate
 // the structure (eg, the linked list) without deallocating its elements or
 // if we know that the structure is empty.
 static void LLNoOpDelete(LLPayload_t delete_me) {}
 static void HTNoOpDelete(HTKeyValue_t delete_me) {}
 
+// Frees a chain and its (key,value) records, invoking kv_free_function on
+// each (key,value).
+static void DeleteChain(LinkedList* chain, KeyValueFreeFnPtr kv_free_function) {
+  HTKeyValue_t* kv;
+
+  // Pop elements off the chain list one at a time.  We can't do a single
+  // call to LinkedList_Delete since we need to use the passed-in
+  // value_free_function -- which takes a HTKeyValue_t, not an LLPayload_t --
+  // to deallocate the caller's memory.
+  while (LinkedList_NumElements(chain) > 0) {
+    LinkedList_Pop(chain, reinterpret_cast<LLPayload_t*>(&kv));
+    kv_free_function(*kv);
+    delete kv;
+  }
+  // The chain is empty, so we can pass in the
+  // null free function to LinkedList_Delete.
+  LinkedList_Delete(chain, LLNoOpDelete);
+}
+
+// Returns a copy of a chain, with copies of its (key,value) records in the
+// same order.  The keys and values themselves are shared.
+static LinkedList* CopyChain(LinkedList* chain) {
+  LinkedList* copy = LinkedList_New();
+  for (LinkedListNode* node = chain->head; node != nullptr; node = node->next) {
+    LinkedList_Append(copy, new HTKeyValue_t(*static_cast<HTKeyValue_t*>(
+                                node->payload)));
+  }
+  return copy;
+}
+
+// Returns whether a shared array's bucket borrows its chain from the
+// array's parent.
+static bool IsBorrowed(HTSharedBuckets* shared, size_t bucket) {
+  return shared->borrowed != nullptr &&
+         ((shared->borrowed[bucket / 64] >> (bucket % 64)) & 1) != 0;
+}
+
+// Drops a reference to a shared bucket array.  The last reference frees the
+// array along with the chains it owns, and drops its reference to its
+// parent in turn.  Keys and values are never freed here.
+static void ReleaseShared(HTSharedBuckets* shared) {
+  while (shared != nullptr &&
+         shared->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    for (size_t i = 0; i < shared->num_buckets; i++) {
+      if (!IsBorrowed(shared, i)) {
+        DeleteChain(shared->buckets[i], &HTNoOpDelete);
+      }
+    }
+    HTSharedBuckets* parent = shared->parent;
+    delete[] shared->buckets;
+    delete[] shared->borrowed;
+    delete shared;
+    shared = parent;
+  }
+}
+
+// Clears a shared array's borrowed bit for bucket, dropping the array's
+// reference to its parent once it borrows nothing more.
+static void ClearBorrowed(HTSharedBuckets* shared, size_t bucket) {
+  shared->borrowed[bucket / 64] &=
+      ~(static_cast<uint64_t>(1) << (bucket % 64));
+  if (--shared->num_borrowed == 0) {
+    delete[] shared->borrowed;
+    shared->borrowed = nullptr;
+    ReleaseShared(shared->parent);
+    shared->parent = nullptr;
+  }
+}
+
+// Folds a shared array's parent, which nothing else refers to any more,
+// into the array: the chains borrowed from the parent become the array's
+// own, the parent's chains the array has its own copies of are freed, and
+// the parent's parent (if any) becomes the array's.
+static void AdoptParent(HTSharedBuckets* shared) {
+  HTSharedBuckets* parent = shared->parent;
+  HTSharedBuckets* grandparent = parent->parent;
+  parent->parent = nullptr;
+  shared->parent = grandparent;
+  for (size_t i = 0; i < shared->num_buckets; i++) {
+    if (IsBorrowed(parent, i)) {
+      continue;  // the grandparent's, whoever holds it
+    }
+    if (IsBorrowed(shared, i)) {
+      ClearBorrowed(shared, i);
+    } else {
+      DeleteChain(parent->buckets[i], &HTNoOpDelete);
+    }
+  }
+  delete[] parent->buckets;
+  delete[] parent->borrowed;
+  delete parent;
+}
+
+// Makes a chained table's bucket its own to write to, first copying the
+// bucket array, the bucket's chain or both if snapshots might see them.
+static void UnshareBucket(HashTable* table, size_t bucket) {
+  HTSharedBuckets* shared = table->shared;
+  if (shared == nullptr) {
+    return;
+  }
+
+  // Once the snapshots that shared the chains borrowed from the parent are
+  // gone, there's no need to copy them.
+  while (shared->parent != nullptr &&
+         shared->parent->refs.load(std::memory_order_acquire) == 1) {
+    AdoptParent(shared);
+  }
+
+  if (shared->refs.load(std::memory_order_acquire) > 1) {
+    // Move to a copy of the array that borrows every chain.  The table's
+    // reference to the old array becomes the copy's reference to its parent.
+    const size_t num_buckets = shared->num_buckets;
+    const size_t num_words = (num_buckets + 63) / 64;
+    HTSharedBuckets* copy = new HTSharedBuckets{};
+    copy->refs.store(1, std::memory_order_relaxed);
+    copy->buckets = new LinkedList*[num_buckets];
+    memcpy(copy->buckets, shared->buckets, num_buckets * sizeof(LinkedList*));
+    copy->num_buckets = num_buckets;
+    copy->borrowed = new uint64_t[num_words];
+    memset(copy->borrowed, 0xff, num_words * sizeof(uint64_t));
+    copy->num_borrowed = num_buckets;
+    copy->parent = shared;
+    table->shared = shared = copy;
+    table->buckets = copy->buckets;
+  }
+
+  if (IsBorrowed(shared, bucket)) {
+    shared->buckets[bucket] = CopyChain(shared->buckets[bucket]);
+    ClearBorrowed(shared, bucket);
+  }
+
+  // Once nothing is shared any more, the table owns its buckets outright
+  // again, and writes skip all of this.
+  if (shared->parent == nullptr &&
+      shared->refs.load(std::memory_order_acquire) == 1) {
+    delete shared;
+    table->shared = nullptr;
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // HashTable implementation.
 
@@ -67,47 +262,138 @@ HashTable* HashTable_New(size_t num_buckets, KeyCmpFnPtr key_compare_function) {
   return ht;
 }
 
+HashTable* HashTable_NewCompact(size_t num_buckets,
+                                KeyCmpFnPtr key_compare_function) {
+  // The chained fields stay empty; every operation is forwarded to the
+  // compact table.
+  HashTable* ht = new HashTable{};
+  ht->key_cmp_fn = key_compare_function;
+  ht->compact = CompactTable_New(num_buckets, key_compare_function);
+  return ht;
+}
+
+HashTable* HashTable_NewStringKeys(size_t num_buckets) {
+  HashTable* ht = new HashTable{};
+  ht->compact = CompactTable_NewStringKeys(num_buckets);
+  return ht;
+}
+
+// Frees a chained table's chains and buckets, invoking kv_free_function on
+// each element.
+static void DeleteChains(HashTable* table, KeyValueFreeFnPtr kv_free_function);
+
 // Implemented for you
 void HashTable_Delete(HashTable* table, KeyValueFreeFnPtr kv_free_function) {
-  int i;
-
-  // Free each bucket's chain.
-  for (i = 0; i < table->num_buckets; i++) {
-    LinkedList* bucket = table->buckets[i];
-    HTKeyValue_t* kv;
-
-    // Pop elements off the chain list one at a time.  We can't do a single
-    // call to LinkedList_Delete since we need to use the passed-in
-    // value_free_function -- which takes a HTKeyValue_t, not an LLPayload_t --
-    // to deallocate the caller's memory.
-    while (LinkedList_NumElements(bucket) > 0) {
-      LinkedList_Pop(bucket, reinterpret_cast<LLPayload_t*>(&kv));
-      kv_free_function(*kv);
-      delete kv;
-    }
-    // The chain is empty, so we can pass in the
-    // null free function to LinkedList_Delete.
-    LinkedList_Delete(bucket, LLNoOpDelete);
+  if (table->log != nullptr) {
+    TableLog_Close(table->log);
   }
-
-  // Free the bucket array within the table, then deallocate the table record itself.
-  delete[] table->buckets;
+  if (table->expiry != nullptr) {
+    TableExpiry_Delete(table->expiry);
+  }
+  if (table->dirty != nullptr) {
+    delete[] table->dirty->bits;
+    delete table->dirty;
+  }
+  if (table->compact != nullptr) {
+    CompactTable_Delete(table->compact, kv_free_function);
+    delete table;
+    return;
+  }
+  DeleteChains(table, kv_free_function);
   delete table;
 }
 
+static void DeleteChains(HashTable* table, KeyValueFreeFnPtr kv_free_function) {
+  if (table->shared != nullptr) {
+    // The chains may be shared, so they go with the last reference to the
+    // array; only a table's keys and values are its own to free now.  A
+    // snapshot owns none.
+    for (size_t i = 0; i < table->num_buckets && !table->snapshot; i++) {
+      for (LinkedListNode* node = table->buckets[i]->head; node != nullptr;
+           node = node->next) {
+        kv_free_function(*static_cast<HTKeyValue_t*>(node->payload));
+      }
+    }
+    ReleaseShared(table->shared);
+    table->shared = nullptr;
+  } else {
+    // Free each bucket's chain, then the bucket array within the table.
+    for (size_t i = 0; i < table->num_buckets; i++) {
+      DeleteChain(table->buckets[i], kv_free_function);
+    }
+    delete[] table->buckets;
+  }
+  table->buckets = nullptr;
+  table->num_buckets = 0;
+  table->num_elements = 0;
+}
+
 // Implemented for you
 size_t HashTable_NumElements(HashTable* table) {
+  if (table->compact != nullptr) {
+    return table->compact->num_elements;
+  }
   return table->num_elements;
 }
 
+size_t HashTable_MemoryBytes(HashTable* table) {
+  if (table->compact != nullptr) {
+    size_t bytes = sizeof(HashTable) + CompactTable_MemoryBytes(table->compact);
+    if (table->expiry != nullptr) {
+      bytes += sizeof(HTExpiry) + table->expiry->num_timers * sizeof(HTTimer);
+    }
+    return bytes;
+  }
+  return sizeof(HashTable) +
+         table->num_buckets * (sizeof(LinkedList*) + sizeof(LinkedList)) +
+         table->num_elements * (sizeof(LinkedListNode) + sizeof(HTKeyValue_t));
+}
+
 bool HashTable_Insert(HashTable* table,
                       HTKeyValue_t newkeyvalue,
                       HTKeyValue_t* oldkeyvalue) {
+  if (table->log != nullptr) {
+    return HashTable_InsertDurable(table, newkeyvalue, oldkeyvalue,
+                                   table->log->durability);
+  }
+  return InsertUnlogged(table, newkeyvalue, oldkeyvalue);
+}
+
+static bool InsertUnlogged(HashTable* table,
+                           HTKeyValue_t newkeyvalue,
+                           HTKeyValue_t* oldkeyvalue) {
+  if (table->compact != nullptr) {
+    if (table->compact->read_only) {
+      return false;  // (a frozen table hasn't even got buckets to mark)
+    }
+    const size_t num_buckets = table->compact->num_buckets;
+    const bool replaced =
+        CompactTable_Insert(table->compact, newkeyvalue, oldkeyvalue);
+    if (replaced && table->expiry != nullptr) {
+      TableExpiry_SetAt(
+          table->expiry, table->compact,
+          CompactTable_IndexOf(table->compact, newkeyvalue.hash,
+                               newkeyvalue.key),
+          k_ht_no_deadline);
+    }
+    if (table->compact->num_buckets != num_buckets) {
+      MarkAllDirty(table);
+    } else {
+      MarkDirty(table, newkeyvalue.hash % num_buckets);
+    }
+    return replaced;
+  }
+
+  if (table->snapshot) {
+    return false;
+  }
   MaybeResize(table);
 
   // Calculate which bucket and chain we're inserting into.
   const size_t bucket = HashKeyToBucketNum(table, newkeyvalue.hash);
+  UnshareBucket(table, bucket);
   LinkedList* chain = table->buckets[bucket];
+  MarkDirty(table, bucket);
 
   // STEP 1: finish the implementation of InsertHashTable.
   // This is a fairly complex task, so you might decide you want
@@ -137,6 +423,14 @@ bool HashTable_Find(HashTable* table,
                     HTHash_t hash,
                     HTKey_t key,
                     HTKeyValue_t* keyvalue) {
+  if (table->compact != nullptr) {
+    if (table->expiry != nullptr) {
+      return TableExpiry_Find(table->expiry, table->compact, hash, key,
+                              keyvalue);
+    }
+    return CompactTable_Find(table->compact, hash, key, keyvalue);
+  }
+
   // STEP 2: implement HashTable_Find.
   const size_t bucket = HashKeyToBucketNum(table, newkeyvalue.hash);
   LinkedList* chain = table->buckets[bucket];
@@ -155,8 +449,46 @@ bool HashTable_Remove(HashTable* table,
                       HTHash_t hash,
                       HTKey_t key,
                       HTKeyValue_t* keyvalue) {
+  if (table->log != nullptr) {
+    return HashTable_RemoveDurable(table, hash, key, keyvalue,
+                                   table->log->durability);
+  }
+  return RemoveUnlogged(table, hash, key, keyvalue);
+}
+
+static bool RemoveUnlogged(HashTable* table,
+                           HTHash_t hash,
+                           HTKey_t key,
+                           HTKeyValue_t* keyvalue) {
+  if (table->compact != nullptr && table->expiry != nullptr) {
+    // Find the entry once, to cancel its timer and then remove it.
+    const uint32_t idx = CompactTable_IndexOf(table->compact, hash, key);
+    if (idx == k_ct_nil) {
+      return false;
+    }
+    TableExpiry_SetAt(table->expiry, table->compact, idx, k_ht_no_deadline);
+    HTStringKey_t key_view;
+    CompactTable_RemoveAt(table->compact, idx, &key_view, keyvalue);
+    if (table->compact->string_keys) {
+      keyvalue->key = key;
+    }
+    MarkDirty(table, hash % table->compact->num_buckets);
+    return true;
+  }
+  if (table->compact != nullptr) {
+    if (!CompactTable_Remove(table->compact, hash, key, keyvalue)) {
+      return false;
+    }
+    MarkDirty(table, hash % table->compact->num_buckets);
+    return true;
+  }
+
   // STEP 3: implement HashTable_Remove.
+  if (table->snapshot) {
+    return false;
+  }
   const size_t bucket = HashKeyToBucketNum(table, hash);
+  UnshareBucket(table, bucket);
   LinkedList* chain = table->buckets[bucket];
   LinkedListNode* node = chain->head;
   while (node != nullptr) {
@@ -164,6 +496,7 @@ bool HashTable_Remove(HashTable* table,
       *keyvalue = *reinterpret_cast<HTKeyValue_t*>(node->payload);
       LinkedList_Remove(chain, node->payload);
       table->num_elements--;
+      MarkDirty(table, bucket);
       return true;
     }
     node = node->next;
@@ -171,6 +504,399 @@ bool HashTable_Remove(HashTable* table,
   return false;  // you may need to change this return value
 }
 
+bool HashTable_Save(HashTable* table, const char* path) {
+  uint64_t image_id = 0;
+  bool ok;
+  if (table->compact != nullptr) {
+    ok = TableImage_Write(table->compact, path, &image_id, true);
+  } else {
+    // Lay the chains out as a compact table with the same bucket count.
+    // The keys and values are only borrowed, so nothing is freed afterwards.
+    CompactTable* ct = CompactTable_New(table->num_buckets, table->key_cmp_fn);
+    HTIterator* it = HTIterator_New(table);
+    for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+      HTKeyValue_t kv;
+      HTIterator_Get(it, &kv);
+      CompactTable_Append(ct, kv);
+    }
+    HTIterator_Delete(it);
+
+    ok = TableImage_Write(ct, path, &image_id, true);
+    CompactTable_Delete(ct, nullptr);
+  }
+
+  // A full snapshot starts a new chain of deltas.
+  if (ok && table->dirty != nullptr) {
+    table->dirty->base_id = image_id;
+    table->dirty->seq = 0;
+    ClearDirty(table->dirty);
+  }
+  return ok;
+}
+
+HashTable* HashTable_Open(const char* path,
+                          KeyCmpFnPtr key_compare_function,
+                          int flags) {
+  CompactTable* ct =
+      TableImage_Map(path, key_compare_function,
+                     (flags & k_ht_open_writable) != 0,
+                     (flags & k_ht_open_verify) != 0, nullptr);
+  if (ct == nullptr) {
+    return nullptr;
+  }
+
+  HashTable* ht = new HashTable{};
+  ht->key_cmp_fn = ct->key_cmp_fn;
+  ht->compact = ct;
+  return ht;
+}
+
+bool HashTable_TrackDirty(HashTable* table, size_t range_buckets) {
+  if (table->dirty != nullptr || table->snapshot ||
+      (table->compact != nullptr && table->compact->read_only)) {
+    return false;
+  }
+
+  HTDirtyMap* dirty = new HTDirtyMap{};
+  while ((static_cast<size_t>(1) << dirty->range_shift) < range_buckets) {
+    dirty->range_shift++;
+  }
+  ResizeDirtyMap(dirty, NumBuckets(table));
+  table->dirty = dirty;
+  return true;
+}
+
+size_t HashTable_NumDirtyRanges(HashTable* table) {
+  HTDirtyMap* dirty = table->dirty;
+  if (dirty == nullptr) {
+    return 0;
+  }
+  if (dirty->all) {
+    return dirty->num_ranges;
+  }
+  size_t count = 0;
+  for (size_t i = 0; i < (dirty->num_ranges + 63) / 64; i++) {
+    count += __builtin_popcountll(dirty->bits[i]);
+  }
+  return count;
+}
+
+bool HashTable_CheckpointDelta(HashTable* table, const char* path) {
+  if (table->dirty == nullptr || table->dirty->base_id == 0 ||
+      !TableDelta_Write(table, path)) {
+    return false;
+  }
+  table->dirty->seq++;
+  ClearDirty(table->dirty);
+  return true;
+}
+
+HashTable* HashTable_OpenCheckpoint(const char* base_path,
+                                    const char* const* delta_paths,
+                                    size_t num_deltas,
+                                    KeyCmpFnPtr key_compare_function) {
+  uint64_t base_id = 0;
+  CompactTable* ct =
+      TableImage_Map(base_path, key_compare_function, true, false, &base_id);
+  if (ct == nullptr) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < num_deltas; i++) {
+    if (!TableDelta_Apply(&ct, delta_paths[i], base_id, i + 1)) {
+      CompactTable_Delete(ct, nullptr);
+      return nullptr;
+    }
+  }
+
+  HashTable* ht = new HashTable{};
+  ht->key_cmp_fn = ct->key_cmp_fn;
+  ht->compact = ct;
+  return ht;
+}
+
+bool HashTable_AttachLog(HashTable* table,
+                         const char* path,
+                         size_t group_ops,
+                         uint64_t group_usecs,
+                         int durability) {
+  if (table->log != nullptr || table->snapshot ||
+      (table->compact != nullptr &&
+       (table->compact->read_only || table->compact->multimap))) {
+    return false;
+  }
+  const bool string_keys =
+      table->compact != nullptr && table->compact->string_keys;
+  table->log = TableLog_Open(path, table, string_keys, group_ops, group_usecs,
+                             durability);
+  return table->log != nullptr;
+}
+
+bool HashTable_InsertDurable(HashTable* table,
+                             HTKeyValue_t newkeyvalue,
+                             HTKeyValue_t* oldkeyvalue,
+                             int durability) {
+  HTLog* log = table->log;
+  if (log == nullptr) {
+    return InsertUnlogged(table, newkeyvalue, oldkeyvalue);
+  }
+
+  // Apply and log under the same lock, so the log's order is the table's.
+  std::unique_lock<std::mutex> lk(log->lock);
+  const bool replaced = InsertUnlogged(table, newkeyvalue, oldkeyvalue);
+  const uint64_t lsn = TableLog_Append(log, false, newkeyvalue);
+  TableLog_Wait(log, &lk, lsn, durability);
+  return replaced;
+}
+
+bool HashTable_RemoveDurable(HashTable* table,
+                             HTHash_t hash,
+                             HTKey_t key,
+                             HTKeyValue_t* keyvalue,
+                             int durability) {
+  HTLog* log = table->log;
+  if (log == nullptr) {
+    return RemoveUnlogged(table, hash, key, keyvalue);
+  }
+
+  // Removing a key that isn't there changes nothing, so isn't logged.
+  std::unique_lock<std::mutex> lk(log->lock);
+  if (!RemoveUnlogged(table, hash, key, keyvalue)) {
+    return false;
+  }
+  const uint64_t lsn = TableLog_Append(log, true, {hash, key, nullptr});
+  TableLog_Wait(log, &lk, lsn, durability);
+  return true;
+}
+
+bool HashTable_SyncLog(HashTable* table) {
+  HTLog* log = table->log;
+  if (log == nullptr) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lk(log->lock);
+  TableLog_Wait(log, &lk, log->appended, k_ht_wal_sync);
+  return !log->failed;
+}
+
+bool HashTable_TruncateLog(HashTable* table) {
+  HTLog* log = table->log;
+  if (log == nullptr) {
+    return false;
+  }
+  std::unique_lock<std::mutex> lk(log->lock);
+  return TableLog_Truncate(log, &lk);
+}
+
+bool HashTable_EnableExpiry(HashTable* table,
+                            HTClockFnPtr clock,
+                            KeyValueFreeFnPtr kv_free_function) {
+  CompactTable* ct = table->compact;
+  if (ct == nullptr || ct->read_only || table->expiry != nullptr) {
+    return false;
+  }
+  table->expiry = TableExpiry_New(clock, kv_free_function, 0);
+  table->expiry->now = table->expiry->clock();
+  ct->timers = new HTTimer*[ct->capacity]();
+  return true;
+}
+
+bool HashTable_InsertWithTTL(HashTable* table,
+                             HTKeyValue_t newkeyvalue,
+                             uint64_t ttl,
+                             HTKeyValue_t* oldkeyvalue) {
+  HTExpiry* expiry = table->expiry;
+  CompactTable* ct = table->compact;
+  const bool replaced = HashTable_Insert(table, newkeyvalue, oldkeyvalue);
+
+  // A new entry is always appended, so only a replaced one needs finding.
+  const uint32_t idx =
+      replaced ? CompactTable_IndexOf(ct, newkeyvalue.hash, newkeyvalue.key)
+               : static_cast<uint32_t>(ct->num_elements - 1);
+  uint64_t deadline = expiry->clock() + ttl;
+  if (deadline < ttl || deadline == k_ht_no_deadline) {
+    deadline = k_ht_no_deadline - 1;  // saturate, rather than wrap
+  }
+  TableExpiry_SetAt(expiry, ct, idx, deadline);
+  return replaced;
+}
+
+void HashTable_RemoveIndex(HashTable* table,
+                           uint32_t idx,
+                           HTStringKey_t* key_view,
+                           HTKeyValue_t* keyvalue) {
+  CompactTable* ct = table->compact;
+  const HTHash_t hash = ct->entries[idx].hash;
+  if (ct->timers != nullptr && ct->timers[idx] != nullptr) {
+    TableExpiry_SetAt(table->expiry, ct, idx, k_ht_no_deadline);
+  }
+  if (table->log != nullptr) {
+    // As in HashTable_RemoveDurable, at the log's usual durability.
+    std::unique_lock<std::mutex> lk(table->log->lock);
+    CompactTable_RemoveAt(ct, idx, key_view, keyvalue);
+    MarkDirty(table, hash % ct->num_buckets);
+    const uint64_t lsn =
+        TableLog_Append(table->log, true, {hash, keyvalue->key, nullptr});
+    TableLog_Wait(table->log, &lk, lsn, table->log->durability);
+    return;
+  }
+  CompactTable_RemoveAt(ct, idx, key_view, keyvalue);
+  MarkDirty(table, hash % ct->num_buckets);
+}
+
+size_t HashTable_Expire(HashTable* table, uint64_t now) {
+  if (table->expiry == nullptr) {
+    return 0;
+  }
+  return TableExpiry_Advance(table, now);
+}
+
+bool HashTable_EnableOrder(HashTable* table, int order) {
+  CompactTable* ct = table->compact;
+  if (ct == nullptr || ct->read_only || ct->order != nullptr ||
+      (order != k_ht_order_insertion && order != k_ht_order_access)) {
+    return false;
+  }
+  CompactTable_EnableOrder(ct, order == k_ht_order_access);
+  return true;
+}
+
+bool HashTable_EnableMultimap(HashTable* table) {
+  CompactTable* ct = table->compact;
+  if (ct == nullptr || ct->read_only || ct->multimap || ct->num_elements > 0 ||
+      table->log != nullptr) {
+    return false;
+  }
+  ct->multimap = true;
+  return true;
+}
+
+bool HashTable_Freeze(HashTable* table) {
+  if (table->log != nullptr || table->expiry != nullptr ||
+      table->dirty != nullptr || table->snapshot) {
+    return false;
+  }
+  if (table->compact != nullptr) {
+    return CompactTable_Freeze(table->compact);
+  }
+
+  // Lay the chains out as a compact table, as HashTable_Save does, but this
+  // time the (key,value)s move over for good.
+  CompactTable* ct = CompactTable_New(table->num_buckets, table->key_cmp_fn);
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    CompactTable_Append(ct, kv);
+  }
+  HTIterator_Delete(it);
+  if (!CompactTable_Freeze(ct)) {
+    CompactTable_Delete(ct, nullptr);
+    return false;
+  }
+  DeleteChains(table, &HTNoOpDelete);
+  table->compact = ct;
+  return true;
+}
+
+// Returns idx, or the first entry after it in its run, that hasn't expired
+// by now; or k_ct_nil if there is none.
+static uint32_t SkipExpired(CompactTable* ct, uint32_t idx, uint64_t now) {
+  if (ct->timers == nullptr) {
+    return idx;
+  }
+  while (idx != k_ct_nil && ct->timers[idx] != nullptr &&
+         ct->timers[idx]->deadline <= now) {
+    idx = CompactTable_NextInRun(ct, idx);
+  }
+  return idx;
+}
+
+HashTable* HashTable_Snapshot(HashTable* table) {
+  if (table->compact != nullptr) {
+    return nullptr;
+  }
+
+  // The table's reference to its own array only has to be counted once
+  // there are others.
+  if (table->shared == nullptr) {
+    table->shared = new HTSharedBuckets{};
+    table->shared->refs.store(1, std::memory_order_relaxed);
+    table->shared->buckets = table->buckets;
+    table->shared->num_buckets = table->num_buckets;
+  }
+  table->shared->refs.fetch_add(1, std::memory_order_relaxed);
+
+  HashTable* snapshot = new HashTable{};
+  snapshot->num_buckets = table->num_buckets;
+  snapshot->num_elements = table->num_elements;
+  snapshot->buckets = table->buckets;
+  snapshot->key_cmp_fn = table->key_cmp_fn;
+  snapshot->shared = table->shared;
+  snapshot->snapshot = true;
+  return snapshot;
+}
+
+HTCursor_t HashTable_FindAll(HashTable* table, HTHash_t hash, HTKey_t key) {
+  HTCursor_t cursor{};
+  cursor.table = table;
+  cursor.idx = k_ct_nil;
+  CompactTable* ct = table->compact;
+  if (ct == nullptr) {
+    return cursor;
+  }
+  if (table->expiry != nullptr) {
+    cursor.now = table->expiry->clock();
+  }
+  cursor.idx = SkipExpired(ct, CompactTable_IndexOf(ct, hash, key), cursor.now);
+  return cursor;
+}
+
+bool HTCursor_IsValid(const HTCursor_t* cursor) {
+  return cursor->idx != k_ct_nil;
+}
+
+bool HTCursor_Next(HTCursor_t* cursor) {
+  if (!HTCursor_IsValid(cursor)) {
+    return false;
+  }
+  CompactTable* ct = cursor->table->compact;
+  cursor->idx =
+      SkipExpired(ct, CompactTable_NextInRun(ct, cursor->idx), cursor->now);
+  return HTCursor_IsValid(cursor);
+}
+
+bool HTCursor_Get(HTCursor_t* cursor, HTKeyValue_t* keyvalue) {
+  if (!HTCursor_IsValid(cursor)) {
+    return false;
+  }
+  CompactTable_GetEntry(cursor->table->compact, cursor->idx,
+                        &cursor->key_view, keyvalue);
+  return true;
+}
+
+size_t HashTable_Count(HashTable* table, HTHash_t hash, HTKey_t key) {
+  CompactTable* ct = table->compact;
+  if (ct == nullptr) {
+    HTKeyValue_t kv;
+    return HashTable_Find(table, hash, key, &kv) ? 1 : 0;
+  }
+
+  // Only a table with expiry needs to look at each entry's timer on the way.
+  size_t count = 0;
+  if (ct->timers != nullptr) {
+    HTCursor_t cursor = HashTable_FindAll(table, hash, key);
+    for (; HTCursor_IsValid(&cursor); HTCursor_Next(&cursor)) {
+      count++;
+    }
+    return count;
+  }
+  for (uint32_t idx = CompactTable_IndexOf(ct, hash, key); idx != k_ct_nil;
+       idx = CompactTable_NextInRun(ct, idx)) {
+    count++;
+  }
+  return count;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // HTIterator implementation.
 
@@ -178,6 +904,18 @@ bool HashTable_Remove(HashTable* table,
 HTIterator* HTIterator_New(HashTable* table) {
   HTIterator* iter = new HTIterator{};
 
+  // A compact table's entries are dense, so its iterator is just an index:
+  // either into the entries, or along the order list.
+  if (table->compact != nullptr) {
+    iter->ht = table;
+    iter->bucket_idx = 0;
+    if (table->compact->order != nullptr) {
+      iter->bucket_idx = table->compact->order_head;
+    }
+    iter->bucket_it = nullptr;
+    return iter;
+  }
+
   // If the hash table is empty, the iterator is immediately invalid,
   // since it can't point to anything.
   if (table->num_elements == 0 || table->num_buckets == 0) {
@@ -211,12 +949,28 @@ void HTIterator_Delete(HTIterator* iter) {
 }
 
 bool HTIterator_IsValid(HTIterator* iter) {
+  if (iter->ht->compact != nullptr) {
+    return iter->bucket_idx < iter->ht->compact->num_elements;
+  }
+
   // STEP 4: implement HTIterator_IsValid.
   return iter->bucket_it != nullptr;
   return true;  // you may need to change this return value
 }
 
 bool HTIterator_Next(HTIterator* iter) {
+  if (iter->ht->compact != nullptr) {
+    if (!HTIterator_IsValid(iter)) {
+      return false;
+    }
+    if (iter->ht->compact->order != nullptr) {
+      iter->bucket_idx = iter->ht->compact->order[iter->bucket_idx].next;
+    } else {
+      iter->bucket_idx++;
+    }
+    return HTIterator_IsValid(iter);
+  }
+
   // STEP 5: implement HTIterator_Next.
   if (iter->bucket_it == nullptr) {
     return false;
@@ -233,6 +987,15 @@ bool HTIterator_Next(HTIterator* iter) {
 }
 
 bool HTIterator_Get(HTIterator* iter, HTKeyValue_t* keyvalue) {
+  if (iter->ht->compact != nullptr) {
+    if (!HTIterator_IsValid(iter)) {
+      return false;
+    }
+    CompactTable_GetEntry(iter->ht->compact, iter->bucket_idx,
+                          &iter->key_view, keyvalue);
+    return true;
+  }
+
   // STEP 6: implement HTIterator_Get.
   if (iter->bucket_it == nullptr) {
     return false;
@@ -252,6 +1015,44 @@ bool HTIterator_Remove(HTIterator* iter, HTKeyValue_t* keyvalue) {
     return false;
   }
 
+  // Removing from a compact table moves its last entry into the current
+  // slot, which is exactly the next element the iterator hasn't visited
+  // yet; so we remove without advancing.  In an ordered table, the next
+  // element is the current one's successor in order, wherever the removal
+  // leaves it.  We remove by index, since in a multimap the key alone
+  // might pick out one of the current entry's neighbours.
+  CompactTable* ct = iter->ht->compact;
+  if (ct != nullptr) {
+    if (ct->read_only) {
+      return false;
+    }
+    const uint32_t idx = static_cast<uint32_t>(iter->bucket_idx);
+    const uint32_t last = static_cast<uint32_t>(ct->num_elements - 1);
+    uint32_t next = ct->order != nullptr ? ct->order[idx].next : idx;
+    HashTable_RemoveIndex(iter->ht, idx, &iter->key_view, keyvalue);
+    if (next == last) {
+      next = idx;
+    }
+    iter->bucket_idx = next;
+    return true;
+  }
+  if (iter->ht->snapshot) {
+    return false;
+  }
+
+  // Removing from a shared chain copies it first.  Move the iterator over
+  // to the copy now, at the same position, so that it doesn't carry on down
+  // the old chain.
+  if (iter->ht->shared != nullptr) {
+    const size_t pos = iter->bucket_it->pos;
+    UnshareBucket(iter->ht, iter->bucket_idx);
+    LLIterator_Delete(iter->bucket_it);
+    iter->bucket_it = LLIterator_New(iter->ht->buckets[iter->bucket_idx]);
+    for (size_t i = 0; i < pos; i++) {
+      LLIterator_Next(iter->bucket_it);
+    }
+  }
+
   // Advance the iterator.  Thanks to the above call to
   // HTIterator_Get, we know that this iterator is valid (though it
   // may not be valid after this call to HTIterator_Next).
@@ -286,14 +1087,19 @@ static void MaybeResize(HashTable* ht) {
     HashTable_Insert(newht, item, &unused);
   }
 
-  // Swap the new table onto the old, then deallocate the old table (tricky!).  We
-  // use the "no-op free" because we don't actually want to deallocate the elements;
-  // they're owned by the new table.
-  const HashTable tmp = *ht;
-  *ht = *newht;
-  *newht = tmp;
-
-  // Done!  Clean up our iterator and temporary table.
+  // Swap the new buckets onto the old table, then deallocate the old buckets
+  // along with the temporary table (tricky!).  Only the buckets are swapped,
+  // so the rest of the table's state (eg, dirty tracking) stays put.  We use
+  // the "no-op free" because we don't actually want to deallocate the
+  // elements; they're owned by the new buckets.  If snapshots share the old
+  // buckets, their sharing state goes with them, and they're only freed
+  // once the snapshots are done with them.
   HTIterator_Delete(it);
+  std::swap(ht->num_buckets, newht->num_buckets);
+  std::swap(ht->buckets, newht->buckets);
+  std::swap(ht->shared, newht->shared);
   HashTable_Delete(newht, &HTNoOpDelete);
+
+  // Every element has moved to a new bucket.
+  MarkAllDirty(ht);
 }
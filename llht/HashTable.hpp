@@ -54,6 +54,15 @@ typedef void (*KeyValueFreeFnPtr)(HTKeyValue_t value);
 // are structurally equal.
 typedef bool (*KeyCmpFnPtr)(HTKey_t, HTKey_t);
 
+// Keys of a string-key table (see HashTable_NewStringKeys) are byte
+// strings rather than customer-managed pointers.  Customers hand such a
+// table a pointer to an HTStringKey_t, typically on the stack, wherever an
+// HTKey_t is expected; the table copies the bytes it needs to keep.
+typedef struct {
+  const void* bytes;  // the key's bytes, which need not be NUL-terminated
+  size_t len;         // the number of bytes in the key
+} HTStringKey_t;
+
 // FNV hash implementation.
 //
 // Customers can use this to hash an arbitrary sequence of bytes into
@@ -81,6 +90,57 @@ HTHash_t FNVHash64(unsigned char* buffer, int len);
 // Returns nullptr on error, non-nullptr on success.
 HashTable* HashTable_New(size_t num_buckets, KeyCmpFnPtr key_compare_function);
 
+// Allocate and return a new HashTable that uses compact storage.
+//
+// A compact table keeps its (key,value)s densely packed in one contiguous
+// array and chains them together with 32-bit indices instead of a
+// LinkedListNode per element.  Each chain link also carries the upper 32
+// bits of its element's hash, so most collisions are rejected without
+// touching the element or calling key_compare_function.  On a 64-bit
+// machine, this costs 32 bytes per element plus 4 bytes per bucket,
+// compared to 48 bytes per element plus 32 bytes per bucket (before any
+// allocator overhead) for a table created by HashTable_New.
+//
+// Apart from HashTable_NewCompact, a compact table is used through exactly
+// the same functions as any other HashTable.  It can hold at most
+// 2^32 - 1 elements.
+//
+// Arguments:
+// - num_buckets: the number of buckets the hash table should
+//   initially contain; MUST be greater than zero.
+// - key_compare_function: a function pointer to compare two keys.
+//   see above for details.
+//
+// Returns nullptr on error, non-nullptr on success.
+HashTable* HashTable_NewCompact(size_t num_buckets,
+                                KeyCmpFnPtr key_compare_function);
+
+// Allocate and return a new compact HashTable whose keys are byte strings.
+//
+// A string-key table copies each new key's bytes into an internal,
+// append-only arena, and compares keys with memcmp rather than through a
+// KeyCmpFnPtr.  Customers therefore don't allocate (or free) anything per
+// key: every HTKey_t passed to the table must point to an HTStringKey_t
+// that only needs to stay valid for the duration of the call.  Space left
+// behind by removed keys is reclaimed when the table resizes.
+//
+// The (key,value)s handed back by a string-key table differ from other
+// tables in two ways:
+// - HashTable_Insert, HashTable_Find and HashTable_Remove return the
+//   caller's own key pointer in the key field.
+// - HTIterator_Get and HTIterator_Remove return a pointer to an
+//   HTStringKey_t that describes the table's copy of the key.  It is only
+//   valid until the iterator or the table is next used.
+//
+// Keys may be at most 16 MiB - 1 bytes long.
+//
+// Arguments:
+// - num_buckets: the number of buckets the hash table should
+//   initially contain; MUST be greater than zero.
+//
+// Returns nullptr on error, non-nullptr on success.
+HashTable* HashTable_NewStringKeys(size_t num_buckets);
+
 // Deallocates a HashTable and its entries.
 //
 // Arguments:
@@ -88,7 +148,9 @@ HashTable* HashTable_New(size_t num_buckets, KeyCmpFnPtr key_compare_function);
 //   after this function returns.
 //
 // - kv_free_function: this argument is a pointer to a key-value
-//   freeing function; see above for details.
+//   freeing function; see above for details.  For a string-key table,
+//   which owns its keys, this may be nullptr if the values don't need
+//   freeing either; the table is then freed without visiting each element.
 void HashTable_Delete(HashTable* table, KeyValueFreeFnPtr kv_free_function);
 
 // Figure out the number of elements in the hash table.
@@ -102,6 +164,19 @@ void HashTable_Delete(HashTable* table, KeyValueFreeFnPtr kv_free_function);
 // - table size (>=0); note that this is an unsigned 64-bit integer.
 size_t HashTable_NumElements(HashTable* table);
 
+// Reports how much memory the table's own bookkeeping occupies.
+//
+// Arguments:
+//
+// - table:  the table to query
+//
+// Returns:
+//
+// - the number of bytes allocated for the table's buckets, chains and
+//   (key,value) records, not counting allocator overhead or anything
+//   that the keys and values point to.
+size_t HashTable_MemoryBytes(HashTable* table);
+
 // Inserts a (key,value) pair into the HashTable.
 //
 // Arguments:
@@ -169,16 +244,468 @@ bool HashTable_Remove(HashTable* table,
                       HTKey_t key,
                       HTKeyValue_t* keyvalue);
 
+///////////////////////////////////////////////////////////////////////////////
+// HashTable snapshots
+//
+// A HashTable can be saved to a snapshot file and later opened straight
+// from that file.  The file is an image of a compact table (see
+// HashTable_NewCompact) in which everything refers to everything else by
+// index or offset, so HashTable_Open simply maps it into memory: finds and
+// iterators work directly on the mapped file, without reading or
+// rebuilding the table first.  Opening a table therefore only costs as
+// much I/O as the pages that are actually touched.
+//
+// Snapshots store keys and values as raw 64-bit words, and (for a
+// string-key table) the bytes of the keys.  They are only meaningful for
+// string-key tables, or for tables whose keys and values are stored
+// directly in the HTKey_t and HTValue_t rather than pointed to.
+
+// Flags for HashTable_Open; combine them with |.
+//
+// - k_ht_open_writable: allow the opened table to be modified.  The file is
+//   mapped privately, so modified pages are copied on write and the file
+//   itself is never changed.  Without this flag, HashTable_Insert and
+//   HashTable_Remove do nothing and return false.
+// - k_ht_open_verify: checksum the entire file and check every index in
+//   it before opening it.  This reads the whole file.  Without this flag,
+//   only the header is validated.
+static constexpr int k_ht_open_writable = 1;
+static constexpr int k_ht_open_verify = 2;
+
+// Writes a snapshot of a HashTable to a file.
+//
+// The file is written under a temporary name and renamed into place once
+// complete, so a crash never leaves a partial snapshot at path.  Saving a
+// table that isn't compact temporarily allocates a compact copy of its
+// chains.
+//
+// Arguments:
+// - table: the HashTable to save.
+// - path: the file to (over)write.
+//
+// Returns:
+// - false: if the snapshot couldn't be written.
+// - true: on success.
+bool HashTable_Save(HashTable* table, const char* path);
+
+// Opens a HashTable from a snapshot written by HashTable_Save.  The result
+// is a compact table, and is deallocated with HashTable_Delete as usual.
+//
+// Arguments:
+// - path: the snapshot to open.
+// - key_compare_function: a function pointer to compare two keys; ignored
+//   if the snapshot is of a string-key table.
+// - flags: zero or more k_ht_open_* flags.
+//
+// Returns nullptr if the file couldn't be opened, isn't a snapshot, was
+// written by an incompatible version, or fails validation; non-nullptr on
+// success.
+HashTable* HashTable_Open(const char* path,
+                          KeyCmpFnPtr key_compare_function,
+                          int flags);
+
+///////////////////////////////////////////////////////////////////////////////
+// Incremental checkpoints
+//
+// Rewriting a full snapshot of a big table is expensive when only a little
+// of it has changed.  A table can instead track which of its buckets have
+// been modified, and write just those buckets to a (much smaller) delta
+// file.  A table is then restored by opening its last full snapshot and
+// applying every delta written since, in order.
+//
+// Buckets are tracked in ranges, one bit per range.  A range is marked
+// whenever an element in it is inserted, replaced or removed.  Growing the
+// table rehashes every element, so the first delta after a resize holds the
+// whole table.
+
+// Starts tracking modified buckets in a HashTable.  Tracking lasts until
+// the table is deleted.
+//
+// Arguments:
+// - table: the HashTable to track.
+// - range_buckets: the number of buckets covered by each bit of tracking
+//   state; rounded up to a power of two.  Smaller ranges make for smaller
+//   deltas, but more tracking state.
+//
+// Returns:
+// - false: if the table is read-only, or is already tracked.
+// - true: on success.
+bool HashTable_TrackDirty(HashTable* table, size_t range_buckets);
+
+// Returns the number of bucket ranges that would be written by a call to
+// HashTable_CheckpointDelta right now, or 0 if the table isn't tracked.
+size_t HashTable_NumDirtyRanges(HashTable* table);
+
+// Writes a delta holding every bucket range modified since the table was
+// last checkpointed, and then marks every range clean.  Both this function
+// and HashTable_Save count as checkpoints; the first checkpoint of a
+// tracked table must be a full HashTable_Save.
+//
+// Like HashTable_Save, the delta is written under a temporary name and
+// renamed into place.  If writing fails, the modified ranges are kept, so
+// they are included in the next attempt.
+//
+// Arguments:
+// - table: the tracked HashTable.
+// - path: the file to (over)write.
+//
+// Returns:
+// - false: if the table isn't tracked, hasn't been saved since tracking
+//   started, or the delta couldn't be written.
+// - true: on success.
+bool HashTable_CheckpointDelta(HashTable* table, const char* path);
+
+// Restores a HashTable from a snapshot and the deltas written after it.
+// The result is a writable compact table, as if opened by HashTable_Open
+// with k_ht_open_writable.
+//
+// Arguments:
+// - base_path: the snapshot written by HashTable_Save.
+// - delta_paths: the deltas written by HashTable_CheckpointDelta since that
+//   snapshot, oldest first.
+// - num_deltas: the number of entries in delta_paths.
+// - key_compare_function: as for HashTable_Open.
+//
+// Returns nullptr if any file couldn't be read or fails validation, or if
+// the deltas don't follow on from the snapshot and from each other in
+// order; non-nullptr on success.
+HashTable* HashTable_OpenCheckpoint(const char* base_path,
+                                    const char* const* delta_paths,
+                                    size_t num_deltas,
+                                    KeyCmpFnPtr key_compare_function);
+
+///////////////////////////////////////////////////////////////////////////////
+// Write-ahead logging
+//
+// A HashTable can have a write-ahead log attached, so that its mutations
+// survive a crash.  Every insert and remove then appends a small record to
+// an in-memory buffer, and a background thread writes the buffer out and
+// fsyncs it as one "group commit": once every group_ops records, or every
+// group_usecs microseconds, whichever comes first.  Reopening the log
+// replays it into the table.
+//
+// Like snapshots, logs store keys and values as raw 64-bit words (plus the
+// bytes of string keys), so they are only meaningful for tables whose keys
+// and values are stored directly in the HTKey_t and HTValue_t.
+//
+// Logged inserts and removes may be called from several threads at once;
+// the log serializes them.  Finds and iterators still need to be kept apart
+// from them by the caller.
+
+// Durability levels for logged mutations:
+//
+// - k_ht_wal_async: return immediately.  The record reaches the disk with
+//   the next group commit, so a crash loses at most one group's worth.
+// - k_ht_wal_group: wait for the next group commit, which is started right
+//   away.  Mutations made by other threads in the meantime share its fsync.
+// - k_ht_wal_sync: write and fsync the log on the calling thread before
+//   returning.
+static constexpr int k_ht_wal_async = 0;
+static constexpr int k_ht_wal_group = 1;
+static constexpr int k_ht_wal_sync = 2;
+
+// Attaches a write-ahead log to a HashTable, first replaying any records
+// already in it.  A damaged or incomplete record at the end of the log
+// (eg, from a crash mid-write) is discarded along with anything after it.
+// The log stays attached until the table is deleted.
+//
+// Arguments:
+// - table: the HashTable to log.  Typically it is empty, or was just opened
+//   from the snapshot that the log follows on from.
+// - path: the log file; it is created if it doesn't exist.
+// - group_ops: commit once this many records are waiting.
+// - group_usecs: commit at least this often; 0 for no time limit.
+// - durability: the k_ht_wal_* level used by HashTable_Insert and
+//   HashTable_Remove.
+//
+// Returns:
+// - false: if the table is read-only, a multimap or already logged, or the
+//   log couldn't be opened or was written for a different kind of table.
+// - true: on success.
+bool HashTable_AttachLog(HashTable* table,
+                         const char* path,
+                         size_t group_ops,
+                         uint64_t group_usecs,
+                         int durability);
+
+// The same as HashTable_Insert and HashTable_Remove, except that for a
+// logged table the mutation is as durable as "durability" (a k_ht_wal_*
+// level) asks for by the time they return.  For a table without a log,
+// durability is ignored.
+bool HashTable_InsertDurable(HashTable* table,
+                             HTKeyValue_t newkeyvalue,
+                             HTKeyValue_t* oldkeyvalue,
+                             int durability);
+bool HashTable_RemoveDurable(HashTable* table,
+                             HTHash_t hash,
+                             HTKey_t key,
+                             HTKeyValue_t* keyvalue,
+                             int durability);
+
+// Waits until every mutation logged so far is on disk.
+//
+// Returns false if the table has no log, or writing the log has failed (in
+// which case mutations keep being applied in memory, but no longer reach
+// the disk); true otherwise.
+bool HashTable_SyncLog(HashTable* table);
+
+// Empties a table's log.  Call it once the table has been saved with
+// HashTable_Save, while no other thread is mutating the table; from then on
+// the log follows on from that snapshot.
+//
+// Returns false if the table has no log, or the log couldn't be truncated;
+// true otherwise.
+bool HashTable_TruncateLog(HashTable* table);
+
+///////////////////////////////////////////////////////////////////////////////
+// Per-entry expiry
+//
+// Entries in a compact table can be given a time to live.  Each such entry
+// gets a timer in a hierarchical timer wheel, so HashTable_Expire only does
+// work for the entries that are actually due, instead of sweeping the
+// whole table.  An entry that is past its deadline stays in the table until
+// HashTable_Expire removes it, but HashTable_Find treats it as missing.
+// Iterators still visit it.
+//
+// Time is whatever the table's clock function returns, in ticks of the
+// customer's choosing (eg, milliseconds); TTLs are in the same ticks.
+// Snapshots, deltas and logs don't record TTLs, so a table opened or
+// restored from them has none.
+
+// Returns the current time, in ticks.  It should never go backwards.
+typedef uint64_t (*HTClockFnPtr)();
+
+// Enables per-entry expiry on a compact table.  Expiry lasts until the
+// table is deleted.
+//
+// Arguments:
+// - table: a table created by HashTable_NewCompact or
+//   HashTable_NewStringKeys, or opened from a snapshot with
+//   k_ht_open_writable.
+// - clock: a function returning the current time, or nullptr for a
+//   monotonic clock in milliseconds.
+// - kv_free_function: invoked on each (key,value) as it expires.
+//
+// Returns:
+// - false: if the table is chained or read-only, or already has expiry
+//   enabled.
+// - true: on success.
+bool HashTable_EnableExpiry(HashTable* table,
+                            HTClockFnPtr clock,
+                            KeyValueFreeFnPtr kv_free_function);
+
+// The same as HashTable_Insert, except that the new (key,value) expires
+// ttl ticks from now; the table must have expiry enabled.  (HashTable_Insert
+// itself inserts without a TTL, cancelling any that a replaced (key,value)
+// had.)
+bool HashTable_InsertWithTTL(HashTable* table,
+                             HTKeyValue_t newkeyvalue,
+                             uint64_t ttl,
+                             HTKeyValue_t* oldkeyvalue);
+
+// Removes every (key,value) whose deadline is at or before now, and frees
+// it with the kv_free_function passed to HashTable_EnableExpiry.  This
+// takes time in proportion to the number of (key,value)s expired, plus a
+// little for each occupied slot of the timer wheel passed over; not to the
+// size of the table.
+//
+// Returns the number of (key,value)s expired, or 0 if the table doesn't
+// have expiry enabled.
+size_t HashTable_Expire(HashTable* table, uint64_t now);
+
+///////////////////////////////////////////////////////////////////////////////
+// Ordered iteration
+//
+// A compact table can keep its (key,value)s on an order list, as well as in
+// its buckets, so that iterators visit them in a deterministic order: the
+// order in which they were inserted, or the order in which they were last
+// used.  Each (key,value) costs 8 more bytes, and inserts and removes
+// update the order list in O(1).  Iterating still takes time in proportion
+// to the number of (key,value)s.
+//
+// Snapshots, deltas and logs don't record the order.
+
+// Iteration orders for HashTable_EnableOrder:
+//
+// - k_ht_order_insertion: the order in which keys were first inserted.
+//   Replacing a key's value leaves it where it was; removing a key and
+//   inserting it again moves it to the end.
+// - k_ht_order_access: least recently used first, where inserting,
+//   replacing or finding a key uses it.  Iterating over the table, or over
+//   a multimap's (key,value)s with HashTable_FindAll, doesn't.
+static constexpr int k_ht_order_insertion = 1;
+static constexpr int k_ht_order_access = 2;
+
+// Makes a compact table's iterators visit its (key,value)s in order.  Any
+// (key,value)s already in the table are ordered as an iterator would have
+// visited them, ahead of any inserted later.  The order is kept until the
+// table is deleted.
+//
+// Arguments:
+// - table: a table created by HashTable_NewCompact or
+//   HashTable_NewStringKeys, or opened from a snapshot with
+//   k_ht_open_writable.
+// - order: k_ht_order_insertion or k_ht_order_access.
+//
+// Returns:
+// - false: if the table is chained, read-only or already ordered, or order
+//   isn't one of the above.
+// - true: on success.
+bool HashTable_EnableOrder(HashTable* table, int order);
+
+///////////////////////////////////////////////////////////////////////////////
+// Multimaps
+//
+// A compact table can be made into a multimap, which holds any number of
+// (key,value)s with equal keys.  HashTable_Insert then never replaces
+// anything: it adds the new (key,value) in front of any others with the
+// same key, and always returns false.  HashTable_Find returns, and
+// HashTable_Remove removes, the most recently inserted of them.
+//
+// A key's (key,value)s are kept next to each other in their bucket's
+// chain, so HashTable_FindAll and HashTable_Count find the first of them
+// and then step straight through the rest, without looking at any other
+// keys on the way.
+//
+// Write-ahead logs can't be attached to multimaps, since their records
+// don't say which of a key's (key,value)s a removal took.  Snapshots and
+// deltas of a multimap restore it as a multimap.
+
+// Makes an empty compact table into a multimap, for good.
+//
+// Arguments:
+// - table: an empty table created by HashTable_NewCompact or
+//   HashTable_NewStringKeys, or opened from a snapshot with
+//   k_ht_open_writable.
+//
+// Returns:
+// - false: if the table is chained, read-only, logged, not empty, or
+//   already a multimap.
+// - true: on success.
+bool HashTable_EnableMultimap(HashTable* table);
+
+// A cursor over the (key,value)s with a given key, returned by
+// HashTable_FindAll.  It is a small value that refers into the table, so
+// there is nothing to deallocate, and its fields are private.  Like an
+// iterator, it becomes undefined if the table is mutated.
+typedef struct {
+  HashTable* table;        // the table it points into
+  uint32_t idx;            // the current (key,value), or UINT32_MAX if none
+  uint64_t now;            // the time, if the table has expiry enabled
+  HTStringKey_t key_view;  // the current key, for string-key tables
+} HTCursor_t;
+
+// Finds every (key,value) with the given key in a compact table (most
+// recently inserted first, for a multimap), skipping any that are past
+// their deadline; see HashTable_EnableExpiry.
+//
+// Arguments:
+// - table: the compact table to look in.
+// - hash: the hash of the key to look up.
+// - key: the key to look up.
+//
+// Returns a cursor pointing at the first of them, which is invalid if
+// there are none (or if the table is chained).
+HTCursor_t HashTable_FindAll(HashTable* table, HTHash_t hash, HTKey_t key);
+
+// Returns true if the cursor points at a (key,value), false if it is past
+// the last one.
+bool HTCursor_IsValid(const HTCursor_t* cursor);
+
+// Advances the cursor to the key's next (key,value).  Returns false if
+// there are no more, leaving the cursor invalid; true otherwise.
+bool HTCursor_Next(HTCursor_t* cursor);
+
+// Copies the (key,value) the cursor points at into keyvalue, as
+// HTIterator_Get would.  Returns false if the cursor is invalid; true
+// otherwise.
+bool HTCursor_Get(HTCursor_t* cursor, HTKeyValue_t* keyvalue);
+
+// Returns the number of (key,value)s with the given key that
+// HashTable_FindAll would visit, without copying any of them out.  (For a
+// chained table, which can't be a multimap, this is 0 or 1.)
+size_t HashTable_Count(HashTable* table, HTHash_t hash, HTKey_t key);
+
+///////////////////////////////////////////////////////////////////////////////
+// Frozen tables
+//
+// A table that is done changing can be frozen: rebuilt, once, around a
+// minimal perfect hash of its (key,value)s' hashes, which maps each of them
+// to a slot of its own in a flat array holding nothing but the
+// (key,value)s.  There are no buckets, chains or spare slots left, so the
+// table takes little more memory than its (key,value)s themselves (about
+// one byte each for the perfect hash), and HashTable_Find reads one slot
+// and compares one key, however the hashes happen to fall.
+//
+// A frozen table is read-only for good: inserts and removes do nothing and
+// return false.  Iterators, HashTable_FindAll and HashTable_Count work as
+// usual.  HashTable_Save writes a frozen table's arrays out as they are,
+// and HashTable_Open maps them back in as a frozen table, read-only
+// whatever the flags.
+
+// Freezes a table, chained or compact.  A chained table becomes a compact
+// one; its (key,value)s stay the caller's to free, as before.
+//
+// Arguments:
+// - table: the table to freeze.
+//
+// Returns:
+// - false: if the table is already frozen, is a multimap, is ordered, has
+//   expiry enabled, is tracked for checkpoints or has a log attached, or if
+//   two of its (key,value)s have equal hashes.  The table is left as it
+//   was.
+// - true: on success.
+bool HashTable_Freeze(HashTable* table);
+
+///////////////////////////////////////////////////////////////////////////////
+// Snapshots
+//
+// A snapshot is a read-only view of a chained table as it was when the
+// snapshot was taken.  Taking one copies nothing: the snapshot shares the
+// table's bucket array, and the array's reference count tells the table to
+// copy before it writes.  The first write after a snapshot copies the array
+// of chain pointers; after that, the first write to each bucket copies that
+// bucket's chain, (key,value) records and all, and leaves the old chain to
+// the snapshot.  Buckets that are never written stay shared.
+//
+// Since nothing a snapshot can see is ever changed in place, a snapshot and
+// its iterators may be used on other threads while the table goes on being
+// written, with no locking, and its iterators stay valid whatever happens
+// to the table.  (The table itself still needs its usual locking.)
+//
+// The keys and values themselves aren't copied, though.  A (key,value)
+// removed or replaced while a snapshot still holds it must not be freed
+// until that snapshot is deleted, and the table must be deleted after its
+// snapshots, or with a free function that does nothing.
+
+// Takes a snapshot of a chained table, in O(1).  The snapshot is itself a
+// HashTable: HashTable_Find, HashTable_NumElements, iterators and so on
+// work on it as on any other table, while inserts and removes do nothing
+// and return false.  Taking a snapshot must not race with writes to the
+// table; reading the snapshot may.
+//
+// Arguments:
+// - table: the table, or another snapshot, to take a snapshot of.
+//
+// Returns:
+// - nullptr: if the table is compact.
+// - the snapshot, which the caller deletes with HashTable_Delete.  Its
+//   (key,value)s belong to the table, so the free function passed to
+//   HashTable_Delete is never called for them.
+HashTable* HashTable_Snapshot(HashTable* table);
+
 ///////////////////////////////////////////////////////////////////////////////
 // HashTable iterator
 //
 // HashTables support the notion of an iterator, similar to Java iterators.
 // You use an iterator to iterate forward through the HashTable.   The order
 // in which the iterator goes through the HashTable is undefined, and not
-// necessarily deterministic; all that is promised is that each (key,value)
+// necessarily deterministic (unless the table is ordered; see
+// HashTable_EnableOrder); all that is promised is that each (key,value)
 // is visited exactly once.  Also, if the customer uses a HashTable function
 // to mutate the hash table, any existing iterators become undefined (ie,
-// dangerous to use; arbitrary memory corruption can occur).
+// dangerous to use; arbitrary memory corruption can occur).  Iterators
+// over a snapshot (see HashTable_Snapshot) are the exception.
 typedef struct ht_it HTIterator;  // same trick to hide implementation.
 
 // Manufacture an iterator for the table.  If there are
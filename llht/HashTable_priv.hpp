@@ -1,8 +1,10 @@
 #ifndef HASHTABLE_PRIV_HPP_
 #define HASHTABLE_PRIV_HPP_
 
+#include <atomic>   // for std::atomic
 #include <cstdint>  // for uint32_t, etc.
 
+#include "./CompactTable_priv.hpp"
 #include "./HashTable.hpp"
 #include "./LinkedList.hpp"
 
@@ -17,26 +19,84 @@
 // its contents.
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
+// Dirty-bucket tracking state (see HashTable_TrackDirty).
+//
+// Bucket b belongs to range b >> range_shift.  A resize changes which bucket
+// every element lives in, so rather than marking each range it sets "all".
+typedef struct ht_dirty {
+  uint64_t* bits;     // one bit per range, set if the range is dirty
+  size_t num_ranges;  // # of ranges covering the table's buckets
+  int range_shift;    // log2 of the # of buckets per range
+  bool all;           // has the table been resized since the last checkpoint?
+  uint64_t base_id;   // image id of the last HashTable_Save, or 0 if none
+  uint64_t seq;       // # of deltas written since that save
+} HTDirtyMap;
+
+// A chained table's bucket array, shared copy-on-write between the table
+// and its snapshots (see HashTable_Snapshot).
+//
+// An array is never changed while more than one table or array refers to
+// it.  A table that has to write to a shared array makes a new one instead,
+// copying the chain pointers and "borrowing" every chain from the old
+// array, its parent; it then copies each borrowed chain, and marks it its
+// own, before writing to it.  A chain is freed along with the array that
+// owns it, and an array keeps its parent alive for as long as it borrows
+// anything from it.
+typedef struct ht_shared {
+  std::atomic<uint32_t> refs;  // # of tables and arrays referring to this
+  LinkedList** buckets;        // the array of buckets
+  size_t num_buckets;          // # of buckets in the array
+  uint64_t* borrowed;          // one bit per bucket, set if parent owns it
+  size_t num_borrowed;         // # of bits set in borrowed
+  struct ht_shared* parent;    // the array borrowed from, or nullptr
+} HTSharedBuckets;
+
+struct ht_log;     // the write-ahead log; see TableLog_priv.hpp
+struct ht_expiry;  // the expiry timer wheel; see TableExpiry_priv.hpp
+
 // The hash table implementation.
 //
 // A hash table is an array of buckets, where each bucket is a linked list
-// of HTKeyValue structs.
+// of HTKeyValue structs.  A table created by HashTable_NewCompact instead
+// keeps all of its state in "compact"; its buckets array is unused.  A
+// chained table with snapshots, and each snapshot, refer to their buckets
+// array through "shared".
 typedef struct ht {
-  size_t num_buckets;      // # of buckets in this HT
-  size_t num_elements;     // # of elements currently in this HT
-  LinkedList** buckets;    // the array of buckets
-  KeyCmpFnPtr key_cmp_fn;  // to check for key collisions
+  size_t num_buckets;        // # of buckets in this HT
+  size_t num_elements;       // # of elements currently in this HT
+  LinkedList** buckets;      // the array of buckets
+  KeyCmpFnPtr key_cmp_fn;    // to check for key collisions
+  CompactTable* compact;     // compact storage, or nullptr if chained
+  HTDirtyMap* dirty;         // dirty-bucket tracking, or nullptr if untracked
+  struct ht_log* log;        // write-ahead log, or nullptr if unlogged
+  struct ht_expiry* expiry;  // expiry timer wheel, or nullptr if none
+  HTSharedBuckets* shared;   // buckets' sharing state, or nullptr if unshared
+  bool snapshot;             // is this a (read-only) snapshot?
 } HashTable;
 
 // The hash table iterator.
+//
+// For a compact table, bucket_idx is instead the index of the current entry
+// and bucket_it is always nullptr.  An ordered table's iterator follows its
+// order list, and is past the end once bucket_idx is k_ct_nil.
 typedef struct ht_it {
-  HashTable* ht;          // the HT we're pointing into
-  size_t bucket_idx;      // which bucket are we in?
-  LLIterator* bucket_it;  // iterator for the bucket, or nullptr
+  HashTable* ht;           // the HT we're pointing into
+  size_t bucket_idx;       // which bucket are we in?
+  LLIterator* bucket_it;   // iterator for the bucket, or nullptr
+  HTStringKey_t key_view;  // the current key, for string-key tables
 } HTIterator;
 
 // This is the internal hash function we use to map from HTHash_t hashes to a
 // bucket number.
 size_t HashToBucketNum(HashTable* ht, HTHash_t hash);
 
+// Removes entry idx of a compact table the way HashTable_Remove would,
+// logging the removal and marking its bucket dirty as need be, and returns
+// it as CompactTable_RemoveAt does.  Used to remove entries whose index is
+// already known, as they expire or through an iterator.
+void HashTable_RemoveIndex(HashTable* table,
+                           uint32_t idx,
+                           HTStringKey_t* key_view,
+                           HTKeyValue_t* keyvalue);
+
 #endif  // HASHTABLE_PRIV_HPP_
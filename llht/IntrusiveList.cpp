@@ -0,0 +1,159 @@
+#include <cstddef>
+
+#include "IntrusiveList.hpp"
+#include "IntrusiveList_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// Splices link, which is on list, out of it, and marks it as on no list.
+static void Unlink(IntrusiveList* list, ILLink* link) {
+  if (link->prev == nullptr) {
+    list->head = link->next;
+  } else {
+    link->prev->next = link->next;
+  }
+  if (link->next == nullptr) {
+    list->tail = link->prev;
+  } else {
+    link->next->prev = link->prev;
+  }
+  list->num_elements--;
+  ILLink_Init(link);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ILLink and IntrusiveList implementation.
+
+void ILLink_Init(ILLink* link) {
+  link->next = nullptr;
+  link->prev = nullptr;
+  link->list = nullptr;
+}
+
+IntrusiveList* ILLink_List(const ILLink* link) {
+  return link->list;
+}
+
+IntrusiveList* IntrusiveList_New() {
+  IntrusiveList* list = new IntrusiveList();
+  list->num_elements = 0;
+  list->head = nullptr;
+  list->tail = nullptr;
+  return list;
+}
+
+void IntrusiveList_Delete(IntrusiveList* list,
+                          ILLinkFreeFnPtr link_free_function) {
+  ILLink* link;
+  while (IntrusiveList_Pop(list, &link)) {
+    if (link_free_function != nullptr) {
+      link_free_function(link);
+    }
+  }
+  delete list;
+}
+
+size_t IntrusiveList_NumElements(IntrusiveList* list) {
+  return list->num_elements;
+}
+
+void IntrusiveList_Push(IntrusiveList* list, ILLink* link) {
+  link->list = list;
+  link->prev = nullptr;
+  link->next = list->head;
+  if (list->head == nullptr) {
+    list->tail = link;
+  } else {
+    list->head->prev = link;
+  }
+  list->head = link;
+  list->num_elements++;
+}
+
+bool IntrusiveList_Pop(IntrusiveList* list, ILLink** link_ptr) {
+  if (list->head == nullptr) {
+    return false;
+  }
+  *link_ptr = list->head;
+  Unlink(list, list->head);
+  return true;
+}
+
+void IntrusiveList_Append(IntrusiveList* list, ILLink* link) {
+  link->list = list;
+  link->next = nullptr;
+  link->prev = list->tail;
+  if (list->tail == nullptr) {
+    list->head = link;
+  } else {
+    list->tail->next = link;
+  }
+  list->tail = link;
+  list->num_elements++;
+}
+
+bool IntrusiveList_Slice(IntrusiveList* list, ILLink** link_ptr) {
+  if (list->tail == nullptr) {
+    return false;
+  }
+  *link_ptr = list->tail;
+  Unlink(list, list->tail);
+  return true;
+}
+
+bool IntrusiveList_Remove(ILLink* link) {
+  if (link->list == nullptr) {
+    return false;
+  }
+  Unlink(link->list, link);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ILIterator implementation.
+
+ILIterator* ILIterator_New(IntrusiveList* list) {
+  ILIterator* iter = new ILIterator();
+  iter->list = list;
+  iter->link = list->head;
+  return iter;
+}
+
+void ILIterator_Delete(ILIterator* iter) {
+  delete iter;
+}
+
+bool ILIterator_IsValid(ILIterator* iter) {
+  return iter->link != nullptr;
+}
+
+bool ILIterator_Next(ILIterator* iter) {
+  if (iter->link == nullptr) {
+    return false;
+  }
+  iter->link = iter->link->next;
+  return iter->link != nullptr;
+}
+
+void ILIterator_Get(ILIterator* iter, ILLink** link_ptr) {
+  if (iter->link == nullptr) {
+    return;
+  }
+  *link_ptr = iter->link;
+}
+
+bool ILIterator_Remove(ILIterator* iter, ILLinkFreeFnPtr link_free_function) {
+  ILLink* link = iter->link;
+  iter->link = (link->next != nullptr) ? link->next : link->prev;
+  Unlink(iter->list, link);
+  if (link_free_function != nullptr) {
+    link_free_function(link);
+  }
+  return iter->list->num_elements > 0;
+}
+
+void ILIterator_Rewind(ILIterator* iter) {
+  iter->link = iter->list->head;
+}
@@ -0,0 +1,133 @@
+#ifndef INTRUSIVELIST_HPP_
+#define INTRUSIVELIST_HPP_
+
+#include <cstddef>  // for size_t and offsetof
+
+///////////////////////////////////////////////////////////////////////////////
+// An IntrusiveList is a doubly-linked list whose nodes are embedded in the
+// customer's own objects.
+//
+// A LinkedList allocates a node for every payload it holds, so an object on
+// several lists costs several allocations, and removing it from one of them
+// needs an iterator that has walked to it.  An IntrusiveList instead links
+// together ILLinks that the customer embeds in their objects, one per list
+// the object can be on:
+//
+//   typedef struct {
+//     int key;
+//     ILLink by_age;    // membership in one list
+//     ILLink by_owner;  // membership in another
+//   } Entry;
+//
+// Pushing, appending and removing never allocate, and an object can be
+// removed from a list in O(1) given just its link.  IL_CONTAINER_OF
+// recovers the object from a link that a Pop or an iterator hands back.
+//
+// The list never frees its customers' objects on its own; where the
+// LinkedList interface takes a payload free function, this one takes an
+// optional function to call on each link that leaves the list.
+//
+// The interface otherwise mirrors LinkedList's: IntrusiveList_X behaves
+// exactly like LinkedList_X, and ILIterator_X like LLIterator_X, except
+// where noted.
+typedef struct il IntrusiveList;
+
+// The link that customers embed in their objects.  Initialize it with
+// ILLink_Init before its first use, and don't touch its fields.  A link
+// may be on at most one list at a time.
+typedef struct il_link {
+  struct il_link* next;  // next link in the list, or nullptr
+  struct il_link* prev;  // prev link in the list, or nullptr
+  IntrusiveList* list;   // the list it is on, or nullptr if none
+} ILLink;
+
+// Called on links as they leave a list through IntrusiveList_Delete or
+// ILIterator_Remove, eg to return their objects to a pool.
+typedef void (*ILLinkFreeFnPtr)(ILLink* link);
+
+// Given a pointer to the ILLink named member within an object of type
+// type, evaluates to a pointer to the object.  type must be a standard-
+// layout type, such as a plain struct.
+#define IL_CONTAINER_OF(link_ptr, type, member) \
+  (reinterpret_cast<type*>(reinterpret_cast<char*>(link_ptr) - \
+                           offsetof(type, member)))
+
+// Mark a link as not being on any list.
+void ILLink_Init(ILLink* link);
+
+// Returns the list a link is on, or nullptr if it isn't on one.
+IntrusiveList* ILLink_List(const ILLink* link);
+
+// Allocate and return a new, empty intrusive list.  The caller takes
+// responsibility for eventually calling IntrusiveList_Delete.
+IntrusiveList* IntrusiveList_New();
+
+// Free an intrusive list.  Each link still on it is unlinked and, if
+// link_free_function is non-null, passed to it.
+void IntrusiveList_Delete(IntrusiveList* list,
+                          ILLinkFreeFnPtr link_free_function);
+
+// Return the number of elements in the list.
+size_t IntrusiveList_NumElements(IntrusiveList* list);
+
+// Add a link, which must not be on any list, to the head of the list.
+void IntrusiveList_Push(IntrusiveList* list, ILLink* link);
+
+// Remove the link at the head of the list, returning it through link_ptr.
+// Returns false if the list is empty.
+bool IntrusiveList_Pop(IntrusiveList* list, ILLink** link_ptr);
+
+// Add a link, which must not be on any list, to the tail of the list.
+void IntrusiveList_Append(IntrusiveList* list, ILLink* link);
+
+// Remove the link at the tail of the list, returning it through link_ptr.
+// Returns false if the list is empty.
+bool IntrusiveList_Slice(IntrusiveList* list, ILLink** link_ptr);
+
+// Remove a link from whichever list it is on, in O(1).
+//
+// Returns:
+// - false if the link wasn't on a list; nothing changes.
+// - true if it was removed.
+bool IntrusiveList_Remove(ILLink* link);
+
+///////////////////////////////////////////////////////////////////////////////
+// Intrusive list iterator.
+//
+// As with LLIterators, mutating a list with an IntrusiveList_*() function
+// makes its iterators undefined.  That includes removing a link that some
+// iterator isn't pointing at with IntrusiveList_Remove.
+typedef struct il_iter ILIterator;
+
+// Manufacture an iterator for the list, pointing at its head.  The caller
+// is responsible for eventually calling ILIterator_Delete.
+ILIterator* ILIterator_New(IntrusiveList* list);
+
+// Free an iterator.
+void ILIterator_Delete(ILIterator* iter);
+
+// Returns true iff the iterator is pointing at an element.
+bool ILIterator_IsValid(ILIterator* iter);
+
+// Advance the iterator.  Returns true if it now points at an element, or
+// false if it has moved past the end.
+bool ILIterator_Next(ILIterator* iter);
+
+// Returns the link the (valid) iterator points at through link_ptr.
+void ILIterator_Get(ILIterator* iter, ILLink** link_ptr);
+
+// Remove the link the (valid) iterator points at, passing it to
+// link_free_function if that is non-null.  Afterwards the iterator points
+// at the removed link's successor or, if it was the tail, its predecessor.
+// If the list is now empty, the iterator is invalid, though it still has
+// to be freed with ILIterator_Delete.
+//
+// Returns:
+// - false if the list is now empty.
+// - true if the list is still non-empty.
+bool ILIterator_Remove(ILIterator* iter, ILLinkFreeFnPtr link_free_function);
+
+// Rewind an iterator to the front of its list.
+void ILIterator_Rewind(ILIterator* iter);
+
+#endif  // INTRUSIVELIST_HPP_
@@ -0,0 +1,30 @@
+#ifndef INTRUSIVELIST_PRIV_HPP_
+#define INTRUSIVELIST_PRIV_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./IntrusiveList.hpp"  // for IntrusiveList, ILLink and ILIterator
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our IntrusiveList
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The entire intrusive list.  The links themselves live in customers'
+// objects.
+typedef struct il {
+  size_t num_elements;  // # elements in the list
+  ILLink* head;         // head of the list, or nullptr if empty
+  ILLink* tail;         // tail of the list, or nullptr if empty
+} IntrusiveList;
+
+// An intrusive list iterator.
+typedef struct il_iter {
+  IntrusiveList* list;  // the list we're for
+  ILLink* link;         // the link we are at, or nullptr if invalid
+} ILIterator;
+
+#endif  // INTRUSIVELIST_PRIV_HPP_
@@ -0,0 +1,144 @@
+#include <cstddef>
+
+#include "HashTable.hpp"
+#include "IntrusiveList.hpp"
+#include "LRUCache.hpp"
+#include "LRUCache_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The number of buckets a byte-budgeted cache's table starts out with; it
+// grows as usual.  An entry-budgeted cache knows how many entries it will
+// hold, and starts out with that many buckets, so that its chains stay
+// short without ever resizing.
+static constexpr size_t k_lru_initial_buckets = 64;
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+static LRUEntry* EntryOf(ILLink* link) {
+  return IL_CONTAINER_OF(link, LRUEntry, recency);
+}
+
+// Evicts least recently used entries until the cache is within budget.
+static void EvictToBudget(LRUCache* cache) {
+  ILLink* link;
+  while (cache->used > cache->capacity &&
+         IntrusiveList_Pop(cache->recency, &link)) {
+    LRUEntry* entry = EntryOf(link);
+    HTKeyValue_t removed;
+    HashTable_Remove(cache->table, entry->kv.hash, entry->kv.key, &removed);
+    cache->used -= entry->size;
+    cache->stats.evictions++;
+    if (cache->evict_fn != nullptr) {
+      cache->evict_fn(entry->kv);
+    }
+    delete entry;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LRUCache implementation.
+
+LRUCache* LRUCache_New(size_t capacity,
+                       KeyCmpFnPtr key_compare_function,
+                       LRUSizeFnPtr size_function,
+                       LRUEvictFnPtr evict_function) {
+  if (capacity == 0) {
+    return nullptr;
+  }
+  LRUCache* cache = new LRUCache();
+  cache->table = HashTable_NewCompact(
+      size_function == nullptr ? capacity : k_lru_initial_buckets,
+      key_compare_function);
+  cache->recency = IntrusiveList_New();
+  cache->capacity = capacity;
+  cache->used = 0;
+  cache->size_fn = size_function;
+  cache->evict_fn = evict_function;
+  cache->stats = LRUStats_t{0, 0, 0};
+  return cache;
+}
+
+void LRUCache_Delete(LRUCache* cache, KeyValueFreeFnPtr kv_free_function) {
+  ILLink* link;
+  while (IntrusiveList_Pop(cache->recency, &link)) {
+    LRUEntry* entry = EntryOf(link);
+    kv_free_function(entry->kv);
+    delete entry;
+  }
+  IntrusiveList_Delete(cache->recency, nullptr);
+  HashTable_Delete(cache->table, &NoOpFree);
+  delete cache;
+}
+
+size_t LRUCache_NumElements(LRUCache* cache) {
+  return IntrusiveList_NumElements(cache->recency);
+}
+
+size_t LRUCache_Used(LRUCache* cache) {
+  return cache->used;
+}
+
+bool LRUCache_Get(LRUCache* cache,
+                  HTHash_t hash,
+                  HTKey_t key,
+                  HTKeyValue_t* keyvalue) {
+  HTKeyValue_t found;
+  if (!HashTable_Find(cache->table, hash, key, &found)) {
+    cache->stats.misses++;
+    return false;
+  }
+  cache->stats.hits++;
+  LRUEntry* entry = static_cast<LRUEntry*>(found.value);
+  IntrusiveList_Remove(&entry->recency);
+  IntrusiveList_Append(cache->recency, &entry->recency);
+  *keyvalue = entry->kv;
+  return true;
+}
+
+bool LRUCache_Put(LRUCache* cache,
+                  HTKeyValue_t newkeyvalue,
+                  HTKeyValue_t* oldkeyvalue) {
+  LRUEntry* entry = new LRUEntry();
+  entry->kv = newkeyvalue;
+  entry->size = (cache->size_fn != nullptr) ? cache->size_fn(newkeyvalue) : 1;
+  ILLink_Init(&entry->recency);
+
+  HTKeyValue_t old;
+  const bool replaced = HashTable_Insert(
+      cache->table, HTKeyValue_t{newkeyvalue.hash, newkeyvalue.key, entry},
+      &old);
+  if (replaced) {
+    LRUEntry* old_entry = static_cast<LRUEntry*>(old.value);
+    IntrusiveList_Remove(&old_entry->recency);
+    cache->used -= old_entry->size;
+    *oldkeyvalue = old_entry->kv;
+    delete old_entry;
+  }
+  IntrusiveList_Append(cache->recency, &entry->recency);
+  cache->used += entry->size;
+  EvictToBudget(cache);
+  return replaced;
+}
+
+bool LRUCache_Remove(LRUCache* cache,
+                     HTHash_t hash,
+                     HTKey_t key,
+                     HTKeyValue_t* keyvalue) {
+  HTKeyValue_t removed;
+  if (!HashTable_Remove(cache->table, hash, key, &removed)) {
+    return false;
+  }
+  LRUEntry* entry = static_cast<LRUEntry*>(removed.value);
+  IntrusiveList_Remove(&entry->recency);
+  cache->used -= entry->size;
+  *keyvalue = entry->kv;
+  delete entry;
+  return true;
+}
+
+void LRUCache_GetStats(LRUCache* cache, LRUStats_t* stats) {
+  *stats = cache->stats;
+}
@@ -0,0 +1,122 @@
+#ifndef LRUCACHE_HPP_
+#define LRUCACHE_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"  // for HTKeyValue_t, KeyCmpFnPtr, etc.
+
+///////////////////////////////////////////////////////////////////////////////
+// An LRUCache is a HashTable of bounded size that evicts its least recently
+// used (key,value)s to make room for new ones.
+//
+// Each cached (key,value) lives in an entry that is both stored in a
+// HashTable and linked into a recency list, so a lookup takes a single
+// probe of the table and then moves the entry to the most-recently-used
+// end of the list in O(1).
+//
+// The cache's capacity is a budget: either a number of entries, or, given
+// a size function, a number of bytes (or any other unit the size function
+// measures in).  Adding an entry evicts least recently used entries until
+// the cache is back within its budget.  An entry that is larger than the
+// whole budget is therefore evicted straight away.
+//
+// Keys and values are owned the same way as in a HashTable.  Like a
+// HashTable, a cache may not be used from several threads at once.
+typedef struct lru LRUCache;
+
+// Returns the size of a (key,value), in the units of the cache's capacity.
+typedef size_t (*LRUSizeFnPtr)(HTKeyValue_t keyvalue);
+
+// Called on each (key,value) the cache evicts, which the cache no longer
+// owns; for example, to free it.
+typedef void (*LRUEvictFnPtr)(HTKeyValue_t keyvalue);
+
+// Counters kept by a cache since it was created.
+typedef struct {
+  uint64_t hits;       // LRUCache_Get calls that found their key
+  uint64_t misses;     // LRUCache_Get calls that didn't
+  uint64_t evictions;  // entries evicted to stay within the budget
+} LRUStats_t;
+
+// Allocate and return a new, empty cache.
+//
+// Arguments:
+// - capacity: the budget.  If size_function is nullptr, this is the most
+//   entries the cache holds; otherwise, the most their sizes can add up
+//   to.  MUST be greater than zero.
+// - key_compare_function: a function pointer to compare two keys; see
+//   HashTable_New.
+// - size_function: measures each entry as it is added, or nullptr to count
+//   each entry as 1.
+// - evict_function: called on each evicted entry, or nullptr.
+//
+// Returns nullptr on error, non-nullptr on success.
+LRUCache* LRUCache_New(size_t capacity,
+                       KeyCmpFnPtr key_compare_function,
+                       LRUSizeFnPtr size_function,
+                       LRUEvictFnPtr evict_function);
+
+// Deallocates a cache, invoking kv_free_function on each (key,value) still
+// in it.  evict_function is not called.
+void LRUCache_Delete(LRUCache* cache, KeyValueFreeFnPtr kv_free_function);
+
+// Returns the number of entries in the cache.
+size_t LRUCache_NumElements(LRUCache* cache);
+
+// Returns the total size of the entries in the cache, in the units of its
+// capacity.
+size_t LRUCache_Used(LRUCache* cache);
+
+// Looks up a key and, if it is present, makes it the most recently used
+// entry and returns a copy of its (key,value).
+//
+// Arguments:
+// - cache: the cache to look in.
+// - hash: the hash of the key to look up.
+// - key: the key to look up.
+// - keyvalue: if the key is present, a copy of the (key,value) is returned
+//   through this return parameter.  It is left in the cache.
+//
+// Returns:
+//  - false: if the key wasn't in the cache (a miss).
+//  - true: if the key was found (a hit).
+bool LRUCache_Get(LRUCache* cache,
+                  HTHash_t hash,
+                  HTKey_t key,
+                  HTKeyValue_t* keyvalue);
+
+// Adds a (key,value) to the cache as its most recently used entry, and then
+// evicts least recently used entries, invoking evict_function on each,
+// until the cache is within its budget.
+//
+// Arguments:
+// - cache: the cache to add to.
+// - newkeyvalue: the (key,value) to add.
+// - oldkeyvalue: if the key was already in the cache, its old (key,value)
+//   is replaced and returned through this return parameter, and the caller
+//   takes ownership of it.
+//
+// Returns:
+//  - false: if there was no entry with that key.
+//  - true: if an old (key,value) was replaced and returned.
+bool LRUCache_Put(LRUCache* cache,
+                  HTKeyValue_t newkeyvalue,
+                  HTKeyValue_t* oldkeyvalue);
+
+// Removes a (key,value) from the cache, without counting it as an
+// eviction.
+//
+// Returns:
+//  - false: if the key wasn't in the cache.
+//  - true: if it was; the (key,value) is returned through keyvalue, and the
+//    caller takes ownership of it.
+bool LRUCache_Remove(LRUCache* cache,
+                     HTHash_t hash,
+                     HTKey_t key,
+                     HTKeyValue_t* keyvalue);
+
+// Returns the cache's hit, miss and eviction counters through stats.
+void LRUCache_GetStats(LRUCache* cache, LRUStats_t* stats);
+
+#endif  // LRUCACHE_HPP_
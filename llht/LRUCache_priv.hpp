@@ -0,0 +1,38 @@
+#ifndef LRUCACHE_PRIV_HPP_
+#define LRUCACHE_PRIV_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"      // for HashTable and HTKeyValue_t
+#include "./IntrusiveList.hpp"  // for IntrusiveList and ILLink
+#include "./LRUCache.hpp"       // for LRUCache
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our LRUCache implementation,
+// broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// A cached (key,value).  The table maps its key to the entry itself, so a
+// lookup finds the entry's recency link without a second search.
+typedef struct lru_entry {
+  HTKeyValue_t kv;  // the customer's (key,value)
+  size_t size;      // its size, as measured when it was added
+  ILLink recency;   // its link in the cache's recency list
+} LRUEntry;
+
+// The cache.  Entries are ordered in "recency" from least recently used, at
+// the head, to most recently used, at the tail.
+typedef struct lru {
+  HashTable* table;        // key -> LRUEntry*, as the value
+  IntrusiveList* recency;  // every entry, least recently used first
+  size_t capacity;         // the budget
+  size_t used;             // the sum of the entries' sizes
+  LRUSizeFnPtr size_fn;    // measures entries, or nullptr
+  LRUEvictFnPtr evict_fn;  // called on evicted entries, or nullptr
+  LRUStats_t stats;        // hit, miss and eviction counters
+} LRUCache;
+
+#endif  // LRUCACHE_PRIV_HPP_
@@ -1,8 +1,254 @@
+#include <cstdint>
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "LinkedList.hpp"
 #include "LinkedList_priv.hpp"
 
+///////////////////////////////////////////////////////////////////////////////
+// Node slabs.
+//
+// Nodes are freed with FreeNode, which tells nodes that LinkedList_AppendMany
+// carved out of a slab from ones allocated individually.  The registry maps
+// each live slab's starting address to the slab.
+
+static std::mutex g_slab_lock;
+static std::map<uintptr_t, LLNodeSlab*> g_slabs;  // guarded by g_slab_lock
+static std::atomic<size_t> g_num_slabs{0};
+
+// Allocates and registers a slab of n nodes, all of them live.
+static LLNodeSlab* NewSlab(size_t n) {
+  LLNodeSlab* slab = new LLNodeSlab;
+  slab->nodes = new LinkedListNode[n];
+  slab->num_nodes = n;
+  slab->num_live.store(n, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(g_slab_lock);
+  g_slabs[reinterpret_cast<uintptr_t>(slab->nodes)] = slab;
+  g_num_slabs.fetch_add(1, std::memory_order_relaxed);
+  return slab;
+}
+
+static bool SlabContains(const LLNodeSlab* slab, const LinkedListNode* node) {
+  return node >= slab->nodes && node < slab->nodes + slab->num_nodes;
+}
+
+// Returns the live slab node was carved from, or nullptr if it was
+// allocated on its own.
+static LLNodeSlab* FindSlab(const LinkedListNode* node) {
+  if (g_num_slabs.load(std::memory_order_relaxed) == 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(g_slab_lock);
+  auto it = g_slabs.upper_bound(reinterpret_cast<uintptr_t>(node));
+  if (it == g_slabs.begin()) {
+    return nullptr;
+  }
+  --it;
+  return SlabContains(it->second, node) ? it->second : nullptr;
+}
+
+// Frees a node.  If hint is non-null, it caches the slab the last node
+// freed through it came from, so that freeing a run of nodes from one slab
+// only looks the slab up once.
+static void FreeNode(LinkedListNode* node, LLNodeSlab** hint = nullptr) {
+  LLNodeSlab* slab = (hint != nullptr && *hint != nullptr &&
+                      SlabContains(*hint, node))
+                         ? *hint
+                         : FindSlab(node);
+  if (slab == nullptr) {
+    delete node;
+    return;
+  }
+  if (hint != nullptr) {
+    *hint = slab;
+  }
+  if (slab->num_live.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  // That was the slab's last node.  Nobody else can be looking for it now.
+  {
+    std::lock_guard<std::mutex> lock(g_slab_lock);
+    g_slabs.erase(reinterpret_cast<uintptr_t>(slab->nodes));
+    g_num_slabs.fetch_sub(1, std::memory_order_relaxed);
+  }
+  if (hint != nullptr) {
+    *hint = nullptr;
+  }
+  delete[] slab->nodes;
+  delete slab;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Skip-list index internals.
+//
+// See LinkedList_AddIndex.  Positions count from 1 at the head node, with
+// the index's head tower at 0.
+
+static LLSkipTower* NewTower(LinkedListNode* node, int height) {
+  LLSkipTower* tower = new LLSkipTower;
+  tower->node = node;
+  tower->height = height;
+  tower->links = new LLSkipLink[height]();
+  return tower;
+}
+
+static void DeleteTower(LLSkipTower* tower) {
+  delete[] tower->links;
+  delete tower;
+}
+
+// Picks the height of a new node's tower: 0 (no tower) three times in
+// four, and each level after that with probability 1/4.
+static int RandomHeight(LLSkipIndex* index) {
+  uint64_t r = index->rng;
+  r ^= r << 13;
+  r ^= r >> 7;
+  r ^= r << 17;
+  index->rng = r;
+  int height = 0;
+  while (height < k_ll_skip_max_height && (r & 3) == 0) {
+    height++;
+    r >>= 2;
+  }
+  return height;
+}
+
+// Builds an index over the list's current nodes, laying each new tower at
+// the end of every level it reaches.
+static LLSkipIndex* BuildIndex(LinkedList* list) {
+  LLSkipIndex* index = new LLSkipIndex;
+  index->head.node = nullptr;
+  index->head.height = k_ll_skip_max_height;
+  index->head.links = new LLSkipLink[k_ll_skip_max_height]();
+  index->height = 0;
+  index->rng = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<uintptr_t>(list);
+
+  LLSkipTower* last[k_ll_skip_max_height];
+  size_t last_pos[k_ll_skip_max_height];
+  for (int level = 0; level < k_ll_skip_max_height; level++) {
+    last[level] = &index->head;
+    last_pos[level] = 0;
+  }
+  size_t pos = 0;
+  for (LinkedListNode* node = list->head; node != nullptr; node = node->next) {
+    pos++;
+    const int height = RandomHeight(index);
+    if (height == 0) {
+      continue;
+    }
+    LLSkipTower* tower = NewTower(node, height);
+    for (int level = 0; level < height; level++) {
+      last[level]->links[level] = {tower, pos - last_pos[level]};
+      last[level] = tower;
+      last_pos[level] = pos;
+    }
+    if (height > index->height) {
+      index->height = height;
+    }
+  }
+  return index;
+}
+
+static void FreeIndex(LLSkipIndex* index) {
+  LLSkipTower* tower = index->head.links[0].next;
+  while (tower != nullptr) {
+    LLSkipTower* next = tower->links[0].next;
+    DeleteTower(tower);
+    tower = next;
+  }
+  delete[] index->head.links;
+  delete index;
+}
+
+// Rebuilds the list's index, if it has one, after its nodes have been
+// rearranged wholesale.
+static void ReindexIfIndexed(LinkedList* list) {
+  if (list->index != nullptr) {
+    FreeIndex(list->index);
+    list->index = BuildIndex(list);
+  }
+}
+
+// Finds, at every level in use, the last tower before position target,
+// filling in before[] and before_pos[].
+static void FindBefore(LLSkipIndex* index,
+                       size_t target,
+                       LLSkipTower** before,
+                       size_t* before_pos) {
+  LLSkipTower* tower = &index->head;
+  size_t pos = 0;
+  for (int level = index->height - 1; level >= 0; level--) {
+    while (tower->links[level].next != nullptr &&
+           pos + tower->links[level].width < target) {
+      pos += tower->links[level].width;
+      tower = tower->links[level].next;
+    }
+    before[level] = tower;
+    before_pos[level] = pos;
+  }
+}
+
+// Updates the index after node has been inserted at position "position".
+static void IndexInsert(LinkedList* list,
+                        LinkedListNode* node,
+                        size_t position) {
+  LLSkipIndex* index = list->index;
+  const int height = RandomHeight(index);
+  if (height > index->height) {
+    index->height = height;
+  }
+  LLSkipTower* before[k_ll_skip_max_height];
+  size_t before_pos[k_ll_skip_max_height];
+  FindBefore(index, position, before, before_pos);
+
+  LLSkipTower* tower = height > 0 ? NewTower(node, height) : nullptr;
+  for (int level = 0; level < index->height; level++) {
+    LLSkipLink* link = &before[level]->links[level];
+    if (level < height) {
+      // Link the new tower in after before[level]; whatever followed is
+      // now one position further along.
+      if (link->next != nullptr) {
+        tower->links[level] = {link->next,
+                               before_pos[level] + link->width + 1 - position};
+      }
+      *link = {tower, position - before_pos[level]};
+    } else if (link->next != nullptr) {
+      link->width++;
+    }
+  }
+}
+
+// Updates the index before node, at position "position", is removed.
+static void IndexRemove(LinkedList* list,
+                        LinkedListNode* node,
+                        size_t position) {
+  LLSkipIndex* index = list->index;
+  LLSkipTower* before[k_ll_skip_max_height];
+  size_t before_pos[k_ll_skip_max_height];
+  FindBefore(index, position, before, before_pos);
+
+  LLSkipTower* tower = nullptr;
+  for (int level = 0; level < index->height; level++) {
+    LLSkipLink* link = &before[level]->links[level];
+    if (link->next != nullptr && link->next->node == node) {
+      // Unlink node's tower, joining the links on either side of it.
+      tower = link->next;
+      const LLSkipLink after = tower->links[level];
+      *link = {after.next,
+               after.next != nullptr ? link->width + after.width - 1 : 0};
+    } else if (link->next != nullptr) {
+      link->width--;
+    }
+  }
+  if (tower != nullptr) {
+    DeleteTower(tower);
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // LinkedList implementation.
 
@@ -13,6 +259,7 @@ LinkedList* LinkedList_New() {
   list->num_elements = 0;
   list->head = nullptr;
   list->tail = nullptr;
+  list->index = nullptr;
   return list;  // you may want to change this
 }
 
@@ -22,11 +269,13 @@ void LinkedList_Delete(LinkedList* list,
   // (using the payload_free_function supplied as an argument) and
   // the nodes themselves.
   // delete the LinkedList
+  LinkedList_DropIndex(list);
+  LLNodeSlab* slab = nullptr;
   while (list->head != nullptr) {
     LinkedListNode* node = list->head;
     list->head = node->next;
     payload_free_function(node->payload);
-    delete node;
+    FreeNode(node, &slab);
   }
   list->tail = nullptr;
   list->num_elements = 0;
@@ -51,6 +300,9 @@ void LinkedList_Push(LinkedList* list, LLPayload_t payload) {
     list->tail = node;
   }
   list->num_elements++;
+  if (list->index != nullptr) {
+    IndexInsert(list, node, 1);
+  }
 }
 
 bool LinkedList_Pop(LinkedList* list, LLPayload_t* payload_ptr) {
@@ -63,6 +315,9 @@ bool LinkedList_Pop(LinkedList* list, LLPayload_t* payload_ptr) {
   if (list->num_elements == 0) {
     return false;
   }
+  if (list->index != nullptr) {
+    IndexRemove(list, list->head, 1);
+  }
 
   LinkedListNode* node = list->head;
   *payload_ptr = node->payload;
@@ -70,7 +325,7 @@ bool LinkedList_Pop(LinkedList* list, LLPayload_t* payload_ptr) {
   if (list->head != nullptr) {
     list->head->prev = nullptr;
   }
-  delete node;
+  FreeNode(node);
   list->num_elements--;
   return true;  // you may need to change this return value
 }
@@ -91,6 +346,9 @@ void LinkedList_Append(LinkedList* list, LLPayload_t payload) {
     list->head = node;
   }
   list->num_elements++;
+  if (list->index != nullptr) {
+    IndexInsert(list, node, list->num_elements);
+  }
 }
 
 bool LinkedList_Slice(LinkedList* list, LLPayload_t* payload_ptr) {
@@ -98,17 +356,221 @@ bool LinkedList_Slice(LinkedList* list, LLPayload_t* payload_ptr) {
   if (list->num_elements == 0) {
     return false;
   }
+  if (list->index != nullptr) {
+    IndexRemove(list, list->tail, list->num_elements);
+  }
   LinkedListNode* node = list->tail;
   *payload_ptr = node->payload;
   list->tail = node->prev;
   if (list->tail != nullptr) {
     list->tail->next = nullptr;
   }
-  delete node;
+  FreeNode(node);
   list->num_elements--;
   return true;  // you may need to change this return value
 }
 
+void LinkedList_AppendMany(LinkedList* list,
+                           const LLPayload_t* payloads,
+                           size_t n) {
+  if (n < k_ll_min_slab_nodes) {
+    for (size_t i = 0; i < n; i++) {
+      LinkedList_Append(list, payloads[i]);
+    }
+    return;
+  }
+
+  LinkedListNode* nodes = NewSlab(n)->nodes;
+  for (size_t i = 0; i < n; i++) {
+    nodes[i].payload = payloads[i];
+    nodes[i].next = (i + 1 < n) ? &nodes[i + 1] : nullptr;
+    nodes[i].prev = (i > 0) ? &nodes[i - 1] : list->tail;
+  }
+  if (list->tail != nullptr) {
+    list->tail->next = &nodes[0];
+  } else {
+    list->head = &nodes[0];
+  }
+  list->tail = &nodes[n - 1];
+  list->num_elements += n;
+  ReindexIfIndexed(list);
+}
+
+size_t LinkedList_ToArray(LinkedList* list, LLPayload_t* out, size_t n) {
+  // Walk a second pointer k_ll_prefetch_distance nodes ahead, prefetching
+  // as it goes, so that the copying loop finds its nodes in cache.
+  LinkedListNode* ahead = list->head;
+  for (size_t i = 0; i < k_ll_prefetch_distance && ahead != nullptr; i++) {
+    ahead = ahead->next;
+  }
+  size_t copied = 0;
+  for (LinkedListNode* node = list->head; node != nullptr && copied < n;
+       node = node->next) {
+    if (ahead != nullptr) {
+      __builtin_prefetch(ahead->next);
+      ahead = ahead->next;
+    }
+    out[copied++] = node->payload;
+  }
+  return copied;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sorting and merging.
+//
+// The helpers below work on nullptr-terminated chains linked through "next"
+// only; the "prev" links are rebuilt once the final chain is known.
+
+// Lists shorter than this aren't worth starting threads for.
+static constexpr size_t k_parallel_sort_min = 1 << 16;
+
+// Merges two sorted chains into one, taking from a first on ties.
+static LinkedListNode* MergeChains(LinkedListNode* a,
+                                   LinkedListNode* b,
+                                   LLPayloadCmpFnPtr comparator) {
+  LinkedListNode head{};
+  LinkedListNode* tail = &head;
+  while (a != nullptr && b != nullptr) {
+    if (comparator(b->payload, a->payload) < 0) {
+      tail->next = b;
+      b = b->next;
+    } else {
+      tail->next = a;
+      a = a->next;
+    }
+    tail = tail->next;
+  }
+  tail->next = (a != nullptr) ? a : b;
+  return head.next;
+}
+
+// Sorts a chain bottom-up.  runs[i] holds a sorted run of 2^i nodes (or
+// nothing); each node is carried into the runs like a binary counter, so
+// every merge is of two runs of equal size and the chain is read just once.
+// Runs at higher indices hold earlier nodes, so they go first in merges.
+static LinkedListNode* SortChain(LinkedListNode* chain,
+                                 LLPayloadCmpFnPtr comparator) {
+  LinkedListNode* runs[64] = {nullptr};
+  while (chain != nullptr) {
+    LinkedListNode* run = chain;
+    chain = chain->next;
+    run->next = nullptr;
+
+    int i = 0;
+    for (; runs[i] != nullptr; i++) {
+      run = MergeChains(runs[i], run, comparator);
+      runs[i] = nullptr;
+    }
+    runs[i] = run;
+  }
+
+  LinkedListNode* sorted = nullptr;
+  for (LinkedListNode* run : runs) {
+    if (run != nullptr) {
+      sorted = MergeChains(run, sorted, comparator);
+    }
+  }
+  return sorted;
+}
+
+// Makes chain the contents of list, rebuilding the prev links and tail.
+static void AdoptChain(LinkedList* list, LinkedListNode* chain) {
+  list->head = chain;
+  list->tail = nullptr;
+  for (LinkedListNode* node = chain; node != nullptr; node = node->next) {
+    node->prev = list->tail;
+    list->tail = node;
+  }
+}
+
+void LinkedList_Sort(LinkedList* list, LLPayloadCmpFnPtr comparator) {
+  if (list->num_elements < 2) {
+    return;
+  }
+  AdoptChain(list, SortChain(list->head, comparator));
+  ReindexIfIndexed(list);
+}
+
+void LinkedList_SortParallel(LinkedList* list,
+                             LLPayloadCmpFnPtr comparator,
+                             int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  size_t num_chunks = num_threads > 0 ? static_cast<size_t>(num_threads) : 1;
+  if (num_chunks > list->num_elements / k_parallel_sort_min) {
+    num_chunks = list->num_elements / k_parallel_sort_min;
+  }
+  if (num_chunks < 2) {
+    LinkedList_Sort(list, comparator);
+    return;
+  }
+
+  // Cut the list into consecutive chunks of (nearly) equal length.
+  std::vector<LinkedListNode*> chunks(num_chunks);
+  LinkedListNode* node = list->head;
+  for (size_t c = 0; c < num_chunks; c++) {
+    chunks[c] = node;
+    size_t len = list->num_elements / num_chunks +
+                 (c < list->num_elements % num_chunks ? 1 : 0);
+    while (--len > 0) {
+      node = node->next;
+    }
+    LinkedListNode* next = node->next;
+    node->next = nullptr;
+    node = next;
+  }
+
+  // Sort each chunk on its own thread (the first on this one), then merge
+  // neighbouring chunks pairwise, a round of merges at a time.  Keeping
+  // chunks in order and the left one first keeps the sort stable.
+  std::vector<std::thread> threads;
+  for (size_t c = 1; c < num_chunks; c++) {
+    threads.emplace_back([&chunks, c, comparator] {
+      chunks[c] = SortChain(chunks[c], comparator);
+    });
+  }
+  chunks[0] = SortChain(chunks[0], comparator);
+  for (std::thread& t : threads) {
+    t.join();
+  }
+
+  for (size_t width = 1; width < num_chunks; width *= 2) {
+    threads.clear();
+    for (size_t c = 2 * width; c + width < num_chunks; c += 2 * width) {
+      threads.emplace_back([&chunks, c, width, comparator] {
+        chunks[c] = MergeChains(chunks[c], chunks[c + width], comparator);
+      });
+    }
+    chunks[0] = MergeChains(chunks[0], chunks[width], comparator);
+    for (std::thread& t : threads) {
+      t.join();
+    }
+  }
+  AdoptChain(list, chunks[0]);
+  ReindexIfIndexed(list);
+}
+
+void LinkedList_Merge(LinkedList* dst,
+                      LinkedList* src,
+                      LLPayloadCmpFnPtr comparator) {
+  if (src->num_elements == 0) {
+    return;
+  }
+  if (dst->num_elements == 0) {
+    dst->head = src->head;
+    dst->tail = src->tail;
+  } else {
+    AdoptChain(dst, MergeChains(dst->head, src->head, comparator));
+  }
+  dst->num_elements += src->num_elements;
+  src->head = nullptr;
+  src->tail = nullptr;
+  src->num_elements = 0;
+  ReindexIfIndexed(dst);
+  ReindexIfIndexed(src);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // LLIterator implementation.
 
@@ -116,6 +578,7 @@ LLIterator* LLIterator_New(LinkedList* list) {
   LLIterator* iter = new LLIterator();
   iter->list = list;
   iter->node = list->head;
+  iter->pos = 0;
   return iter; 
 }
 
@@ -135,6 +598,7 @@ bool LLIterator_Next(LLIterator* iter) {
   if (iter->node == nullptr) {
     return false;
   }
+  iter->pos++;
   iter->node = iter->node->next;
   return true;
 }
@@ -160,9 +624,12 @@ bool LLIterator_Remove(LLIterator* iter,
   // Be sure to call the payload_free_function to deallocate the payload
   // the iterator is pointing to, and also deallocate any LinkedList
   // data structure element as appropriate.
+  if (iter->list->index != nullptr) {
+    IndexRemove(iter->list, iter->node, iter->pos + 1);
+  }
   if (iter->list->num_elements <= 1) {
     payload_free_function(iter->node->payload);
-    delete iter->node;
+    FreeNode(iter->node);
     iter->list->head = nullptr;
     iter->list->tail = nullptr;
     iter->list->num_elements = 0;
@@ -174,7 +641,7 @@ bool LLIterator_Remove(LLIterator* iter,
     iter->list->head->prev = nullptr;
     iter->list->num_elements--;
     payload_free_function(iter->node->payload);
-    delete iter->node;
+    FreeNode(iter->node);
     iter->node = iter->list->head;
     return true;
   }
@@ -183,15 +650,16 @@ bool LLIterator_Remove(LLIterator* iter,
     iter->list->tail->next = nullptr;
     iter->list->num_elements--;
     payload_free_function(iter->node->payload);
-    delete iter->node;
+    FreeNode(iter->node);
     iter->node = iter->list->tail;
+    iter->pos--;
     return true;
   }
   iter->node->prev->next = iter->node->next;
   iter->node->next->prev = iter->node->prev;
   iter->list->num_elements--;
   payload_free_function(iter->node->payload);
-  delete iter->node;
+  FreeNode(iter->node);
   iter->node = iter->node->next;
   return true;
 }
@@ -199,4 +667,184 @@ bool LLIterator_Remove(LLIterator* iter,
 // Implemented for you
 void LLIterator_Rewind(LLIterator* iter) {
   iter->node = iter->list->head;
+  iter->pos = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Splicing and splitting.
+
+// Empties list without freeing anything; its nodes now belong elsewhere.
+static void ForgetNodes(LinkedList* list) {
+  list->num_elements = 0;
+  list->head = nullptr;
+  list->tail = nullptr;
+  ReindexIfIndexed(list);
+}
+
+void LinkedList_Concat(LinkedList* dst, LinkedList* src) {
+  if (src->num_elements == 0) {
+    return;
+  }
+  if (dst->num_elements == 0) {
+    dst->head = src->head;
+  } else {
+    dst->tail->next = src->head;
+    src->head->prev = dst->tail;
+  }
+  dst->tail = src->tail;
+  dst->num_elements += src->num_elements;
+  ForgetNodes(src);
+  ReindexIfIndexed(dst);
+}
+
+void LinkedList_SpliceAt(LLIterator* iter, LinkedList* src) {
+  LinkedList* list = iter->list;
+  LinkedListNode* at = iter->node;
+  if (at == nullptr) {
+    LinkedList_Concat(list, src);
+    return;
+  }
+  if (src->num_elements == 0) {
+    return;
+  }
+  if (at->prev != nullptr) {
+    at->prev->next = src->head;
+  } else {
+    list->head = src->head;
+  }
+  src->head->prev = at->prev;
+  src->tail->next = at;
+  at->prev = src->tail;
+  list->num_elements += src->num_elements;
+  iter->pos += src->num_elements;
+  ForgetNodes(src);
+  ReindexIfIndexed(list);
+}
+
+LinkedList* LinkedList_SplitAt(LLIterator* iter) {
+  LinkedList* list = iter->list;
+  LinkedList* rest = LinkedList_New();
+  LinkedListNode* at = iter->node;
+  if (at == nullptr) {
+    return rest;
+  }
+
+  // Count outwards from the split point in both directions at once, and
+  // stop at whichever end comes first; that side's count gives the other.
+  size_t num_before = 0;
+  size_t num_after = 1;
+  LinkedListNode* back = at->prev;
+  LinkedListNode* fwd = at->next;
+  while (back != nullptr && fwd != nullptr) {
+    back = back->prev;
+    fwd = fwd->next;
+    num_before++;
+    num_after++;
+  }
+  if (back == nullptr) {
+    num_after = list->num_elements - num_before;
+  } else {
+    num_before = list->num_elements - num_after;
+  }
+
+  rest->head = at;
+  rest->tail = list->tail;
+  rest->num_elements = num_after;
+  list->tail = at->prev;
+  if (at->prev != nullptr) {
+    at->prev->next = nullptr;
+  } else {
+    list->head = nullptr;
+  }
+  at->prev = nullptr;
+  list->num_elements = num_before;
+  iter->node = nullptr;
+  iter->pos = num_before;
+  ReindexIfIndexed(list);
+  return rest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Skip-list index.
+
+void LinkedList_AddIndex(LinkedList* list) {
+  if (list->index == nullptr) {
+    list->index = BuildIndex(list);
+  }
+}
+
+void LinkedList_DropIndex(LinkedList* list) {
+  if (list->index != nullptr) {
+    FreeIndex(list->index);
+    list->index = nullptr;
+  }
+}
+
+bool LLIterator_Seek(LLIterator* iter,
+                     LLPayload_t key,
+                     LLPayloadCmpFnPtr comparator) {
+  LinkedList* list = iter->list;
+
+  // Run down the index to the last tower whose payload is less than key,
+  // then walk the rest of the way.
+  LinkedListNode* node = list->head;
+  size_t pos = 1;
+  if (list->index != nullptr) {
+    LLSkipTower* tower = &list->index->head;
+    size_t tower_pos = 0;
+    for (int level = list->index->height - 1; level >= 0; level--) {
+      while (tower->links[level].next != nullptr &&
+             comparator(tower->links[level].next->node->payload, key) < 0) {
+        tower_pos += tower->links[level].width;
+        tower = tower->links[level].next;
+      }
+    }
+    if (tower->node != nullptr) {
+      node = tower->node->next;
+      pos = tower_pos + 1;
+    }
+  }
+  while (node != nullptr && comparator(node->payload, key) < 0) {
+    node = node->next;
+    pos++;
+  }
+  iter->node = node;
+  iter->pos = pos - 1;
+  return node != nullptr;
+}
+
+bool LLIterator_SeekIndex(LLIterator* iter, size_t n) {
+  LinkedList* list = iter->list;
+  if (n >= list->num_elements) {
+    iter->node = nullptr;
+    iter->pos = list->num_elements;
+    return false;
+  }
+
+  // Run down the index to the last tower at or before the element, then
+  // walk the rest of the way.
+  const size_t target = n + 1;
+  LinkedListNode* node = list->head;
+  size_t pos = 1;
+  if (list->index != nullptr) {
+    LLSkipTower* tower = &list->index->head;
+    size_t tower_pos = 0;
+    for (int level = list->index->height - 1; level >= 0; level--) {
+      while (tower->links[level].next != nullptr &&
+             tower_pos + tower->links[level].width <= target) {
+        tower_pos += tower->links[level].width;
+        tower = tower->links[level].next;
+      }
+    }
+    if (tower->node != nullptr) {
+      node = tower->node;
+      pos = tower_pos;
+    }
+  }
+  for (; pos < target; pos++) {
+    node = node->next;
+  }
+  iter->node = node;
+  iter->pos = n;
+  return true;
 }
@@ -108,6 +108,80 @@ void LinkedList_Append(LinkedList* list, LLPayload_t payload);
 // - true: on success.
 bool LinkedList_Slice(LinkedList* list, LLPayload_t* payload_ptr);
 
+// Append an array of payloads to the tail of the linked list, in order.
+//
+// The new nodes are allocated as one contiguous block, laid out in list
+// order, so this costs one allocation rather than n, and walking the
+// appended run afterwards reads memory sequentially.  The nodes are
+// otherwise ordinary: they can be popped, removed, moved to other lists
+// and freed individually, and the block is released once all of its nodes
+// have been.
+//
+// Arguments:
+// - list: the LinkedList to append to.
+// - payloads: the payloads to append.
+// - n: the number of payloads.
+void LinkedList_AppendMany(LinkedList* list,
+                           const LLPayload_t* payloads,
+                           size_t n);
+
+// Copy the payloads at the front of the linked list into an array, in
+// order, leaving the list unchanged.
+//
+// Arguments:
+// - list: the LinkedList to copy from.
+// - out: the array to copy into.
+// - n: the size of out.
+//
+// Returns:
+// - the number of payloads copied, which is the lesser of n and the
+//   list's length.
+size_t LinkedList_ToArray(LinkedList* list, LLPayload_t* out, size_t n);
+
+// When we sort or merge lists, we need the user to specify how payloads are
+// ordered.  The function returns a negative number if "a" sorts before "b",
+// zero if they are equivalent, and a positive number if "a" sorts after "b".
+typedef int (*LLPayloadCmpFnPtr)(LLPayload_t a, LLPayload_t b);
+
+// Sorts a linked list in place.
+//
+// This is a stable bottom-up merge sort: it takes O(n log n) comparisons,
+// relinks the list's existing nodes rather than allocating new ones, and
+// keeps equivalent payloads in their original order.
+//
+// Arguments:
+// - list: the LinkedList to sort.
+// - comparator: the ordering of the payloads.
+void LinkedList_Sort(LinkedList* list, LLPayloadCmpFnPtr comparator);
+
+// Sorts a linked list in place, using up to num_threads threads.
+//
+// The list is cut into num_threads chunks, which are sorted concurrently and
+// then merged.  The result is the same as that of LinkedList_Sort, so
+// comparator must be safe to call from several threads at once.  Short
+// lists are just sorted on the calling thread.
+//
+// Arguments:
+// - list: the LinkedList to sort.
+// - comparator: the ordering of the payloads.
+// - num_threads: the most threads to use; 0 means one per hardware thread.
+void LinkedList_SortParallel(LinkedList* list,
+                             LLPayloadCmpFnPtr comparator,
+                             int num_threads);
+
+// Merges one sorted linked list into another, relinking the nodes of src
+// into dst.  Afterwards, dst is sorted and src is empty (but still needs to
+// be deleted by the caller).  The merge is stable: payloads of dst come
+// before equivalent payloads of src.
+//
+// Arguments:
+// - dst: the sorted list to merge into.
+// - src: the sorted list to merge from.
+// - comparator: the ordering both lists are sorted by.
+void LinkedList_Merge(LinkedList* dst,
+                      LinkedList* src,
+                      LLPayloadCmpFnPtr comparator);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Linked list iterator.
 //
@@ -200,4 +274,98 @@ bool LLIterator_Remove(LLIterator* iter,
 // - iter: the iterator to rewind.
 void LLIterator_Rewind(LLIterator* iter);
 
+///////////////////////////////////////////////////////////////////////////////
+// Splicing and splitting.
+//
+// These move runs of elements between lists by relinking their nodes, with
+// no allocation and without touching the payloads.
+
+// Moves all of src's elements onto the tail of dst, in O(1).  Afterwards
+// src is empty (but still needs to be deleted by the caller).
+//
+// Arguments:
+// - dst: the list to append to.
+// - src: the list to take the elements from; must not be dst.
+void LinkedList_Concat(LinkedList* dst, LinkedList* src);
+
+// Moves all of src's elements into iter's list, just before the element
+// iter points at, in O(1).  If iter is "past the end", they go on the tail.
+// iter keeps pointing at the same element, and src is left empty.
+//
+// Arguments:
+// - iter: where in its list to insert src's elements.
+// - src: the list to take the elements from; must not be iter's list.
+void LinkedList_SpliceAt(LLIterator* iter, LinkedList* src);
+
+// Detaches the element iter points at, and everything after it, into a new
+// list.  Relinking takes O(1); counting the detached elements takes time
+// proportional to the shorter of the two resulting lists.  Afterwards iter
+// is "past the end" of its (shortened) list.
+//
+// Arguments:
+// - iter: the first element to detach.  If iter is "past the end",
+//   nothing is detached.
+//
+// Returns:
+// - a newly-allocated list holding the detached elements.  The caller is
+//   responsible for eventually calling LinkedList_Delete on it.
+LinkedList* LinkedList_SplitAt(LLIterator* iter);
+
+///////////////////////////////////////////////////////////////////////////////
+// Skip-list index.
+//
+// Walking to the n-th element, or to where a key belongs in a sorted list,
+// takes O(n) LLIterator_Next calls.  A list can optionally be given a
+// skip-list index: "express lanes" over its nodes, with about one node in
+// four having a tower of links that skip ahead, and each level of links a
+// quarter as dense as the one below.  With an index, the seeks below take
+// O(log n) expected time.  Without one, they scan from the head.
+//
+// The index is kept up to date by LinkedList_Push/Pop/Append/Slice and
+// LLIterator_Remove, at an expected O(log n) cost per call (O(1) at the
+// head).  Sorting, merging, splicing and splitting rebuild the index of any
+// indexed list they change, which takes O(n).
+
+// Builds a skip-list index over the list's nodes, in O(n).  Does nothing if
+// the list already has one.
+//
+// Arguments:
+// - list: the list to index.
+void LinkedList_AddIndex(LinkedList* list);
+
+// Frees the list's skip-list index, if it has one.
+//
+// Arguments:
+// - list: the list to stop indexing.
+void LinkedList_DropIndex(LinkedList* list);
+
+// Moves the iterator to the first element whose payload is not less than
+// key.  The list must be sorted by comparator, as by LinkedList_Sort.
+//
+// Arguments:
+// - iter: the iterator to move.
+// - key: the payload to look for.
+// - comparator: the ordering the list is sorted by.
+//
+// Returns:
+// - true if the iterator points at such an element.
+// - false if every element is less than key; the iterator is now "past
+//   the end".
+bool LLIterator_Seek(LLIterator* iter,
+                     LLPayload_t key,
+                     LLPayloadCmpFnPtr comparator);
+
+// Moves the iterator to the n-th element of its list, counting from 0 at
+// the head.
+//
+// Arguments:
+// - iter: the iterator to move.
+// - n: the index of the element to move to.
+//
+// Returns:
+// - true if the iterator points at the element.
+// - false if the list has n or fewer elements; the iterator is now "past
+//   the end".
+bool LLIterator_SeekIndex(LLIterator* iter, size_t n);
+
 #endif  // LINKEDLIST_HPP_
@@ -1,6 +1,10 @@
 #ifndef LINKEDLIST_PRIV_HPP_
 #define LINKEDLIST_PRIV_HPP_
 
+#include <atomic>   // for std::atomic
+#include <cstdint>  // for uint64_t
+#include <cstddef>  // for size_t
+
 #include "./LinkedList.hpp"  // for LinkedList and LLIterator
 
 // !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -24,6 +28,55 @@ typedef struct ll_node {
   struct ll_node* prev;  // prev node in list, or nullptr
 } LinkedListNode;
 
+// A block of nodes allocated together by LinkedList_AppendMany.
+//
+// Its nodes are freed one by one like any others, but their memory is only
+// returned once the last of them is freed.  Nodes can move between lists,
+// so slabs are tracked process-wide rather than by the list that made them.
+typedef struct ll_node_slab {
+  LinkedListNode* nodes;         // the block, nodes[num_nodes]
+  size_t num_nodes;              // # nodes in the block
+  std::atomic<size_t> num_live;  // # of them not freed yet
+} LLNodeSlab;
+
+// LinkedList_AppendMany appends fewer payloads than this one node at a
+// time, since a slab costs a couple of allocations and a registry update.
+static constexpr size_t k_ll_min_slab_nodes = 16;
+
+// How many nodes ahead of the one it is copying LinkedList_ToArray
+// prefetches.
+static constexpr size_t k_ll_prefetch_distance = 8;
+
+// A tower in a list's skip-list index (see LinkedList_AddIndex).
+//
+// Positions in an indexed list count from 1 for the head node; the index's
+// head tower stands at position 0.  A tower of height h links, at each
+// level below h, to the next tower at that level, and records how many
+// positions along that is.
+typedef struct ll_skip_link {
+  struct ll_skip_tower* next;  // next tower at this level, or nullptr
+  size_t width;                // position of next minus ours, if non-null
+} LLSkipLink;
+
+typedef struct ll_skip_tower {
+  LinkedListNode* node;  // the node it stands on, or nullptr for the head
+  int height;            // # of levels
+  LLSkipLink* links;     // links[height]
+} LLSkipTower;
+
+// The most levels a tower can have.  Each level is 1/4 as dense as the one
+// below it, so this covers lists of billions of elements.
+static constexpr int k_ll_skip_max_height = 16;
+
+// A skip-list index over a list's nodes.  About 1 in 4 nodes gets a tower;
+// a search runs down the towers' levels, and then walks along the nodes
+// from the last tower it reached.
+typedef struct ll_skip {
+  LLSkipTower head;  // the head tower, k_ll_skip_max_height high
+  int height;        // levels above this have never been used
+  uint64_t rng;      // xorshift state for choosing tower heights
+} LLSkipIndex;
+
 // The entire linked list.
 //
 // We provided a struct declaration (but not definition) in LinkedList.hpp;
@@ -33,6 +86,7 @@ typedef struct ll {
   size_t num_elements;   //  # elements in the list
   LinkedListNode* head;  // head of linked list, or nullptr if empty
   LinkedListNode* tail;  // tail of linked list, or nullptr if empty
+  LLSkipIndex* index;    // skip-list index, or nullptr if unindexed
 } LinkedList;
 
 // A linked list iterator.
@@ -42,6 +96,7 @@ typedef struct ll {
 typedef struct ll_iter {
   LinkedList* list;      // the list we're for
   LinkedListNode* node;  // the node we are at, or nullptr if broken
+  size_t pos;            // the index of node in the list, if not nullptr
 } LLIterator;
 
 #endif  // LINKEDLIST_PRIV_HPP_
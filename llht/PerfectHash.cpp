@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "PerfectHash_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// Tries to find pilots for every bucket with mph's current seed.  Returns
+// false (allocating nothing) if some bucket runs out of pilots.
+static bool TryBuild(const HTHash_t* hashes, CTPerfectHash* mph) {
+  const size_t n = mph->num_keys;
+  const size_t num_buckets = mph->num_buckets;
+
+  // Sort the keys by bucket, keeping each key's mixed hash.
+  std::vector<uint64_t> mixed(n);
+  std::vector<size_t> bucket_starts(num_buckets + 1, 0);
+  for (size_t i = 0; i < n; i++) {
+    mixed[i] = PerfectHash_Mix(hashes[i] ^ mph->seed);
+    bucket_starts[PerfectHash_BucketOf(mph, mixed[i]) + 1]++;
+  }
+  size_t max_size = 0;
+  for (size_t b = 0; b < num_buckets; b++) {
+    max_size = std::max(max_size, bucket_starts[b + 1]);
+    bucket_starts[b + 1] += bucket_starts[b];
+  }
+  std::vector<uint64_t> keys(n);
+  std::vector<size_t> fill(bucket_starts.begin(), bucket_starts.end() - 1);
+  for (size_t i = 0; i < n; i++) {
+    keys[fill[PerfectHash_BucketOf(mph, mixed[i])]++] = mixed[i];
+  }
+
+  // Order the buckets biggest first, with a counting sort on their sizes.
+  std::vector<size_t> size_starts(max_size + 2, 0);
+  for (size_t b = 0; b < num_buckets; b++) {
+    size_starts[max_size - (bucket_starts[b + 1] - bucket_starts[b]) + 1]++;
+  }
+  for (size_t s = 0; s <= max_size; s++) {
+    size_starts[s + 1] += size_starts[s];
+  }
+  std::vector<size_t> order(num_buckets);
+  for (size_t b = 0; b < num_buckets; b++) {
+    order[size_starts[max_size - (bucket_starts[b + 1] - bucket_starts[b])]++] =
+        b;
+  }
+
+  // Place each bucket with the first pilot whose slots are all free.
+  std::vector<uint64_t> taken((mph->num_slots + 63) / 64, 0);
+  std::vector<size_t> slots(max_size);
+  uint32_t* pilots = new uint32_t[num_buckets]();
+  for (size_t b : order) {
+    const size_t start = bucket_starts[b];
+    const size_t size = bucket_starts[b + 1] - start;
+    if (size == 0) {
+      break;  // the rest are empty too
+    }
+    uint32_t pilot = 0;
+    for (;; pilot++) {
+      if (pilot == k_mph_max_pilot) {
+        delete[] pilots;
+        return false;
+      }
+      size_t placed = 0;
+      for (; placed < size; placed++) {
+        const size_t slot = PerfectHash_Place(mph, keys[start + placed], pilot);
+        if ((taken[slot / 64] >> (slot % 64)) & 1) {
+          break;
+        }
+        if (std::find(slots.begin(), slots.begin() + placed, slot) !=
+            slots.begin() + placed) {
+          break;
+        }
+        slots[placed] = slot;
+      }
+      if (placed == size) {
+        break;
+      }
+    }
+    pilots[b] = pilot;
+    for (size_t i = 0; i < size; i++) {
+      taken[slots[i] / 64] |= static_cast<uint64_t>(1) << (slots[i] % 64);
+    }
+  }
+
+  // Exactly as many slots past num_keys are taken as slots before it are
+  // free, so pair them up in order.
+  uint32_t* remap = new uint32_t[mph->num_slots - n]();
+  size_t free_slot = 0;
+  for (size_t slot = n; slot < mph->num_slots; slot++) {
+    if (((taken[slot / 64] >> (slot % 64)) & 1) == 0) {
+      continue;
+    }
+    while ((taken[free_slot / 64] >> (free_slot % 64)) & 1) {
+      free_slot++;
+    }
+    remap[slot - n] = static_cast<uint32_t>(free_slot++);
+  }
+
+  mph->pilots = pilots;
+  mph->remap = remap;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PerfectHash implementation.
+
+bool PerfectHash_Build(const HTHash_t* hashes, size_t n, CTPerfectHash* mph) {
+  // Equal hashes would have to share a slot, whatever the pilots.
+  std::vector<HTHash_t> sorted(hashes, hashes + n);
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+    return false;
+  }
+
+  mph->num_keys = n;
+  mph->num_slots = (n * k_mph_slots_per_100 + 99) / 100;
+  mph->num_buckets = std::max<size_t>(
+      k_mph_min_buckets, (n + k_mph_bucket_keys - 1) / k_mph_bucket_keys);
+  for (int s = 0; s < k_mph_max_seeds; s++) {
+    mph->seed = PerfectHash_Mix(static_cast<uint64_t>(s) + 1);
+    if (TryBuild(hashes, mph)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t PerfectHash_MemoryBytes(const CTPerfectHash* mph) {
+  return sizeof(CTPerfectHash) +
+         (mph->num_buckets + mph->num_slots - mph->num_keys) *
+             sizeof(uint32_t);
+}
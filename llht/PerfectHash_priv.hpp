@@ -0,0 +1,115 @@
+#ifndef PERFECTHASH_PRIV_HPP_
+#define PERFECTHASH_PRIV_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"  // for HTHash_t
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for the minimal perfect hash
+// behind frozen tables (see HashTable_Freeze).
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The average # of keys per bucket.  Fewer means more pilots to store, but
+// quicker searches for them.
+static constexpr size_t k_mph_bucket_keys = 5;
+
+// The fewest buckets a perfect hash has, so that both groups of buckets
+// (see below) have at least one.
+static constexpr size_t k_mph_min_buckets = 2;
+
+// The # of slots per 100 keys.  Leaving a few slots spare keeps the search
+// for the last buckets' pilots short; the keys that land in them are then
+// remapped into the free slots among the first num_keys.
+static constexpr size_t k_mph_slots_per_100 = 101;
+
+// The most pilots tried for any one bucket before starting over with
+// another seed, and the most seeds tried before giving up.
+static constexpr uint32_t k_mph_max_pilot = 1 << 20;
+static constexpr int k_mph_max_seeds = 16;
+
+// A PTHash-style minimal perfect hash over a set of distinct 64-bit hashes.
+//
+// Each hash picks a bucket, and each bucket stores a "pilot": the first
+// value that, mixed into the hashes of the bucket's keys, sends all of them
+// to slots nobody else took.  Looking a hash up therefore reads one pilot,
+// and (for about 1% of hashes) one remap entry, to give a slot in
+// [0, num_keys) that no other hash in the set maps to.  Hashes outside the
+// set map to arbitrary slots.
+//
+// Buckets are filled biggest first, which is what keeps the search cheap:
+// 60% of the keys are skewed into the first 30% of the buckets, so the
+// crowded buckets are placed while the slots are still mostly empty.
+typedef struct ct_mph {
+  size_t num_keys;     // # of hashes, and of slots handed out
+  size_t num_slots;    // # of slots the pilots map into, >= num_keys
+  size_t num_buckets;  // # of pilots, >= k_mph_min_buckets
+  uint64_t seed;       // mixed into every hash
+  uint32_t* pilots;    // per-bucket pilots
+  uint32_t* remap;     // slots in [0, num_keys) for slots past num_keys
+} CTPerfectHash;
+
+// Builds a perfect hash over hashes[0, n) into mph, allocating its arrays.
+// Returns false (allocating nothing) if two of the hashes are equal, or if
+// no pilots could be found.
+bool PerfectHash_Build(const HTHash_t* hashes, size_t n, CTPerfectHash* mph);
+
+// Returns the number of bytes taken by the perfect hash's arrays.
+size_t PerfectHash_MemoryBytes(const CTPerfectHash* mph);
+
+// Scrambles the bits of x; this is the finalizer of MurmurHash3.
+static inline uint64_t PerfectHash_Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Maps x uniformly onto [0, n) with a multiply rather than a division.
+static inline size_t PerfectHash_Reduce(uint64_t x, size_t n) {
+  return static_cast<size_t>(
+      (static_cast<unsigned __int128>(x) * n) >> 64);
+}
+
+// Returns the bucket of a hash that has already been mixed with the seed.
+static inline size_t PerfectHash_BucketOf(const CTPerfectHash* mph,
+                                          uint64_t mixed) {
+  // The low half of the mixed hash decides whether the key is one of the
+  // 60% skewed into the first 30% of the buckets; the high half picks the
+  // bucket within that group.
+  const size_t dense = (mph->num_buckets * 3 + 9) / 10;
+  const uint64_t high = mixed >> 32;
+  if ((mixed & 0xffffffffULL) < 0x99999999ULL) {
+    return PerfectHash_Reduce(high << 32, dense);
+  }
+  return dense + PerfectHash_Reduce(high << 32, mph->num_buckets - dense);
+}
+
+// Returns the slot, in [0, num_slots), that pilot sends a mixed hash to.
+static inline size_t PerfectHash_Place(const CTPerfectHash* mph,
+                                       uint64_t mixed,
+                                       uint32_t pilot) {
+  // The reduction only looks at the high bits, so the pilot has to be mixed
+  // in before it; otherwise keys that agree in their high bits would land
+  // in the same slot whatever the pilot.
+  return PerfectHash_Reduce(
+      PerfectHash_Mix(mixed ^ PerfectHash_Mix(pilot + mph->seed)),
+      mph->num_slots);
+}
+
+// Returns the slot of a hash in a non-empty perfect hash.
+static inline size_t PerfectHash_Slot(const CTPerfectHash* mph,
+                                      HTHash_t hash) {
+  const uint64_t mixed = PerfectHash_Mix(hash ^ mph->seed);
+  const size_t slot = PerfectHash_Place(
+      mph, mixed, mph->pilots[PerfectHash_BucketOf(mph, mixed)]);
+  return slot < mph->num_keys ? slot : mph->remap[slot - mph->num_keys];
+}
+
+#endif  // PERFECTHASH_PRIV_HPP_
@@ -0,0 +1,156 @@
+#include <cstddef>
+
+#include "RingDeque.hpp"
+#include "RingDeque_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// Returns the smallest power of 2 that is at least n.
+static size_t RoundUpPow2(size_t n) {
+  size_t pow2 = 1;
+  while (pow2 < n) {
+    pow2 <<= 1;
+  }
+  return pow2;
+}
+
+// Returns the index in slots of the payload at position pos.
+static size_t Index(RingDeque* deque, size_t pos) {
+  return (deque->head + pos) & (deque->capacity - 1);
+}
+
+// Makes room for one more payload: grows a full, growable deque's array
+// (unwrapping the payloads to the front of the new one as it goes).
+// Returns false if the deque is bounded and full.
+static bool MakeRoom(RingDeque* deque) {
+  if (deque->num_elements < deque->capacity &&
+      (deque->max_elements == 0 ||
+       deque->num_elements < deque->max_elements)) {
+    return true;
+  }
+  if (deque->max_elements != 0) {
+    return false;
+  }
+
+  const size_t capacity =
+      deque->capacity == 0 ? k_rd_initial_capacity : 2 * deque->capacity;
+  LLPayload_t* slots = new LLPayload_t[capacity];
+  for (size_t i = 0; i < deque->num_elements; i++) {
+    slots[i] = deque->slots[Index(deque, i)];
+  }
+  delete[] deque->slots;
+  deque->slots = slots;
+  deque->capacity = capacity;
+  deque->head = 0;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RingDeque implementation.
+
+RingDeque* RingDeque_New() {
+  RingDeque* deque = new RingDeque();
+  deque->slots = nullptr;
+  deque->capacity = 0;
+  deque->head = 0;
+  deque->num_elements = 0;
+  deque->max_elements = 0;
+  return deque;
+}
+
+RingDeque* RingDeque_NewBounded(size_t max_elements) {
+  RingDeque* deque = RingDeque_New();
+  deque->capacity = RoundUpPow2(max_elements);
+  deque->slots = new LLPayload_t[deque->capacity];
+  deque->max_elements = max_elements;
+  return deque;
+}
+
+void RingDeque_Delete(RingDeque* deque,
+                      LLPayloadFreeFnPtr payload_free_function) {
+  for (size_t i = 0; i < deque->num_elements; i++) {
+    payload_free_function(deque->slots[Index(deque, i)]);
+  }
+  delete[] deque->slots;
+  delete deque;
+}
+
+size_t RingDeque_NumElements(RingDeque* deque) {
+  return deque->num_elements;
+}
+
+bool RingDeque_Push(RingDeque* deque, LLPayload_t payload) {
+  if (!MakeRoom(deque)) {
+    return false;
+  }
+  deque->head = (deque->head - 1) & (deque->capacity - 1);
+  deque->slots[deque->head] = payload;
+  deque->num_elements++;
+  return true;
+}
+
+bool RingDeque_Pop(RingDeque* deque, LLPayload_t* payload_ptr) {
+  if (deque->num_elements == 0) {
+    return false;
+  }
+  *payload_ptr = deque->slots[deque->head];
+  deque->head = (deque->head + 1) & (deque->capacity - 1);
+  deque->num_elements--;
+  return true;
+}
+
+bool RingDeque_Append(RingDeque* deque, LLPayload_t payload) {
+  if (!MakeRoom(deque)) {
+    return false;
+  }
+  deque->slots[Index(deque, deque->num_elements)] = payload;
+  deque->num_elements++;
+  return true;
+}
+
+bool RingDeque_Slice(RingDeque* deque, LLPayload_t* payload_ptr) {
+  if (deque->num_elements == 0) {
+    return false;
+  }
+  deque->num_elements--;
+  *payload_ptr = deque->slots[Index(deque, deque->num_elements)];
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RDIterator implementation.
+
+RDIterator* RDIterator_New(RingDeque* deque) {
+  RDIterator* iter = new RDIterator();
+  iter->deque = deque;
+  iter->pos = 0;
+  return iter;
+}
+
+void RDIterator_Delete(RDIterator* iter) {
+  delete iter;
+}
+
+bool RDIterator_IsValid(RDIterator* iter) {
+  return iter->pos < iter->deque->num_elements;
+}
+
+bool RDIterator_Next(RDIterator* iter) {
+  if (iter->pos >= iter->deque->num_elements) {
+    return false;
+  }
+  return ++iter->pos < iter->deque->num_elements;
+}
+
+void RDIterator_Get(RDIterator* iter, LLPayload_t* payload) {
+  if (iter->pos >= iter->deque->num_elements) {
+    return;
+  }
+  *payload = iter->deque->slots[Index(iter->deque, iter->pos)];
+}
+
+void RDIterator_Rewind(RDIterator* iter) {
+  iter->pos = 0;
+}
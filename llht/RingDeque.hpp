@@ -0,0 +1,93 @@
+#ifndef RINGDEQUE_HPP_
+#define RINGDEQUE_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./LinkedList.hpp"  // for LLPayload_t and LLPayloadFreeFnPtr
+
+///////////////////////////////////////////////////////////////////////////////
+// A RingDeque is a double-ended queue of payloads kept in one contiguous
+// circular array.
+//
+// It is for LinkedLists that are only ever used as FIFO or LIFO buffers:
+// it supports pushing and popping at both ends and forward iteration, but
+// not removal from the middle.  In exchange, it doesn't allocate per
+// payload, takes 8 bytes per payload rather than a node, and iterates
+// through memory in order.
+//
+// The array's capacity is a power of two, and doubles whenever it fills.
+// Alternatively, a deque can be given a fixed capacity, in which case
+// adding to a full deque fails rather than growing it, so that producers
+// can be made to back off.
+//
+// The interface mirrors LinkedList's: RingDeque_X behaves exactly like
+// LinkedList_X, and RDIterator_X like LLIterator_X, except where noted.
+typedef struct rd RingDeque;
+
+// Allocate and return a new, empty deque that grows as needed.  The caller
+// takes responsibility for eventually calling RingDeque_Delete.
+RingDeque* RingDeque_New();
+
+// Allocate and return a new, empty deque that holds at most max_elements
+// payloads (which must be at least 1).  Its whole array is allocated up
+// front.  The caller takes responsibility for eventually calling
+// RingDeque_Delete.
+RingDeque* RingDeque_NewBounded(size_t max_elements);
+
+// Free a deque, invoking payload_free_function on each payload still in it.
+void RingDeque_Delete(RingDeque* deque,
+                      LLPayloadFreeFnPtr payload_free_function);
+
+// Return the number of elements in the deque.
+size_t RingDeque_NumElements(RingDeque* deque);
+
+// Add a payload to the head of the deque.
+//
+// Returns:
+// - false if the deque is bounded and already full; it is left unchanged.
+// - true otherwise.
+bool RingDeque_Push(RingDeque* deque, LLPayload_t payload);
+
+// Remove the payload at the head of the deque, returning it through
+// payload_ptr.  Returns false if the deque is empty.
+bool RingDeque_Pop(RingDeque* deque, LLPayload_t* payload_ptr);
+
+// Add a payload to the tail of the deque.
+//
+// Returns:
+// - false if the deque is bounded and already full; it is left unchanged.
+// - true otherwise.
+bool RingDeque_Append(RingDeque* deque, LLPayload_t payload);
+
+// Remove the payload at the tail of the deque, returning it through
+// payload_ptr.  Returns false if the deque is empty.
+bool RingDeque_Slice(RingDeque* deque, LLPayload_t* payload_ptr);
+
+///////////////////////////////////////////////////////////////////////////////
+// Ring deque iterator.
+//
+// As with LLIterators, mutating a deque with a RingDeque_*() function makes
+// its iterators undefined.  There is no RDIterator_Remove.
+typedef struct rd_iter RDIterator;
+
+// Manufacture an iterator for the deque, pointing at its head.  The caller
+// is responsible for eventually calling RDIterator_Delete.
+RDIterator* RDIterator_New(RingDeque* deque);
+
+// Free an iterator.
+void RDIterator_Delete(RDIterator* iter);
+
+// Returns true iff the iterator is pointing at an element.
+bool RDIterator_IsValid(RDIterator* iter);
+
+// Advance the iterator.  Returns true if it now points at an element, or
+// false if it has moved past the end.
+bool RDIterator_Next(RDIterator* iter);
+
+// Returns the payload the (valid) iterator points at through payload.
+void RDIterator_Get(RDIterator* iter, LLPayload_t* payload);
+
+// Rewind an iterator to the front of its deque.
+void RDIterator_Rewind(RDIterator* iter);
+
+#endif  // RINGDEQUE_HPP_
@@ -0,0 +1,36 @@
+#ifndef RINGDEQUE_PRIV_HPP_
+#define RINGDEQUE_PRIV_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./RingDeque.hpp"  // for RingDeque and RDIterator
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our RingDeque
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The capacity of a growable deque's first array.
+static constexpr size_t k_rd_initial_capacity = 16;
+
+// The entire deque.  Its payloads are slots[(head + i) & (capacity - 1)]
+// for i in [0, num_elements).  A growable deque allocates no array until
+// its first payload arrives.
+typedef struct rd {
+  LLPayload_t* slots;    // the array, or nullptr if not allocated yet
+  size_t capacity;       // # of slots; a power of 2, or 0
+  size_t head;           // index of the head payload
+  size_t num_elements;   // # elements in the deque
+  size_t max_elements;   // the bound, or 0 if the deque may grow
+} RingDeque;
+
+// A ring deque iterator.
+typedef struct rd_iter {
+  RingDeque* deque;  // the deque we're for
+  size_t pos;        // the position (from the head) we are at
+} RDIterator;
+
+#endif  // RINGDEQUE_PRIV_HPP_
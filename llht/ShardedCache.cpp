@@ -0,0 +1,310 @@
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+
+#include "HashTable.hpp"
+#include "IntrusiveList.hpp"
+#include "ShardedCache.hpp"
+#include "ShardedCache_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The number of buckets a byte-budgeted shard's table starts out with; it
+// grows as usual.
+static constexpr size_t k_sc_initial_buckets = 64;
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+
+static SCEntry* EntryOf(ILLink* link) {
+  return IL_CONTAINER_OF(link, SCEntry, queue);
+}
+
+static SCShard* ShardFor(ShardedCache* cache, HTHash_t hash) {
+  // The tables pick buckets with the low bits of the hash, so the shards
+  // are picked with the high bits.
+  return cache->shard_bits == 0
+             ? &cache->shards[0]
+             : &cache->shards[hash >> (64 - cache->shard_bits)];
+}
+
+// Ghost slots hold 0 when empty, so a hash is stored with its low bit set;
+// the ghosts are only ever approximate.
+static HTHash_t GhostOf(HTHash_t hash) {
+  return hash | 1;
+}
+
+static HTHash_t* GhostSlot(ShardedCache* cache,
+                           SCShard* shard,
+                           HTHash_t hash) {
+  return &shard->ghosts[hash & cache->ghost_mask];
+}
+
+// Removes an entry from its queue, and the budget.
+static void UnqueueEntry(SCShard* shard, SCEntry* entry) {
+  IntrusiveList_Remove(&entry->queue);
+  if (entry->in_main) {
+    shard->main_used -= entry->size;
+  } else {
+    shard->small_used -= entry->size;
+  }
+}
+
+// Removes an entry, already taken off its queue, from its shard's table,
+// and frees it.
+static void EvictEntry(ShardedCache* cache, SCShard* shard, SCEntry* entry) {
+  HTKeyValue_t removed;
+  HashTable_Remove(shard->table, entry->kv.hash, entry->kv.key, &removed);
+  shard->evictions++;
+  if (cache->evict_fn != nullptr) {
+    cache->evict_fn(entry->kv);
+  }
+  delete entry;
+}
+
+static void AddToMain(SCShard* shard, SCEntry* entry) {
+  entry->in_main = true;
+  entry->freq.store(0, std::memory_order_relaxed);
+  IntrusiveList_Append(shard->main, &entry->queue);
+  shard->main_used += entry->size;
+}
+
+// Takes the entry at the head of the small queue: promotes it to the main
+// queue if it was hit while in the small one, and evicts it otherwise.
+static void EvictFromSmall(ShardedCache* cache, SCShard* shard) {
+  ILLink* link;
+  IntrusiveList_Pop(shard->small, &link);
+  SCEntry* entry = EntryOf(link);
+  shard->small_used -= entry->size;
+  if (entry->freq.load(std::memory_order_relaxed) > 0) {
+    AddToMain(shard, entry);
+    return;
+  }
+  *GhostSlot(cache, shard, entry->kv.hash) = GhostOf(entry->kv.hash);
+  EvictEntry(cache, shard, entry);
+}
+
+// Takes the entry at the head of the main queue: sends it round again if
+// it was hit since it last was, and evicts it otherwise.
+static void EvictFromMain(ShardedCache* cache, SCShard* shard) {
+  ILLink* link;
+  IntrusiveList_Pop(shard->main, &link);
+  SCEntry* entry = EntryOf(link);
+  const uint8_t freq = entry->freq.load(std::memory_order_relaxed);
+  if (freq > 0) {
+    entry->freq.store(freq - 1, std::memory_order_relaxed);
+    IntrusiveList_Append(shard->main, &entry->queue);
+    return;
+  }
+  shard->main_used -= entry->size;
+  EvictEntry(cache, shard, entry);
+}
+
+// Evicts until the shard is within budget.  Entries leave the small queue
+// while it is over its share (or the main queue is empty), and the main
+// queue otherwise.
+static void EvictToBudget(ShardedCache* cache, SCShard* shard) {
+  while (shard->small_used + shard->main_used > cache->shard_capacity) {
+    if (IntrusiveList_NumElements(shard->small) > 0 &&
+        (shard->small_used > cache->small_capacity ||
+         IntrusiveList_NumElements(shard->main) == 0)) {
+      EvictFromSmall(cache, shard);
+    } else {
+      EvictFromMain(cache, shard);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ShardedCache implementation.
+
+ShardedCache* ShardedCache_New(const SCOptions_t* options,
+                               KeyCmpFnPtr key_compare_function) {
+  if (options->num_shards == 0 || options->shard_capacity == 0) {
+    return nullptr;
+  }
+  ShardedCache* cache = new ShardedCache();
+  cache->num_shards = 1;
+  cache->shard_bits = 0;
+  while (cache->num_shards < options->num_shards) {
+    cache->num_shards <<= 1;
+    cache->shard_bits++;
+  }
+  cache->shard_capacity = options->shard_capacity;
+  cache->small_capacity = options->shard_capacity / k_sc_small_divisor;
+  cache->size_fn = options->size_function;
+  cache->evict_fn = options->evict_function;
+  cache->admit_fn = options->admit_function;
+  const size_t ghosts = (cache->size_fn == nullptr) ? cache->shard_capacity
+                                                     : k_sc_sized_ghosts;
+  size_t num_ghosts = 1;
+  while (num_ghosts < ghosts) {
+    num_ghosts <<= 1;
+  }
+  cache->ghost_mask = num_ghosts - 1;
+
+  // As with an LRUCache, an entry-budgeted shard sizes its table for the
+  // entries it will hold.
+  const size_t buckets = (cache->size_fn == nullptr)
+                             ? cache->shard_capacity
+                             : k_sc_initial_buckets;
+  cache->shards = new SCShard[cache->num_shards];
+  for (size_t i = 0; i < cache->num_shards; i++) {
+    SCShard* shard = &cache->shards[i];
+    shard->table = HashTable_NewCompact(buckets, key_compare_function);
+    shard->small = IntrusiveList_New();
+    shard->main = IntrusiveList_New();
+    shard->small_used = 0;
+    shard->main_used = 0;
+    shard->ghosts = new HTHash_t[num_ghosts]();
+    shard->evictions = 0;
+    shard->rejections = 0;
+    shard->hits.store(0, std::memory_order_relaxed);
+    shard->misses.store(0, std::memory_order_relaxed);
+  }
+  return cache;
+}
+
+void ShardedCache_Delete(ShardedCache* cache,
+                         KeyValueFreeFnPtr kv_free_function) {
+  for (size_t i = 0; i < cache->num_shards; i++) {
+    SCShard* shard = &cache->shards[i];
+    for (IntrusiveList* queue : {shard->small, shard->main}) {
+      ILLink* link;
+      while (IntrusiveList_Pop(queue, &link)) {
+        SCEntry* entry = EntryOf(link);
+        kv_free_function(entry->kv);
+        delete entry;
+      }
+      IntrusiveList_Delete(queue, nullptr);
+    }
+    HashTable_Delete(shard->table, &NoOpFree);
+    delete[] shard->ghosts;
+  }
+  delete[] cache->shards;
+  delete cache;
+}
+
+size_t ShardedCache_NumElements(ShardedCache* cache) {
+  size_t total = 0;
+  for (size_t i = 0; i < cache->num_shards; i++) {
+    std::shared_lock<std::shared_mutex> lock(cache->shards[i].lock);
+    total += HashTable_NumElements(cache->shards[i].table);
+  }
+  return total;
+}
+
+bool ShardedCache_Get(ShardedCache* cache,
+                      HTHash_t hash,
+                      HTKey_t key,
+                      HTKeyValue_t* keyvalue) {
+  SCShard* shard = ShardFor(cache, hash);
+  std::shared_lock<std::shared_mutex> lock(shard->lock);
+  HTKeyValue_t found;
+  if (!HashTable_Find(shard->table, hash, key, &found)) {
+    shard->misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  shard->hits.fetch_add(1, std::memory_order_relaxed);
+
+  // Only bump the counter if it isn't already at the max, so that hot
+  // entries' cache lines stay shared between the threads hitting them.
+  SCEntry* entry = static_cast<SCEntry*>(found.value);
+  uint8_t freq = entry->freq.load(std::memory_order_relaxed);
+  while (freq < k_sc_max_freq &&
+         !entry->freq.compare_exchange_weak(freq, freq + 1,
+                                            std::memory_order_relaxed)) {
+  }
+  *keyvalue = entry->kv;
+  return true;
+}
+
+bool ShardedCache_Put(ShardedCache* cache,
+                      HTKeyValue_t newkeyvalue,
+                      HTKeyValue_t* oldkeyvalue) {
+  SCShard* shard = ShardFor(cache, newkeyvalue.hash);
+  const size_t size =
+      (cache->size_fn != nullptr) ? cache->size_fn(newkeyvalue) : 1;
+  std::unique_lock<std::shared_mutex> lock(shard->lock);
+  if (size > cache->shard_capacity ||
+      (cache->admit_fn != nullptr && !cache->admit_fn(newkeyvalue, size))) {
+    shard->rejections++;
+    if (cache->evict_fn != nullptr) {
+      cache->evict_fn(newkeyvalue);
+    }
+    return false;
+  }
+
+  SCEntry* entry = new SCEntry();
+  entry->kv = newkeyvalue;
+  entry->size = size;
+  ILLink_Init(&entry->queue);
+  entry->freq.store(0, std::memory_order_relaxed);
+
+  HTKeyValue_t old;
+  const bool replaced = HashTable_Insert(
+      shard->table, {newkeyvalue.hash, newkeyvalue.key, entry}, &old);
+  bool to_main = false;
+  if (replaced) {
+    // The new value takes over the old one's place.
+    SCEntry* old_entry = static_cast<SCEntry*>(old.value);
+    to_main = old_entry->in_main;
+    entry->freq.store(old_entry->freq.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    UnqueueEntry(shard, old_entry);
+    *oldkeyvalue = old_entry->kv;
+    delete old_entry;
+  } else {
+    // If it was evicted from the small queue recently, it's back too soon
+    // to be a one-off.
+    HTHash_t* ghost = GhostSlot(cache, shard, newkeyvalue.hash);
+    if (*ghost == GhostOf(newkeyvalue.hash)) {
+      *ghost = 0;
+      to_main = true;
+    }
+  }
+
+  if (to_main) {
+    const uint8_t freq = entry->freq.load(std::memory_order_relaxed);
+    AddToMain(shard, entry);
+    entry->freq.store(freq, std::memory_order_relaxed);
+  } else {
+    entry->in_main = false;
+    IntrusiveList_Append(shard->small, &entry->queue);
+    shard->small_used += entry->size;
+  }
+  EvictToBudget(cache, shard);
+  return replaced;
+}
+
+bool ShardedCache_Remove(ShardedCache* cache,
+                         HTHash_t hash,
+                         HTKey_t key,
+                         HTKeyValue_t* keyvalue) {
+  SCShard* shard = ShardFor(cache, hash);
+  std::unique_lock<std::shared_mutex> lock(shard->lock);
+  HTKeyValue_t found;
+  if (!HashTable_Remove(shard->table, hash, key, &found)) {
+    return false;
+  }
+  SCEntry* entry = static_cast<SCEntry*>(found.value);
+  UnqueueEntry(shard, entry);
+  *keyvalue = entry->kv;
+  delete entry;
+  return true;
+}
+
+void ShardedCache_GetStats(ShardedCache* cache, SCStats_t* stats) {
+  *stats = SCStats_t{0, 0, 0, 0};
+  for (size_t i = 0; i < cache->num_shards; i++) {
+    SCShard* shard = &cache->shards[i];
+    std::shared_lock<std::shared_mutex> lock(shard->lock);
+    stats->hits += shard->hits.load(std::memory_order_relaxed);
+    stats->misses += shard->misses.load(std::memory_order_relaxed);
+    stats->evictions += shard->evictions;
+    stats->rejections += shard->rejections;
+  }
+}
@@ -0,0 +1,128 @@
+#ifndef SHARDEDCACHE_HPP_
+#define SHARDEDCACHE_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"  // for HTKeyValue_t, KeyCmpFnPtr, etc.
+#include "./LRUCache.hpp"   // for LRUSizeFnPtr and LRUEvictFnPtr
+
+///////////////////////////////////////////////////////////////////////////////
+// A ShardedCache is a size-bounded cache that many threads can use at once.
+//
+// An LRUCache moves an entry to the front of its recency list on every hit,
+// so hits have to be serialized.  A ShardedCache instead splits its entries
+// between independent shards, chosen by the high bits of each key's hash,
+// and evicts within each shard using S3-FIFO:
+//
+// - A new entry goes into a small FIFO queue that holds about a tenth of
+//   the shard's budget.  Entries reaching its head that haven't been hit
+//   since they were added are evicted, so one-off keys (eg, a scan) pass
+//   through quickly without displacing the working set.  Their hashes are
+//   remembered, for a while, as "ghosts".
+// - Entries that were hit, and new entries whose hashes are ghosts, go
+//   into the main FIFO queue.  Entries reaching its head go round
+//   again if they were hit since they last did (as in CLOCK), and are
+//   evicted otherwise.
+//
+// A hit only bumps a counter in the entry, under a shard's shared lock, so
+// hits to the same shard proceed in parallel.  Puts, removes and evictions
+// take the shard's lock exclusively.
+//
+// Keys and values are owned the same way as in a HashTable.  Values that
+// are pointers must stay valid for as long as another thread might have
+// copied them out of the cache with ShardedCache_Get.
+typedef struct sc ShardedCache;
+
+// Decides whether to admit a new (key,value), whose size has been measured
+// as size; see ShardedCache_Put.  It may be called from several threads at
+// once.
+typedef bool (*SCAdmitFnPtr)(HTKeyValue_t keyvalue, size_t size);
+
+// How to build a cache.
+typedef struct {
+  size_t num_shards;             // rounded up to a power of two; at least 1
+  size_t shard_capacity;         // each shard's budget; at least 1
+  LRUSizeFnPtr size_function;    // as for LRUCache_New; may be nullptr
+  LRUEvictFnPtr evict_function;  // as for LRUCache_New; may be nullptr
+  SCAdmitFnPtr admit_function;   // returns false to reject; may be nullptr
+} SCOptions_t;
+
+// Counters kept by a cache since it was created, summed over its shards.
+typedef struct {
+  uint64_t hits;        // ShardedCache_Get calls that found their key
+  uint64_t misses;      // ShardedCache_Get calls that didn't
+  uint64_t evictions;   // entries evicted to stay within budget
+  uint64_t rejections;  // puts that weren't admitted
+} SCStats_t;
+
+// Allocate and return a new, empty cache.
+//
+// Arguments:
+// - options: the shape of the cache.  The cache holds up to num_shards
+//   times shard_capacity in total, but since keys are spread over the
+//   shards by hash, each shard evicts once its own budget is full.
+// - key_compare_function: a function pointer to compare two keys; see
+//   HashTable_New.
+//
+// Returns nullptr on error (eg, a zero capacity), non-nullptr on success.
+ShardedCache* ShardedCache_New(const SCOptions_t* options,
+                               KeyCmpFnPtr key_compare_function);
+
+// Deallocates a cache, which no other thread may be using, invoking
+// kv_free_function on each (key,value) still in it.
+void ShardedCache_Delete(ShardedCache* cache,
+                         KeyValueFreeFnPtr kv_free_function);
+
+// Returns the number of entries in the cache.  If other threads are using
+// the cache, this is only a snapshot of each shard in turn.
+size_t ShardedCache_NumElements(ShardedCache* cache);
+
+// Looks up a key and, if it is present, marks it as recently used and
+// returns a copy of its (key,value).
+//
+// Returns:
+//  - false: if the key wasn't in the cache (a miss).
+//  - true: if the key was found (a hit).
+bool ShardedCache_Get(ShardedCache* cache,
+                      HTHash_t hash,
+                      HTKey_t key,
+                      HTKeyValue_t* keyvalue);
+
+// Offers a (key,value) to the cache.  It is rejected, leaving the cache as
+// it was, if it is bigger than a whole shard's budget or if
+// admit_function returns false for it; evict_function is then called on
+// it straight away.  Otherwise it is added, evicting as described above
+// to make room.  evict_function is called with the shard's lock held.
+//
+// Arguments:
+// - cache: the cache to add to.
+// - newkeyvalue: the (key,value) to add.
+// - oldkeyvalue: if the key was already in the cache, its old (key,value)
+//   is replaced and returned through this return parameter, and the caller
+//   takes ownership of it.
+//
+// Returns:
+//  - false: if there was no entry with that key, or if the new (key,value)
+//    was rejected.
+//  - true: if an old (key,value) was replaced and returned.
+bool ShardedCache_Put(ShardedCache* cache,
+                      HTKeyValue_t newkeyvalue,
+                      HTKeyValue_t* oldkeyvalue);
+
+// Removes a (key,value) from the cache, without counting it as an
+// eviction.
+//
+// Returns:
+//  - false: if the key wasn't in the cache.
+//  - true: if it was; the (key,value) is returned through keyvalue, and the
+//    caller takes ownership of it.
+bool ShardedCache_Remove(ShardedCache* cache,
+                         HTHash_t hash,
+                         HTKey_t key,
+                         HTKeyValue_t* keyvalue);
+
+// Returns the cache's counters, summed over its shards, through stats.
+void ShardedCache_GetStats(ShardedCache* cache, SCStats_t* stats);
+
+#endif  // SHARDEDCACHE_HPP_
@@ -0,0 +1,76 @@
+#ifndef SHARDEDCACHE_PRIV_HPP_
+#define SHARDEDCACHE_PRIV_HPP_
+
+#include <atomic>        // for std::atomic
+#include <cstdint>       // for uint8_t, etc.
+#include <cstddef>       // for size_t
+#include <shared_mutex>  // for std::shared_mutex
+
+#include "./HashTable.hpp"      // for HashTable and HTKeyValue_t
+#include "./IntrusiveList.hpp"  // for IntrusiveList and ILLink
+#include "./ShardedCache.hpp"   // for ShardedCache
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our ShardedCache
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The most hits an entry's counter remembers.  An entry in the main queue
+// can go round it this many times without being hit again.
+static constexpr uint8_t k_sc_max_freq = 3;
+
+// The small queue's share of a shard's budget, as 1/k_sc_small_divisor.
+static constexpr size_t k_sc_small_divisor = 10;
+
+// A shard remembers the hashes of entries evicted from its small queue in
+// a direct-mapped array, where a newer hash overwrites any older one that
+// falls in the same slot.  It has as many slots as the shard's budget has
+// entries, rounded up to a power of two, or this many for byte budgets.
+static constexpr size_t k_sc_sized_ghosts = 1024;
+
+// A cached (key,value).  Its shard's table maps its key to the entry.
+typedef struct sc_entry {
+  HTKeyValue_t kv;            // the customer's (key,value)
+  size_t size;                // its size, as measured when it was added
+  ILLink queue;               // its link in the small or main queue
+  bool in_main;               // which of them it is in
+  std::atomic<uint8_t> freq;  // hits since it was queued, up to the max
+} SCEntry;
+
+// One shard.  Each is aligned to its own cache lines, so that threads
+// working on different shards don't contend for them.
+typedef struct alignas(64) sc_shard {
+  std::shared_mutex lock;  // shared for hits, exclusive otherwise
+
+  // The following are guarded by lock.
+  HashTable* table;        // key -> SCEntry*, as the value
+  IntrusiveList* small;    // new entries, oldest first
+  IntrusiveList* main;     // entries that proved themselves, oldest first
+  size_t small_used;       // the sum of the sizes in small
+  size_t main_used;        // the sum of the sizes in main
+  HTHash_t* ghosts;        // hashes of entries evicted from small, or 0
+  uint64_t evictions;      // counters, as in SCStats_t
+  uint64_t rejections;
+
+  // Updated by hits and misses under the shared lock.
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+} SCShard;
+
+// The entire cache.
+typedef struct sc {
+  SCShard* shards;         // shards[num_shards]
+  size_t num_shards;       // a power of two
+  int shard_bits;          // log2(num_shards)
+  size_t shard_capacity;   // each shard's budget
+  size_t small_capacity;   // the small queue's target share of it
+  size_t ghost_mask;       // each shard's number of ghost slots, minus 1
+  LRUSizeFnPtr size_fn;    // measures entries, or nullptr
+  LRUEvictFnPtr evict_fn;  // called on evicted entries, or nullptr
+  SCAdmitFnPtr admit_fn;   // filters new entries, or nullptr
+} ShardedCache;
+
+#endif  // SHARDEDCACHE_PRIV_HPP_
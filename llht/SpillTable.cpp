@@ -0,0 +1,347 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "HashTable.hpp"
+#include "HashTable_priv.hpp"
+#include "SpillTable.hpp"
+#include "SpillTable_priv.hpp"
+#include "TableImage_priv.hpp"
+#include "TableLog_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+static std::string SnapshotPath(SpillTable* table, size_t p) {
+  return table->dir + "/" + std::to_string(p) + ".snap";
+}
+
+static std::string LogPath(SpillTable* table, size_t p) {
+  return table->dir + "/" + std::to_string(p) + ".log";
+}
+
+// Returns the size of the file at path, or 0 if it can't be found.
+static uint64_t FileBytes(const std::string& path) {
+  struct stat st{};
+  if (stat(path.c_str(), &st) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(st.st_size);
+}
+
+static HashTable* NewPartitionTable(SpillTable* table) {
+  return table->string_keys
+             ? HashTable_NewStringKeys(k_st_initial_buckets)
+             : HashTable_NewCompact(k_st_initial_buckets, table->key_cmp_fn);
+}
+
+// Marks partition p as the one used most recently.
+static void Touch(SpillTable* table, size_t p) {
+  table->partitions[p].last_used = ++table->uses;
+}
+
+// Brings partition p's memory_bytes up to date, along with the total.
+static void Remeasure(SpillTable* table, size_t p) {
+  STPartition* part = &table->partitions[p];
+  const size_t bytes = HashTable_MemoryBytes(part->table);
+  table->memory_bytes = table->memory_bytes - part->memory_bytes + bytes;
+  part->memory_bytes = bytes;
+}
+
+// Spills the partitions used least recently, other than keep, until the
+// table is back within its budget.  Empty partitions aren't worth spilling.
+static void EnforceBudget(SpillTable* table, size_t keep) {
+  while (table->memory_bytes > table->memory_limit) {
+    size_t victim = SIZE_MAX;
+    for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+      const STPartition& part = table->partitions[p];
+      if (p != keep && part.table != nullptr &&
+          HashTable_NumElements(part.table) > 0 &&
+          (victim == SIZE_MAX ||
+           part.last_used < table->partitions[victim].last_used)) {
+        victim = p;
+      }
+    }
+    if (victim == SIZE_MAX || !SpillTable_Spill(table, victim)) {
+      return;
+    }
+  }
+}
+
+// Appends whatever of partition p's log is still in memory to its file.
+static bool FlushLog(SpillTable* table, size_t p) {
+  STPartition* part = &table->partitions[p];
+  if (part->log.empty()) {
+    return true;
+  }
+  const std::string path = LogPath(table, p);
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600);
+  bool ok = fd >= 0;
+  const char* buf = part->log.data();
+  size_t len = part->log.size();
+  while (ok && len > 0) {
+    const ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    ok = n > 0;
+    if (ok) {
+      buf += n;
+      len -= static_cast<size_t>(n);
+    }
+  }
+  if (fd >= 0 && close(fd) != 0) {
+    ok = false;
+  }
+  table->memory_bytes -= part->log.size();
+  part->log.clear();
+  if (!ok) {
+    table->stats.failures++;
+  }
+  return ok;
+}
+
+// Logs an insert into spilled partition p, to be replayed when it's next
+// reloaded.
+static void BufferInsert(SpillTable* table, size_t p, HTKeyValue_t kv) {
+  STPartition* part = &table->partitions[p];
+  const size_t before = part->log.size();
+  if (part->log_end == 0) {
+    TableLog_EncodeHeader(&part->log, table->string_keys);
+    part->log_end = part->log.size();
+  }
+  part->log_end += TableLog_Encode(&part->log, part->log_end,
+                                   table->string_keys, false, kv);
+  table->memory_bytes += part->log.size() - before;
+  table->stats.buffered_ops++;
+  if (part->log.size() >= k_st_log_flush_bytes) {
+    FlushLog(table, p);
+  }
+}
+
+// Creates a private directory for spill files under dir (or $TMPDIR, or
+// /tmp), storing its path in *path.
+static bool MakeSpillDir(const char* dir, std::string* path) {
+  if (dir == nullptr) {
+    dir = getenv("TMPDIR");
+  }
+  if (dir == nullptr || *dir == '\0') {
+    dir = "/tmp";
+  }
+  std::string templ = std::string(dir) + "/llht-spill-XXXXXX";
+  if (mkdtemp(&templ[0]) == nullptr) {
+    return false;
+  }
+  *path = templ;
+  return true;
+}
+
+static SpillTable* NewSpillTable(const STOptions_t* options,
+                                 KeyCmpFnPtr key_compare_function,
+                                 bool string_keys) {
+  std::string dir;
+  if (!MakeSpillDir(options->dir, &dir)) {
+    return nullptr;
+  }
+  SpillTable* table = new SpillTable{};
+  table->radix_bits = options->radix_bits;
+  if (table->radix_bits <= 0) {
+    table->radix_bits = k_st_default_radix_bits;
+  } else if (table->radix_bits > k_st_max_radix_bits) {
+    table->radix_bits = k_st_max_radix_bits;
+  }
+  table->memory_limit = options->memory_limit;
+  table->memory_bytes = 0;
+  table->buffer_inserts = options->buffer_inserts;
+  table->string_keys = string_keys;
+  table->key_cmp_fn = key_compare_function;
+  table->dir = dir;
+  table->uses = 0;
+
+  table->partitions = new STPartition[SpillTable_NumPartitions(table)];
+  for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+    STPartition* part = &table->partitions[p];
+    part->table = NewPartitionTable(table);
+    part->memory_bytes = 0;
+    part->num_spilled = 0;
+    part->last_used = 0;
+    part->log_end = 0;
+    Remeasure(table, p);
+  }
+  return table;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SpillTable implementation.
+
+SpillTable* SpillTable_New(const STOptions_t* options,
+                           KeyCmpFnPtr key_compare_function) {
+  return NewSpillTable(options, key_compare_function, false);
+}
+
+SpillTable* SpillTable_NewStringKeys(const STOptions_t* options) {
+  return NewSpillTable(options, nullptr, true);
+}
+
+void SpillTable_Delete(SpillTable* table) {
+  for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+    if (table->partitions[p].table != nullptr) {
+      HashTable_Delete(table->partitions[p].table, nullptr);
+    }
+    remove(SnapshotPath(table, p).c_str());
+    remove(LogPath(table, p).c_str());
+  }
+  rmdir(table->dir.c_str());
+  delete[] table->partitions;
+  delete table;
+}
+
+size_t SpillTable_NumElements(SpillTable* table) {
+  size_t n = 0;
+  for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+    const STPartition& part = table->partitions[p];
+    n += (part.table != nullptr) ? HashTable_NumElements(part.table)
+                                 : part.num_spilled;
+  }
+  return n;
+}
+
+bool SpillTable_Spill(SpillTable* table, size_t p) {
+  STPartition* part = &table->partitions[p];
+  // Spill files never outlive the table, so there's no point syncing them.
+  const std::string path = SnapshotPath(table, p);
+  if (!TableImage_Write(part->table->compact, path.c_str(), nullptr, false)) {
+    table->stats.failures++;
+    return false;
+  }
+  table->stats.spills++;
+  table->stats.spill_bytes += FileBytes(path);
+
+  part->num_spilled = HashTable_NumElements(part->table);
+  HashTable_Delete(part->table, nullptr);
+  part->table = nullptr;
+  table->memory_bytes -= part->memory_bytes;
+  part->memory_bytes = 0;
+  return true;
+}
+
+bool SpillTable_Reload(SpillTable* table, size_t p) {
+  STPartition* part = &table->partitions[p];
+  if (part->table != nullptr) {
+    return true;
+  }
+
+  // The snapshot is mapped privately, so it can be unlinked straight away,
+  // and only the pages actually touched are read back in.
+  const std::string path = SnapshotPath(table, p);
+  const uint64_t snapshot_bytes = FileBytes(path);
+  part->table = HashTable_Open(path.c_str(), table->key_cmp_fn,
+                               k_ht_open_writable);
+  if (part->table == nullptr) {
+    table->stats.failures++;
+    return false;
+  }
+  remove(path.c_str());
+  table->stats.reloads++;
+  table->stats.reload_bytes += snapshot_bytes;
+
+  if (part->log_end > 0) {
+    const std::string log_path = LogPath(table, p);
+    if (!FlushLog(table, p) ||
+        !TableLog_ReplayFile(log_path.c_str(), part->table,
+                             table->string_keys)) {
+      table->stats.failures++;
+    }
+    table->stats.reload_bytes += part->log_end;
+    remove(log_path.c_str());
+    part->log_end = 0;
+  }
+
+  part->num_spilled = 0;
+  Touch(table, p);
+  Remeasure(table, p);
+  EnforceBudget(table, p);
+  return true;
+}
+
+bool SpillTable_Insert(SpillTable* table,
+                       HTKeyValue_t newkeyvalue,
+                       HTKeyValue_t* oldkeyvalue) {
+  const size_t p = SpillTable_PartitionOf(table, newkeyvalue.hash);
+  STPartition* part = &table->partitions[p];
+  if (part->table == nullptr) {
+    if (table->buffer_inserts) {
+      BufferInsert(table, p, newkeyvalue);
+      EnforceBudget(table, p);
+      return false;
+    }
+    if (!SpillTable_Reload(table, p)) {
+      return false;
+    }
+  }
+  Touch(table, p);
+  const bool replaced = HashTable_Insert(part->table, newkeyvalue,
+                                         oldkeyvalue);
+  Remeasure(table, p);
+  EnforceBudget(table, p);
+  return replaced;
+}
+
+bool SpillTable_Find(SpillTable* table,
+                     HTHash_t hash,
+                     HTKey_t key,
+                     HTKeyValue_t* keyvalue) {
+  const size_t p = SpillTable_PartitionOf(table, hash);
+  if (!SpillTable_Reload(table, p)) {
+    return false;
+  }
+  Touch(table, p);
+  return HashTable_Find(table->partitions[p].table, hash, key, keyvalue);
+}
+
+bool SpillTable_Remove(SpillTable* table,
+                       HTHash_t hash,
+                       HTKey_t key,
+                       HTKeyValue_t* keyvalue) {
+  const size_t p = SpillTable_PartitionOf(table, hash);
+  if (!SpillTable_Reload(table, p)) {
+    return false;
+  }
+  Touch(table, p);
+  const bool removed =
+      HashTable_Remove(table->partitions[p].table, hash, key, keyvalue);
+  Remeasure(table, p);
+  return removed;
+}
+
+bool SpillTable_Merge(SpillTable* table) {
+  const uint64_t failures = table->stats.failures;
+  for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+    if (table->partitions[p].table == nullptr &&
+        table->partitions[p].log_end > 0) {
+      SpillTable_Reload(table, p);
+    }
+  }
+  // Each reload only made room for itself, so the last one may have left
+  // the table over budget.
+  EnforceBudget(table, SIZE_MAX);
+  return table->stats.failures == failures;
+}
+
+void SpillTable_GetStats(SpillTable* table, STStats_t* stats) {
+  *stats = table->stats;
+  stats->memory_bytes = table->memory_bytes;
+  stats->num_spilled = 0;
+  for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+    if (table->partitions[p].table == nullptr) {
+      stats->num_spilled++;
+    }
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef SPILLTABLE_HPP_
+#define SPILLTABLE_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"  // for HTKeyValue_t, KeyCmpFnPtr, etc.
+
+///////////////////////////////////////////////////////////////////////////////
+// A SpillTable is a HashTable with a memory budget, for tables that may not
+// fit in RAM.
+//
+// Its elements are split between partitions by the high bits of their
+// hashes, each a compact HashTable of its own.  Whenever the partitions in
+// memory together take more than the budget (as measured by
+// HashTable_MemoryBytes), the ones used least recently are "spilled": saved
+// to a snapshot file (see HashTable_Save) in a private temporary directory,
+// and deleted from memory.
+//
+// A find or remove on a spilled partition reloads it, by opening its
+// snapshot (see HashTable_Open), which may spill others in turn.  So does
+// an insert, unless the table buffers inserts: then inserts into a spilled
+// partition are appended to a log file of its own (in the format of a
+// write-ahead log; see HashTable_AttachLog) instead, and replayed into it
+// whenever it is next reloaded, or by SpillTable_Merge.
+//
+// Like snapshots, a SpillTable stores keys and values as raw 64-bit words,
+// so it is only meaningful for string keys, or for keys and values stored
+// directly in the HTKey_t and HTValue_t.  The table owns everything in it,
+// and frees nothing but its own memory.
+typedef struct st SpillTable;
+
+// How to build a SpillTable.
+typedef struct {
+  size_t memory_limit;  // bytes of partitions to keep in memory at most
+  int radix_bits;       // log2 of the # of partitions, up to 12; 0 picks
+  const char* dir;      // where to spill to; nullptr for $TMPDIR or /tmp
+  bool buffer_inserts;  // log inserts into spilled partitions, not reload?
+} STOptions_t;
+
+// Counters kept by a SpillTable since it was created.
+typedef struct {
+  uint64_t spills;         // partitions saved and deleted from memory
+  uint64_t spill_bytes;    // bytes of snapshots written by those spills
+  uint64_t reloads;        // partitions opened back up
+  uint64_t reload_bytes;   // bytes of snapshots and logs they read back
+  uint64_t buffered_ops;   // inserts logged for spilled partitions
+  uint64_t failures;       // spills and reloads that failed
+  size_t memory_bytes;     // bytes of partitions in memory now
+  size_t num_spilled;      // # of partitions spilled now
+} STStats_t;
+
+// Allocate and return a new, empty SpillTable.
+//
+// Arguments:
+// - options: how to build the table.  A partition is only ever spilled to
+//   make room for another, so the table may exceed its budget if a single
+//   partition does.
+// - key_compare_function: a function pointer to compare two keys; see
+//   HashTable_New.
+//
+// Returns nullptr on error (eg, the directory can't be created),
+// non-nullptr on success.
+SpillTable* SpillTable_New(const STOptions_t* options,
+                           KeyCmpFnPtr key_compare_function);
+
+// The same as SpillTable_New, except that the table's keys are strings,
+// as for HashTable_NewStringKeys.
+SpillTable* SpillTable_NewStringKeys(const STOptions_t* options);
+
+// Deallocates a SpillTable, and deletes its spill files and directory.
+void SpillTable_Delete(SpillTable* table);
+
+// Returns the number of elements in the table.  Inserts still buffered for
+// spilled partitions aren't counted until they are replayed.
+size_t SpillTable_NumElements(SpillTable* table);
+
+// These have the same contract as HashTable_Insert, HashTable_Find and
+// HashTable_Remove respectively, except that:
+//
+// - an insert buffered for a spilled partition returns false, since
+//   whether it replaces an element isn't known until it's replayed.
+// - if a spilled partition can't be reloaded, finds and removes on it
+//   return false, and inserts into it are dropped and return false; the
+//   failure is counted in the table's stats.
+bool SpillTable_Insert(SpillTable* table,
+                       HTKeyValue_t newkeyvalue,
+                       HTKeyValue_t* oldkeyvalue);
+bool SpillTable_Find(SpillTable* table,
+                     HTHash_t hash,
+                     HTKey_t key,
+                     HTKeyValue_t* keyvalue);
+bool SpillTable_Remove(SpillTable* table,
+                       HTHash_t hash,
+                       HTKey_t key,
+                       HTKeyValue_t* keyvalue);
+
+// Replays every spilled partition's buffered inserts into it, reloading
+// each in turn (and spilling it again if need be).
+//
+// Returns false if any partition couldn't be reloaded or spilled again;
+// true otherwise.
+bool SpillTable_Merge(SpillTable* table);
+
+// Fills in stats with the table's counters.
+void SpillTable_GetStats(SpillTable* table, STStats_t* stats);
+
+#endif  // SPILLTABLE_HPP_
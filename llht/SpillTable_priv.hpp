@@ -0,0 +1,80 @@
+#ifndef SPILLTABLE_PRIV_HPP_
+#define SPILLTABLE_PRIV_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+#include <string>   // for std::string
+
+#include "./HashTable.hpp"   // for HashTable and KeyCmpFnPtr
+#include "./SpillTable.hpp"  // for SpillTable and STStats_t
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our SpillTable
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The number of partitions, as log2, if the options leave it to us.
+static constexpr int k_st_default_radix_bits = 6;
+
+// The most partitions a table may have, as log2.
+static constexpr int k_st_max_radix_bits = 12;
+
+// The number of buckets each partition's table starts out with; they grow
+// as usual.
+static constexpr size_t k_st_initial_buckets = 16;
+
+// A spilled partition's buffered inserts are written out to its log file
+// once this many bytes of records have built up in memory.
+static constexpr size_t k_st_log_flush_bytes = 64 * 1024;
+
+// A partition.  Its snapshot and log live in the table's directory, named
+// after its index.
+typedef struct st_partition {
+  HashTable* table;      // the partition, or nullptr if it is spilled
+  size_t memory_bytes;   // HashTable_MemoryBytes(table), when last measured
+  size_t num_spilled;    // # of elements in its snapshot, if spilled
+  uint64_t last_used;    // the SpillTable's use count when it was last used
+  std::string log;       // encoded log records not written out yet
+  uint64_t log_end;      // the log file's length, once log is written out
+} STPartition;
+
+// The SpillTable.  memory_bytes is the sum of the partitions' memory_bytes
+// and the sizes of their unwritten logs.
+typedef struct st {
+  STPartition* partitions;  // 2^radix_bits of them
+  int radix_bits;           // log2 of the # of partitions
+  size_t memory_limit;      // spill once memory_bytes is above this
+  size_t memory_bytes;      // bytes of partitions and logs in memory
+  bool buffer_inserts;      // log inserts into spilled partitions?
+  bool string_keys;         // are the partitions string-key tables?
+  KeyCmpFnPtr key_cmp_fn;   // to check for key collisions
+  std::string dir;          // the private directory spill files go in
+  uint64_t uses;            // # of partition uses so far, as a clock
+  STStats_t stats;          // the counters; sizes are filled in on demand
+} SpillTable;
+
+// Returns the number of partitions in a table.
+static inline size_t SpillTable_NumPartitions(const SpillTable* table) {
+  return static_cast<size_t>(1) << table->radix_bits;
+}
+
+// Returns the partition a hash falls in.
+static inline size_t SpillTable_PartitionOf(const SpillTable* table,
+                                            HTHash_t hash) {
+  // The partitions' tables pick buckets with the low bits of the hash, so
+  // the partitions are picked with the high bits.
+  return table->radix_bits == 0 ? 0 : hash >> (64 - table->radix_bits);
+}
+
+// Spills partition p, which must be in memory.  Returns false if its
+// snapshot couldn't be written, in which case it stays in memory.
+bool SpillTable_Spill(SpillTable* table, size_t p);
+
+// Reloads partition p if it is spilled, replaying its log.  Returns false
+// if its snapshot couldn't be opened, in which case it stays spilled.
+bool SpillTable_Reload(SpillTable* table, size_t p);
+
+#endif  // SPILLTABLE_PRIV_HPP_
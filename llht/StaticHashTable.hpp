@@ -0,0 +1,287 @@
+#ifndef STATICHASHTABLE_HPP_
+#define STATICHASHTABLE_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./HashTable.hpp"  // for HTHash_t
+
+///////////////////////////////////////////////////////////////////////////////
+// A StaticHashTable is a read-only table over a fixed set of string keys,
+// such as a language's keywords or an instruction set's opcodes, built by
+// the compiler rather than at startup.
+//
+// StaticHashTable_Build takes an array of (key,value)s and lays them out
+// around a perfect hash of the keys' FNVHash64s, much as HashTable_Freeze
+// does (see PerfectHash_priv.hpp), but entirely in constant expressions.
+// Declared constexpr, the table is just initialized data: there is nothing
+// to run at startup and nothing on the heap.  A find hashes the key, reads
+// one pilot and one slot, and compares the key with the one slot's key;
+// there are no chains to walk.
+//
+//   static constexpr SHTEntry_t k_keywords[] = {{"if", 1}, {"else", 2}};
+//   static constexpr auto k_keyword_table = StaticHashTable_Build(k_keywords);
+//   static_assert(k_keyword_table.built);
+//
+// Everything, lookups included, also works in constant expressions.  The
+// table is meant for sets of up to a few thousand keys; bigger ones may run
+// into the compiler's limits on constant evaluation.
+
+// The same hash as FNVHash64, usable in constant expressions.
+constexpr HTHash_t FNVHash64Constexpr(const char* bytes, size_t len) {
+  uint64_t hval = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++) {
+    hval ^= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i]));
+    hval *= 0x100000001b3ULL;
+  }
+  return hval;
+}
+
+// A (key,value) to build a table from.  Values are plain integers (eg,
+// enumerators or opcode numbers); to look up anything bigger, store an
+// index into an array of it.
+typedef struct {
+  const char* key;  // a NUL-terminated string
+  uint64_t value;   // the key's value
+} SHTEntry_t;
+
+// A slot of a StaticHashTable.
+typedef struct {
+  HTHash_t hash;    // FNVHash64Constexpr of the key
+  const char* key;  // the key, or nullptr if the slot is empty
+  size_t len;       // the length of the key
+  uint64_t value;   // the key's value
+} SHTSlot_t;
+
+// Returns the # of slots in a table of n keys: a power of two, keeping the
+// table at most 80% full.
+constexpr size_t StaticHashTable_NumSlots(size_t n) {
+  size_t m = 1;
+  while (m < n + n / 4 + 1) {
+    m *= 2;
+  }
+  return m;
+}
+
+// Returns the # of pilots in a table of n keys: a power of two, with about
+// four keys per pilot.
+constexpr size_t StaticHashTable_NumPilots(size_t n) {
+  size_t b = 1;
+  while (b * 4 < n) {
+    b *= 2;
+  }
+  return b;
+}
+
+// The most pilots tried for any one bucket before starting over with
+// another seed, and the most seeds tried before giving up.
+static constexpr uint32_t k_sht_max_pilot = 1 << 16;
+static constexpr int k_sht_max_seeds = 8;
+
+// A table of N (key,value)s.  Its fields are private; use the functions
+// below.
+template <size_t N>
+struct StaticHashTable {
+  SHTSlot_t slots[StaticHashTable_NumSlots(N)];    // the keys, by slot
+  uint32_t pilots[StaticHashTable_NumPilots(N)];  // per-bucket pilots
+  uint64_t seed;  // mixed into every hash
+  bool built;     // did StaticHashTable_Build succeed?
+};
+
+// Scrambles the bits of x; the same finalizer PerfectHash_Mix uses.
+constexpr uint64_t StaticHashTable_Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Returns the bucket a hash, already mixed with the seed, falls in.
+template <size_t N>
+constexpr size_t StaticHashTable_BucketOf(uint64_t mixed) {
+  return mixed & (StaticHashTable_NumPilots(N) - 1);
+}
+
+// Returns the slot that pilot sends a hash, already mixed with the seed,
+// to.
+template <size_t N>
+constexpr size_t StaticHashTable_Place(uint64_t mixed, uint32_t pilot) {
+  return StaticHashTable_Mix(mixed ^ StaticHashTable_Mix(pilot + 1)) &
+         (StaticHashTable_NumSlots(N) - 1);
+}
+
+// Returns the only slot a key with the given hash can be in.
+template <size_t N>
+constexpr size_t StaticHashTable_SlotOf(const StaticHashTable<N>& table,
+                                        HTHash_t hash) {
+  const uint64_t mixed = StaticHashTable_Mix(hash ^ table.seed);
+  return StaticHashTable_Place<N>(
+      mixed, table.pilots[StaticHashTable_BucketOf<N>(mixed)]);
+}
+
+// Tries to find pilots for every bucket with table->seed, and fills in the
+// slots if it does.  The buckets are placed biggest first, while the slots
+// are still mostly empty.  Sets *duplicate if two of the hashes are equal,
+// since no seed can separate those.  Used by StaticHashTable_Build.
+template <size_t N>
+constexpr bool StaticHashTable_TryBuild(StaticHashTable<N>* table,
+                                        const SHTEntry_t (&entries)[N],
+                                        const HTHash_t (&hashes)[N],
+                                        const size_t (&lens)[N],
+                                        bool* duplicate) {
+  constexpr size_t num_slots = StaticHashTable_NumSlots(N);
+  constexpr size_t num_buckets = StaticHashTable_NumPilots(N);
+
+  // Sort the keys by bucket.
+  uint64_t mixed[N]{};
+  size_t bucket_starts[num_buckets + 1]{};
+  for (size_t i = 0; i < N; i++) {
+    mixed[i] = StaticHashTable_Mix(hashes[i] ^ table->seed);
+    bucket_starts[StaticHashTable_BucketOf<N>(mixed[i]) + 1]++;
+  }
+  for (size_t b = 0; b < num_buckets; b++) {
+    bucket_starts[b + 1] += bucket_starts[b];
+  }
+  size_t keys[N]{};
+  size_t fill[num_buckets]{};
+  for (size_t i = 0; i < N; i++) {
+    const size_t b = StaticHashTable_BucketOf<N>(mixed[i]);
+    keys[bucket_starts[b] + fill[b]++] = i;
+  }
+
+  // Equal hashes share a bucket; checking within buckets keeps the build
+  // linear in N rather than quadratic.
+  for (size_t b = 0; b < num_buckets; b++) {
+    for (size_t j = bucket_starts[b]; j < bucket_starts[b + 1]; j++) {
+      for (size_t k = j + 1; k < bucket_starts[b + 1]; k++) {
+        if (hashes[keys[j]] == hashes[keys[k]]) {
+          *duplicate = true;
+          return false;
+        }
+      }
+    }
+  }
+
+  // Order the buckets biggest first.
+  size_t size_starts[N + 2]{};
+  for (size_t b = 0; b < num_buckets; b++) {
+    size_starts[N - (bucket_starts[b + 1] - bucket_starts[b]) + 1]++;
+  }
+  for (size_t s = 0; s <= N; s++) {
+    size_starts[s + 1] += size_starts[s];
+  }
+  size_t order[num_buckets]{};
+  for (size_t b = 0; b < num_buckets; b++) {
+    order[size_starts[N - (bucket_starts[b + 1] - bucket_starts[b])]++] = b;
+  }
+
+  // Place each bucket with the first pilot whose slots are all free.
+  bool taken[num_slots]{};
+  size_t slots[N]{};
+  for (size_t b : order) {
+    const size_t start = bucket_starts[b];
+    const size_t size = bucket_starts[b + 1] - start;
+    uint32_t pilot = 0;
+    for (;; pilot++) {
+      if (pilot == k_sht_max_pilot) {
+        return false;
+      }
+      size_t placed = 0;
+      for (; placed < size; placed++) {
+        const size_t slot =
+            StaticHashTable_Place<N>(mixed[keys[start + placed]], pilot);
+        bool clash = taken[slot];
+        for (size_t j = 0; j < placed && !clash; j++) {
+          clash = slots[start + j] == slot;
+        }
+        if (clash) {
+          break;
+        }
+        slots[start + placed] = slot;
+      }
+      if (placed == size) {
+        break;
+      }
+    }
+    table->pilots[b] = pilot;
+    for (size_t j = start; j < start + size; j++) {
+      taken[slots[j]] = true;
+    }
+  }
+
+  for (size_t j = 0; j < N; j++) {
+    const size_t i = keys[j];
+    table->slots[slots[j]] = {hashes[i], entries[i].key, lens[i],
+                              entries[i].value};
+  }
+  return true;
+}
+
+// Builds a table holding the given (key,value)s; usually called to
+// initialize a constexpr variable.
+//
+// Arguments:
+// - entries: the (key,value)s.  The keys must stay valid as long as the
+//   table does (eg, string literals), and be distinct.
+//
+// Returns the table.  Its "built" field is false, and the table is empty,
+// if two keys are equal or have equal hashes, or no perfect hash could be
+// found; static_assert on it.
+template <size_t N>
+constexpr StaticHashTable<N> StaticHashTable_Build(
+    const SHTEntry_t (&entries)[N]) {
+  HTHash_t hashes[N]{};
+  size_t lens[N]{};
+  for (size_t i = 0; i < N; i++) {
+    while (entries[i].key[lens[i]] != '\0') {
+      lens[i]++;
+    }
+    hashes[i] = FNVHash64Constexpr(entries[i].key, lens[i]);
+  }
+
+  bool duplicate = false;
+  for (int s = 0; s < k_sht_max_seeds && !duplicate; s++) {
+    StaticHashTable<N> table{};
+    table.seed = StaticHashTable_Mix(static_cast<uint64_t>(s) + 1);
+    if (StaticHashTable_TryBuild(&table, entries, hashes, lens, &duplicate)) {
+      table.built = true;
+      return table;
+    }
+  }
+  return StaticHashTable<N>{};
+}
+
+// Looks up a key in a table.
+//
+// Arguments:
+// - table: the table to look in.
+// - key: the key's bytes; they need not be NUL-terminated.
+// - len: the # of bytes in the key.
+// - value: if the key is found, its value is returned through this
+//   return parameter.
+//
+// Returns:
+// - false: if the key isn't in the table.
+// - true: if the key is in the table.
+template <size_t N>
+constexpr bool StaticHashTable_Find(const StaticHashTable<N>& table,
+                                    const char* key,
+                                    size_t len,
+                                    uint64_t* value) {
+  const HTHash_t hash = FNVHash64Constexpr(key, len);
+  const SHTSlot_t& slot = table.slots[StaticHashTable_SlotOf(table, hash)];
+  if (slot.hash != hash || slot.len != len || slot.key == nullptr) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (slot.key[i] != key[i]) {
+      return false;
+    }
+  }
+  *value = slot.value;
+  return true;
+}
+
+#endif  // STATICHASHTABLE_HPP_
@@ -0,0 +1,365 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "CompactTable_priv.hpp"
+#include "HashTable_priv.hpp"
+#include "LinkedList_priv.hpp"
+#include "TableDelta_priv.hpp"
+#include "TableImage_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// Rounds n up to a multiple of 8.
+static uint64_t Align8(uint64_t n) {
+  return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Writes one record; for a string-key table, kv.key points to an
+// HTStringKey_t.
+static void WriteRecord(ImageWriter* w, bool string_keys, HTKeyValue_t kv) {
+  if (!string_keys) {
+    ImageWriter_Write(w, &kv, sizeof(kv));
+    return;
+  }
+  const HTStringKey_t* skey = static_cast<const HTStringKey_t*>(kv.key);
+  kv.key = reinterpret_cast<HTKey_t>(skey->len);
+  ImageWriter_Write(w, &kv, sizeof(kv));
+  ImageWriter_Write(w, skey->bytes, skey->len);
+  ImageWriter_Pad(w);
+}
+
+// Visits every element of bucket, writing each one to w if w is
+// non-nullptr.  Returns the number of elements in the bucket.
+static size_t VisitBucket(HashTable* table, size_t bucket, ImageWriter* w) {
+  size_t count = 0;
+  CompactTable* ct = table->compact;
+  if (ct != nullptr) {
+    for (uint32_t idx = ct->heads[bucket]; idx != k_ct_nil;
+         idx = ct->links[idx].next) {
+      if (w != nullptr) {
+        HTStringKey_t key_view;
+        HTKeyValue_t kv;
+        CompactTable_GetEntry(ct, idx, &key_view, &kv);
+        WriteRecord(w, ct->string_keys, kv);
+      }
+      count++;
+    }
+    return count;
+  }
+
+  for (LinkedListNode* node = table->buckets[bucket]->head; node != nullptr;
+       node = node->next) {
+    if (w != nullptr) {
+      WriteRecord(w, false, *static_cast<HTKeyValue_t*>(node->payload));
+    }
+    count++;
+  }
+  return count;
+}
+
+// Walks the ranges and records of a delta held in memory.
+typedef struct {
+  const char* bytes;  // the whole file
+  uint64_t pos;       // offset of the next thing to read
+  uint64_t end;       // the size of the file
+} DeltaReader;
+
+static bool ReadRange(DeltaReader* r, HTDeltaRange* range) {
+  if (r->end - r->pos < sizeof(HTDeltaRange)) {
+    return false;
+  }
+  memcpy(range, r->bytes + r->pos, sizeof(HTDeltaRange));
+  r->pos += sizeof(HTDeltaRange);
+  return true;
+}
+
+// Reads one record.  For a string-key delta, kv->key is set to key_view,
+// which is filled in to point at the key's bytes within the file.
+static bool ReadRecord(DeltaReader* r,
+                       bool string_keys,
+                       HTStringKey_t* key_view,
+                       HTKeyValue_t* kv) {
+  if (r->end - r->pos < sizeof(HTKeyValue_t)) {
+    return false;
+  }
+  memcpy(kv, r->bytes + r->pos, sizeof(HTKeyValue_t));
+  r->pos += sizeof(HTKeyValue_t);
+  if (!string_keys) {
+    return true;
+  }
+
+  const uint64_t len = reinterpret_cast<uint64_t>(kv->key);
+  if (len > k_ct_max_key_len || Align8(len) > r->end - r->pos) {
+    return false;
+  }
+  key_view->bytes = r->bytes + r->pos;
+  key_view->len = len;
+  kv->key = key_view;
+  r->pos += Align8(len);
+  return true;
+}
+
+// Reads num_records records onto the end of kvs and, for string keys,
+// views.  Their keys are left for RecordAt to fill in, since views may
+// move as it grows.
+static void ReadRecords(DeltaReader* r,
+                        bool string_keys,
+                        uint64_t num_records,
+                        std::vector<HTStringKey_t>* views,
+                        std::vector<HTKeyValue_t>* kvs) {
+  const size_t first = kvs->size();
+  views->resize(first + num_records);
+  kvs->resize(first + num_records);
+  for (uint64_t j = 0; j < num_records; j++) {
+    ReadRecord(r, string_keys, &(*views)[first + j], &(*kvs)[first + j]);
+  }
+}
+
+// Returns record j of those read by ReadRecords.
+static HTKeyValue_t RecordAt(bool string_keys,
+                             std::vector<HTStringKey_t>* views,
+                             const std::vector<HTKeyValue_t>& kvs,
+                             size_t j) {
+  HTKeyValue_t kv = kvs[j];
+  if (string_keys) {
+    kv.key = &(*views)[j];
+  }
+  return kv;
+}
+
+// Reads the whole of the file at path into a new[]'d buffer of words, so
+// that the records in it are suitably aligned.  Returns nullptr on error.
+static uint64_t* ReadFile(const char* path, uint64_t* file_bytes) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  long len = -1;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    len = ftell(file);
+  }
+  if (len < static_cast<long>(sizeof(HTDeltaHeader)) || len % 8 != 0 ||
+      fseek(file, 0, SEEK_SET) != 0) {
+    fclose(file);
+    return nullptr;
+  }
+
+  uint64_t* buf = new uint64_t[len / 8];
+  if (fread(buf, 1, len, file) != static_cast<size_t>(len)) {
+    delete[] buf;
+    buf = nullptr;
+  }
+  fclose(file);
+  *file_bytes = static_cast<uint64_t>(len);
+  return buf;
+}
+
+// Checks the header and body checksums, and that every range and record
+// lies within the file and belongs where it claims to.
+static bool DeltaIsValid(const char* bytes, uint64_t file_bytes) {
+  const HTDeltaHeader* hdr = reinterpret_cast<const HTDeltaHeader*>(bytes);
+  if (hdr->magic != k_delta_magic || hdr->version != k_delta_version) {
+    return false;
+  }
+  const uint64_t checksum = TableImage_Checksum(
+      k_image_checksum_seed, hdr, offsetof(HTDeltaHeader, header_checksum));
+  if (checksum != hdr->header_checksum || hdr->file_bytes != file_bytes ||
+      TableImage_Checksum(k_image_checksum_seed, bytes + sizeof(HTDeltaHeader),
+                          file_bytes - sizeof(HTDeltaHeader)) !=
+          hdr->body_checksum) {
+    return false;
+  }
+  if ((hdr->flags & ~(k_image_string_keys | k_delta_full)) != 0 ||
+      hdr->num_buckets == 0 || hdr->range_buckets == 0 ||
+      (hdr->range_buckets & (hdr->range_buckets - 1)) != 0) {
+    return false;
+  }
+
+  const bool string_keys = (hdr->flags & k_image_string_keys) != 0;
+  DeltaReader r{bytes, sizeof(HTDeltaHeader), file_bytes};
+  uint64_t num_records = 0;
+  for (uint64_t i = 0; i < hdr->num_ranges; i++) {
+    HTDeltaRange range;
+    if (!ReadRange(&r, &range) || range.first_bucket >= hdr->num_buckets ||
+        range.first_bucket % hdr->range_buckets != 0) {
+      return false;
+    }
+    for (uint64_t j = 0; j < range.num_records; j++) {
+      HTStringKey_t key_view;
+      HTKeyValue_t kv;
+      if (!ReadRecord(&r, string_keys, &key_view, &kv) ||
+          kv.hash % hdr->num_buckets - range.first_bucket >=
+              hdr->range_buckets) {
+        return false;
+      }
+    }
+    num_records += range.num_records;
+  }
+  return r.pos == file_bytes && num_records == hdr->num_records &&
+         num_records <= k_ct_max_elements;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TableDelta implementation.
+
+bool TableDelta_Write(HashTable* table, const char* path) {
+  HTDirtyMap* dirty = table->dirty;
+  const size_t num_buckets = table->compact != nullptr
+                                 ? table->compact->num_buckets
+                                 : table->num_buckets;
+  const size_t range_buckets = static_cast<size_t>(1) << dirty->range_shift;
+  const bool string_keys =
+      table->compact != nullptr && table->compact->string_keys;
+
+  HTDeltaHeader hdr{};
+  hdr.magic = k_delta_magic;
+  hdr.version = k_delta_version;
+  hdr.flags = (string_keys ? k_image_string_keys : 0) |
+              (dirty->all ? k_delta_full : 0);
+  hdr.base_id = dirty->base_id;
+  hdr.seq = dirty->seq + 1;
+  hdr.num_buckets = num_buckets;
+  hdr.range_buckets = range_buckets;
+
+  // The header goes in last, once the ranges have been counted.
+  ImageWriter w;
+  if (!ImageWriter_Begin(&w, path, sizeof(hdr))) {
+    return false;
+  }
+  for (size_t i = 0; i < dirty->num_ranges; i++) {
+    if (!dirty->all && (dirty->bits[i / 64] >> (i % 64) & 1) == 0) {
+      continue;
+    }
+    const size_t first = i << dirty->range_shift;
+    const size_t last = first + range_buckets < num_buckets
+                            ? first + range_buckets
+                            : num_buckets;
+
+    // Count the range's records first, since they come after its header.
+    HTDeltaRange range{first, 0};
+    for (size_t b = first; b < last; b++) {
+      range.num_records += VisitBucket(table, b, nullptr);
+    }
+    ImageWriter_Write(&w, &range, sizeof(range));
+    for (size_t b = first; b < last; b++) {
+      VisitBucket(table, b, &w);
+    }
+    hdr.num_ranges++;
+    hdr.num_records += range.num_records;
+  }
+
+  hdr.file_bytes = w.offset;
+  hdr.body_checksum = w.checksum;
+  hdr.header_checksum = TableImage_Checksum(
+      k_image_checksum_seed, &hdr, offsetof(HTDeltaHeader, header_checksum));
+  return ImageWriter_Finish(&w, &hdr, sizeof(hdr));
+}
+
+bool TableDelta_Apply(CompactTable** table,
+                      const char* path,
+                      uint64_t base_id,
+                      uint64_t seq) {
+  uint64_t file_bytes = 0;
+  uint64_t* buf = ReadFile(path, &file_bytes);
+  if (buf == nullptr) {
+    return false;
+  }
+  const char* bytes = reinterpret_cast<const char*>(buf);
+  const HTDeltaHeader* hdr = reinterpret_cast<const HTDeltaHeader*>(buf);
+  CompactTable* ct = *table;
+
+  // Validate everything before touching the table, so that a bad delta
+  // never leaves it half-updated.
+  const bool string_keys = (hdr->flags & k_image_string_keys) != 0;
+  const bool full = (hdr->flags & k_delta_full) != 0;
+  if (!DeltaIsValid(bytes, file_bytes) || hdr->base_id != base_id ||
+      hdr->seq != seq || string_keys != ct->string_keys ||
+      (!full && hdr->num_buckets != ct->num_buckets) || ct->read_only) {
+    delete[] buf;
+    return false;
+  }
+
+  DeltaReader r{bytes, sizeof(HTDeltaHeader), file_bytes};
+  HTStringKey_t key_view;
+  HTKeyValue_t kv, old;
+  if (full) {
+    // The delta holds the entire table, laid out over its new buckets.
+    CompactTable* newct =
+        string_keys ? CompactTable_NewStringKeys(hdr->num_buckets)
+                    : CompactTable_New(hdr->num_buckets, ct->key_cmp_fn);
+    newct->multimap = ct->multimap;
+
+    // Adding a record pushes it onto the front of its chain, or of its
+    // key's run in a multimap.  A multimap's records are added in reverse,
+    // so that each run comes back in the order it was written.
+    std::vector<HTStringKey_t> views;
+    std::vector<HTKeyValue_t> kvs;
+    for (uint64_t i = 0; i < hdr->num_ranges; i++) {
+      HTDeltaRange range;
+      ReadRange(&r, &range);
+      if (newct->multimap) {
+        ReadRecords(&r, string_keys, range.num_records, &views, &kvs);
+        continue;
+      }
+      for (uint64_t j = 0; j < range.num_records; j++) {
+        ReadRecord(&r, string_keys, &key_view, &kv);
+        CompactTable_Append(newct, kv);
+      }
+    }
+    for (size_t j = kvs.size(); j > 0; j--) {
+      CompactTable_Append(newct, RecordAt(string_keys, &views, kvs, j - 1));
+    }
+    CompactTable_Delete(ct, nullptr);
+    *table = newct;
+    delete[] buf;
+    return true;
+  }
+
+  // Empty every range first, and only then insert the records.  That way
+  // the table never holds more elements than the writer's did, so it never
+  // resizes (and changes its bucket count) when the writer's didn't.
+  for (uint64_t i = 0; i < hdr->num_ranges; i++) {
+    HTDeltaRange range;
+    ReadRange(&r, &range);
+    const uint64_t last = range.first_bucket + hdr->range_buckets;
+    for (uint64_t b = range.first_bucket; b < last && b < ct->num_buckets;
+         b++) {
+      while (ct->heads[b] != k_ct_nil) {
+        CompactTable_GetEntry(ct, ct->heads[b], &key_view, &kv);
+        CompactTable_Remove(ct, kv.hash, kv.key, &old);
+      }
+    }
+    for (uint64_t j = 0; j < range.num_records; j++) {
+      ReadRecord(&r, string_keys, &key_view, &kv);
+    }
+  }
+  r.pos = sizeof(HTDeltaHeader);
+  std::vector<HTStringKey_t> views;
+  std::vector<HTKeyValue_t> kvs;
+  for (uint64_t i = 0; i < hdr->num_ranges; i++) {
+    HTDeltaRange range;
+    ReadRange(&r, &range);
+    if (ct->multimap) {
+      // As above, each range's records go in in reverse.
+      views.clear();
+      kvs.clear();
+      ReadRecords(&r, string_keys, range.num_records, &views, &kvs);
+      for (size_t j = kvs.size(); j > 0; j--) {
+        CompactTable_Insert(ct, RecordAt(string_keys, &views, kvs, j - 1),
+                            &old);
+      }
+      continue;
+    }
+    for (uint64_t j = 0; j < range.num_records; j++) {
+      ReadRecord(&r, string_keys, &key_view, &kv);
+      CompactTable_Insert(ct, kv, &old);
+    }
+  }
+  delete[] buf;
+  return true;
+}
@@ -0,0 +1,69 @@
+#ifndef TABLEDELTA_PRIV_HPP_
+#define TABLEDELTA_PRIV_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+
+#include "./CompactTable_priv.hpp"
+#include "./HashTable_priv.hpp"
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for incremental checkpoints (see
+// HashTable_CheckpointDelta and HashTable_OpenCheckpoint).
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// A delta file is a header followed by a sequence of ranges.  Each range is
+// an HTDeltaRange followed by num_records records, and each record is an
+// HTKeyValue_t holding the raw hash, key and value words.  In a string-key
+// delta, a record's key word is instead the length of the key, and its
+// bytes follow the record, padded to a multiple of 8.
+//
+// A range holds every element of its buckets, so applying it means
+// emptying those buckets and inserting its records.  A "full" delta (one
+// written after a resize) holds a range for every bucket of the table, and
+// replaces the table outright.
+static constexpr uint64_t k_delta_magic = 0x41544c4454484c4cULL;  // LLHTDLTA
+static constexpr uint32_t k_delta_version = 1;
+
+// Bits in HTDeltaHeader.flags, alongside k_image_string_keys.
+static constexpr uint32_t k_delta_full = 2;
+
+typedef struct ht_delta_header {
+  uint64_t magic;            // k_delta_magic
+  uint32_t version;          // k_delta_version
+  uint32_t flags;            // k_image_string_keys and k_delta_* bits
+  uint64_t base_id;          // image id of the snapshot this delta follows
+  uint64_t seq;              // 1 for the first delta after the snapshot, etc.
+  uint64_t num_buckets;      // the table's bucket count when written
+  uint64_t range_buckets;    // # of buckets per range (a power of two)
+  uint64_t num_ranges;       // # of ranges in the file
+  uint64_t num_records;      // # of records in all ranges
+  uint64_t file_bytes;       // the total size of the file
+  uint64_t body_checksum;    // TableImage_Checksum of [sizeof(header), file_bytes)
+  uint64_t header_checksum;  // TableImage_Checksum of all of the fields above
+} HTDeltaHeader;
+static_assert(sizeof(HTDeltaHeader) % 8 == 0, "ranges must stay aligned");
+
+typedef struct ht_delta_range {
+  uint64_t first_bucket;  // a multiple of range_buckets
+  uint64_t num_records;   // # of records that follow
+} HTDeltaRange;
+
+// Writes every range of table that table->dirty marks as dirty (or every
+// range, if the table has been resized) to path, as delta number
+// table->dirty->seq + 1.  Doesn't change the tracking state.  Returns false
+// on an I/O error.
+bool TableDelta_Write(HashTable* table, const char* path);
+
+// Reads the delta at path and applies it to *table, which may be replaced
+// by a new table.  The delta must be number seq after the snapshot with
+// image id base_id.  Returns false, leaving *table untouched, if the delta
+// can't be read, fails validation, or doesn't follow on from *table.
+bool TableDelta_Apply(CompactTable** table,
+                      const char* path,
+                      uint64_t base_id,
+                      uint64_t seq);
+
+#endif  // TABLEDELTA_PRIV_HPP_
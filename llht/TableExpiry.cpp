@@ -0,0 +1,314 @@
+#include <chrono>
+#include <cstdint>
+
+#include "CompactTable_priv.hpp"
+#include "HashTable.hpp"
+#include "HashTable_priv.hpp"
+#include "IntrusiveList.hpp"
+#include "IntrusiveList_priv.hpp"
+#include "TableExpiry_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The clock used if the customer doesn't supply one.
+static uint64_t SteadyMillis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Sets, clears and tests a slot's bit in a level's bitmap.
+static void MarkOccupied(HTExpiry* expiry, int level, int slot) {
+  expiry->occupied[level][slot / 64] |= static_cast<uint64_t>(1)
+                                        << (slot % 64);
+}
+
+static void MarkEmpty(HTExpiry* expiry, int level, int slot) {
+  expiry->occupied[level][slot / 64] &= ~(static_cast<uint64_t>(1)
+                                          << (slot % 64));
+}
+
+static bool IsOccupied(HTExpiry* expiry, int level, int slot) {
+  return (expiry->occupied[level][slot / 64] >> (slot % 64)) & 1;
+}
+
+// Returns the first occupied slot on a level after slot "after", or -1 if
+// there is none.
+static int NextOccupied(HTExpiry* expiry, int level, int after) {
+  const int first = after + 1;
+  for (int word = first / 64; word < k_ht_wheel_words; word++) {
+    uint64_t bits = expiry->occupied[level][word];
+    if (word == first / 64) {
+      bits &= ~static_cast<uint64_t>(0) << (first % 64);
+    }
+    if (bits != 0) {
+      return word * 64 + __builtin_ctzll(bits);
+    }
+  }
+  return -1;
+}
+
+static HTTimer* TimerOf(ILLink* link) {
+  return IL_CONTAINER_OF(link, HTTimer, link);
+}
+
+// The number of ticks spanned by the whole wheel.
+static constexpr int k_wheel_span_bits = k_ht_wheel_bits * k_ht_wheel_levels;
+
+// Queues a timer according to its deadline and the wheel's time.
+static void Queue(HTExpiry* expiry, HTTimer* timer) {
+  const uint64_t deadline = timer->deadline;
+  timer->level = -1;
+  if (deadline <= expiry->now) {
+    IntrusiveList_Append(expiry->overdue, &timer->link);
+    return;
+  }
+
+  // The lowest level on which the deadline falls in the same span as now.
+  for (int level = 0; level < k_ht_wheel_levels; level++) {
+    const int span_shift = k_ht_wheel_bits * (level + 1);
+    if ((deadline >> span_shift) == (expiry->now >> span_shift)) {
+      const int slot =
+          (deadline >> (k_ht_wheel_bits * level)) & (k_ht_wheel_slots - 1);
+      timer->level = level;
+      timer->slot = slot;
+      IntrusiveList_Append(expiry->slots[level][slot], &timer->link);
+      MarkOccupied(expiry, level, slot);
+      return;
+    }
+  }
+  IntrusiveList_Append(expiry->later, &timer->link);
+}
+
+// Takes a timer off whichever slot or list it is queued on.
+static void Dequeue(HTExpiry* expiry, HTTimer* timer) {
+  IntrusiveList_Remove(&timer->link);
+  if (timer->level >= 0 &&
+      IntrusiveList_NumElements(expiry->slots[timer->level][timer->slot]) ==
+          0) {
+    MarkEmpty(expiry, timer->level, timer->slot);
+  }
+}
+
+// Returns the earliest tick after the wheel's time at which a slot needs
+// handling: a level-0 slot comes due, a higher slot needs requeueing, or
+// the wheel wraps round with timers waiting beyond it.  Returns UINT64_MAX
+// if no timers are queued.
+static uint64_t NextEvent(HTExpiry* expiry) {
+  uint64_t next = UINT64_MAX;
+  for (int level = 0; level < k_ht_wheel_levels; level++) {
+    const int shift = k_ht_wheel_bits * level;
+    const int current = (expiry->now >> shift) & (k_ht_wheel_slots - 1);
+    const int slot = NextOccupied(expiry, level, current);
+    if (slot >= 0) {
+      const int span_shift = shift + k_ht_wheel_bits;
+      const uint64_t tick = ((expiry->now >> span_shift) << span_shift) |
+                            (static_cast<uint64_t>(slot) << shift);
+      if (tick < next) {
+        next = tick;
+      }
+    }
+  }
+  if (IntrusiveList_NumElements(expiry->later) > 0) {
+    const uint64_t wrap = ((expiry->now >> k_wheel_span_bits) + 1)
+                          << k_wheel_span_bits;
+    if (wrap < next) {
+      next = wrap;
+    }
+  }
+  return next;
+}
+
+// Moves every timer in a list back through Queue.  Timers requeued from a
+// slot always land on a lower level (or in overdue), but those requeued
+// from later may land back in it, so only as many as were there to begin
+// with are taken.
+static void Requeue(HTExpiry* expiry, IntrusiveList* list) {
+  ILLink* link;
+  for (size_t n = IntrusiveList_NumElements(list); n > 0; n--) {
+    IntrusiveList_Pop(list, &link);
+    Queue(expiry, TimerOf(link));
+  }
+}
+
+// Starts loading what removing the entries of the timers after link will
+// touch.  Expiring entries are scattered all over the table, and each
+// removal is a chain of dependent loads (timer, entry, bucket head, chain
+// links), so the next three timers are each warmed up one stage further
+// along that chain.  These are only hints: a removal can move an entry
+// that a later timer refers to.
+static void PrefetchAfter(CompactTable* ct, const ILLink* link) {
+  const ILLink* second = link->next;
+  if (second == nullptr) {
+    return;
+  }
+  const HTTimer* timer = TimerOf(const_cast<ILLink*>(second));
+  const HTHash_t hash = ct->entries[timer->index].hash;
+  __builtin_prefetch(&ct->heads[hash % ct->num_buckets]);
+  const ILLink* third = second->next;
+  if (third == nullptr) {
+    return;
+  }
+  timer = TimerOf(const_cast<ILLink*>(third));
+  __builtin_prefetch(&ct->entries[timer->index]);
+  __builtin_prefetch(&ct->timers[timer->index]);
+  if (third->next != nullptr) {
+    __builtin_prefetch(third->next);
+  }
+}
+
+// Removes the entry of every timer in list, each of which is due, and
+// frees it.  Returns the number removed.
+static size_t Fire(HashTable* table, HTExpiry* expiry, IntrusiveList* list) {
+  CompactTable* ct = table->compact;
+  size_t count = 0;
+  while (list->head != nullptr) {
+    ILLink* link = list->head;
+    PrefetchAfter(ct, link);
+    IntrusiveList_Remove(link);
+    HTTimer* timer = TimerOf(link);
+    const uint32_t idx = timer->index;
+    ct->timers[idx] = nullptr;
+    expiry->num_timers--;
+    delete timer;
+
+    HTStringKey_t key_view;
+    HTKeyValue_t removed;
+    HashTable_RemoveIndex(table, idx, &key_view, &removed);
+    expiry->kv_free_fn(removed);
+    count++;
+  }
+  return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TableExpiry implementation.
+
+HTExpiry* TableExpiry_New(HTClockFnPtr clock,
+                          KeyValueFreeFnPtr kv_free_function,
+                          uint64_t now) {
+  HTExpiry* expiry = new HTExpiry{};
+  expiry->clock = (clock != nullptr) ? clock : &SteadyMillis;
+  expiry->kv_free_fn = kv_free_function;
+  expiry->now = now;
+  expiry->num_timers = 0;
+  expiry->later = IntrusiveList_New();
+  expiry->overdue = IntrusiveList_New();
+  for (int level = 0; level < k_ht_wheel_levels; level++) {
+    for (int slot = 0; slot < k_ht_wheel_slots; slot++) {
+      expiry->slots[level][slot] = IntrusiveList_New();
+    }
+    for (int word = 0; word < k_ht_wheel_words; word++) {
+      expiry->occupied[level][word] = 0;
+    }
+  }
+  return expiry;
+}
+
+static void DeleteTimer(ILLink* link) {
+  delete TimerOf(link);
+}
+
+void TableExpiry_Delete(HTExpiry* expiry) {
+  for (int level = 0; level < k_ht_wheel_levels; level++) {
+    for (int slot = 0; slot < k_ht_wheel_slots; slot++) {
+      IntrusiveList_Delete(expiry->slots[level][slot], &DeleteTimer);
+    }
+  }
+  IntrusiveList_Delete(expiry->later, &DeleteTimer);
+  IntrusiveList_Delete(expiry->overdue, &DeleteTimer);
+  delete expiry;
+}
+
+void TableExpiry_SetAt(HTExpiry* expiry,
+                       CompactTable* table,
+                       uint32_t idx,
+                       uint64_t deadline) {
+  HTTimer* timer = table->timers[idx];
+  if (timer != nullptr) {
+    Dequeue(expiry, timer);
+  }
+  if (deadline == k_ht_no_deadline) {
+    if (timer != nullptr) {
+      table->timers[idx] = nullptr;
+      expiry->num_timers--;
+      delete timer;
+    }
+    return;
+  }
+
+  if (timer == nullptr) {
+    timer = new HTTimer();
+    timer->index = idx;
+    ILLink_Init(&timer->link);
+    table->timers[idx] = timer;
+    expiry->num_timers++;
+  }
+  timer->deadline = deadline;
+  Queue(expiry, timer);
+}
+
+bool TableExpiry_Find(HTExpiry* expiry,
+                      CompactTable* table,
+                      HTHash_t hash,
+                      HTKey_t key,
+                      HTKeyValue_t* keyvalue) {
+  const uint32_t idx = CompactTable_IndexOf(table, hash, key);
+  if (idx == k_ct_nil) {
+    return false;
+  }
+  // Only entries with a timer need the clock read.
+  const HTTimer* timer = table->timers[idx];
+  if (timer != nullptr && timer->deadline <= expiry->clock()) {
+    return false;
+  }
+  HTStringKey_t key_view;
+  CompactTable_GetEntry(table, idx, &key_view, keyvalue);
+  if (table->string_keys) {
+    keyvalue->key = key;
+  }
+  CompactTable_Touch(table, idx);
+  return true;
+}
+
+size_t TableExpiry_Advance(HashTable* table, uint64_t now) {
+  HTExpiry* expiry = table->expiry;
+  size_t count = Fire(table, expiry, expiry->overdue);
+
+  // Jump from one occupied slot to the next, rather than tick by tick.
+  for (;;) {
+    const uint64_t tick = NextEvent(expiry);
+    if (tick > now) {
+      break;
+    }
+    expiry->now = tick;
+
+    // Requeue from the top down, so that timers trickle all the way down
+    // to the slot due now (or straight into overdue, if due at tick).  A
+    // slot that is entirely due by now is expired without requeueing.
+    if ((tick & ((static_cast<uint64_t>(1) << k_wheel_span_bits) - 1)) == 0) {
+      Requeue(expiry, expiry->later);
+    }
+    for (int level = k_ht_wheel_levels - 1; level >= 0; level--) {
+      const int shift = k_ht_wheel_bits * level;
+      const uint64_t span = static_cast<uint64_t>(1) << shift;
+      const int slot = (tick >> shift) & (k_ht_wheel_slots - 1);
+      if ((tick & (span - 1)) != 0 || !IsOccupied(expiry, level, slot)) {
+        continue;
+      }
+      MarkEmpty(expiry, level, slot);
+      if (tick + (span - 1) <= now) {
+        count += Fire(table, expiry, expiry->slots[level][slot]);
+      } else {
+        Requeue(expiry, expiry->slots[level][slot]);
+      }
+    }
+    count += Fire(table, expiry, expiry->overdue);
+  }
+  if (now > expiry->now) {
+    expiry->now = now;
+  }
+  return count;
+}
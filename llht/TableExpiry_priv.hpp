@@ -0,0 +1,97 @@
+#ifndef TABLEEXPIRY_PRIV_HPP_
+#define TABLEEXPIRY_PRIV_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./CompactTable_priv.hpp"
+#include "./HashTable.hpp"
+#include "./IntrusiveList.hpp"
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for a HashTable's per-entry
+// expiry (see HashTable_EnableExpiry).
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The timer wheel has k_ht_wheel_levels levels of 2^k_ht_wheel_bits slots.
+// A slot on level L spans 2^(k_ht_wheel_bits * L) ticks of the clock, so
+// the levels between them cover deadlines up to 2^32 ticks away (about 49
+// days in milliseconds); later ones wait in a separate list.  Wide levels
+// mean that timers are requeued onto lower levels less often.
+static constexpr int k_ht_wheel_bits = 8;
+static constexpr int k_ht_wheel_slots = 1 << k_ht_wheel_bits;
+static constexpr int k_ht_wheel_levels = 4;
+static constexpr int k_ht_wheel_words = k_ht_wheel_slots / 64;
+
+// An entry's timer.
+//
+// A compact table with expiry keeps an array of timer pointers parallel to
+// its entries (see CompactTable.timers), holding nullptr for entries
+// without one.  Moving an entry moves its timer pointer and updates the
+// timer's index to match.
+typedef struct ht_timer {
+  uint64_t deadline;  // the entry expires once the clock reaches this
+  uint32_t index;     // the entry's index in the table
+  int level;          // the wheel level it is queued on, or -1 if not
+  int slot;           // the slot on that level
+  ILLink link;        // its link in that slot (or list)
+} HTTimer;
+
+// The timer wheel.
+//
+// A timer on level L is due in the same level-(L+1) slot as "now" (or
+// the same span of the whole wheel, for the top level), in a later
+// level-L slot than now.  When now reaches the start of that slot, the
+// slot's timers are requeued on lower levels, and so on down to level 0,
+// whose slots each hold the timers due at a single tick; or, if the whole
+// of the slot is already due, they are expired straight away.  A bitmap
+// per level tracks which slots are occupied, so that advancing the wheel
+// skips straight to the next occupied slot.
+typedef struct ht_expiry {
+  HTClockFnPtr clock;            // reads the current time
+  KeyValueFreeFnPtr kv_free_fn;  // frees entries as they expire
+  uint64_t now;                  // every timer due by now has fired
+  size_t num_timers;             // # of timers queued
+  IntrusiveList* later;          // timers beyond the top level
+  IntrusiveList* overdue;        // timers already due when queued
+
+  // Each level's slots, and a bitmap of which of them hold timers.
+  IntrusiveList* slots[k_ht_wheel_levels][k_ht_wheel_slots];
+  uint64_t occupied[k_ht_wheel_levels][k_ht_wheel_words];
+} HTExpiry;
+
+// Allocates a timer wheel whose time starts at now.
+HTExpiry* TableExpiry_New(HTClockFnPtr clock,
+                          KeyValueFreeFnPtr kv_free_function,
+                          uint64_t now);
+
+// Frees a timer wheel and every timer queued on it.
+void TableExpiry_Delete(HTExpiry* expiry);
+
+// The deadline of an entry without a timer.
+static constexpr uint64_t k_ht_no_deadline = UINT64_MAX;
+
+// Gives entry idx of table an expiry deadline, replacing any it had, or
+// (if deadline is k_ht_no_deadline) cancels its timer.
+void TableExpiry_SetAt(HTExpiry* expiry,
+                       CompactTable* table,
+                       uint32_t idx,
+                       uint64_t deadline);
+
+// The same contract as CompactTable_Find, except that an entry whose
+// deadline has passed by the clock's reading is treated as missing.
+bool TableExpiry_Find(HTExpiry* expiry,
+                      CompactTable* table,
+                      HTHash_t hash,
+                      HTKey_t key,
+                      HTKeyValue_t* keyvalue);
+
+// Advances the wheel of table (which must have expiry enabled) to now,
+// removing and freeing every entry due by then.  Returns the number of
+// entries removed.
+size_t TableExpiry_Advance(HashTable* table, uint64_t now);
+
+#endif  // TABLEEXPIRY_PRIV_HPP_
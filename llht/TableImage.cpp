@@ -0,0 +1,505 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "CompactTable_priv.hpp"
+#include "PerfectHash_priv.hpp"
+#include "TableImage_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// The number of entries rewritten at a time while saving a string-key table.
+static constexpr size_t k_entry_chunk = 1024;
+
+static constexpr uint64_t k_checksum_prime = 0x100000001b3ULL;
+
+// Rounds n up to a multiple of 8.
+static uint64_t Align8(uint64_t n) {
+  return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Writes the entries array.  A string-key table's arena may contain the
+// leftovers of removed keys, so for those we write the entries with their
+// key offsets rewritten as if the arena had just been compacted; the
+// arena itself is then written by WriteLiveKeys.
+static void WriteEntries(ImageWriter* w, CompactTable* ct) {
+  if (!ct->string_keys) {
+    ImageWriter_Write(w, ct->entries, ct->num_elements * sizeof(HTKeyValue_t));
+    return;
+  }
+
+  HTKeyValue_t chunk[k_entry_chunk];
+  uint64_t arena_offset = 0;
+  for (size_t i = 0; i < ct->num_elements; i += k_entry_chunk) {
+    const size_t n = ct->num_elements - i < k_entry_chunk
+                         ? ct->num_elements - i
+                         : k_entry_chunk;
+    for (size_t j = 0; j < n; j++) {
+      const uint64_t packed = reinterpret_cast<uint64_t>(ct->entries[i + j].key);
+      const uint64_t len = packed & k_ct_max_key_len;
+      chunk[j] = ct->entries[i + j];
+      chunk[j].key = reinterpret_cast<HTKey_t>(
+          (arena_offset << k_ct_key_len_bits) | len);
+      arena_offset += len;
+    }
+    ImageWriter_Write(w, chunk, n * sizeof(HTKeyValue_t));
+  }
+}
+
+// Writes the bytes of every current key, in entry order.
+static void WriteLiveKeys(ImageWriter* w, CompactTable* ct) {
+  for (size_t i = 0; i < ct->num_elements; i++) {
+    const uint64_t packed = reinterpret_cast<uint64_t>(ct->entries[i].key);
+    ImageWriter_Write(w, ct->arena + (packed >> k_ct_key_len_bits),
+               packed & k_ct_max_key_len);
+  }
+}
+
+// Returns true iff the section [offset, offset + len) lies within a file of
+// file_bytes bytes, after the header, and starts on an 8-byte boundary.
+static bool SectionFits(uint64_t offset, uint64_t len, uint64_t file_bytes) {
+  return offset % 8 == 0 && offset >= sizeof(HTImageHeader) &&
+         offset <= file_bytes && len <= file_bytes - offset;
+}
+
+// Checks everything about the header that can be checked without touching
+// the rest of the image.
+static bool HeaderIsValid(const HTImageHeader* hdr, uint64_t file_bytes) {
+  if (hdr->magic != k_image_magic || hdr->version != k_image_version) {
+    return false;
+  }
+  const uint64_t checksum = TableImage_Checksum(
+      k_image_checksum_seed, hdr, offsetof(HTImageHeader, header_checksum));
+  if (checksum != hdr->header_checksum || hdr->file_bytes != file_bytes) {
+    return false;
+  }
+  if ((hdr->flags & ~(k_image_string_keys | k_image_multimap)) != 0 ||
+      hdr->num_buckets == 0 || hdr->num_elements > k_ct_max_elements) {
+    return false;
+  }
+
+  // Guard the size computations below against overflow.
+  if (hdr->num_buckets > file_bytes || hdr->num_elements > file_bytes) {
+    return false;
+  }
+  return SectionFits(hdr->heads_offset, hdr->num_buckets * sizeof(uint32_t),
+                     file_bytes) &&
+         SectionFits(hdr->links_offset, hdr->num_elements * sizeof(CTLink),
+                     file_bytes) &&
+         SectionFits(hdr->entries_offset,
+                     hdr->num_elements * sizeof(HTKeyValue_t), file_bytes) &&
+         SectionFits(hdr->arena_offset, hdr->arena_bytes, file_bytes);
+}
+
+// Returns true iff key is a packed string key whose bytes lie within an
+// arena of arena_bytes bytes.
+static bool KeyFits(HTKey_t key, uint64_t arena_bytes) {
+  const uint64_t packed = reinterpret_cast<uint64_t>(key);
+  const uint64_t offset = packed >> k_ct_key_len_bits;
+  const uint64_t len = packed & k_ct_max_key_len;
+  return offset <= arena_bytes && len <= arena_bytes - offset;
+}
+
+// Checks that every index and key offset in a mapped table is in range.
+// This touches every page of the image.
+static bool StructureIsValid(CompactTable* ct) {
+  for (size_t i = 0; i < ct->num_buckets; i++) {
+    if (ct->heads[i] != k_ct_nil && ct->heads[i] >= ct->num_elements) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < ct->num_elements; i++) {
+    if (ct->links[i].next != k_ct_nil && ct->links[i].next >= ct->num_elements) {
+      return false;
+    }
+    if (ct->string_keys && !KeyFits(ct->entries[i].key, ct->arena_used)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes the image of a frozen table, whose arrays need no rewriting.
+static bool WriteFrozen(CompactTable* table,
+                        const char* path,
+                        uint64_t* image_id,
+                        bool sync) {
+  const CTPerfectHash* mph = table->mph;
+  const uint64_t remap_len = mph->num_slots - mph->num_keys;
+  HTFrozenHeader hdr{};
+  hdr.magic = k_frozen_image_magic;
+  hdr.version = k_frozen_image_version;
+  hdr.flags = table->string_keys ? k_image_string_keys : 0;
+  hdr.num_elements = table->num_elements;
+  hdr.num_slots = mph->num_slots;
+  hdr.num_buckets = mph->num_buckets;
+  hdr.seed = mph->seed;
+  hdr.pilots_offset = sizeof(HTFrozenHeader);
+  hdr.remap_offset =
+      Align8(hdr.pilots_offset + mph->num_buckets * sizeof(uint32_t));
+  hdr.entries_offset = Align8(hdr.remap_offset + remap_len * sizeof(uint32_t));
+  hdr.arena_offset =
+      hdr.entries_offset + table->num_elements * sizeof(HTKeyValue_t);
+  hdr.arena_bytes = table->string_keys ? table->arena_used : 0;
+  hdr.file_bytes = Align8(hdr.arena_offset + hdr.arena_bytes);
+
+  ImageWriter w;
+  if (!ImageWriter_Begin(&w, path, sizeof(hdr))) {
+    return false;
+  }
+  w.sync = sync;
+  ImageWriter_Write(&w, mph->pilots, mph->num_buckets * sizeof(uint32_t));
+  ImageWriter_Pad(&w);
+  ImageWriter_Write(&w, mph->remap, remap_len * sizeof(uint32_t));
+  ImageWriter_Pad(&w);
+  ImageWriter_Write(&w, table->entries,
+                    table->num_elements * sizeof(HTKeyValue_t));
+  ImageWriter_Write(&w, table->arena, hdr.arena_bytes);
+  ImageWriter_Pad(&w);
+
+  hdr.body_checksum = w.checksum;
+  hdr.header_checksum = TableImage_Checksum(
+      k_image_checksum_seed, &hdr, offsetof(HTFrozenHeader, header_checksum));
+  if (!ImageWriter_Finish(&w, &hdr, sizeof(hdr))) {
+    return false;
+  }
+  if (image_id != nullptr) {
+    *image_id = hdr.header_checksum;
+  }
+  return true;
+}
+
+// As HeaderIsValid, for the header of a frozen image.
+static bool FrozenHeaderIsValid(const HTFrozenHeader* hdr,
+                                uint64_t file_bytes) {
+  if (file_bytes < sizeof(HTFrozenHeader) ||
+      hdr->version != k_frozen_image_version) {
+    return false;
+  }
+  const uint64_t checksum = TableImage_Checksum(
+      k_image_checksum_seed, hdr, offsetof(HTFrozenHeader, header_checksum));
+  if (checksum != hdr->header_checksum || hdr->file_bytes != file_bytes) {
+    return false;
+  }
+  if ((hdr->flags & ~k_image_string_keys) != 0 ||
+      hdr->num_buckets < k_mph_min_buckets ||
+      hdr->num_elements > k_ct_max_elements ||
+      hdr->num_slots < hdr->num_elements) {
+    return false;
+  }
+
+  // Guard the size computations below against overflow.
+  if (hdr->num_buckets > file_bytes || hdr->num_slots > file_bytes) {
+    return false;
+  }
+  return SectionFits(hdr->pilots_offset, hdr->num_buckets * sizeof(uint32_t),
+                     file_bytes) &&
+         SectionFits(hdr->remap_offset,
+                     (hdr->num_slots - hdr->num_elements) * sizeof(uint32_t),
+                     file_bytes) &&
+         SectionFits(hdr->entries_offset,
+                     hdr->num_elements * sizeof(HTKeyValue_t), file_bytes) &&
+         SectionFits(hdr->arena_offset, hdr->arena_bytes, file_bytes);
+}
+
+// As StructureIsValid, for a mapped frozen table.  Any pilot gives a slot
+// in range, so only the remap array and the keys need checking.
+static bool FrozenStructureIsValid(CompactTable* ct) {
+  const CTPerfectHash* mph = ct->mph;
+  for (size_t i = 0; i < mph->num_slots - mph->num_keys; i++) {
+    if (mph->remap[i] >= mph->num_keys) {
+      return false;
+    }
+  }
+  if (ct->string_keys) {
+    for (size_t i = 0; i < ct->num_elements; i++) {
+      if (!KeyFits(ct->entries[i].key, ct->arena_used)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The second half of TableImage_Map, for a frozen image mapped at base.
+static CompactTable* MapFrozen(void* base,
+                               size_t map_bytes,
+                               KeyCmpFnPtr key_compare_function,
+                               bool verify,
+                               uint64_t* image_id) {
+  const HTFrozenHeader* hdr = static_cast<const HTFrozenHeader*>(base);
+  char* bytes = static_cast<char*>(base);
+  if (!FrozenHeaderIsValid(hdr, map_bytes) ||
+      (verify && TableImage_Checksum(k_image_checksum_seed,
+                                     bytes + sizeof(HTFrozenHeader),
+                                     map_bytes - sizeof(HTFrozenHeader)) !=
+                     hdr->body_checksum)) {
+    munmap(base, map_bytes);
+    return nullptr;
+  }
+
+  CTPerfectHash* mph = new CTPerfectHash{};
+  mph->num_keys = hdr->num_elements;
+  mph->num_slots = hdr->num_slots;
+  mph->num_buckets = hdr->num_buckets;
+  mph->seed = hdr->seed;
+  mph->pilots = reinterpret_cast<uint32_t*>(bytes + hdr->pilots_offset);
+  mph->remap = reinterpret_cast<uint32_t*>(bytes + hdr->remap_offset);
+
+  CompactTable* ct = new CompactTable{};
+  ct->num_elements = hdr->num_elements;
+  ct->capacity = hdr->num_elements;
+  ct->entries = reinterpret_cast<HTKeyValue_t*>(bytes + hdr->entries_offset);
+  ct->key_cmp_fn = key_compare_function;
+  ct->string_keys = (hdr->flags & k_image_string_keys) != 0;
+  ct->arena = ct->string_keys ? bytes + hdr->arena_offset : nullptr;
+  ct->arena_used = hdr->arena_bytes;
+  ct->arena_capacity = hdr->arena_bytes;
+  ct->arena_live = hdr->arena_bytes;
+  ct->map_base = base;
+  ct->map_bytes = map_bytes;
+  ct->read_only = true;
+  ct->order_head = k_ct_nil;
+  ct->order_tail = k_ct_nil;
+  ct->mph = mph;
+
+  if (verify && !FrozenStructureIsValid(ct)) {
+    CompactTable_Delete(ct, nullptr);
+    return nullptr;
+  }
+  if (image_id != nullptr) {
+    *image_id = hdr->header_checksum;
+  }
+  return ct;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TableImage implementation.
+
+void ImageWriter_Write(ImageWriter* w, const void* buf, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  if (fwrite(buf, 1, len, w->file) != len) {
+    w->ok = false;
+  }
+  w->offset += len;
+
+  // Pieces of the body can be any length, so we hold back any partial word
+  // until the next write completes it.
+  const unsigned char* bp = static_cast<const unsigned char*>(buf);
+  if (w->carry_len > 0) {
+    while (len > 0 && w->carry_len < sizeof(w->carry)) {
+      w->carry[w->carry_len++] = *bp++;
+      len--;
+    }
+    if (w->carry_len < sizeof(w->carry)) {
+      return;
+    }
+    w->checksum = TableImage_Checksum(w->checksum, w->carry, sizeof(w->carry));
+    w->carry_len = 0;
+  }
+  const size_t whole = len - len % sizeof(w->carry);
+  w->checksum = TableImage_Checksum(w->checksum, bp, whole);
+  memcpy(w->carry, bp + whole, len - whole);
+  w->carry_len = len - whole;
+}
+
+void ImageWriter_Pad(ImageWriter* w) {
+  static constexpr char k_zeros[8] = {0};
+  ImageWriter_Write(w, k_zeros, Align8(w->offset) - w->offset);
+}
+
+bool ImageWriter_Begin(ImageWriter* w, const char* path, size_t header_bytes) {
+  // Write to a temporary file and rename it into place, so that a crash
+  // halfway through never leaves a truncated file behind.
+  w->path = path;
+  w->tmp_path = std::string(path) + ".tmp";
+  w->file = fopen(w->tmp_path.c_str(), "wb");
+  if (w->file == nullptr) {
+    return false;
+  }
+  w->offset = header_bytes;
+  w->checksum = k_image_checksum_seed;
+  w->carry_len = 0;
+  w->sync = true;
+  w->ok = fseek(w->file, static_cast<long>(header_bytes), SEEK_SET) == 0;
+  return true;
+}
+
+bool ImageWriter_Finish(ImageWriter* w, const void* header,
+                        size_t header_bytes) {
+  if (fseek(w->file, 0, SEEK_SET) != 0 ||
+      fwrite(header, header_bytes, 1, w->file) != 1) {
+    w->ok = false;
+  }
+  if (fflush(w->file) != 0 || (w->sync && fsync(fileno(w->file)) != 0)) {
+    w->ok = false;
+  }
+  if (fclose(w->file) != 0) {
+    w->ok = false;
+  }
+  w->file = nullptr;
+
+  if (!w->ok || rename(w->tmp_path.c_str(), w->path) != 0) {
+    remove(w->tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+uint64_t TableImage_Checksum(uint64_t seed, const void* buf, size_t len) {
+  // This is FNV-1a, but consuming 8 bytes per multiply instead of one.
+  const unsigned char* bp = static_cast<const unsigned char*>(buf);
+  uint64_t hval = seed;
+
+  while (len >= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bp, sizeof(word));
+    hval ^= word;
+    hval *= k_checksum_prime;
+    bp += sizeof(word);
+    len -= sizeof(word);
+  }
+  while (len > 0) {
+    hval ^= static_cast<uint64_t>(*bp++);
+    hval *= k_checksum_prime;
+    len--;
+  }
+  return hval;
+}
+
+bool TableImage_Write(CompactTable* table,
+                      const char* path,
+                      uint64_t* image_id,
+                      bool sync) {
+  if (table->mph != nullptr) {
+    return WriteFrozen(table, path, image_id, sync);
+  }
+
+  // Lay the file out.
+  HTImageHeader hdr{};
+  hdr.magic = k_image_magic;
+  hdr.version = k_image_version;
+  hdr.flags = (table->string_keys ? k_image_string_keys : 0) |
+              (table->multimap ? k_image_multimap : 0);
+  hdr.num_buckets = table->num_buckets;
+  hdr.num_elements = table->num_elements;
+  hdr.heads_offset = sizeof(HTImageHeader);
+  hdr.links_offset =
+      Align8(hdr.heads_offset + table->num_buckets * sizeof(uint32_t));
+  hdr.entries_offset = hdr.links_offset + table->num_elements * sizeof(CTLink);
+  hdr.arena_offset =
+      hdr.entries_offset + table->num_elements * sizeof(HTKeyValue_t);
+  hdr.arena_bytes = table->string_keys ? table->arena_live : 0;
+  hdr.file_bytes = Align8(hdr.arena_offset + hdr.arena_bytes);
+
+  // The header goes in last, once we know the body's checksum.
+  ImageWriter w;
+  if (!ImageWriter_Begin(&w, path, sizeof(hdr))) {
+    return false;
+  }
+  w.sync = sync;
+  ImageWriter_Write(&w, table->heads, table->num_buckets * sizeof(uint32_t));
+  ImageWriter_Pad(&w);
+  ImageWriter_Write(&w, table->links, table->num_elements * sizeof(CTLink));
+  WriteEntries(&w, table);
+  if (table->string_keys) {
+    WriteLiveKeys(&w, table);
+  }
+  ImageWriter_Pad(&w);
+
+  // The body is padded to a whole number of words, so nothing is left over.
+  hdr.body_checksum = w.checksum;
+  hdr.header_checksum = TableImage_Checksum(
+      k_image_checksum_seed, &hdr, offsetof(HTImageHeader, header_checksum));
+  if (!ImageWriter_Finish(&w, &hdr, sizeof(hdr))) {
+    return false;
+  }
+  if (image_id != nullptr) {
+    *image_id = hdr.header_checksum;
+  }
+  return true;
+}
+
+CompactTable* TableImage_Map(const char* path,
+                             KeyCmpFnPtr key_compare_function,
+                             bool writable,
+                             bool verify,
+                             uint64_t* image_id) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st{};
+  if (fstat(fd, &st) != 0 ||
+      static_cast<uint64_t>(st.st_size) < sizeof(HTImageHeader)) {
+    close(fd);
+    return nullptr;
+  }
+
+  // A private mapping means writes are copied on write, a page at a time,
+  // and never make it back to the file.
+  const size_t map_bytes = static_cast<size_t>(st.st_size);
+  const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* base = mmap(nullptr, map_bytes, prot, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+
+  const HTImageHeader* hdr = static_cast<const HTImageHeader*>(base);
+  const char* bytes = static_cast<const char*>(base);
+  if (hdr->magic == k_frozen_image_magic) {
+    return MapFrozen(base, map_bytes, key_compare_function, verify, image_id);
+  }
+  if (!HeaderIsValid(hdr, map_bytes) ||
+      (verify && TableImage_Checksum(k_image_checksum_seed,
+                                     bytes + sizeof(HTImageHeader),
+                                     map_bytes - sizeof(HTImageHeader)) !=
+                     hdr->body_checksum)) {
+    munmap(base, map_bytes);
+    return nullptr;
+  }
+
+  // Point a table at the arrays, in place.  There's no spare capacity, so
+  // the first insert of a new key copies the entries onto the heap.
+  char* mutable_bytes = static_cast<char*>(base);
+  CompactTable* ct = new CompactTable{};
+  ct->num_buckets = hdr->num_buckets;
+  ct->num_elements = hdr->num_elements;
+  ct->capacity = hdr->num_elements;
+  ct->heads = reinterpret_cast<uint32_t*>(mutable_bytes + hdr->heads_offset);
+  ct->links = reinterpret_cast<CTLink*>(mutable_bytes + hdr->links_offset);
+  ct->entries =
+      reinterpret_cast<HTKeyValue_t*>(mutable_bytes + hdr->entries_offset);
+  ct->key_cmp_fn = key_compare_function;
+  ct->string_keys = (hdr->flags & k_image_string_keys) != 0;
+  ct->multimap = (hdr->flags & k_image_multimap) != 0;
+  ct->arena = ct->string_keys ? mutable_bytes + hdr->arena_offset : nullptr;
+  ct->arena_used = hdr->arena_bytes;
+  ct->arena_capacity = hdr->arena_bytes;
+  ct->arena_live = hdr->arena_bytes;
+  ct->map_base = base;
+  ct->map_bytes = map_bytes;
+  ct->read_only = !writable;
+
+  if (verify && !StructureIsValid(ct)) {
+    CompactTable_Delete(ct, nullptr);
+    return nullptr;
+  }
+  if (image_id != nullptr) {
+    *image_id = hdr->header_checksum;
+  }
+  return ct;
+}
@@ -0,0 +1,145 @@
+#ifndef TABLEIMAGE_PRIV_HPP_
+#define TABLEIMAGE_PRIV_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+#include <cstdio>   // for FILE
+#include <string>   // for std::string
+
+#include "./CompactTable_priv.hpp"
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for HashTable snapshots (see
+// HashTable_Save and HashTable_Open).
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// A snapshot file is the image of a CompactTable: a header followed by the
+// table's heads, links, entries and (for a string-key table) arena arrays,
+// each starting on an 8-byte boundary.  Everything refers to everything
+// else by index or by file offset, so the image can be mapped anywhere and
+// used in place.
+static constexpr uint64_t k_image_magic = 0x50414e5354484c4cULL;  // LLHTSNAP
+static constexpr uint32_t k_image_version = 1;
+
+// Bits in HTImageHeader.flags.
+static constexpr uint32_t k_image_string_keys = 1;
+static constexpr uint32_t k_image_multimap = 2;
+
+typedef struct ht_image_header {
+  uint64_t magic;            // k_image_magic
+  uint32_t version;          // k_image_version
+  uint32_t flags;            // k_image_* bits
+  uint64_t num_buckets;      // # of entries in the heads array
+  uint64_t num_elements;     // # of entries in the links/entries arrays
+  uint64_t heads_offset;     // file offset of the heads array
+  uint64_t links_offset;     // file offset of the links array
+  uint64_t entries_offset;   // file offset of the entries array
+  uint64_t arena_offset;     // file offset of the arena
+  uint64_t arena_bytes;      // # of bytes in the arena
+  uint64_t file_bytes;       // the total size of the file
+  uint64_t body_checksum;    // TableImage_Checksum of [sizeof(header), file_bytes)
+  uint64_t header_checksum;  // TableImage_Checksum of all of the fields above
+} HTImageHeader;
+static_assert(sizeof(HTImageHeader) % 8 == 0, "sections must stay aligned");
+
+// A frozen table (see HashTable_Freeze) has an image of its own: a header
+// of its own, followed by its perfect hash's pilots and remap arrays, and
+// its entries and arena, each starting on an 8-byte boundary.  Its entries
+// are already in their slots and its arena already compact, so the arrays
+// are written out exactly as they are in memory.  Mapping it gives back a
+// frozen table, which is read-only whatever the flags.
+static constexpr uint64_t k_frozen_image_magic =
+    0x5a4f524654484c4cULL;  // LLHTFROZ
+static constexpr uint32_t k_frozen_image_version = 1;
+
+typedef struct ht_frozen_header {
+  uint64_t magic;            // k_frozen_image_magic
+  uint32_t version;          // k_frozen_image_version
+  uint32_t flags;            // k_image_string_keys, or 0
+  uint64_t num_elements;     // # of entries, and of slots handed out
+  uint64_t num_slots;        // the perfect hash's num_slots
+  uint64_t num_buckets;      // # of entries in the pilots array
+  uint64_t seed;             // the perfect hash's seed
+  uint64_t pilots_offset;    // file offset of the pilots array
+  uint64_t remap_offset;     // file offset of the remap array
+  uint64_t entries_offset;   // file offset of the entries array
+  uint64_t arena_offset;     // file offset of the arena
+  uint64_t arena_bytes;      // # of bytes in the arena
+  uint64_t file_bytes;       // the total size of the file
+  uint64_t body_checksum;    // TableImage_Checksum of [sizeof(header), file_bytes)
+  uint64_t header_checksum;  // TableImage_Checksum of all of the fields above
+} HTFrozenHeader;
+static_assert(sizeof(HTFrozenHeader) % 8 == 0, "sections must stay aligned");
+
+// Checksums len bytes at buf, continuing from a previous checksum "seed".
+// Whole 8-byte words are consumed at a time, so the result of checksumming
+// a buffer in pieces is the same as checksumming it in one go as long as
+// every piece but the last is a multiple of 8 bytes long.
+uint64_t TableImage_Checksum(uint64_t seed, const void* buf, size_t len);
+
+// The seed for a fresh checksum.
+static constexpr uint64_t k_image_checksum_seed = 0xcbf29ce484222325ULL;
+
+// Streams a checksummed file out: a fixed-size header, written last, then a
+// body that is checksummed as it is written.  The file is built under a
+// temporary name and renamed into place, so readers never see a partial
+// file.  Shared by snapshots and checkpoint deltas.
+typedef struct {
+  FILE* file;
+  const char* path;      // where the file ends up
+  std::string tmp_path;  // where it is built
+  uint64_t offset;       // # of bytes written so far, including the header
+  uint64_t checksum;     // running checksum of everything after the header
+  unsigned char carry[sizeof(uint64_t)];  // bytes not yet checksummed
+  size_t carry_len;      // # of bytes in carry
+  bool ok;               // have all writes succeeded so far?
+  bool sync;             // fsync the file before renaming it?
+} ImageWriter;
+
+// Creates the temporary file and skips over header_bytes for the header.
+// The file will be synced on finishing unless w->sync is cleared.  Returns
+// false if the file can't be created.
+bool ImageWriter_Begin(ImageWriter* w, const char* path, size_t header_bytes);
+
+// Appends len bytes at buf to the body, folding them into w->checksum.
+// Pieces can be any length; checksumming only ever sees whole words.
+void ImageWriter_Write(ImageWriter* w, const void* buf, size_t len);
+
+// Pads the body with zeros up to the next multiple of 8 bytes.
+void ImageWriter_Pad(ImageWriter* w);
+
+// Writes the header at the start of the file, syncs it (if w->sync) and
+// renames it into place.  Returns false (and removes the temporary file) if
+// any step along the way failed.
+bool ImageWriter_Finish(ImageWriter* w, const void* header,
+                        size_t header_bytes);
+
+// Writes the image of table (frozen or not) to path, atomically replacing
+// any existing file.  If image_id is non-nullptr, it receives a value
+// identifying this particular image (its header checksum).  If sync is
+// false, the file isn't fsynced, which is only safe for scratch files that
+// needn't survive a crash.  Returns false on an I/O error.
+bool TableImage_Write(CompactTable* table,
+                      const char* path,
+                      uint64_t* image_id,
+                      bool sync);
+
+// Maps the image at path and returns a CompactTable that uses it in place.
+// key_compare_function is ignored for string-key images.  If writable is
+// false (or the image is frozen), the table refuses all mutations;
+// otherwise the mapping is private, so mutations are copied on write and
+// never reach the file.  If verify is true, every byte of the image is
+// checksummed and every index checked before it is used.  If image_id is
+// non-nullptr, it receives the value TableImage_Write reported for this
+// image.  Returns nullptr if the file can't be mapped or is not a valid
+// image.
+CompactTable* TableImage_Map(const char* path,
+                             KeyCmpFnPtr key_compare_function,
+                             bool writable,
+                             bool verify,
+                             uint64_t* image_id);
+
+#endif  // TABLEIMAGE_PRIV_HPP_
@@ -0,0 +1,345 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "HashTable.hpp"
+#include "TableImage_priv.hpp"
+#include "TableLog_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+// Rounds n up to a multiple of 8.
+static uint64_t Align8(uint64_t n) {
+  return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Each record's checksum is seeded with its offset in the file, so that a
+// record can't be mistaken for one at a different position.
+static uint64_t RecordChecksum(uint64_t offset, const char* record,
+                               size_t len) {
+  return TableImage_Checksum(k_image_checksum_seed ^ offset,
+                             record + sizeof(uint64_t),
+                             len - sizeof(uint64_t));
+}
+
+// Writes all len bytes at buf to fd, retrying short writes.
+static bool WriteAll(int fd, const char* buf, size_t len) {
+  while (len > 0) {
+    const ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    buf += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Reads all of the file behind fd into contents.
+static bool ReadAll(int fd, std::string* contents) {
+  struct stat st{};
+  if (fstat(fd, &st) != 0) {
+    return false;
+  }
+  contents->resize(static_cast<size_t>(st.st_size));
+  size_t pos = 0;
+  while (pos < contents->size()) {
+    const ssize_t n = pread(fd, &(*contents)[pos], contents->size() - pos,
+                            static_cast<off_t>(pos));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    pos += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Replays the records in contents into table, stopping at the first record
+// that is incomplete or damaged.  Returns the offset just past the last
+// record replayed.
+static uint64_t Replay(const std::string& contents,
+                       HashTable* table,
+                       bool string_keys) {
+  uint64_t pos = sizeof(HTLogHeader);
+  while (contents.size() - pos >= sizeof(HTLogRecord)) {
+    HTLogRecord rec;
+    memcpy(&rec, contents.data() + pos, sizeof(rec));
+    const uint64_t len = sizeof(rec) + Align8(rec.key_len);
+    if (len > contents.size() - pos ||
+        RecordChecksum(pos, contents.data() + pos, len) != rec.checksum) {
+      break;
+    }
+
+    HTStringKey_t key_view{contents.data() + pos + sizeof(rec), rec.key_len};
+    const HTKey_t key = string_keys ? &key_view
+                                    : reinterpret_cast<HTKey_t>(rec.key);
+    HTKeyValue_t old;
+    if (rec.op == k_log_insert) {
+      HashTable_Insert(table,
+                       {rec.hash, key, reinterpret_cast<HTValue_t>(rec.value)},
+                       &old);
+    } else if (rec.op == k_log_remove) {
+      HashTable_Remove(table, rec.hash, key, &old);
+    } else {
+      break;
+    }
+    pos += len;
+  }
+  return pos;
+}
+
+// Runs one commit of whatever is buffered, first waiting out any commit
+// already in progress.  Called with the lock held via lk; the lock is
+// released during the write and fsync.
+static void Commit(HTLog* log, std::unique_lock<std::mutex>* lk) {
+  while (log->committing) {
+    log->done.wait(*lk);
+  }
+  if (log->failed || log->durable == log->appended) {
+    return;
+  }
+
+  std::string batch;
+  batch.swap(log->spare);
+  batch.swap(log->buffer);
+  const uint64_t target = log->appended;
+  log->buffered_ops = 0;
+  log->committing = true;
+  lk->unlock();
+
+  const bool ok = WriteAll(log->fd, batch.data(), batch.size()) &&
+                  fdatasync(log->fd) == 0;
+
+  lk->lock();
+  if (ok) {
+    log->durable = target;
+  } else {
+    log->failed = true;
+  }
+  batch.clear();
+  log->spare.swap(batch);
+  log->committing = false;
+  log->done.notify_all();
+}
+
+// The committer thread: commits every group_usecs (if non-zero), or sooner
+// once enough records are buffered or someone is waiting.  Commits once
+// more on the way out.
+static void CommitterMain(HTLog* log) {
+  // Only wake for records that aren't durable yet; a waiter that has been
+  // satisfied but hasn't run yet mustn't keep us spinning.
+  auto should_commit = [log] {
+    return log->stop ||
+           (!log->failed && log->durable < log->appended &&
+            (log->waiters > 0 || log->buffered_ops >= log->group_ops));
+  };
+  std::unique_lock<std::mutex> lk(log->lock);
+  while (!log->stop) {
+    if (log->group_usecs > 0) {
+      log->wake.wait_for(lk, std::chrono::microseconds(log->group_usecs),
+                         should_commit);
+    } else {
+      log->wake.wait(lk, should_commit);
+    }
+    Commit(log, &lk);
+  }
+  Commit(log, &lk);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TableLog implementation.
+
+HTLog* TableLog_Open(const char* path,
+                     HashTable* table,
+                     bool string_keys,
+                     size_t group_ops,
+                     uint64_t group_usecs,
+                     int durability) {
+  // O_APPEND means truncating the log never needs a seek afterwards.
+  const int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    return nullptr;
+  }
+  std::string contents;
+  if (!ReadAll(fd, &contents)) {
+    close(fd);
+    return nullptr;
+  }
+
+  // A log too short to have a header was never used; start it afresh.
+  uint64_t end_offset = sizeof(HTLogHeader);
+  const uint32_t flags = string_keys ? k_log_string_keys : 0;
+  if (contents.size() < sizeof(HTLogHeader)) {
+    const HTLogHeader hdr{k_log_magic, k_log_version, flags};
+    if (ftruncate(fd, 0) != 0 ||
+        !WriteAll(fd, reinterpret_cast<const char*>(&hdr), sizeof(hdr)) ||
+        fsync(fd) != 0) {
+      close(fd);
+      return nullptr;
+    }
+  } else {
+    HTLogHeader hdr;
+    memcpy(&hdr, contents.data(), sizeof(hdr));
+    if (hdr.magic != k_log_magic || hdr.version != k_log_version ||
+        hdr.flags != flags) {
+      close(fd);
+      return nullptr;
+    }
+
+    // Cut off any torn record, so new records follow the last good one.
+    end_offset = Replay(contents, table, string_keys);
+    if (end_offset < contents.size() &&
+        (ftruncate(fd, static_cast<off_t>(end_offset)) != 0 ||
+         fsync(fd) != 0)) {
+      close(fd);
+      return nullptr;
+    }
+  }
+
+  HTLog* log = new HTLog{};
+  log->fd = fd;
+  log->string_keys = string_keys;
+  log->group_ops = group_ops > 0 ? group_ops : 1;
+  log->group_usecs = group_usecs;
+  log->durability = durability;
+  log->end_offset = end_offset;
+  log->committer = std::thread(CommitterMain, log);
+  return log;
+}
+
+void TableLog_Close(HTLog* log) {
+  {
+    std::lock_guard<std::mutex> lk(log->lock);
+    log->stop = true;
+  }
+  log->wake.notify_one();
+  log->committer.join();
+  close(log->fd);
+  delete log;
+}
+
+size_t TableLog_Encode(std::string* buffer,
+                       uint64_t offset,
+                       bool string_keys,
+                       bool remove,
+                       HTKeyValue_t kv) {
+  HTLogRecord rec{};
+  rec.op = remove ? k_log_remove : k_log_insert;
+  rec.hash = kv.hash;
+  rec.value = remove ? 0 : reinterpret_cast<uint64_t>(kv.value);
+  const HTStringKey_t* skey = nullptr;
+  if (string_keys) {
+    skey = static_cast<const HTStringKey_t*>(kv.key);
+    rec.key_len = static_cast<uint32_t>(skey->len);
+  } else {
+    rec.key = reinterpret_cast<uint64_t>(kv.key);
+  }
+
+  // Encode the record straight into the buffer, then fill in its checksum.
+  static constexpr char k_zeros[8] = {0};
+  const size_t start = buffer->size();
+  buffer->append(reinterpret_cast<const char*>(&rec), sizeof(rec));
+  if (skey != nullptr) {
+    buffer->append(static_cast<const char*>(skey->bytes), skey->len);
+    buffer->append(k_zeros, Align8(skey->len) - skey->len);
+  }
+  const size_t len = buffer->size() - start;
+  rec.checksum = RecordChecksum(offset, &(*buffer)[start], len);
+  memcpy(&(*buffer)[start], &rec.checksum, sizeof(rec.checksum));
+  return len;
+}
+
+void TableLog_EncodeHeader(std::string* buffer, bool string_keys) {
+  const HTLogHeader hdr{k_log_magic, k_log_version,
+                        string_keys ? k_log_string_keys : 0};
+  buffer->append(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+}
+
+bool TableLog_ReplayFile(const char* path,
+                         HashTable* table,
+                         bool string_keys) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  std::string contents;
+  const bool read = ReadAll(fd, &contents);
+  close(fd);
+  HTLogHeader hdr;
+  if (!read || contents.size() < sizeof(hdr)) {
+    return false;
+  }
+  memcpy(&hdr, contents.data(), sizeof(hdr));
+  if (hdr.magic != k_log_magic || hdr.version != k_log_version ||
+      hdr.flags != (string_keys ? k_log_string_keys : 0)) {
+    return false;
+  }
+  return Replay(contents, table, string_keys) == contents.size();
+}
+
+uint64_t TableLog_Append(HTLog* log, bool remove, HTKeyValue_t kv) {
+  log->end_offset += TableLog_Encode(&log->buffer, log->end_offset,
+                                     log->string_keys, remove, kv);
+  log->buffered_ops++;
+  return ++log->appended;
+}
+
+void TableLog_Wait(HTLog* log,
+                   std::unique_lock<std::mutex>* lk,
+                   uint64_t lsn,
+                   int durability) {
+  if (durability == k_ht_wal_async) {
+    // Nudge the committer once a group's worth has built up.
+    if (log->buffered_ops >= log->group_ops) {
+      log->wake.notify_one();
+    }
+    return;
+  }
+
+  if (durability == k_ht_wal_group) {
+    // Hand the commit to the committer, so that whatever other threads
+    // append in the meantime shares its fsync.
+    log->waiters++;
+    log->wake.notify_one();
+    while (log->durable < lsn && !log->failed) {
+      log->done.wait(*lk);
+    }
+    log->waiters--;
+    return;
+  }
+
+  // k_ht_wal_sync: commit right here, without a round trip to the
+  // committer.
+  while (log->durable < lsn && !log->failed) {
+    Commit(log, lk);
+  }
+}
+
+bool TableLog_Truncate(HTLog* log, std::unique_lock<std::mutex>* lk) {
+  while ((log->committing || log->durable < log->appended) && !log->failed) {
+    Commit(log, lk);
+  }
+  if (log->failed) {
+    return false;
+  }
+  if (ftruncate(log->fd, sizeof(HTLogHeader)) != 0 || fsync(log->fd) != 0) {
+    log->failed = true;
+    return false;
+  }
+  log->end_offset = sizeof(HTLogHeader);
+  return true;
+}
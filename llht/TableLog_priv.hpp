@@ -0,0 +1,134 @@
+#ifndef TABLELOG_PRIV_HPP_
+#define TABLELOG_PRIV_HPP_
+
+#include <condition_variable>  // for std::condition_variable
+#include <cstdint>             // for uint64_t, etc.
+#include <mutex>               // for std::mutex, std::unique_lock
+#include <string>              // for std::string
+#include <thread>              // for std::thread
+
+#include "./HashTable.hpp"
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for a HashTable's write-ahead log
+// (see HashTable_AttachLog).
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// A log file is an HTLogHeader followed by records.  Each record is an
+// HTLogRecord, followed for a string-key table by the key's bytes padded to
+// a multiple of 8.  A crash can leave a torn record at the end of the
+// file; its checksum won't match, so it is discarded on replay.
+static constexpr uint64_t k_log_magic = 0x474f4c5754484c4cULL;  // LLHTWLOG
+static constexpr uint32_t k_log_version = 1;
+
+// Bits in HTLogHeader.flags.
+static constexpr uint32_t k_log_string_keys = 1;
+
+// Values of HTLogRecord.op.
+static constexpr uint32_t k_log_insert = 1;
+static constexpr uint32_t k_log_remove = 2;
+
+typedef struct ht_log_header {
+  uint64_t magic;    // k_log_magic
+  uint32_t version;  // k_log_version
+  uint32_t flags;    // k_log_* bits
+} HTLogHeader;
+
+typedef struct ht_log_record {
+  uint64_t checksum;  // of everything after this field, including key bytes
+  uint32_t op;        // k_log_insert or k_log_remove
+  uint32_t key_len;   // # of key bytes that follow, for string keys
+  uint64_t hash;      // the element's hash
+  uint64_t key;       // the raw key word; 0 for string keys
+  uint64_t value;     // the raw value word; 0 for removes
+} HTLogRecord;
+static_assert(sizeof(HTLogRecord) % 8 == 0, "records must stay aligned");
+
+// The write-ahead log.
+//
+// Records are appended to "buffer" under "lock", in the same critical
+// section as the mutation they describe, so the log's order is the table's
+// order.  A commit swaps the buffer out, writes it and fsyncs the file.
+// Only one commit runs at a time; the rest of the time the lock is free for
+// appending.  Commits are run by the committer thread once group_ops
+// records are buffered or group_usecs have passed, or as soon as someone is
+// waiting for one; and by callers asking for k_ht_wal_sync.
+typedef struct ht_log {
+  int fd;                            // the log file
+  bool string_keys;                  // does the log hold key bytes?
+  size_t group_ops;                  // commit once this many are buffered
+  uint64_t group_usecs;              // ...or this long has passed
+  int durability;                    // the level HashTable_Insert etc. use
+
+  std::mutex lock;                   // protects everything below
+  std::condition_variable wake;      // wakes the committer
+  std::condition_variable done;      // signalled at the end of each commit
+  std::string buffer;                // encoded records not yet written
+  std::string spare;                 // an empty buffer, kept for its capacity
+  size_t buffered_ops;               // # of records in buffer
+  uint64_t end_offset;               // file offset after the last record
+  uint64_t appended;                 // # of records ever appended
+  uint64_t durable;                  // # of those known to be on disk
+  int waiters;                       // # of threads waiting for a commit
+  bool committing;                   // is a commit in progress?
+  bool failed;                       // has a write or fsync failed?
+  bool stop;                         // should the committer exit?
+  std::thread committer;             // runs CommitterMain
+} HTLog;
+
+// Opens the log at path, creating it if need be, and replays any records
+// in it into table (which must not have a log attached yet).  A torn
+// record at the end of the log is truncated away.  Then starts the
+// committer thread.  Returns nullptr if the log can't be opened, isn't a
+// log, or was written for the other kind of key.
+HTLog* TableLog_Open(const char* path,
+                     HashTable* table,
+                     bool string_keys,
+                     size_t group_ops,
+                     uint64_t group_usecs,
+                     int durability);
+
+// Commits anything still buffered, stops the committer and closes the log.
+void TableLog_Close(HTLog* log);
+
+// Appends a record of an insert (or, if remove is true, a removal) of kv.
+// For a string-key table, kv.key points to an HTStringKey_t.  The caller
+// must hold log->lock.  Returns the record's sequence number.
+uint64_t TableLog_Append(HTLog* log, bool remove, HTKeyValue_t kv);
+
+// Encodes a record of an insert (or, if remove is true, a removal) of kv
+// onto the end of buffer, as it would be written at the given offset in a
+// log file.  For a string-key log, kv.key points to an HTStringKey_t.
+// Returns the record's length in bytes.
+size_t TableLog_Encode(std::string* buffer,
+                       uint64_t offset,
+                       bool string_keys,
+                       bool remove,
+                       HTKeyValue_t kv);
+
+// Encodes the header of a new log onto the end of buffer.
+void TableLog_EncodeHeader(std::string* buffer, bool string_keys);
+
+// Replays every record in the log at path into table, without attaching
+// the log to it.  Returns false if the file can't be read, isn't a log of
+// the right kind of key, or ends in a damaged record; true otherwise.
+bool TableLog_ReplayFile(const char* path,
+                         HashTable* table,
+                         bool string_keys);
+
+// Returns once record lsn is as durable as "durability" asks for.  The
+// caller must hold log->lock, via lk; it is released while waiting.
+void TableLog_Wait(HTLog* log,
+                   std::unique_lock<std::mutex>* lk,
+                   uint64_t lsn,
+                   int durability);
+
+// Truncates the log to no records, once everything appended so far has
+// been committed.  Returns false if the log has failed.  The caller must
+// hold log->lock, via lk.
+bool TableLog_Truncate(HTLog* log, std::unique_lock<std::mutex>* lk);
+
+#endif  // TABLELOG_PRIV_HPP_
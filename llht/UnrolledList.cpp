@@ -0,0 +1,245 @@
+#include <cstdint>
+#include <cstring>
+
+#include "UnrolledList.hpp"
+#include "UnrolledList_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+static constexpr uint32_t k_capacity = k_ul_node_capacity;
+
+// Allocates a node whose (empty) range of payloads sits at index idx, so
+// that it can grow in the direction it will be filled from.
+static UnrolledListNode* NewNode(uint32_t idx) {
+  UnrolledListNode* node = new UnrolledListNode;
+  node->next = nullptr;
+  node->prev = nullptr;
+  node->begin = idx;
+  node->end = idx;
+  return node;
+}
+
+// Unlinks an (empty) node from the list and deallocates it.
+static void RemoveNode(UnrolledList* list, UnrolledListNode* node) {
+  if (node->prev != nullptr) {
+    node->prev->next = node->next;
+  } else {
+    list->head = node->next;
+  }
+  if (node->next != nullptr) {
+    node->next->prev = node->prev;
+  } else {
+    list->tail = node->prev;
+  }
+  delete node;
+}
+
+// If node and its successor fit into one node together, moves the
+// successor's payloads onto the end of node and deallocates it.  iter, which
+// points into one of the two, is kept pointing at the same payload.  This
+// keeps nodes from being left mostly empty by removals.
+static void MaybeMergeNext(UnrolledList* list,
+                           UnrolledListNode* node,
+                           ULIterator* iter) {
+  UnrolledListNode* next = node->next;
+  if (next == nullptr) {
+    return;
+  }
+  const uint32_t count = node->end - node->begin;
+  const uint32_t next_count = next->end - next->begin;
+  if (count + next_count > k_capacity) {
+    return;
+  }
+
+  // Slide node's payloads to the front to make room, if need be.
+  if (node->end + next_count > k_capacity) {
+    memmove(&node->payloads[0], &node->payloads[node->begin],
+            count * sizeof(LLPayload_t));
+    if (iter->node == node) {
+      iter->idx -= node->begin;
+    }
+    node->begin = 0;
+    node->end = count;
+  }
+  memcpy(&node->payloads[node->end], &next->payloads[next->begin],
+         next_count * sizeof(LLPayload_t));
+  if (iter->node == next) {
+    iter->node = node;
+    iter->idx = node->end + (iter->idx - next->begin);
+  }
+  node->end += next_count;
+  RemoveNode(list, next);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UnrolledList implementation.
+
+UnrolledList* UnrolledList_New() {
+  UnrolledList* list = new UnrolledList();
+  list->num_elements = 0;
+  list->head = nullptr;
+  list->tail = nullptr;
+  return list;
+}
+
+void UnrolledList_Delete(UnrolledList* list,
+                         LLPayloadFreeFnPtr payload_free_function) {
+  while (list->head != nullptr) {
+    UnrolledListNode* node = list->head;
+    list->head = node->next;
+    for (uint32_t i = node->begin; i < node->end; i++) {
+      payload_free_function(node->payloads[i]);
+    }
+    delete node;
+  }
+  delete list;
+}
+
+size_t UnrolledList_NumElements(UnrolledList* list) {
+  return list->num_elements;
+}
+
+void UnrolledList_Push(UnrolledList* list, LLPayload_t payload) {
+  if (list->head == nullptr || list->head->begin == 0) {
+    // New head nodes fill from the back.
+    UnrolledListNode* node = NewNode(k_capacity);
+    node->next = list->head;
+    if (list->head != nullptr) {
+      list->head->prev = node;
+    } else {
+      list->tail = node;
+    }
+    list->head = node;
+  }
+  list->head->payloads[--list->head->begin] = payload;
+  list->num_elements++;
+}
+
+bool UnrolledList_Pop(UnrolledList* list, LLPayload_t* payload_ptr) {
+  if (list->num_elements == 0) {
+    return false;
+  }
+  UnrolledListNode* node = list->head;
+  *payload_ptr = node->payloads[node->begin++];
+  if (node->begin == node->end) {
+    RemoveNode(list, node);
+  }
+  list->num_elements--;
+  return true;
+}
+
+void UnrolledList_Append(UnrolledList* list, LLPayload_t payload) {
+  if (list->tail == nullptr || list->tail->end == k_capacity) {
+    // New tail nodes fill from the front.
+    UnrolledListNode* node = NewNode(0);
+    node->prev = list->tail;
+    if (list->tail != nullptr) {
+      list->tail->next = node;
+    } else {
+      list->head = node;
+    }
+    list->tail = node;
+  }
+  list->tail->payloads[list->tail->end++] = payload;
+  list->num_elements++;
+}
+
+bool UnrolledList_Slice(UnrolledList* list, LLPayload_t* payload_ptr) {
+  if (list->num_elements == 0) {
+    return false;
+  }
+  UnrolledListNode* node = list->tail;
+  *payload_ptr = node->payloads[--node->end];
+  if (node->begin == node->end) {
+    RemoveNode(list, node);
+  }
+  list->num_elements--;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ULIterator implementation.
+
+ULIterator* ULIterator_New(UnrolledList* list) {
+  ULIterator* iter = new ULIterator();
+  iter->list = list;
+  ULIterator_Rewind(iter);
+  return iter;
+}
+
+void ULIterator_Delete(ULIterator* iter) {
+  delete iter;
+}
+
+bool ULIterator_IsValid(ULIterator* iter) {
+  return iter->node != nullptr;
+}
+
+bool ULIterator_Next(ULIterator* iter) {
+  if (iter->node == nullptr) {
+    return false;
+  }
+  if (++iter->idx < iter->node->end) {
+    return true;
+  }
+  iter->node = iter->node->next;
+  if (iter->node == nullptr) {
+    return false;
+  }
+  iter->idx = iter->node->begin;
+  return true;
+}
+
+void ULIterator_Get(ULIterator* iter, LLPayload_t* payload) {
+  if (iter->node == nullptr) {
+    return;
+  }
+  *payload = iter->node->payloads[iter->idx];
+}
+
+bool ULIterator_Remove(ULIterator* iter,
+                       LLPayloadFreeFnPtr payload_free_function) {
+  UnrolledList* list = iter->list;
+  UnrolledListNode* node = iter->node;
+  payload_free_function(node->payloads[iter->idx]);
+  list->num_elements--;
+
+  // Close the gap; the successor (if it's in this node) slides into place.
+  memmove(&node->payloads[iter->idx], &node->payloads[iter->idx + 1],
+          (node->end - iter->idx - 1) * sizeof(LLPayload_t));
+  node->end--;
+
+  if (node->begin == node->end) {
+    // The node is now empty: move on to the next node, or back to the
+    // previous one if this was the tail.
+    if (node->next != nullptr) {
+      iter->node = node->next;
+      iter->idx = node->next->begin;
+    } else if (node->prev != nullptr) {
+      iter->node = node->prev;
+      iter->idx = node->prev->end - 1;
+    } else {
+      iter->node = nullptr;
+    }
+    RemoveNode(list, node);
+    return list->num_elements > 0;
+  }
+
+  if (iter->idx == node->end) {
+    // We removed the node's last payload.
+    if (node->next != nullptr) {
+      iter->node = node->next;
+      iter->idx = node->next->begin;
+    } else {
+      iter->idx--;
+    }
+  }
+  MaybeMergeNext(list, node, iter);
+  return true;
+}
+
+void ULIterator_Rewind(ULIterator* iter) {
+  iter->node = iter->list->head;
+  iter->idx = iter->node != nullptr ? iter->node->begin : 0;
+}
@@ -0,0 +1,87 @@
+#ifndef UNROLLEDLIST_HPP_
+#define UNROLLEDLIST_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./LinkedList.hpp"  // for LLPayload_t and LLPayloadFreeFnPtr
+
+///////////////////////////////////////////////////////////////////////////////
+// An UnrolledList is a doubly-linked list that stores several payloads per
+// node.
+//
+// A LinkedList allocates a node for every payload, so walking it takes a
+// (likely) cache miss per element.  An UnrolledList instead packs up to a
+// couple of cache lines' worth of payloads into each node, so walking it
+// only misses once per node, and it uses a fraction of the memory.
+//
+// The interface mirrors LinkedList's: UnrolledList_X behaves exactly like
+// LinkedList_X, and ULIterator_X like LLIterator_X, except where noted.
+typedef struct ul UnrolledList;
+
+// Allocate and return a new, empty unrolled list.  The caller takes
+// responsibility for eventually calling UnrolledList_Delete.
+UnrolledList* UnrolledList_New();
+
+// Free an unrolled list, invoking payload_free_function on each payload
+// still in it.
+void UnrolledList_Delete(UnrolledList* list,
+                         LLPayloadFreeFnPtr payload_free_function);
+
+// Return the number of elements in the list.
+size_t UnrolledList_NumElements(UnrolledList* list);
+
+// Add a payload to the head of the list.
+void UnrolledList_Push(UnrolledList* list, LLPayload_t payload);
+
+// Remove the payload at the head of the list, returning it through
+// payload_ptr.  Returns false if the list is empty.
+bool UnrolledList_Pop(UnrolledList* list, LLPayload_t* payload_ptr);
+
+// Add a payload to the tail of the list.
+void UnrolledList_Append(UnrolledList* list, LLPayload_t payload);
+
+// Remove the payload at the tail of the list, returning it through
+// payload_ptr.  Returns false if the list is empty.
+bool UnrolledList_Slice(UnrolledList* list, LLPayload_t* payload_ptr);
+
+///////////////////////////////////////////////////////////////////////////////
+// Unrolled list iterator.
+//
+// As with LLIterators, mutating a list with an UnrolledList_*() function
+// makes its iterators undefined.
+typedef struct ul_iter ULIterator;
+
+// Manufacture an iterator for the list, pointing at its head.  The caller
+// is responsible for eventually calling ULIterator_Delete.
+ULIterator* ULIterator_New(UnrolledList* list);
+
+// Free an iterator.
+void ULIterator_Delete(ULIterator* iter);
+
+// Returns true iff the iterator is pointing at an element.
+bool ULIterator_IsValid(ULIterator* iter);
+
+// Advance the iterator.  Returns true if it now points at an element, or
+// false if it has moved past the end.
+bool ULIterator_Next(ULIterator* iter);
+
+// Returns the payload the (valid) iterator points at through payload.
+void ULIterator_Get(ULIterator* iter, LLPayload_t* payload);
+
+// Remove the element the (valid) iterator points at, invoking
+// payload_free_function on its payload.  Afterwards the iterator points at
+// the removed element's successor or, if it was the tail, its predecessor.
+// If the list is now empty, the iterator is invalid, though it still has
+// to be freed with ULIterator_Delete.
+//
+// Returns:
+// - false if the list is now empty.
+// - true if the list is still non-empty.
+bool ULIterator_Remove(ULIterator* iter,
+                       LLPayloadFreeFnPtr payload_free_function);
+
+// Rewind an iterator to the front of its list.
+void ULIterator_Rewind(ULIterator* iter);
+
+#endif  // UNROLLEDLIST_HPP_
@@ -0,0 +1,54 @@
+#ifndef UNROLLEDLIST_PRIV_HPP_
+#define UNROLLEDLIST_PRIV_HPP_
+
+#include <cstdint>  // for uint16_t, etc.
+#include <cstddef>  // for size_t
+
+#include "./UnrolledList.hpp"  // for UnrolledList and ULIterator
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our UnrolledList
+// implementation, broken out so that our unittests can peek inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The size of a node, including its links; a multiple of the cache line.
+static constexpr size_t k_ul_node_bytes = 128;
+
+// The number of payloads a node can hold.
+static constexpr size_t k_ul_node_capacity =
+    (k_ul_node_bytes - 2 * sizeof(void*) - 2 * sizeof(uint32_t)) /
+    sizeof(LLPayload_t);
+
+// A single node within an unrolled list.
+//
+// A node's payloads occupy payloads[begin, end), which is never empty.
+// Pushing fills a node from the back and appending from the front, so
+// that both are O(1) without shifting payloads around.
+typedef struct alignas(64) ul_node {
+  struct ul_node* next;  // next node in list, or nullptr
+  struct ul_node* prev;  // prev node in list, or nullptr
+  uint32_t begin;        // index of the first payload
+  uint32_t end;          // one past the index of the last payload
+  LLPayload_t payloads[k_ul_node_capacity];
+} UnrolledListNode;
+static_assert(sizeof(UnrolledListNode) == k_ul_node_bytes,
+              "nodes should fill their cache lines exactly");
+
+// The entire unrolled list.
+typedef struct ul {
+  size_t num_elements;     // # elements in the list
+  UnrolledListNode* head;  // head of the list, or nullptr if empty
+  UnrolledListNode* tail;  // tail of the list, or nullptr if empty
+} UnrolledList;
+
+// An unrolled list iterator.
+typedef struct ul_iter {
+  UnrolledList* list;      // the list we're for
+  UnrolledListNode* node;  // the node we are at, or nullptr if invalid
+  uint32_t idx;            // the index within node->payloads we are at
+} ULIterator;
+
+#endif  // UNROLLEDLIST_PRIV_HPP_
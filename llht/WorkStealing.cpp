@@ -0,0 +1,267 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "WorkStealing.hpp"
+#include "WorkStealing_priv.hpp"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal helper functions.
+//
+
+static WSArray* NewArray(int64_t capacity) {
+  WSArray* array = new WSArray;
+  array->capacity = capacity;
+  array->slots = new std::atomic<LLPayload_t>[capacity];
+  return array;
+}
+
+static void DeleteArray(WSArray* array) {
+  delete[] array->slots;
+  delete array;
+}
+
+static std::atomic<LLPayload_t>& Slot(WSArray* array, int64_t i) {
+  return array->slots[i & (array->capacity - 1)];
+}
+
+// Replaces the deque's (full) array, holding [top, bottom), with one twice
+// the size.
+static WSArray* Grow(WorkDeque* deque,
+                     WSArray* array,
+                     int64_t top,
+                     int64_t bottom) {
+  WSArray* bigger = NewArray(2 * array->capacity);
+  for (int64_t i = top; i < bottom; i++) {
+    Slot(bigger, i).store(Slot(array, i).load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+  }
+  deque->old_arrays.push_back(array);
+  deque->array.store(bigger, std::memory_order_release);
+  return bigger;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WorkDeque implementation.
+//
+// This follows the C11 formulation of Le, Pop, Cohen and Zappa Nardelli,
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP '13).
+
+WorkDeque* WorkDeque_New() {
+  WorkDeque* deque = new WorkDeque();
+  deque->top.store(0, std::memory_order_relaxed);
+  deque->bottom.store(0, std::memory_order_relaxed);
+  deque->array.store(NewArray(k_ws_initial_capacity),
+                     std::memory_order_relaxed);
+  return deque;
+}
+
+void WorkDeque_Delete(WorkDeque* deque,
+                      LLPayloadFreeFnPtr payload_free_function) {
+  WSArray* array = deque->array.load();
+  for (int64_t i = deque->top.load(); i < deque->bottom.load(); i++) {
+    payload_free_function(Slot(array, i).load());
+  }
+  DeleteArray(array);
+  for (WSArray* old : deque->old_arrays) {
+    DeleteArray(old);
+  }
+  delete deque;
+}
+
+void WorkDeque_Push(WorkDeque* deque, LLPayload_t payload) {
+  const int64_t bottom = deque->bottom.load(std::memory_order_relaxed);
+  const int64_t top = deque->top.load(std::memory_order_acquire);
+  WSArray* array = deque->array.load(std::memory_order_relaxed);
+  if (bottom - top >= array->capacity) {
+    array = Grow(deque, array, top, bottom);
+  }
+  Slot(array, bottom).store(payload, std::memory_order_relaxed);
+
+  // Publish the payload (and whatever it points to) to thieves.
+  deque->bottom.store(bottom + 1, std::memory_order_release);
+}
+
+bool WorkDeque_Pop(WorkDeque* deque, LLPayload_t* payload_ptr) {
+  // Claim the bottom slot first, then look at top: a thief either sees the
+  // claim, or its steal is visible to us here.
+  const int64_t bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+  WSArray* array = deque->array.load(std::memory_order_relaxed);
+  deque->bottom.store(bottom, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t top = deque->top.load(std::memory_order_relaxed);
+
+  if (top > bottom) {
+    // Empty.
+    deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return false;
+  }
+  *payload_ptr = Slot(array, bottom).load(std::memory_order_relaxed);
+  if (top < bottom) {
+    // More than one payload; no thief can reach this one.
+    return true;
+  }
+
+  // The last payload: race any thieves for it.
+  const bool won = deque->top.compare_exchange_strong(
+      top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+  return won;
+}
+
+bool WorkDeque_Steal(WorkDeque* deque, LLPayload_t* payload_ptr) {
+  int64_t top = deque->top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+  if (top >= bottom) {
+    return false;
+  }
+
+  // Read the payload before claiming it: once top moves on, the owner may
+  // overwrite its slot.
+  WSArray* array = deque->array.load(std::memory_order_acquire);
+  const LLPayload_t payload = Slot(array, top).load(std::memory_order_relaxed);
+  if (!deque->top.compare_exchange_strong(top, top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+    return false;
+  }
+  *payload_ptr = payload;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ForkJoinPool implementation.
+
+// Handles a task, first splitting off (and pushing, for others to steal)
+// its right half until what's left is at most grain indices.
+static void RunTask(ForkJoinPool* pool, int self, FJTask* task) {
+  WorkDeque* deque = pool->deques[self];
+  const size_t begin = task->begin;
+  size_t end = task->end;
+  while (end - begin > pool->grain) {
+    const size_t mid = begin + (end - begin) / 2;
+    WorkDeque_Push(deque, new FJTask{mid, end});
+    end = mid;
+  }
+  delete task;
+  pool->fn(begin, end, pool->arg);
+  pool->remaining.fetch_sub(end - begin, std::memory_order_release);
+}
+
+// Runs the current loop's tasks on thread "self" until none are left: its
+// own (newest first), and failing that, the other threads' (oldest first,
+// as those are the biggest).
+static void RunLoop(ForkJoinPool* pool, int self) {
+  uint64_t rng = static_cast<uint64_t>(self) * 0x9e3779b97f4a7c15ULL + 1;
+  while (pool->remaining.load(std::memory_order_acquire) > 0) {
+    LLPayload_t payload;
+    bool found = WorkDeque_Pop(pool->deques[self], &payload);
+    for (int i = 0; !found && i < pool->num_threads; i++) {
+      // Start from a random victim (xorshift), so thieves spread out.
+      rng ^= rng << 13;
+      rng ^= rng >> 7;
+      rng ^= rng << 17;
+      const int victim = static_cast<int>(rng % pool->num_threads);
+      found = victim != self &&
+              WorkDeque_Steal(pool->deques[victim], &payload);
+    }
+    if (found) {
+      RunTask(pool, self, static_cast<FJTask*>(payload));
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+static void WorkerMain(ForkJoinPool* pool, int self) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(pool->lock);
+      pool->wake.wait(lk, [pool, seen] {
+        return pool->stop || pool->generation != seen;
+      });
+      if (pool->stop) {
+        return;
+      }
+      seen = pool->generation;
+      pool->active.fetch_add(1);
+    }
+    RunLoop(pool, self);
+    pool->active.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+static void FreeTask(LLPayload_t payload) {
+  delete static_cast<FJTask*>(payload);
+}
+
+ForkJoinPool* ForkJoinPool_New(int num_threads) {
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  if (num_threads <= 0) {
+    num_threads = 1;
+  }
+  ForkJoinPool* pool = new ForkJoinPool();
+  pool->num_threads = num_threads;
+  for (int i = 0; i < num_threads; i++) {
+    pool->deques.push_back(WorkDeque_New());
+  }
+  pool->generation = 0;
+  pool->stop = false;
+  pool->remaining.store(0);
+  pool->active.store(0);
+  for (int i = 1; i < num_threads; i++) {
+    pool->workers.emplace_back(WorkerMain, pool, i);
+  }
+  return pool;
+}
+
+void ForkJoinPool_Delete(ForkJoinPool* pool) {
+  {
+    std::lock_guard<std::mutex> lk(pool->lock);
+    pool->stop = true;
+  }
+  pool->wake.notify_all();
+  for (std::thread& worker : pool->workers) {
+    worker.join();
+  }
+  for (WorkDeque* deque : pool->deques) {
+    WorkDeque_Delete(deque, FreeTask);
+  }
+  delete pool;
+}
+
+int ForkJoinPool_NumThreads(ForkJoinPool* pool) {
+  return pool->num_threads;
+}
+
+void ForkJoinPool_ParallelFor(ForkJoinPool* pool,
+                              size_t begin,
+                              size_t end,
+                              size_t grain,
+                              FJRangeFnPtr fn,
+                              void* arg) {
+  if (begin >= end) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(pool->lock);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->grain = grain > 0 ? grain : 1;
+    pool->remaining.store(end - begin);
+    pool->generation++;
+  }
+  pool->wake.notify_all();
+
+  WorkDeque_Push(pool->deques[0], new FJTask{begin, end});
+  RunLoop(pool, 0);
+  while (pool->active.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+}
@@ -0,0 +1,93 @@
+#ifndef WORKSTEALING_HPP_
+#define WORKSTEALING_HPP_
+
+#include <cstddef>  // for size_t
+
+#include "./LinkedList.hpp"  // for LLPayload_t
+
+///////////////////////////////////////////////////////////////////////////////
+// A WorkDeque is a work-stealing deque of payloads (Chase and Lev's).
+//
+// Like a LinkedList used through LinkedList_Push/Pop at one end and
+// LinkedList_Slice at the other, it has two ends, but they belong to
+// different threads.  A single "owner" thread pushes and pops payloads at
+// the bottom, as a stack; any other thread may "steal" the payload at the
+// top, the oldest one.  The owner's pushes and pops are plain loads and
+// stores (plus a fence in WorkDeque_Pop), and only contend with a thief
+// for the very last payload; thieves compete with a compare-and-swap.
+//
+// The payloads live in a circular array, which doubles whenever it fills.
+typedef struct ws_deque WorkDeque;
+
+// Allocate and return a new, empty deque.  The caller takes responsibility
+// for eventually calling WorkDeque_Delete.
+WorkDeque* WorkDeque_New();
+
+// Free a deque, invoking payload_free_function on each payload still in
+// it.  No other thread may be using the deque.
+void WorkDeque_Delete(WorkDeque* deque,
+                      LLPayloadFreeFnPtr payload_free_function);
+
+// Add a payload to the bottom of the deque.  Only the owner may call this.
+void WorkDeque_Push(WorkDeque* deque, LLPayload_t payload);
+
+// Remove the payload at the bottom of the deque (the one pushed most
+// recently), returning it through payload_ptr.  Only the owner may call
+// this.
+//
+// Returns:
+// - false if the deque was empty, or a thief stole its last payload.
+// - true if a payload was removed.
+bool WorkDeque_Pop(WorkDeque* deque, LLPayload_t* payload_ptr);
+
+// Remove the payload at the top of the deque (the oldest one), returning
+// it through payload_ptr.  Any thread may call this.
+//
+// Returns:
+// - false if the deque was empty, or another thread got to the payload
+//   first.
+// - true if a payload was removed.
+bool WorkDeque_Steal(WorkDeque* deque, LLPayload_t* payload_ptr);
+
+///////////////////////////////////////////////////////////////////////////////
+// A ForkJoinPool runs loops in parallel on a fixed set of threads, which
+// balance the work between them by stealing from one another's WorkDeques.
+
+typedef struct fj_pool ForkJoinPool;
+
+// The body of a parallel loop: handles the indices [begin, end).
+typedef void (*FJRangeFnPtr)(size_t begin, size_t end, void* arg);
+
+// Allocate and return a new pool of num_threads threads (including the one
+// calling ForkJoinPool_ParallelFor), or one per hardware thread if
+// num_threads is 0.  The caller takes responsibility for eventually calling
+// ForkJoinPool_Delete.
+ForkJoinPool* ForkJoinPool_New(int num_threads);
+
+// Stop the pool's threads and free it.
+void ForkJoinPool_Delete(ForkJoinPool* pool);
+
+// Returns the number of threads in the pool, including the one calling
+// ForkJoinPool_ParallelFor.
+int ForkJoinPool_NumThreads(ForkJoinPool* pool);
+
+// Calls fn over the indices [begin, end) on the pool's threads, and returns
+// once every index has been handled.  The range is split in halves, and
+// halves of halves, until pieces have at most grain indices; idle threads
+// steal the biggest pieces not started yet.  Only one thread at a time may
+// run loops on a pool, and fn may not itself run a loop on it.
+//
+// Arguments:
+// - pool: the pool to run on.
+// - begin, end: the range of indices to handle.
+// - grain: the most indices to hand fn at once; 0 is treated as 1.
+// - fn: the loop body.
+// - arg: passed through to fn.
+void ForkJoinPool_ParallelFor(ForkJoinPool* pool,
+                              size_t begin,
+                              size_t end,
+                              size_t grain,
+                              FJRangeFnPtr fn,
+                              void* arg);
+
+#endif  // WORKSTEALING_HPP_
@@ -0,0 +1,79 @@
+#ifndef WORKSTEALING_PRIV_HPP_
+#define WORKSTEALING_PRIV_HPP_
+
+#include <atomic>              // for std::atomic
+#include <condition_variable>  // for std::condition_variable
+#include <cstdint>             // for int64_t, etc.
+#include <mutex>               // for std::mutex
+#include <thread>              // for std::thread
+#include <vector>              // for std::vector
+
+#include "./WorkStealing.hpp"  // for WorkDeque and ForkJoinPool
+
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Internal structures and helper functions for our WorkDeque and
+// ForkJoinPool implementations, broken out so that our unittests can peek
+// inside.
+//
+// Customers should not include this file or assume anything based on
+// its contents.
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
+// The capacity of a new deque's array.
+static constexpr int64_t k_ws_initial_capacity = 64;
+
+// A deque's circular array.  Index i lives in slots[i & (capacity - 1)].
+// The slots are atomic because a thief may read one while the owner is
+// overwriting it; the thief's compare-and-swap then fails.
+typedef struct ws_array {
+  int64_t capacity;                   // a power of 2
+  std::atomic<LLPayload_t>* slots;    // capacity slots
+} WSArray;
+
+// The entire deque.  It holds the payloads at indices [top, bottom).  The
+// owner alone moves bottom; top only ever increases, by a compare-and-swap.
+// The two are kept on separate cache lines, as thieves hammer on top.
+//
+// When the array fills, the owner copies it into one twice the size.  A
+// thief may still be reading the old one, so old arrays are kept until the
+// deque is deleted; they add up to less than the current one.
+typedef struct ws_deque {
+  alignas(64) std::atomic<int64_t> top;
+  alignas(64) std::atomic<int64_t> bottom;
+  std::atomic<WSArray*> array;
+  std::vector<WSArray*> old_arrays;   // owner only
+} WorkDeque;
+
+// A piece of a parallel loop: the indices [begin, end).
+typedef struct fj_task {
+  size_t begin;
+  size_t end;
+} FJTask;
+
+// The pool.  Thread i works from deques[i] and steals from the others;
+// thread 0 is whichever thread calls ForkJoinPool_ParallelFor.
+//
+// Workers sleep on "wake" between loops.  To start a loop, the caller sets
+// up the loop fields and bumps "generation" under "lock", and then works
+// alongside them until "remaining" drops to 0.  Before returning, it waits
+// for "active" (the number of workers still inside the loop) to drop to 0,
+// so that none of them can see the next loop's fields change under it.
+typedef struct fj_pool {
+  int num_threads;
+  std::vector<WorkDeque*> deques;     // one per thread
+  std::vector<std::thread> workers;   // threads 1 .. num_threads - 1
+
+  std::mutex lock;                    // protects the fields below...
+  std::condition_variable wake;       // signalled when a loop starts
+  uint64_t generation;                // # of loops started
+  bool stop;                          // should the workers exit?
+
+  // ...and the loop fields, which are set while no worker is active.
+  FJRangeFnPtr fn;
+  void* arg;
+  size_t grain;
+  std::atomic<size_t> remaining;      // # of indices not yet handled
+  std::atomic<int> active;            // # of workers inside the loop
+} ForkJoinPool;
+
+#endif  // WORKSTEALING_PRIV_HPP_
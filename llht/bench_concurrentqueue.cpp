@@ -0,0 +1,115 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./ConcurrentQueue.hpp"
+#include "./LinkedList.hpp"
+#include "./bench_util.hpp"
+
+static void NoOpFree(LLPayload_t payload) {}
+
+static LLPayload_t Payload(uint64_t i) {
+  return reinterpret_cast<LLPayload_t>(i);
+}
+
+// The baseline: a LinkedList behind a mutex.
+struct LockedList {
+  std::mutex lock;
+  LinkedList* list;
+};
+
+// Runs num_threads / 2 producers, which between them append n payloads
+// ("batch" at a time), and as many consumers, which pop them all (likewise),
+// through whichever queue "append" and "pop" operate on.  Reports the time
+// taken per payload.
+template <typename AppendFn, typename PopFn>
+static void RunQueue(const char* variant, size_t n, int num_threads,
+                     size_t batch, AppendFn append, PopFn pop) {
+  const int num_producers = num_threads / 2;
+  const size_t per_producer = n / num_producers;
+  const size_t total = per_producer * num_producers;
+  std::atomic<size_t> num_popped{0};
+  std::atomic<uint64_t> sum{0};
+
+  const double start = Bench_NowSeconds();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_producers; t++) {
+    threads.emplace_back([&, t] {
+      std::vector<LLPayload_t> payloads(batch);
+      for (size_t i = 0; i < per_producer; i += batch) {
+        for (size_t j = 0; j < batch; j++) {
+          payloads[j] = Payload(t * per_producer + i + j + 1);
+        }
+        append(payloads.data(), batch);
+      }
+    });
+    threads.emplace_back([&] {
+      std::vector<LLPayload_t> payloads(batch);
+      uint64_t local = 0;
+      while (num_popped.load(std::memory_order_relaxed) < total) {
+        const size_t got = pop(payloads.data(), batch);
+        if (got == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (size_t j = 0; j < got; j++) {
+          local += reinterpret_cast<uint64_t>(payloads[j]);
+        }
+        num_popped.fetch_add(got, std::memory_order_relaxed);
+      }
+      sum.fetch_add(local);
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const std::string name =
+      "QueueThroughput/" + std::to_string(num_threads) + " threads";
+  Bench_Report(name.c_str(), variant, total, Bench_NowSeconds() - start);
+  Bench_Consume(sum.load());
+}
+
+// Producer/consumer throughput for the lock-free queue (one payload and 32
+// payloads per operation) and a mutex-protected LinkedList, from 2 to 32
+// threads.
+BENCH_CASE(QueueThroughput) {
+  const size_t n = (1 << 20) * scale;
+  constexpr size_t k_batch = 32;
+  for (int num_threads = 2; num_threads <= 32; num_threads *= 2) {
+    LockedList locked;
+    locked.list = LinkedList_New();
+    RunQueue(
+        "mutex+LinkedList", n, num_threads, 1,
+        [&locked](const LLPayload_t* payloads, size_t count) {
+          std::lock_guard<std::mutex> lk(locked.lock);
+          LinkedList_Append(locked.list, payloads[0]);
+        },
+        [&locked](LLPayload_t* payloads, size_t max) -> size_t {
+          std::lock_guard<std::mutex> lk(locked.lock);
+          return LinkedList_Pop(locked.list, &payloads[0]) ? 1 : 0;
+        });
+    LinkedList_Delete(locked.list, NoOpFree);
+
+    ConcurrentQueue* queue = ConcurrentQueue_New();
+    RunQueue(
+        "ConcurrentQueue", n, num_threads, 1,
+        [queue](const LLPayload_t* payloads, size_t count) {
+          ConcurrentQueue_Append(queue, payloads[0]);
+        },
+        [queue](LLPayload_t* payloads, size_t max) -> size_t {
+          return ConcurrentQueue_Pop(queue, &payloads[0]) ? 1 : 0;
+        });
+    RunQueue(
+        "ConcurrentQueue, batch 32", n, num_threads, k_batch,
+        [queue](const LLPayload_t* payloads, size_t count) {
+          ConcurrentQueue_AppendMany(queue, payloads, count);
+        },
+        [queue](LLPayload_t* payloads, size_t max) {
+          return ConcurrentQueue_PopMany(queue, payloads, max);
+        });
+    ConcurrentQueue_Delete(queue, NoOpFree);
+  }
+}
@@ -0,0 +1,97 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./GroupBy.hpp"
+#include "./HashTable.hpp"
+#include "./WorkStealing.hpp"
+#include "./bench_util.hpp"
+
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+// A cheap, well-mixed stand-in for hashing the key bytes.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static HTValue_t Sum(HTValue_t acc, HTValue_t value) {
+  return reinterpret_cast<HTValue_t>(reinterpret_cast<uint64_t>(acc) +
+                                     reinterpret_cast<uint64_t>(value));
+}
+
+// Sums the counts of every group, so the group-by can't be optimized away.
+static void SumGroups(const HTKeyValue_t* groups, size_t num_groups,
+                      void* arg) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < num_groups; i++) {
+    sum += reinterpret_cast<uint64_t>(groups[i].value);
+  }
+  static_cast<std::atomic<uint64_t>*>(arg)->fetch_add(
+      sum, std::memory_order_relaxed);
+}
+
+// Counts n records by key, over num_keys keys: with HashTable_Find then
+// HashTable_Insert per record, and with GroupBy_Run on this thread and on
+// a ForkJoinPool of 1 to 8 threads.
+static void MeasureGroupBy(const char* name, size_t n, uint64_t num_keys) {
+  std::vector<HTKeyValue_t> records;
+  records.reserve(n);
+  for (uint64_t i = 0; i < n; i++) {
+    const uint64_t key = MixHash(i) % num_keys;
+    records.push_back({MixHash(key), reinterpret_cast<HTKey_t>(key),
+                       reinterpret_cast<HTValue_t>(1)});
+  }
+
+  double start = Bench_NowSeconds();
+  HashTable* table = HashTable_NewCompact(16, CompareInlineKeys);
+  for (const HTKeyValue_t& record : records) {
+    HTKeyValue_t kv;
+    if (HashTable_Find(table, record.hash, record.key, &kv)) {
+      kv.value = Sum(kv.value, record.value);
+    } else {
+      kv = record;
+    }
+    HashTable_Insert(table, kv, &kv);
+  }
+  Bench_Report(name, "Find then Insert", n, Bench_NowSeconds() - start);
+  Bench_Consume(HashTable_NumElements(table));
+  HashTable_Delete(table, NoOpFree);
+
+  std::atomic<uint64_t> total{0};
+  start = Bench_NowSeconds();
+  GroupBy_Run(records.data(), n, CompareInlineKeys, Sum, nullptr, SumGroups,
+              &total);
+  Bench_Report(name, "GroupBy_Run", n, Bench_NowSeconds() - start);
+  Bench_Consume(total.load());
+
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    ForkJoinPool* pool = ForkJoinPool_New(num_threads);
+    GBOptions_t options{pool, 0};
+    total.store(0);
+    start = Bench_NowSeconds();
+    GroupBy_Run(records.data(), n, CompareInlineKeys, Sum, &options,
+                SumGroups, &total);
+    const std::string variant =
+        "GroupBy_Run/" + std::to_string(num_threads) + " threads";
+    Bench_Report(name, variant.c_str(), n, Bench_NowSeconds() - start);
+    Bench_Consume(total.load());
+    ForkJoinPool_Delete(pool);
+  }
+}
+
+// Counting over a few groups, which stay in cache, and over many.
+BENCH_CASE(GroupBy) {
+  const size_t n = 20000000 * scale;
+  MeasureGroupBy("GroupBy/1K keys", n, 1000);
+  MeasureGroupBy("GroupBy/1M keys", n, 1000000);
+}
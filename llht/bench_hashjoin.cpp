@@ -0,0 +1,99 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./HashJoin.hpp"
+#include "./HashTable.hpp"
+#include "./WorkStealing.hpp"
+#include "./bench_util.hpp"
+
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+// A cheap, well-mixed stand-in for hashing the key bytes.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static HTKeyValue_t Record(uint64_t key, uint64_t value) {
+  return HTKeyValue_t{MixHash(key), reinterpret_cast<HTKey_t>(key),
+                      reinterpret_cast<HTValue_t>(value)};
+}
+
+// Sums the values of every match, so the join can't be optimized away.
+static void SumMatches(const HJMatch_t* matches, size_t num_matches,
+                       void* arg) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < num_matches; i++) {
+    sum += reinterpret_cast<uint64_t>(matches[i].build.value) +
+           reinterpret_cast<uint64_t>(matches[i].probe.value);
+  }
+  static_cast<std::atomic<uint64_t>*>(arg)->fetch_add(
+      sum, std::memory_order_relaxed);
+}
+
+// Joins n unique build keys with 4n probe records, half of which match,
+// by building one compact table and looking every probe up in it, and
+// with HashJoin_Run on this thread and on a ForkJoinPool of 1 to 8
+// threads.  Times are per probe record and include building.
+BENCH_CASE(HashJoin) {
+  const size_t n = 2000000 * scale;
+  std::vector<HTKeyValue_t> build;
+  std::vector<HTKeyValue_t> probe;
+  for (uint64_t i = 0; i < n; i++) {
+    build.push_back(Record(MixHash(i) % (2 * n), i));
+  }
+  for (uint64_t i = 0; i < 4 * n; i++) {
+    probe.push_back(Record(MixHash(i + 4 * n) % (2 * n), i));
+  }
+
+  double start = Bench_NowSeconds();
+  HashTable* table = HashTable_NewCompact(n, CompareInlineKeys);
+  HTKeyValue_t kv;
+  for (const HTKeyValue_t& record : build) {
+    HashTable_Insert(table, record, &kv);
+  }
+  uint64_t sum = 0;
+  for (const HTKeyValue_t& record : probe) {
+    if (HashTable_Find(table, record.hash, record.key, &kv)) {
+      sum += reinterpret_cast<uint64_t>(kv.value) +
+             reinterpret_cast<uint64_t>(record.value);
+    }
+  }
+  Bench_Report("HashJoin", "build then Find", probe.size(),
+               Bench_NowSeconds() - start);
+  Bench_Consume(sum);
+  HashTable_Delete(table, NoOpFree);
+
+  std::atomic<uint64_t> total{0};
+  start = Bench_NowSeconds();
+  HashJoin_Run(build.data(), build.size(), probe.data(), probe.size(),
+               CompareInlineKeys, nullptr, SumMatches, &total);
+  Bench_Report("HashJoin", "HashJoin_Run", probe.size(),
+               Bench_NowSeconds() - start);
+  Bench_Consume(total.load());
+
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    ForkJoinPool* pool = ForkJoinPool_New(num_threads);
+    HJOptions_t options{pool, 0};
+    total.store(0);
+    start = Bench_NowSeconds();
+    HashJoin_Run(build.data(), build.size(), probe.data(), probe.size(),
+                 CompareInlineKeys, &options, SumMatches, &total);
+    const std::string variant =
+        "HashJoin_Run/" + std::to_string(num_threads) + " threads";
+    Bench_Report("HashJoin", variant.c_str(), probe.size(),
+                 Bench_NowSeconds() - start);
+    Bench_Consume(total.load());
+    ForkJoinPool_Delete(pool);
+  }
+}
@@ -0,0 +1,558 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "./IntrusiveList.hpp"
+#include "./LinkedList.hpp"
+#include "./LinkedList_priv.hpp"
+#include "./RingDeque.hpp"
+#include "./UnrolledList.hpp"
+#include "./bench_util.hpp"
+
+static void NoOpFree(LLPayload_t payload) {}
+
+static LLPayload_t Payload(uint64_t i) {
+  return reinterpret_cast<LLPayload_t>(i);
+}
+
+BENCH_CASE(UnrolledLayout) {
+  const size_t n = 5000000 * scale;
+  uint64_t sum = 0;
+
+  // LinkedList: one node per payload.
+  size_t heap_before = Bench_HeapBytes();
+  double start = Bench_NowSeconds();
+  LinkedList* list = LinkedList_New();
+  for (uint64_t i = 0; i < n; i++) {
+    LinkedList_Append(list, Payload(i));
+  }
+  Bench_Report("UnrolledLayout/append", "LinkedList", n,
+               Bench_NowSeconds() - start);
+  Bench_ReportValue("UnrolledLayout/memory", "LinkedList", "heap bytes/entry",
+                    static_cast<double>(Bench_HeapBytes() - heap_before) /
+                        static_cast<double>(n));
+
+  start = Bench_NowSeconds();
+  LLIterator* lli = LLIterator_New(list);
+  for (; LLIterator_IsValid(lli); LLIterator_Next(lli)) {
+    LLPayload_t payload;
+    LLIterator_Get(lli, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  LLIterator_Delete(lli);
+  Bench_Report("UnrolledLayout/scan", "LinkedList", n,
+               Bench_NowSeconds() - start);
+
+  start = Bench_NowSeconds();
+  LLPayload_t payload;
+  while (LinkedList_Pop(list, &payload)) {
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  Bench_Report("UnrolledLayout/pop", "LinkedList", n,
+               Bench_NowSeconds() - start);
+  LinkedList_Delete(list, NoOpFree);
+
+  // UnrolledList: a cache-line-sized array of payloads per node.
+  heap_before = Bench_HeapBytes();
+  start = Bench_NowSeconds();
+  UnrolledList* ulist = UnrolledList_New();
+  for (uint64_t i = 0; i < n; i++) {
+    UnrolledList_Append(ulist, Payload(i));
+  }
+  Bench_Report("UnrolledLayout/append", "UnrolledList", n,
+               Bench_NowSeconds() - start);
+  Bench_ReportValue("UnrolledLayout/memory", "UnrolledList", "heap bytes/entry",
+                    static_cast<double>(Bench_HeapBytes() - heap_before) /
+                        static_cast<double>(n));
+
+  start = Bench_NowSeconds();
+  ULIterator* uli = ULIterator_New(ulist);
+  for (; ULIterator_IsValid(uli); ULIterator_Next(uli)) {
+    ULIterator_Get(uli, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  ULIterator_Delete(uli);
+  Bench_Report("UnrolledLayout/scan", "UnrolledList", n,
+               Bench_NowSeconds() - start);
+
+  start = Bench_NowSeconds();
+  while (UnrolledList_Pop(ulist, &payload)) {
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  Bench_Report("UnrolledLayout/pop", "UnrolledList", n,
+               Bench_NowSeconds() - start);
+  UnrolledList_Delete(ulist, NoOpFree);
+  Bench_Consume(sum);
+}
+
+// Scans lists whose nodes were allocated on an "aged" heap: every append is
+// interleaved with a randomly-sized allocation that lives on, so the
+// LinkedList's nodes end up scattered rather than laid out in order.
+BENCH_CASE(UnrolledScattered) {
+  const size_t n = 2000000 * scale;
+  std::vector<char*> clutter;
+  clutter.reserve(2 * n);
+  srand(1);
+  LinkedList* list = LinkedList_New();
+  UnrolledList* ulist = UnrolledList_New();
+  for (uint64_t i = 0; i < n; i++) {
+    clutter.push_back(new char[16 + rand() % 256]);
+    LinkedList_Append(list, Payload(i));
+    clutter.push_back(new char[16 + rand() % 256]);
+    UnrolledList_Append(ulist, Payload(i));
+  }
+
+  uint64_t sum = 0;
+  LLPayload_t payload;
+  double start = Bench_NowSeconds();
+  LLIterator* lli = LLIterator_New(list);
+  for (; LLIterator_IsValid(lli); LLIterator_Next(lli)) {
+    LLIterator_Get(lli, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  LLIterator_Delete(lli);
+  Bench_Report("UnrolledScattered/scan", "LinkedList", n,
+               Bench_NowSeconds() - start);
+
+  start = Bench_NowSeconds();
+  ULIterator* uli = ULIterator_New(ulist);
+  for (; ULIterator_IsValid(uli); ULIterator_Next(uli)) {
+    ULIterator_Get(uli, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  ULIterator_Delete(uli);
+  Bench_Report("UnrolledScattered/scan", "UnrolledList", n,
+               Bench_NowSeconds() - start);
+
+  LinkedList_Delete(list, NoOpFree);
+  UnrolledList_Delete(ulist, NoOpFree);
+  for (char* p : clutter) {
+    delete[] p;
+  }
+  Bench_Consume(sum);
+}
+
+static int ComparePayloads(LLPayload_t a, LLPayload_t b) {
+  const uint64_t ka = reinterpret_cast<uint64_t>(a);
+  const uint64_t kb = reinterpret_cast<uint64_t>(b);
+  return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+// Builds a list of n random payloads.
+static LinkedList* RandomList(size_t n) {
+  srand(1);
+  LinkedList* list = LinkedList_New();
+  for (size_t i = 0; i < n; i++) {
+    LinkedList_Append(list, Payload(static_cast<uint64_t>(rand())));
+  }
+  return list;
+}
+
+// Sorts the same random list with LinkedList_Sort (sequentially and in
+// parallel), with std::list::sort, and by copying the payloads out to a
+// vector, sorting that and writing them back.  Every list is built before
+// any is sorted or freed, so that all of them start out with their nodes
+// laid out in allocation order.
+BENCH_CASE(ListSort) {
+  const size_t n = 1000000 * scale;
+  const int k_threads[] = {1, 2, 4};
+  const char* const k_variants[] = {"LinkedList_Sort", "SortParallel/2",
+                                    "SortParallel/4"};
+  LinkedList* lists[3];
+  for (LinkedList*& list : lists) {
+    list = RandomList(n);
+  }
+  LinkedList* copied = RandomList(n);
+  srand(1);
+  std::list<LLPayload_t> std_list;
+  for (size_t i = 0; i < n; i++) {
+    std_list.push_back(Payload(static_cast<uint64_t>(rand())));
+  }
+
+  for (int v = 0; v < 3; v++) {
+    const double start = Bench_NowSeconds();
+    LinkedList_SortParallel(lists[v], ComparePayloads, k_threads[v]);
+    Bench_Report("ListSort", k_variants[v], n, Bench_NowSeconds() - start);
+    Bench_Consume(reinterpret_cast<uint64_t>(lists[v]->head->payload));
+  }
+
+  double start = Bench_NowSeconds();
+  std_list.sort([](LLPayload_t a, LLPayload_t b) {
+    return ComparePayloads(a, b) < 0;
+  });
+  Bench_Report("ListSort", "std::list::sort", n, Bench_NowSeconds() - start);
+  Bench_Consume(reinterpret_cast<uint64_t>(std_list.front()));
+
+  start = Bench_NowSeconds();
+  std::vector<LLPayload_t> payloads;
+  payloads.reserve(n);
+  for (LinkedListNode* node = copied->head; node != nullptr;
+       node = node->next) {
+    payloads.push_back(node->payload);
+  }
+  std::stable_sort(payloads.begin(), payloads.end(),
+                   [](LLPayload_t a, LLPayload_t b) {
+                     return ComparePayloads(a, b) < 0;
+                   });
+  size_t i = 0;
+  for (LinkedListNode* node = copied->head; node != nullptr;
+       node = node->next) {
+    node->payload = payloads[i++];
+  }
+  Bench_Report("ListSort", "copy to vector", n, Bench_NowSeconds() - start);
+  Bench_Consume(reinterpret_cast<uint64_t>(copied->head->payload));
+
+  for (LinkedList* list : lists) {
+    LinkedList_Delete(list, NoOpFree);
+  }
+  LinkedList_Delete(copied, NoOpFree);
+}
+
+// Hands batches of elements down a pipeline of lists, once by popping and
+// re-appending each element and once by concatenating whole lists.
+BENCH_CASE(ListHandoff) {
+  const size_t k_stages = 8;
+  const size_t k_batch = 1000;
+  const size_t num_batches = 500 * scale;
+  const size_t n = k_stages * k_batch * num_batches;
+
+  for (bool concat : {false, true}) {
+    LinkedList* stages[k_stages];
+    for (LinkedList*& stage : stages) {
+      stage = LinkedList_New();
+    }
+    const double start = Bench_NowSeconds();
+    for (size_t b = 0; b < num_batches; b++) {
+      for (uint64_t i = 0; i < k_batch; i++) {
+        LinkedList_Append(stages[0], Payload(i));
+      }
+      for (size_t s = 1; s < k_stages; s++) {
+        if (concat) {
+          LinkedList_Concat(stages[s], stages[s - 1]);
+        } else {
+          LLPayload_t payload;
+          while (LinkedList_Pop(stages[s - 1], &payload)) {
+            LinkedList_Append(stages[s], payload);
+          }
+        }
+      }
+      LinkedList_Delete(stages[k_stages - 1], NoOpFree);
+      stages[k_stages - 1] = LinkedList_New();
+    }
+    Bench_Report("ListHandoff", concat ? "LinkedList_Concat" : "pop/append",
+                 n, Bench_NowSeconds() - start);
+    for (LinkedList* stage : stages) {
+      LinkedList_Delete(stage, NoOpFree);
+    }
+  }
+}
+
+// Uses a LinkedList and a RingDeque as a buffer: fills each, scans it, and
+// drains it; then runs each as a FIFO queue holding a steady 1024 payloads.
+BENCH_CASE(RingLayout) {
+  const size_t n = 5000000 * scale;
+  uint64_t sum = 0;
+  LLPayload_t payload;
+
+  size_t heap_before = Bench_HeapBytes();
+  double start = Bench_NowSeconds();
+  LinkedList* list = LinkedList_New();
+  for (uint64_t i = 0; i < n; i++) {
+    LinkedList_Append(list, Payload(i));
+  }
+  Bench_Report("RingLayout/append", "LinkedList", n,
+               Bench_NowSeconds() - start);
+  Bench_ReportValue("RingLayout/memory", "LinkedList", "heap bytes/entry",
+                    static_cast<double>(Bench_HeapBytes() - heap_before) /
+                        static_cast<double>(n));
+  start = Bench_NowSeconds();
+  LLIterator* lli = LLIterator_New(list);
+  for (; LLIterator_IsValid(lli); LLIterator_Next(lli)) {
+    LLIterator_Get(lli, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  LLIterator_Delete(lli);
+  Bench_Report("RingLayout/scan", "LinkedList", n, Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  while (LinkedList_Pop(list, &payload)) {
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  Bench_Report("RingLayout/pop", "LinkedList", n, Bench_NowSeconds() - start);
+
+  heap_before = Bench_HeapBytes();
+  start = Bench_NowSeconds();
+  RingDeque* deque = RingDeque_New();
+  for (uint64_t i = 0; i < n; i++) {
+    RingDeque_Append(deque, Payload(i));
+  }
+  Bench_Report("RingLayout/append", "RingDeque", n,
+               Bench_NowSeconds() - start);
+  Bench_ReportValue("RingLayout/memory", "RingDeque", "heap bytes/entry",
+                    static_cast<double>(Bench_HeapBytes() - heap_before) /
+                        static_cast<double>(n));
+  start = Bench_NowSeconds();
+  RDIterator* rdi = RDIterator_New(deque);
+  for (; RDIterator_IsValid(rdi); RDIterator_Next(rdi)) {
+    RDIterator_Get(rdi, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  RDIterator_Delete(rdi);
+  Bench_Report("RingLayout/scan", "RingDeque", n, Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  while (RingDeque_Pop(deque, &payload)) {
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  Bench_Report("RingLayout/pop", "RingDeque", n, Bench_NowSeconds() - start);
+
+  // Steady-state FIFO: every append is matched by a pop.
+  for (uint64_t i = 0; i < 1024; i++) {
+    LinkedList_Append(list, Payload(i));
+    RingDeque_Append(deque, Payload(i));
+  }
+  start = Bench_NowSeconds();
+  for (uint64_t i = 0; i < n; i++) {
+    LinkedList_Append(list, Payload(i));
+    LinkedList_Pop(list, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  Bench_Report("RingLayout/fifo", "LinkedList", n, Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  for (uint64_t i = 0; i < n; i++) {
+    RingDeque_Append(deque, Payload(i));
+    RingDeque_Pop(deque, &payload);
+    sum += reinterpret_cast<uint64_t>(payload);
+  }
+  Bench_Report("RingLayout/fifo", "RingDeque", n, Bench_NowSeconds() - start);
+
+  LinkedList_Delete(list, NoOpFree);
+  RingDeque_Delete(deque, NoOpFree);
+  Bench_Consume(sum);
+}
+
+// Seeks to random positions and random keys in sorted lists of 1K to 10M
+// payloads, with a skip-list index and by linear scan.  The scans are given
+// fewer seeks as the lists grow, so that each size takes similar time.
+BENCH_CASE(SkipSeek) {
+  const size_t k_indexed_seeks = 200000;
+  for (size_t n = 1000; n <= 10000000 * scale; n *= 10) {
+    LinkedList* list = LinkedList_New();
+    for (uint64_t i = 0; i < n; i++) {
+      LinkedList_Append(list, Payload(2 * i));
+    }
+    LLIterator* lli = LLIterator_New(list);
+    LLPayload_t payload;
+    uint64_t sum = 0;
+    for (bool indexed : {false, true}) {
+      if (indexed) {
+        const size_t heap_before = Bench_HeapBytes();
+        const double start = Bench_NowSeconds();
+        LinkedList_AddIndex(list);
+        Bench_Report("SkipSeek/build", std::to_string(n).c_str(), n,
+                     Bench_NowSeconds() - start);
+        Bench_ReportValue("SkipSeek/memory", std::to_string(n).c_str(),
+                          "index bytes/entry",
+                          static_cast<double>(Bench_HeapBytes() - heap_before) /
+                              static_cast<double>(n));
+      }
+      const size_t seeks =
+          indexed ? k_indexed_seeks : std::max<size_t>(20, 20000000 / n);
+      const std::string variant =
+          std::string(indexed ? "indexed/" : "linear/") + std::to_string(n);
+
+      srand(7);
+      double start = Bench_NowSeconds();
+      for (size_t s = 0; s < seeks; s++) {
+        LLIterator_SeekIndex(lli, static_cast<size_t>(rand()) % n);
+        LLIterator_Get(lli, &payload);
+        sum += reinterpret_cast<uint64_t>(payload);
+      }
+      Bench_Report("SkipSeek/position", variant.c_str(), seeks,
+                   Bench_NowSeconds() - start);
+
+      start = Bench_NowSeconds();
+      for (size_t s = 0; s < seeks; s++) {
+        const uint64_t key = static_cast<uint64_t>(rand()) % (2 * n);
+        LLIterator_Seek(lli, Payload(key), &ComparePayloads);
+        LLIterator_Get(lli, &payload);
+        sum += reinterpret_cast<uint64_t>(payload);
+      }
+      Bench_Report("SkipSeek/key", variant.c_str(), seeks,
+                   Bench_NowSeconds() - start);
+    }
+    LLIterator_Delete(lli);
+    LinkedList_Delete(list, NoOpFree);
+    Bench_Consume(sum);
+  }
+}
+
+// A pooled object, as a customer would keep on lists.
+typedef struct {
+  uint64_t key;
+  ILLink link;
+} PooledEntry;
+
+// Keeps pooled objects on a LinkedList (one node per membership, with the
+// payload pointing at the object) and on an IntrusiveList: builds each
+// list, scans it, rotates it as a FIFO queue, and removes every other
+// object.
+BENCH_CASE(IntrusiveMembership) {
+  const size_t n = 1000000 * scale;
+  std::vector<PooledEntry> pool(n);
+  for (uint64_t i = 0; i < n; i++) {
+    pool[i].key = i;
+    ILLink_Init(&pool[i].link);
+  }
+  uint64_t sum = 0;
+
+  size_t heap_before = Bench_HeapBytes();
+  double start = Bench_NowSeconds();
+  LinkedList* list = LinkedList_New();
+  for (PooledEntry& entry : pool) {
+    LinkedList_Append(list, &entry);
+  }
+  Bench_Report("IntrusiveMembership/append", "LinkedList", n,
+               Bench_NowSeconds() - start);
+  Bench_ReportValue("IntrusiveMembership/memory", "LinkedList",
+                    "heap bytes/entry",
+                    static_cast<double>(Bench_HeapBytes() - heap_before) /
+                        static_cast<double>(n));
+  LLPayload_t payload;
+  start = Bench_NowSeconds();
+  LLIterator* lli = LLIterator_New(list);
+  for (; LLIterator_IsValid(lli); LLIterator_Next(lli)) {
+    LLIterator_Get(lli, &payload);
+    sum += static_cast<PooledEntry*>(payload)->key;
+  }
+  Bench_Report("IntrusiveMembership/scan", "LinkedList", n,
+               Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  for (size_t i = 0; i < n; i++) {
+    LinkedList_Pop(list, &payload);
+    LinkedList_Append(list, payload);
+  }
+  Bench_Report("IntrusiveMembership/rotate", "LinkedList", n,
+               Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  LLIterator_Rewind(lli);
+  while (LLIterator_IsValid(lli) && LLIterator_Remove(lli, NoOpFree)) {
+    LLIterator_Next(lli);
+  }
+  Bench_Report("IntrusiveMembership/remove", "LinkedList (iterator)", n / 2,
+               Bench_NowSeconds() - start);
+  LLIterator_Delete(lli);
+  LinkedList_Delete(list, NoOpFree);
+
+  heap_before = Bench_HeapBytes();
+  start = Bench_NowSeconds();
+  IntrusiveList* ilist = IntrusiveList_New();
+  for (PooledEntry& entry : pool) {
+    IntrusiveList_Append(ilist, &entry.link);
+  }
+  Bench_Report("IntrusiveMembership/append", "IntrusiveList", n,
+               Bench_NowSeconds() - start);
+  Bench_ReportValue("IntrusiveMembership/memory", "IntrusiveList",
+                    "heap bytes/entry",
+                    static_cast<double>(Bench_HeapBytes() - heap_before) /
+                        static_cast<double>(n));
+  ILLink* link;
+  start = Bench_NowSeconds();
+  ILIterator* ili = ILIterator_New(ilist);
+  for (; ILIterator_IsValid(ili); ILIterator_Next(ili)) {
+    ILIterator_Get(ili, &link);
+    sum += IL_CONTAINER_OF(link, PooledEntry, link)->key;
+  }
+  ILIterator_Delete(ili);
+  Bench_Report("IntrusiveMembership/scan", "IntrusiveList", n,
+               Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  for (size_t i = 0; i < n; i++) {
+    IntrusiveList_Pop(ilist, &link);
+    IntrusiveList_Append(ilist, link);
+  }
+  Bench_Report("IntrusiveMembership/rotate", "IntrusiveList", n,
+               Bench_NowSeconds() - start);
+  start = Bench_NowSeconds();
+  for (size_t i = 0; i < n; i += 2) {
+    IntrusiveList_Remove(&pool[i].link);
+  }
+  Bench_Report("IntrusiveMembership/remove", "IntrusiveList (by object)",
+               n / 2, Bench_NowSeconds() - start);
+  IntrusiveList_Delete(ilist, nullptr);
+  Bench_Consume(sum);
+}
+
+// Builds lists from an array of payloads with LinkedList_Append and with
+// LinkedList_AppendMany, then scans and exports each, by iterator and with
+// LinkedList_ToArray.  A third list is appended to on an aged heap (see
+// UnrolledScattered), as long-lived lists usually are.
+BENCH_CASE(BulkBuild) {
+  const size_t n = 2000000 * scale;
+  std::vector<LLPayload_t> payloads(n);
+  for (uint64_t i = 0; i < n; i++) {
+    payloads[i] = Payload(i);
+  }
+  std::vector<LLPayload_t> out(n);
+  uint64_t sum = 0;
+
+  double start = Bench_NowSeconds();
+  LinkedList* appended = LinkedList_New();
+  for (LLPayload_t payload : payloads) {
+    LinkedList_Append(appended, payload);
+  }
+  Bench_Report("BulkBuild/build", "Append", n, Bench_NowSeconds() - start);
+
+  start = Bench_NowSeconds();
+  LinkedList* bulk = LinkedList_New();
+  LinkedList_AppendMany(bulk, payloads.data(), n);
+  Bench_Report("BulkBuild/build", "AppendMany", n, Bench_NowSeconds() - start);
+
+  std::vector<char*> clutter;
+  clutter.reserve(n);
+  srand(1);
+  LinkedList* aged = LinkedList_New();
+  for (LLPayload_t payload : payloads) {
+    clutter.push_back(new char[16 + rand() % 256]);
+    LinkedList_Append(aged, payload);
+  }
+
+  const std::pair<const char*, LinkedList*> k_lists[] = {
+      {"Append", appended}, {"Append (aged heap)", aged}, {"AppendMany", bulk}};
+  for (const auto& [variant, list] : k_lists) {
+    LLPayload_t payload;
+    start = Bench_NowSeconds();
+    LLIterator* lli = LLIterator_New(list);
+    for (; LLIterator_IsValid(lli); LLIterator_Next(lli)) {
+      LLIterator_Get(lli, &payload);
+      sum += reinterpret_cast<uint64_t>(payload);
+    }
+    Bench_Report("BulkBuild/scan", variant, n, Bench_NowSeconds() - start);
+
+    start = Bench_NowSeconds();
+    LLIterator_Rewind(lli);
+    for (size_t i = 0; LLIterator_IsValid(lli); LLIterator_Next(lli), i++) {
+      LLIterator_Get(lli, &out[i]);
+    }
+    LLIterator_Delete(lli);
+    Bench_Report("BulkBuild/export",
+                 (std::string(variant) + ", iterator").c_str(), n,
+                 Bench_NowSeconds() - start);
+
+    start = Bench_NowSeconds();
+    sum += LinkedList_ToArray(list, out.data(), n);
+    Bench_Report("BulkBuild/export",
+                 (std::string(variant) + ", ToArray").c_str(), n,
+                 Bench_NowSeconds() - start);
+    sum += reinterpret_cast<uint64_t>(out[n / 2]);
+
+    start = Bench_NowSeconds();
+    LinkedList_Delete(list, NoOpFree);
+    Bench_Report("BulkBuild/delete", variant, n, Bench_NowSeconds() - start);
+  }
+  for (char* p : clutter) {
+    delete[] p;
+  }
+  Bench_Consume(sum);
+}
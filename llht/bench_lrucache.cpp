@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./LRUCache.hpp"
+#include "./ShardedCache.hpp"
+#include "./bench_util.hpp"
+
+// As in bench_hashtable.cpp, keys and values are small integers stored
+// directly in their slots.
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Returns n keys drawn from a Zipf distribution (exponent s) over
+// [0, keyspace), the usual model of a cache's request stream.
+static std::vector<uint64_t> ZipfKeys(size_t n, size_t keyspace, double s) {
+  std::vector<double> cdf(keyspace);
+  double total = 0;
+  for (size_t k = 0; k < keyspace; k++) {
+    total += 1.0 / std::pow(static_cast<double>(k + 1), s);
+    cdf[k] = total;
+  }
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> uniform(0, total);
+  std::vector<uint64_t> keys(n);
+  for (uint64_t& key : keys) {
+    key = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+  }
+  return keys;
+}
+
+// The usual hand-rolled LRU, for comparison: a std::list of (key,value)s,
+// most recently used first, and a std::unordered_map from each key to its
+// place in the list.
+class StdLRU {
+ public:
+  explicit StdLRU(size_t capacity) : capacity_(capacity) {}
+
+  bool Get(uint64_t key, uint64_t* value) {
+    auto it = map_.find(key);
+    if (it == map_.end()) {
+      return false;
+    }
+    order_.splice(order_.begin(), order_, it->second);
+    *value = it->second->second;
+    return true;
+  }
+
+  void Put(uint64_t key, uint64_t value) {
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      it->second->second = value;
+      order_.splice(order_.begin(), order_, it->second);
+      return;
+    }
+    order_.emplace_front(key, value);
+    map_[key] = order_.begin();
+    if (map_.size() > capacity_) {
+      map_.erase(order_.back().first);
+      order_.pop_back();
+    }
+  }
+
+ private:
+  size_t capacity_;
+  std::list<std::pair<uint64_t, uint64_t>> order_;
+  std::unordered_map<uint64_t,
+                     std::list<std::pair<uint64_t, uint64_t>>::iterator>
+      map_;
+};
+
+// Serves a Zipf-distributed request stream, putting each miss, from caches
+// holding 1% and 10% of the keyspace.  Every variant takes a mutex per
+// request, as a cache shared between threads would, except the bare
+// LRUCache, which shows what the locking costs.
+BENCH_CASE(CacheZipf) {
+  const size_t k_keyspace = 1000000;
+  const size_t n = 4000000 * scale;
+  const std::vector<uint64_t> keys = ZipfKeys(n, k_keyspace, 0.99);
+
+  for (size_t capacity : {k_keyspace / 100, k_keyspace / 10}) {
+    const std::string suffix = "/" + std::to_string(capacity);
+    for (int variant = 0; variant < 3; variant++) {
+      const char* const k_names[] = {"LRUCache", "LRUCache+mutex",
+                                     "std::unordered_map+list+mutex"};
+      const std::string name = k_names[variant] + suffix;
+      std::mutex lock;
+      LRUCache* cache =
+          LRUCache_New(capacity, &CompareInlineKeys, nullptr, nullptr);
+      StdLRU std_lru(capacity);
+      uint64_t hits = 0;
+      uint64_t sum = 0;
+
+      const double start = Bench_NowSeconds();
+      for (uint64_t key : keys) {
+        uint64_t value;
+        bool hit;
+        if (variant == 2) {
+          std::lock_guard<std::mutex> guard(lock);
+          hit = std_lru.Get(key, &value);
+          if (!hit) {
+            std_lru.Put(key, key);
+          }
+        } else {
+          if (variant == 1) {
+            lock.lock();
+          }
+          HTKeyValue_t kv;
+          const HTHash_t hash = MixHash(key);
+          HTKey_t k = reinterpret_cast<HTKey_t>(key);
+          hit = LRUCache_Get(cache, hash, k, &kv);
+          if (hit) {
+            value = reinterpret_cast<uint64_t>(kv.value);
+          } else {
+            HTKeyValue_t old;
+            LRUCache_Put(cache, HTKeyValue_t{hash, k, k}, &old);
+          }
+          if (variant == 1) {
+            lock.unlock();
+          }
+        }
+        if (hit) {
+          hits++;
+          sum += value;
+        }
+      }
+      Bench_Report("CacheZipf", name.c_str(), n, Bench_NowSeconds() - start);
+      Bench_ReportValue("CacheZipf/hit ratio", name.c_str(), "hits/request",
+                        static_cast<double>(hits) / static_cast<double>(n));
+      LRUCache_Delete(cache, &NoOpFree);
+      Bench_Consume(sum);
+    }
+  }
+}
+
+// Returns the Zipf stream with a scan mixed in: every fourth request, in
+// runs of 1000, is for the next of a series of keys that are each requested
+// only once.
+static std::vector<uint64_t> WithScans(std::vector<uint64_t> keys,
+                                       uint64_t keyspace) {
+  uint64_t next_scan_key = keyspace;
+  for (size_t i = 0; i + 1000 <= keys.size(); i += 4000) {
+    for (size_t j = i; j < i + 1000; j++) {
+      keys[j] = next_scan_key++;
+    }
+  }
+  return keys;
+}
+
+// Serves keys from threads that split the stream between them, each putting
+// its misses, and reports the throughput and hit ratio.
+static void RunShared(const char* trace,
+                      const std::string& variant,
+                      const std::vector<uint64_t>& keys,
+                      int num_threads,
+                      bool (*get_or_put)(void* cache, uint64_t key),
+                      void* cache) {
+  std::vector<uint64_t> hits(num_threads, 0);
+  std::vector<std::thread> threads;
+  const size_t per_thread = keys.size() / num_threads;
+  const double start = Bench_NowSeconds();
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      uint64_t thread_hits = 0;
+      for (size_t i = t * per_thread; i < (t + 1) * per_thread; i++) {
+        thread_hits += get_or_put(cache, keys[i]);
+      }
+      hits[t] = thread_hits;
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const double secs = Bench_NowSeconds() - start;
+  const size_t total = per_thread * num_threads;
+  uint64_t total_hits = 0;
+  for (uint64_t thread_hits : hits) {
+    total_hits += thread_hits;
+  }
+  const std::string name = std::string("ShardedZipf/") + trace + "/" +
+                           std::to_string(num_threads) + " threads";
+  Bench_Report(name.c_str(), variant.c_str(), total, secs);
+  Bench_ReportValue((name + "/hit ratio").c_str(), variant.c_str(),
+                    "hits/request",
+                    static_cast<double>(total_hits) /
+                        static_cast<double>(total));
+}
+
+// An LRUCache behind a mutex, as shared in CacheZipf.
+struct LockedLRU {
+  std::mutex lock;
+  LRUCache* cache;
+};
+
+static bool LockedLRUGetOrPut(void* cache, uint64_t key) {
+  LockedLRU* locked = static_cast<LockedLRU*>(cache);
+  const HTHash_t hash = MixHash(key);
+  HTKey_t k = reinterpret_cast<HTKey_t>(key);
+  HTKeyValue_t kv;
+  std::lock_guard<std::mutex> guard(locked->lock);
+  if (LRUCache_Get(locked->cache, hash, k, &kv)) {
+    return true;
+  }
+  HTKeyValue_t old;
+  LRUCache_Put(locked->cache, HTKeyValue_t{hash, k, k}, &old);
+  return false;
+}
+
+static bool ShardedGetOrPut(void* cache, uint64_t key) {
+  ShardedCache* sharded = static_cast<ShardedCache*>(cache);
+  const HTHash_t hash = MixHash(key);
+  HTKey_t k = reinterpret_cast<HTKey_t>(key);
+  HTKeyValue_t kv;
+  if (ShardedCache_Get(sharded, hash, k, &kv)) {
+    return true;
+  }
+  HTKeyValue_t old;
+  ShardedCache_Put(sharded, HTKeyValue_t{hash, k, k}, &old);
+  return false;
+}
+
+// Serves the Zipf stream, with and without scans mixed in, from 1 to 8
+// threads sharing a cache that holds 1% of the keyspace: either a single
+// LRUCache behind a mutex, or a ShardedCache with the same total budget.
+BENCH_CASE(ShardedZipf) {
+  const size_t k_keyspace = 1000000;
+  const size_t k_capacity = k_keyspace / 100;
+  const size_t k_shards = 16;
+  const size_t n = 4000000 * scale;
+  const std::vector<uint64_t> zipf = ZipfKeys(n, k_keyspace, 0.99);
+  const std::vector<uint64_t> scans = WithScans(zipf, k_keyspace);
+
+  for (int trace = 0; trace < 2; trace++) {
+    const std::vector<uint64_t>& keys = (trace == 0) ? zipf : scans;
+    const char* const trace_name = (trace == 0) ? "zipf" : "zipf+scan";
+    for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+      LockedLRU locked;
+      locked.cache =
+          LRUCache_New(k_capacity, &CompareInlineKeys, nullptr, nullptr);
+      RunShared(trace_name, "LRUCache+mutex", keys, num_threads,
+                &LockedLRUGetOrPut, &locked);
+      LRUCache_Delete(locked.cache, &NoOpFree);
+
+      SCOptions_t options{k_shards, k_capacity / k_shards, nullptr, nullptr,
+                          nullptr};
+      ShardedCache* sharded = ShardedCache_New(&options, &CompareInlineKeys);
+      RunShared(trace_name, "ShardedCache/" + std::to_string(k_shards),
+                keys, num_threads, &ShardedGetOrPut, sharded);
+      ShardedCache_Delete(sharded, &NoOpFree);
+    }
+  }
+}
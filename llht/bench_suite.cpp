@@ -0,0 +1,69 @@
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "./bench_util.hpp"
+
+typedef struct {
+  const char* name;
+  BenchFnPtr fn;
+} BenchCase;
+
+// Function-local so that registration from other translation units' static
+// initializers doesn't depend on initialization order.
+static std::vector<BenchCase>& Registry() {
+  static std::vector<BenchCase> registry;
+  return registry;
+}
+
+static volatile uint64_t g_sink = 0;
+
+bool Bench_Register(const char* name, BenchFnPtr fn) {
+  Registry().push_back({name, fn});
+  return true;
+}
+
+double Bench_NowSeconds() {
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(now).count();
+}
+
+size_t Bench_HeapBytes() {
+  return mallinfo2().uordblks;
+}
+
+void Bench_Consume(uint64_t value) {
+  g_sink = g_sink + value;
+}
+
+void Bench_Report(const char* name,
+                  const char* variant,
+                  size_t ops,
+                  double seconds) {
+  printf("%-28s %-28s %12zu ops %10.2f ns/op %10.2f Mops/s\n", name, variant,
+         ops, seconds * 1e9 / static_cast<double>(ops),
+         static_cast<double>(ops) / seconds / 1e6);
+}
+
+void Bench_ReportValue(const char* name,
+                       const char* variant,
+                       const char* metric,
+                       double value) {
+  printf("%-28s %-28s %12.2f %s\n", name, variant, value, metric);
+}
+
+int main(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : "";
+  const size_t scale = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1;
+
+  for (const BenchCase& bc : Registry()) {
+    if (strstr(bc.name, filter) != nullptr) {
+      bc.fn(scale > 0 ? scale : 1);
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#ifndef BENCH_UTIL_HPP_
+#define BENCH_UTIL_HPP_
+
+#include <cstdint>  // for uint64_t, etc.
+#include <cstddef>  // for size_t
+
+///////////////////////////////////////////////////////////////////////////////
+// A tiny benchmark harness for the LinkedList and HashTable modules.
+//
+// Each bench_*.cpp file defines its benchmarks with BENCH_CASE, and
+// bench_suite runs every benchmark whose name contains the (optional)
+// filter given on the command line:
+//
+//     ./bench_suite                # everything, at the default scale
+//     ./bench_suite Compact 10     # names containing "Compact", 10x scale
+//
+// Benchmarks are handed the scale factor (>= 1) and should multiply their
+// default problem sizes by it.  Results are printed with Bench_Report and
+// Bench_ReportValue, one line per measurement.
+
+// A benchmark body.
+typedef void (*BenchFnPtr)(size_t scale);
+
+// Registers a benchmark; used by BENCH_CASE.  Always returns true.
+bool Bench_Register(const char* name, BenchFnPtr fn);
+
+// Returns a monotonic timestamp, in seconds.
+double Bench_NowSeconds();
+
+// Returns the number of bytes currently allocated from the heap.
+size_t Bench_HeapBytes();
+
+// Keeps the compiler from optimizing away a computed value.
+void Bench_Consume(uint64_t value);
+
+// Prints the throughput of "ops" operations that took "seconds" seconds.
+void Bench_Report(const char* name,
+                  const char* variant,
+                  size_t ops,
+                  double seconds);
+
+// Prints an arbitrary measurement, eg, ("bytes/entry", 32.0).
+void Bench_ReportValue(const char* name,
+                       const char* variant,
+                       const char* metric,
+                       double value);
+
+// Defines and registers a benchmark called "name".
+#define BENCH_CASE(name)                                             \
+  static void name(size_t scale);                                    \
+  static const bool g_registered_##name = Bench_Register(#name, name); \
+  static void name(size_t scale)
+
+#endif  // BENCH_UTIL_HPP_
@@ -0,0 +1,92 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "./HashTable.hpp"
+#include "./HashTable_priv.hpp"
+#include "./LinkedList_priv.hpp"
+#include "./WorkStealing.hpp"
+#include "./bench_util.hpp"
+
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+// A cheap, well-mixed stand-in for hashing the key bytes.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Sums the values in buckets [begin, end) of the table into the total.
+struct BucketSum {
+  HashTable* table;
+  std::atomic<uint64_t> total;
+};
+
+static void SumBuckets(size_t begin, size_t end, void* arg) {
+  BucketSum* state = static_cast<BucketSum*>(arg);
+  uint64_t sum = 0;
+  for (size_t b = begin; b < end; b++) {
+    for (LinkedListNode* node = state->table->buckets[b]->head;
+         node != nullptr; node = node->next) {
+      const HTKeyValue_t* kv = static_cast<HTKeyValue_t*>(node->payload);
+      sum += reinterpret_cast<uint64_t>(kv->value);
+    }
+  }
+  state->total.fetch_add(sum, std::memory_order_relaxed);
+}
+
+// Visits every element of a chained table: with an HTIterator, by walking
+// the buckets directly, and by handing ranges of buckets out over a
+// ForkJoinPool of 1 to 8 threads.
+BENCH_CASE(ParallelBuckets) {
+  const size_t n = 2000000 * scale;
+  HashTable* table = HashTable_New(n / 4, CompareInlineKeys);
+  for (uint64_t i = 0; i < n; i++) {
+    HTKeyValue_t old;
+    HashTable_Insert(table,
+                     {MixHash(i), reinterpret_cast<HTKey_t>(i),
+                      reinterpret_cast<HTValue_t>(i)},
+                     &old);
+  }
+
+  double start = Bench_NowSeconds();
+  uint64_t sum = 0;
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    sum += reinterpret_cast<uint64_t>(kv.value);
+  }
+  HTIterator_Delete(it);
+  Bench_Report("ParallelBuckets", "HTIterator", n, Bench_NowSeconds() - start);
+  Bench_Consume(sum);
+
+  BucketSum serial{table, {0}};
+  start = Bench_NowSeconds();
+  SumBuckets(0, table->num_buckets, &serial);
+  Bench_Report("ParallelBuckets", "bucket walk", n, Bench_NowSeconds() - start);
+  Bench_Consume(serial.total.load());
+
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    ForkJoinPool* pool = ForkJoinPool_New(num_threads);
+    BucketSum state{table, {0}};
+    start = Bench_NowSeconds();
+    ForkJoinPool_ParallelFor(pool, 0, table->num_buckets, 1024, SumBuckets,
+                             &state);
+    const std::string variant =
+        "ForkJoinPool/" + std::to_string(num_threads) + " threads";
+    Bench_Report("ParallelBuckets", variant.c_str(), n,
+                 Bench_NowSeconds() - start);
+    Bench_Consume(state.total.load());
+    ForkJoinPool_Delete(pool);
+  }
+  HashTable_Delete(table, NoOpFree);
+}
@@ -0,0 +1,137 @@
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "./ConcurrentQueue.hpp"
+#include "./ConcurrentQueue_priv.hpp"
+
+#include "./catch.hpp"
+
+static LLPayload_t Payload(uint64_t i) {
+  return std::bit_cast<LLPayload_t>(i);
+}
+
+static int g_cq_free_invocations = 0;
+
+static void CountedDelete(LLPayload_t payload) {
+  g_cq_free_invocations++;
+}
+
+TEST_CASE("AppendPop", "[Test_ConcurrentQueue]") {
+  ConcurrentQueue* queue = ConcurrentQueue_New();
+  REQUIRE(queue->head.load() == queue->tail.load());
+  LLPayload_t payload;
+  REQUIRE_FALSE(ConcurrentQueue_Pop(queue, &payload));
+
+  // Single appends and pops come out in FIFO order.
+  for (uint64_t i = 1; i <= 5; i++) {
+    ConcurrentQueue_Append(queue, Payload(i));
+  }
+  for (uint64_t i = 1; i <= 3; i++) {
+    REQUIRE(ConcurrentQueue_Pop(queue, &payload));
+    REQUIRE(Payload(i) == payload);
+  }
+
+  // Batches stay in order, and interleave correctly with single ones.
+  const LLPayload_t batch[] = {Payload(6), Payload(7), Payload(8)};
+  ConcurrentQueue_AppendMany(queue, batch, 3);
+  ConcurrentQueue_AppendMany(queue, batch, 0);
+  ConcurrentQueue_Append(queue, Payload(9));
+  LLPayload_t out[4];
+  REQUIRE(0 == ConcurrentQueue_PopMany(queue, out, 0));
+  REQUIRE(4 == ConcurrentQueue_PopMany(queue, out, 4));
+  for (uint64_t i = 0; i < 4; i++) {
+    REQUIRE(Payload(i + 4) == out[i]);
+  }
+  REQUIRE(2 == ConcurrentQueue_PopMany(queue, out, 4));
+  REQUIRE(Payload(9) == out[1]);
+  REQUIRE(0 == ConcurrentQueue_PopMany(queue, out, 4));
+  REQUIRE(queue->head.load() == queue->tail.load());
+  REQUIRE(nullptr == queue->head.load()->next.load());
+
+  // Popped nodes are eventually freed, rather than piling up.
+  for (uint64_t i = 0; i < 100000; i++) {
+    ConcurrentQueue_Append(queue, Payload(i));
+    REQUIRE(ConcurrentQueue_Pop(queue, &payload));
+  }
+  REQUIRE(ConcurrentQueue_NumRetired() < 1000);
+
+  // Deleting frees the payloads still queued.
+  g_cq_free_invocations = 0;
+  ConcurrentQueue_AppendMany(queue, batch, 3);
+  ConcurrentQueue_Delete(queue, &CountedDelete);
+  REQUIRE(3 == g_cq_free_invocations);
+}
+
+TEST_CASE("ManyThreads", "[Test_ConcurrentQueue]") {
+  // Producers append (some singly, some in batches) values tagged with
+  // their id; consumers pop (likewise) until they've seen everything.
+  // Every value must come out exactly once, and each producer's values in
+  // the order that producer appended them.
+  constexpr int k_producers = 4;
+  constexpr int k_consumers = 4;
+  constexpr uint64_t k_per_producer = 20000;
+  ConcurrentQueue* queue = ConcurrentQueue_New();
+  std::atomic<uint64_t> num_popped{0};
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < k_producers; p++) {
+    threads.emplace_back([queue, p] {
+      const uint64_t tag = static_cast<uint64_t>(p) << 32;
+      for (uint64_t i = 1; i <= k_per_producer;) {
+        if (p % 2 == 0) {
+          ConcurrentQueue_Append(queue, Payload(tag | i++));
+        } else {
+          LLPayload_t batch[7];
+          size_t n = 0;
+          for (; n < 7 && i <= k_per_producer; n++) {
+            batch[n] = Payload(tag | i++);
+          }
+          ConcurrentQueue_AppendMany(queue, batch, n);
+        }
+      }
+    });
+  }
+
+  std::vector<std::vector<uint64_t>> seen(k_consumers);
+  for (int c = 0; c < k_consumers; c++) {
+    threads.emplace_back([queue, c, &seen, &num_popped] {
+      constexpr uint64_t k_total = k_producers * k_per_producer;
+      LLPayload_t out[5];
+      while (num_popped.load() < k_total) {
+        const size_t n = ConcurrentQueue_PopMany(queue, out, c % 2 ? 5 : 1);
+        for (size_t i = 0; i < n; i++) {
+          seen[c].push_back(std::bit_cast<uint64_t>(out[i]));
+        }
+        if (n == 0) {
+          std::this_thread::yield();
+        }
+        num_popped.fetch_add(n);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<uint64_t> num_seen(k_producers, 0);
+  for (const std::vector<uint64_t>& values : seen) {
+    std::vector<uint64_t> last(k_producers, 0);
+    for (uint64_t v : values) {
+      const uint64_t p = v >> 32;
+      const uint64_t i = v & 0xffffffff;
+      REQUIRE(p < k_producers);
+      REQUIRE(last[p] < i);
+      last[p] = i;
+      num_seen[p]++;
+    }
+  }
+  for (uint64_t n : num_seen) {
+    REQUIRE(k_per_producer == n);
+  }
+  LLPayload_t payload;
+  REQUIRE_FALSE(ConcurrentQueue_Pop(queue, &payload));
+  ConcurrentQueue_Delete(queue, &CountedDelete);
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "./GroupBy.hpp"
+#include "./GroupBy_priv.hpp"
+#include "./WorkStealing.hpp"
+
+#include "./catch.hpp"
+
+// The tests store small integers directly in the key and value slots.
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+// Spreads keys over every bit of the hash, so that they spread over the
+// partitions too.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static HTKeyValue_t Record(uint64_t key, uint64_t value) {
+  return HTKeyValue_t{MixHash(key), reinterpret_cast<HTKey_t>(key),
+                      reinterpret_cast<HTValue_t>(value)};
+}
+
+static uint64_t AsInt(void* slot) {
+  return reinterpret_cast<uint64_t>(slot);
+}
+
+static HTValue_t Sum(HTValue_t acc, HTValue_t value) {
+  return reinterpret_cast<HTValue_t>(AsInt(acc) + AsInt(value));
+}
+
+static HTValue_t Max(HTValue_t acc, HTValue_t value) {
+  return AsInt(acc) > AsInt(value) ? acc : value;
+}
+
+// Collects groups as a map from key to value.
+typedef struct {
+  std::mutex lock;
+  std::map<uint64_t, uint64_t> groups;
+  size_t num_calls;
+} Collected;
+
+static void Collect(const HTKeyValue_t* groups, size_t num_groups,
+                    void* arg) {
+  Collected* collected = static_cast<Collected*>(arg);
+  std::lock_guard<std::mutex> lk(collected->lock);
+  collected->num_calls++;
+  for (size_t i = 0; i < num_groups; i++) {
+    // Every group comes out exactly once.
+    REQUIRE(collected->groups
+                .emplace(AsInt(groups[i].key), AsInt(groups[i].value))
+                .second);
+  }
+}
+
+TEST_CASE("Aggregate", "[Test_GroupBy]") {
+  CompactTable* table = CompactTable_New(k_gb_initial_buckets,
+                                         CompareInlineKeys);
+  for (uint64_t i = 0; i < 10000; i++) {
+    GroupBy_Aggregate(table, Record(i % 100, i), Sum);
+  }
+  // Values are combined in place, without adding entries.
+  REQUIRE(100 == table->num_elements);
+  for (uint64_t k = 0; k < 100; k++) {
+    HTKeyValue_t kv;
+    REQUIRE(CompactTable_Find(table, MixHash(k),
+                              reinterpret_cast<HTKey_t>(k), &kv));
+    // k + (k + 100) + ... + (k + 9900)
+    REQUIRE(100 * k + 495000 == AsInt(kv.value));
+  }
+  CompactTable_Delete(table, nullptr);
+
+  REQUIRE(0 == GroupBy_PickRadixBits(1));
+  REQUIRE(3 == GroupBy_PickRadixBits(2));
+  REQUIRE(4 == GroupBy_PickRadixBits(3));
+  REQUIRE(k_gb_max_radix_bits == GroupBy_PickRadixBits(1 << 20));
+}
+
+TEST_CASE("GroupBy", "[Test_GroupBy]") {
+  // Counts and maxima of 200000 records over 30000 keys, skewed so that
+  // low keys have many more records than high ones.
+  std::vector<HTKeyValue_t> ones;
+  std::vector<HTKeyValue_t> values;
+  std::map<uint64_t, uint64_t> counts;
+  std::map<uint64_t, uint64_t> maxima;
+  for (uint64_t i = 0; i < 200000; i++) {
+    const uint64_t key = (MixHash(i) % 30000) * (MixHash(i + 1) % 30000) /
+                         30000;
+    ones.push_back(Record(key, 1));
+    values.push_back(Record(key, MixHash(i) >> 40));
+    counts[key]++;
+    maxima[key] = std::max(maxima[key], MixHash(i) >> 40);
+  }
+
+  SECTION("on one thread") {
+    for (int radix_bits : {0, 1, 6, 12}) {
+      GBOptions_t options{nullptr, radix_bits};
+      Collected collected;
+      collected.num_calls = 0;
+      REQUIRE(counts.size() == GroupBy_Run(ones.data(), ones.size(),
+                                           CompareInlineKeys, Sum, &options,
+                                           Collect, &collected));
+      REQUIRE(counts == collected.groups);
+    }
+  }
+
+  SECTION("on a pool") {
+    for (int num_threads : {2, 3, 8}) {
+      ForkJoinPool* pool = ForkJoinPool_New(num_threads);
+      GBOptions_t options{pool, 0};
+      Collected collected;
+      collected.num_calls = 0;
+      REQUIRE(counts.size() == GroupBy_Run(ones.data(), ones.size(),
+                                           CompareInlineKeys, Sum, &options,
+                                           Collect, &collected));
+      REQUIRE(counts == collected.groups);
+
+      Collected max_collected;
+      max_collected.num_calls = 0;
+      REQUIRE(maxima.size() == GroupBy_Run(values.data(), values.size(),
+                                           CompareInlineKeys, Max, &options,
+                                           Collect, &max_collected));
+      REQUIRE(maxima == max_collected.groups);
+      // Groups are handed over in batches.
+      REQUIRE(max_collected.num_calls <
+              maxima.size() / (k_gb_emit_batch / 2) +
+                  (size_t{1} << GroupBy_PickRadixBits(num_threads)));
+      ForkJoinPool_Delete(pool);
+    }
+  }
+
+  SECTION("with fewer records than threads") {
+    ForkJoinPool* pool = ForkJoinPool_New(4);
+    GBOptions_t options{pool, 0};
+    Collected collected;
+    collected.num_calls = 0;
+    REQUIRE(1 == GroupBy_Run(ones.data(), 1, CompareInlineKeys, Sum,
+                             &options, Collect, &collected));
+    REQUIRE(1 == collected.groups.size());
+    REQUIRE(0 == GroupBy_Run(ones.data(), 0, CompareInlineKeys, Sum,
+                             &options, Collect, &collected));
+    ForkJoinPool_Delete(pool);
+  }
+}
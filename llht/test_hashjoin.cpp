@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "./HashJoin.hpp"
+#include "./HashJoin_priv.hpp"
+#include "./WorkStealing.hpp"
+
+#include "./catch.hpp"
+
+// The tests store small integers directly in the key and value slots.
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+// Spreads keys over every bit of the hash, so that they spread over the
+// partitions too.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static HTKeyValue_t Record(uint64_t key, uint64_t value) {
+  return HTKeyValue_t{MixHash(key), reinterpret_cast<HTKey_t>(key),
+                      reinterpret_cast<HTValue_t>(value)};
+}
+
+static uint64_t AsInt(void* slot) {
+  return reinterpret_cast<uint64_t>(slot);
+}
+
+// Collects matches as (build value, probe value) pairs.
+typedef struct {
+  std::mutex lock;
+  std::vector<std::pair<uint64_t, uint64_t>> pairs;
+  size_t num_calls;
+} Collected;
+
+static void Collect(const HJMatch_t* matches, size_t num_matches, void* arg) {
+  Collected* collected = static_cast<Collected*>(arg);
+  std::lock_guard<std::mutex> lk(collected->lock);
+  collected->num_calls++;
+  for (size_t i = 0; i < num_matches; i++) {
+    // Every match must be between equal keys.
+    REQUIRE(matches[i].build.key == matches[i].probe.key);
+    collected->pairs.emplace_back(AsInt(matches[i].build.value),
+                                  AsInt(matches[i].probe.value));
+  }
+}
+
+// Returns the (build value, probe value) pairs a nested-loop join would
+// produce, sorted.
+static std::vector<std::pair<uint64_t, uint64_t>> ExpectedPairs(
+    const std::vector<HTKeyValue_t>& build,
+    const std::vector<HTKeyValue_t>& probe) {
+  std::multimap<uint64_t, uint64_t> by_key;
+  for (const HTKeyValue_t& kv : build) {
+    by_key.emplace(AsInt(kv.key), AsInt(kv.value));
+  }
+  std::vector<std::pair<uint64_t, uint64_t>> pairs;
+  for (const HTKeyValue_t& kv : probe) {
+    auto range = by_key.equal_range(AsInt(kv.key));
+    for (auto it = range.first; it != range.second; ++it) {
+      pairs.emplace_back(it->second, AsInt(kv.value));
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+TEST_CASE("Partition", "[Test_HashJoin]") {
+  std::vector<HTKeyValue_t> records;
+  for (uint64_t i = 0; i < 100000; i++) {
+    records.push_back(Record(i % 30000, i));
+  }
+
+  for (int radix_bits : {0, 1, 6, 12}) {
+    HJPartitions parts;
+    HashJoin_Partition(records.data(), records.size(), radix_bits, nullptr,
+                       &parts);
+    REQUIRE(radix_bits == parts.radix_bits);
+    REQUIRE(0 == parts.starts[0]);
+    REQUIRE(records.size() == parts.starts[size_t{1} << radix_bits]);
+
+    // Every record lands in its own partition, once, and each chunk's
+    // records keep their order.
+    std::vector<bool> seen(records.size(), false);
+    for (size_t p = 0; p < (size_t{1} << radix_bits); p++) {
+      REQUIRE(parts.starts[p] <= parts.starts[p + 1]);
+      for (size_t i = parts.starts[p]; i < parts.starts[p + 1]; i++) {
+        REQUIRE(p == HashJoin_PartitionOf(parts.rows[i].hash, radix_bits));
+        const uint64_t value = AsInt(parts.rows[i].value);
+        REQUIRE_FALSE(seen[value]);
+        seen[value] = true;
+      }
+    }
+    REQUIRE(std::count(seen.begin(), seen.end(), true) ==
+            static_cast<ptrdiff_t>(records.size()));
+    HashJoin_FreePartitions(&parts);
+  }
+
+  REQUIRE(0 == HashJoin_PickRadixBits(0));
+  REQUIRE(0 == HashJoin_PickRadixBits(k_hj_partition_rows));
+  REQUIRE(1 == HashJoin_PickRadixBits(k_hj_partition_rows + 1));
+  REQUIRE(k_hj_max_radix_bits == HashJoin_PickRadixBits(SIZE_MAX));
+}
+
+TEST_CASE("Join", "[Test_HashJoin]") {
+  // Build keys repeat up to three times, and probe keys up to twice; a
+  // third of the probe keys have no match.
+  std::vector<HTKeyValue_t> build;
+  std::vector<HTKeyValue_t> probe;
+  for (uint64_t i = 0; i < 40000; i++) {
+    build.push_back(Record(MixHash(i) % 20000, i));
+  }
+  for (uint64_t i = 0; i < 60000; i++) {
+    probe.push_back(Record(MixHash(i + 1000000) % 30000, i));
+  }
+  const std::vector<std::pair<uint64_t, uint64_t>> expected =
+      ExpectedPairs(build, probe);
+  REQUIRE(expected.size() > probe.size());
+
+  SECTION("on one thread") {
+    for (int radix_bits : {0, 1, 5, 12}) {
+      Collected collected;
+      collected.num_calls = 0;
+      HJOptions_t options{nullptr, radix_bits};
+      REQUIRE(expected.size() ==
+              HashJoin_Run(build.data(), build.size(), probe.data(),
+                           probe.size(), CompareInlineKeys, &options,
+                           Collect, &collected));
+      std::sort(collected.pairs.begin(), collected.pairs.end());
+      REQUIRE(expected == collected.pairs);
+      // Matches are handed over in batches.
+      REQUIRE(collected.num_calls <
+              expected.size() / (k_hj_emit_batch / 2));
+    }
+  }
+
+  SECTION("on a pool") {
+    ForkJoinPool* pool = ForkJoinPool_New(4);
+    HJOptions_t options{pool, 0};
+    Collected collected;
+    collected.num_calls = 0;
+    REQUIRE(expected.size() ==
+            HashJoin_Run(build.data(), build.size(), probe.data(),
+                         probe.size(), CompareInlineKeys, &options, Collect,
+                         &collected));
+    std::sort(collected.pairs.begin(), collected.pairs.end());
+    REQUIRE(expected == collected.pairs);
+    ForkJoinPool_Delete(pool);
+  }
+
+  SECTION("with no options") {
+    Collected collected;
+    collected.num_calls = 0;
+    REQUIRE(expected.size() ==
+            HashJoin_Run(build.data(), build.size(), probe.data(),
+                         probe.size(), CompareInlineKeys, nullptr, Collect,
+                         &collected));
+    std::sort(collected.pairs.begin(), collected.pairs.end());
+    REQUIRE(expected == collected.pairs);
+  }
+
+  SECTION("with an empty side") {
+    Collected collected;
+    collected.num_calls = 0;
+    REQUIRE(0 == HashJoin_Run(build.data(), 0, probe.data(), probe.size(),
+                              CompareInlineKeys, nullptr, Collect,
+                              &collected));
+    REQUIRE(0 == HashJoin_Run(build.data(), build.size(), probe.data(), 0,
+                              CompareInlineKeys, nullptr, Collect,
+                              &collected));
+    REQUIRE(0 == collected.num_calls);
+  }
+}
+
+TEST_CASE("JoinCollidingHashes", "[Test_HashJoin]") {
+  // Keys that share a hash only match when the keys compare equal.
+  std::vector<HTKeyValue_t> build;
+  std::vector<HTKeyValue_t> probe;
+  for (uint64_t i = 0; i < 1000; i++) {
+    build.push_back(HTKeyValue_t{42, reinterpret_cast<HTKey_t>(i % 10),
+                                 reinterpret_cast<HTValue_t>(i)});
+  }
+  for (uint64_t i = 0; i < 20; i++) {
+    probe.push_back(HTKeyValue_t{42, reinterpret_cast<HTKey_t>(i),
+                                 reinterpret_cast<HTValue_t>(i)});
+  }
+  Collected collected;
+  collected.num_calls = 0;
+  REQUIRE(1000 == HashJoin_Run(build.data(), build.size(), probe.data(),
+                               probe.size(), CompareInlineKeys, nullptr,
+                               Collect, &collected));
+  std::sort(collected.pairs.begin(), collected.pairs.end());
+  REQUIRE(ExpectedPairs(build, probe) == collected.pairs);
+}
@@ -1,10 +1,22 @@
+#include <unistd.h>
+
+#include <algorithm>
 #include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "./HashTable.hpp"
 #include "./HashTable_priv.hpp"
 #include "./LinkedList.hpp"
 #include "./LinkedList_priv.hpp"
+#include "./PerfectHash_priv.hpp"
+#include "./TableDelta_priv.hpp"
+#include "./TableExpiry_priv.hpp"
+#include "./TableImage_priv.hpp"
 
 #include "./catch.hpp"
 
@@ -40,8 +52,37 @@ static bool CompareKeys(HTKey_t lhs, HTKey_t rhs) {
   return *lhs_str == *rhs_str;
 }
 
+static bool ComparePointers(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
 static void NoOpDelete(HTKeyValue_t delete_me) {}
 
+// Returns the name of a fresh, empty temporary file.
+static string TempPath() {
+  char path[] = "/tmp/test_hashtable_XXXXXX";
+  const int fd = mkstemp(path);
+  REQUIRE(fd >= 0);
+  close(fd);
+  return path;
+}
+
+// Overwrites the byte at offset within the file at path.
+static void CorruptByte(const string& path, long offset) {
+  FILE* f = fopen(path.c_str(), "r+b");
+  REQUIRE(f != nullptr);
+  REQUIRE(0 == fseek(f, offset, SEEK_SET));
+  const int c = fgetc(f);
+  REQUIRE(0 == fseek(f, offset, SEEK_SET));
+  fputc(c ^ 0x5a, f);
+  fclose(f);
+}
+
+static HTHash_t HashString(const string& str) {
+  return FNVHash64(reinterpret_cast<unsigned char*>(const_cast<char*>(str.data())),
+                   static_cast<int>(str.size()));
+}
+
 // listener to reset the g_free_invocations to 0 before every test
 class HTTestSetupListener : public Catch::EventListenerBase {
 public:
@@ -447,3 +488,1504 @@ TEST_CASE("Resize", "[Test_HashTable]") {
 
   HashTable_Delete(table, NoOpDelete);
 }
+
+TEST_CASE("CompactInsertFindRemove", "[Test_HashTable]") {
+  HashTable* table = HashTable_NewCompact(2, CompareKeys);
+  REQUIRE(table->compact != nullptr);
+  REQUIRE(0 == HashTable_NumElements(table));
+
+  // Insert enough elements to force several resizes.  Every key shares its
+  // bucket with others, and keys 100 apart even share the low 32 bits of
+  // their hashes, so we exercise the tag and full-hash checks.
+  for (int i = 0; i < 200; i++) {
+    const HTHash_t hash =
+        (static_cast<HTHash_t>(i / 100) << 32) | static_cast<HTHash_t>(i % 100);
+    HTKeyValue_t oldkv{};
+    const HTKeyValue_t newkv{hash, new string(to_string(i)),
+                             new Payload{k_magic_num, i}};
+    REQUIRE_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    REQUIRE(i + 1 == static_cast<int>(HashTable_NumElements(table)));
+  }
+  REQUIRE(2 < table->compact->num_buckets);
+
+  for (int i = 0; i < 200; i++) {
+    const HTHash_t hash =
+        (static_cast<HTHash_t>(i / 100) << 32) | static_cast<HTHash_t>(i % 100);
+    string key = to_string(i);
+    HTKeyValue_t oldkv{};
+    REQUIRE(HashTable_Find(table, hash, &key, &oldkv));
+    REQUIRE(hash == oldkv.hash);
+    REQUIRE(i == static_cast<Payload*>(oldkv.value)->payload_num);
+
+    // The same key under a different hash is a different element.
+    REQUIRE_FALSE(HashTable_Find(table, hash ^ (1ULL << 40), &key, &oldkv));
+  }
+
+  // Replace one value.
+  string* key = new string("7");
+  Payload* np = new Payload{k_magic_num, 1007};
+  HTKeyValue_t oldkv{};
+  REQUIRE(HashTable_Insert(table, {7, key, np}, &oldkv));
+  REQUIRE(7 == static_cast<Payload*>(oldkv.value)->payload_num);
+  VerifiedDelete(oldkv);
+  REQUIRE(HashTable_Find(table, 7, key, &oldkv));
+  REQUIRE(static_cast<HTValue_t>(np) == oldkv.value);
+  REQUIRE(200 == HashTable_NumElements(table));
+
+  // Remove every other element; the survivors must all still be found,
+  // even though removal shuffles entries around to keep them dense.
+  for (int i = 0; i < 200; i += 2) {
+    const HTHash_t hash =
+        (static_cast<HTHash_t>(i / 100) << 32) | static_cast<HTHash_t>(i % 100);
+    string key = to_string(i);
+    REQUIRE(HashTable_Remove(table, hash, &key, &oldkv));
+    REQUIRE(i == static_cast<Payload*>(oldkv.value)->payload_num);
+    VerifiedDelete(oldkv);
+    REQUIRE_FALSE(HashTable_Remove(table, hash, &key, &oldkv));
+  }
+  REQUIRE(100 == HashTable_NumElements(table));
+  for (int i = 1; i < 200; i += 2) {
+    const HTHash_t hash =
+        (static_cast<HTHash_t>(i / 100) << 32) | static_cast<HTHash_t>(i % 100);
+    string key = to_string(i);
+    REQUIRE(HashTable_Find(table, hash, &key, &oldkv));
+    REQUIRE(CompareKeys(&key, oldkv.key));
+  }
+
+  HashTable_Delete(table, &InstrumentedDelete);
+  REQUIRE(100 == g_free_invocations);
+}
+
+TEST_CASE("CompactIterator", "[Test_HashTable]") {
+  HashTable* table = HashTable_NewCompact(10, CompareKeys);
+  HTKeyValue_t oldkv{};
+
+  HTIterator* it = HTIterator_New(table);
+  REQUIRE_FALSE(HTIterator_IsValid(it));
+  REQUIRE_FALSE(HTIterator_Get(it, &oldkv));
+  REQUIRE_FALSE(HTIterator_Next(it));
+  HTIterator_Delete(it);
+
+  for (int i = 0; i < 100; i++) {
+    const HTKeyValue_t newkv{static_cast<HTHash_t>(i),
+                             new string(to_string(i)),
+                             new Payload{k_magic_num, i}};
+    REQUIRE_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  }
+
+  // Remove every third element through the iterator, making sure that every
+  // element is still visited exactly once.
+  std::array<int, 100> num_times_seen = {0};
+  it = HTIterator_New(table);
+  for (int i = 0; i < 100; i++) {
+    REQUIRE(HTIterator_IsValid(it));
+    REQUIRE(HTIterator_Get(it, &oldkv));
+    const int htkey = static_cast<int>(oldkv.hash);
+    num_times_seen.at(htkey)++;
+    if (htkey % 3 == 0) {
+      REQUIRE(HTIterator_Remove(it, &oldkv));
+      REQUIRE(htkey == static_cast<int>(oldkv.hash));
+      VerifiedDelete(oldkv);
+    } else {
+      HTIterator_Next(it);
+    }
+  }
+  REQUIRE_FALSE(HTIterator_IsValid(it));
+  HTIterator_Delete(it);
+  for (int i = 0; i < 100; i++) {
+    REQUIRE(1 == num_times_seen.at(i));
+  }
+  REQUIRE(66 == HashTable_NumElements(table));
+
+  HashTable_Delete(table, &InstrumentedDelete);
+  REQUIRE(66 == g_free_invocations);
+}
+
+TEST_CASE("MemoryBytes", "[Test_HashTable]") {
+  HashTable* chained = HashTable_New(100, ComparePointers);
+  HashTable* compact = HashTable_NewCompact(100, ComparePointers);
+  const size_t chained_empty = HashTable_MemoryBytes(chained);
+  const size_t compact_empty = HashTable_MemoryBytes(compact);
+  REQUIRE(compact_empty < chained_empty);
+
+  HTKeyValue_t oldkv;
+  for (int i = 0; i < 256; i++) {
+    const HTKeyValue_t newkv{static_cast<HTHash_t>(i),
+                             reinterpret_cast<HTKey_t>(static_cast<int64_t>(i)),
+                             nullptr};
+    HashTable_Insert(chained, newkv, &oldkv);
+    HashTable_Insert(compact, newkv, &oldkv);
+  }
+  const size_t chained_per_entry =
+      (HashTable_MemoryBytes(chained) - chained_empty) / 256;
+  const size_t compact_per_entry =
+      (HashTable_MemoryBytes(compact) - compact_empty) / 256;
+  REQUIRE(compact_per_entry * 3 / 2 <= chained_per_entry);
+
+  HashTable_Delete(chained, &NoOpDelete);
+  HashTable_Delete(compact, &NoOpDelete);
+}
+
+TEST_CASE("StringKeys", "[Test_HashTable]") {
+  HashTable* table = HashTable_NewStringKeys(2);
+  REQUIRE(table->compact != nullptr);
+  REQUIRE(table->compact->string_keys);
+
+  // Insert keys built on the stack; the table must keep its own copies.
+  HTKeyValue_t oldkv{};
+  for (int i = 0; i < 100; i++) {
+    string keystr = "key" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    const HTHash_t hash = FNVHash64(
+        reinterpret_cast<unsigned char*>(keystr.data()),
+        static_cast<int>(keystr.size()));
+    const HTKeyValue_t newkv{hash, &key,
+                             reinterpret_cast<HTValue_t>(static_cast<int64_t>(i))};
+    REQUIRE_FALSE(HashTable_Insert(table, newkv, &oldkv));
+    keystr.assign("clobbered");
+  }
+  REQUIRE(100 == HashTable_NumElements(table));
+
+  for (int i = 0; i < 100; i++) {
+    string keystr = "key" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    const HTHash_t hash = FNVHash64(
+        reinterpret_cast<unsigned char*>(keystr.data()),
+        static_cast<int>(keystr.size()));
+    REQUIRE(HashTable_Find(table, hash, &key, &oldkv));
+    REQUIRE(&key == oldkv.key);
+    REQUIRE(i == reinterpret_cast<int64_t>(oldkv.value));
+
+    // A prefix of the key, under the same hash, is a different key.
+    HTStringKey_t prefix{keystr.data(), keystr.size() - 1};
+    REQUIRE_FALSE(HashTable_Find(table, hash, &prefix, &oldkv));
+  }
+
+  // Replace a value; the key stays the same.
+  string keystr = "key42";
+  HTStringKey_t key{keystr.data(), keystr.size()};
+  const HTHash_t hash42 = FNVHash64(
+      reinterpret_cast<unsigned char*>(keystr.data()),
+      static_cast<int>(keystr.size()));
+  REQUIRE(HashTable_Insert(table, {hash42, &key, nullptr}, &oldkv));
+  REQUIRE(42 == reinterpret_cast<int64_t>(oldkv.value));
+  REQUIRE(HashTable_Find(table, hash42, &key, &oldkv));
+  REQUIRE(nullptr == oldkv.value);
+
+  // Every key the iterator hands back describes the table's own copy.
+  int num_seen = 0;
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    REQUIRE(HTIterator_Get(it, &oldkv));
+    const HTStringKey_t* seen = static_cast<HTStringKey_t*>(oldkv.key);
+    const string seenstr(static_cast<const char*>(seen->bytes), seen->len);
+    REQUIRE(0 == seenstr.rfind("key", 0));
+    num_seen++;
+  }
+  HTIterator_Delete(it);
+  REQUIRE(100 == num_seen);
+
+  // Remove most keys through the iterator, then insert more: the removed
+  // keys' bytes are reclaimed instead of growing the arena forever.
+  it = HTIterator_New(table);
+  while (HTIterator_IsValid(it) && HashTable_NumElements(table) > 10) {
+    REQUIRE(HTIterator_Remove(it, &oldkv));
+  }
+  HTIterator_Delete(it);
+  REQUIRE(10 == HashTable_NumElements(table));
+  const size_t arena_capacity = table->compact->arena_capacity;
+  for (int i = 0; i < 1000; i++) {
+    string keystr = "churn" + to_string(i % 50);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    const HTHash_t hash = FNVHash64(
+        reinterpret_cast<unsigned char*>(keystr.data()),
+        static_cast<int>(keystr.size()));
+    if (i % 2 == 0) {
+      HashTable_Insert(table, {hash, &key, nullptr}, &oldkv);
+    } else {
+      HashTable_Remove(table, hash, &key, &oldkv);
+    }
+  }
+  REQUIRE(table->compact->arena_capacity <= 2 * arena_capacity);
+  REQUIRE(table->compact->arena_live <= table->compact->arena_used);
+
+  // Empty keys are keys too.
+  HTStringKey_t empty{nullptr, 0};
+  REQUIRE_FALSE(HashTable_Insert(table, {0, &empty, nullptr}, &oldkv));
+  REQUIRE(HashTable_Find(table, 0, &empty, &oldkv));
+  REQUIRE(HashTable_Remove(table, 0, &empty, &oldkv));
+
+  // The table owns the keys, so there's nothing for the caller to free.
+  HashTable_Delete(table, nullptr);
+}
+
+TEST_CASE("SaveOpen", "[Test_HashTable]") {
+  const string path = TempPath();
+  HTKeyValue_t oldkv{};
+
+  // Build a string-key table, including some garbage in its arena.
+  HashTable* table = HashTable_NewStringKeys(4);
+  for (int i = 0; i < 500; i++) {
+    string keystr = "k" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    const HTKeyValue_t newkv{HashString(keystr), &key,
+                             reinterpret_cast<HTValue_t>(static_cast<int64_t>(i))};
+    HashTable_Insert(table, newkv, &oldkv);
+  }
+  for (int i = 0; i < 500; i += 5) {
+    string keystr = "k" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    REQUIRE(HashTable_Remove(table, HashString(keystr), &key, &oldkv));
+  }
+  REQUIRE(HashTable_Save(table, path.c_str()));
+  HashTable_Delete(table, nullptr);
+
+  // Open it read-only; everything is served straight from the file.
+  table = HashTable_Open(path.c_str(), nullptr, k_ht_open_verify);
+  REQUIRE(table != nullptr);
+  REQUIRE(400 == HashTable_NumElements(table));
+  for (int i = 0; i < 500; i++) {
+    string keystr = "k" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    if (i % 5 == 0) {
+      REQUIRE_FALSE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+    } else {
+      REQUIRE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+      REQUIRE(i == reinterpret_cast<int64_t>(oldkv.value));
+    }
+  }
+  int num_seen = 0;
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    REQUIRE(HTIterator_Get(it, &oldkv));
+    const HTStringKey_t* key = static_cast<HTStringKey_t*>(oldkv.key);
+    const string keystr(static_cast<const char*>(key->bytes), key->len);
+    REQUIRE(to_string(reinterpret_cast<int64_t>(oldkv.value)) ==
+            keystr.substr(1));
+    num_seen++;
+  }
+  HTIterator_Delete(it);
+  REQUIRE(400 == num_seen);
+
+  // A read-only table refuses changes.
+  string keystr = "k1";
+  HTStringKey_t key{keystr.data(), keystr.size()};
+  REQUIRE_FALSE(HashTable_Insert(table, {HashString(keystr), &key, nullptr},
+                                 &oldkv));
+  REQUIRE_FALSE(HashTable_Remove(table, HashString(keystr), &key, &oldkv));
+  REQUIRE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+  REQUIRE(1 == reinterpret_cast<int64_t>(oldkv.value));
+  HashTable_Delete(table, nullptr);
+
+  // A writable table can be modified freely, without touching the file.
+  table = HashTable_Open(path.c_str(), nullptr, k_ht_open_writable);
+  REQUIRE(table != nullptr);
+  REQUIRE(HashTable_Insert(table, {HashString(keystr), &key, nullptr}, &oldkv));
+  REQUIRE(HashTable_Remove(table, HashString(keystr), &key, &oldkv));
+  for (int i = 500; i < 2000; i++) {
+    string newkeystr = "k" + to_string(i);
+    HTStringKey_t newkey{newkeystr.data(), newkeystr.size()};
+    REQUIRE_FALSE(HashTable_Insert(table, {HashString(newkeystr), &newkey,
+                                           nullptr}, &oldkv));
+  }
+  REQUIRE(1899 == HashTable_NumElements(table));
+  HashTable_Delete(table, nullptr);
+
+  table = HashTable_Open(path.c_str(), nullptr, k_ht_open_verify);
+  REQUIRE(table != nullptr);
+  REQUIRE(400 == HashTable_NumElements(table));
+  REQUIRE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+  HashTable_Delete(table, nullptr);
+
+  // Damage to the header is always caught; damage elsewhere is caught when
+  // verifying.
+  CorruptByte(path, sizeof(HTImageHeader) + 3);
+  table = HashTable_Open(path.c_str(), nullptr, 0);
+  REQUIRE(table != nullptr);
+  HashTable_Delete(table, nullptr);
+  REQUIRE(nullptr == HashTable_Open(path.c_str(), nullptr, k_ht_open_verify));
+  CorruptByte(path, 9);
+  REQUIRE(nullptr == HashTable_Open(path.c_str(), nullptr, 0));
+  REQUIRE(nullptr == HashTable_Open("/nonexistent/snapshot", nullptr, 0));
+
+  remove(path.c_str());
+}
+
+TEST_CASE("SaveOpenChained", "[Test_HashTable]") {
+  const string path = TempPath();
+  HTKeyValue_t oldkv{};
+
+  // Keys and values stored directly in the table survive the round trip.
+  HashTable* table = HashTable_New(7, ComparePointers);
+  for (int64_t i = 0; i < 100; i++) {
+    const HTKeyValue_t newkv{static_cast<HTHash_t>(i * 31),
+                             reinterpret_cast<HTKey_t>(i),
+                             reinterpret_cast<HTValue_t>(i * i)};
+    HashTable_Insert(table, newkv, &oldkv);
+  }
+  REQUIRE(HashTable_Save(table, path.c_str()));
+
+  HashTable* opened =
+      HashTable_Open(path.c_str(), ComparePointers, k_ht_open_verify);
+  REQUIRE(opened != nullptr);
+  REQUIRE(HashTable_NumElements(table) == HashTable_NumElements(opened));
+  for (int64_t i = 0; i < 100; i++) {
+    REQUIRE(HashTable_Find(opened, static_cast<HTHash_t>(i * 31),
+                           reinterpret_cast<HTKey_t>(i), &oldkv));
+    REQUIRE(i * i == reinterpret_cast<int64_t>(oldkv.value));
+  }
+
+  HashTable_Delete(opened, &NoOpDelete);
+  HashTable_Delete(table, &NoOpDelete);
+  remove(path.c_str());
+}
+
+// Requires that expected and actual hold the same keys, with the same values.
+static void RequireSameContents(HashTable* expected, HashTable* actual) {
+  REQUIRE(HashTable_NumElements(expected) == HashTable_NumElements(actual));
+  HTIterator* it = HTIterator_New(expected);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv, found;
+    REQUIRE(HTIterator_Get(it, &kv));
+    REQUIRE(HashTable_Find(actual, kv.hash, kv.key, &found));
+    REQUIRE(kv.value == found.value);
+  }
+  HTIterator_Delete(it);
+}
+
+TEST_CASE("CheckpointDelta", "[Test_HashTable]") {
+  const string base = TempPath();
+  const string delta1 = TempPath();
+  const string delta2 = TempPath();
+  const string delta3 = TempPath();
+  HTKeyValue_t oldkv{};
+
+  // Keys and values are stored inline, so they survive the round trip.
+  HashTable* table = HashTable_New(64, ComparePointers);
+  REQUIRE(0 == HashTable_NumDirtyRanges(table));
+  REQUIRE(HashTable_TrackDirty(table, 3));
+  REQUIRE_FALSE(HashTable_TrackDirty(table, 4));
+  for (int64_t i = 0; i < 100; i++) {
+    HashTable_Insert(table, {static_cast<HTHash_t>(i * 7),
+                             reinterpret_cast<HTKey_t>(i),
+                             reinterpret_cast<HTValue_t>(i)}, &oldkv);
+  }
+  REQUIRE(16 == HashTable_NumDirtyRanges(table));
+
+  // The first checkpoint has to be a full one.
+  REQUIRE_FALSE(HashTable_CheckpointDelta(table, delta1.c_str()));
+  REQUIRE(HashTable_Save(table, base.c_str()));
+  REQUIRE(0 == HashTable_NumDirtyRanges(table));
+
+  // Replacing and removing only dirties the ranges they touch: hashes
+  // 0..63 fall into ranges 0..15 of 4 buckets each, so these touch ranges
+  // 0, 1, 3, 5 and 7.
+  for (int64_t i = 0; i < 4; i++) {
+    HashTable_Insert(table, {static_cast<HTHash_t>(i * 7),
+                             reinterpret_cast<HTKey_t>(i),
+                             reinterpret_cast<HTValue_t>(i + 1000)}, &oldkv);
+  }
+  REQUIRE(HashTable_Remove(table, 50 * 7, reinterpret_cast<HTKey_t>(50),
+                           &oldkv));
+  REQUIRE(5 == HashTable_NumDirtyRanges(table));
+  REQUIRE(HashTable_CheckpointDelta(table, delta1.c_str()));
+  REQUIRE(0 == HashTable_NumDirtyRanges(table));
+  HashTable* after1 = HashTable_OpenCheckpoint(base.c_str(), nullptr, 0,
+                                               ComparePointers);
+  REQUIRE(after1 != nullptr);
+  REQUIRE(100 == HashTable_NumElements(after1));
+  HashTable_Delete(after1, NoOpDelete);
+
+  // Growing the table dirties everything.
+  for (int64_t i = 100; i < 1000; i++) {
+    HashTable_Insert(table, {static_cast<HTHash_t>(i * 7),
+                             reinterpret_cast<HTKey_t>(i),
+                             reinterpret_cast<HTValue_t>(i)}, &oldkv);
+  }
+  REQUIRE(table->num_buckets > 64);
+  REQUIRE(table->dirty->all);
+  REQUIRE(HashTable_CheckpointDelta(table, delta2.c_str()));
+  REQUIRE_FALSE(table->dirty->all);
+  for (int64_t i = 0; i < 1000; i += 100) {
+    REQUIRE(HashTable_Remove(table, static_cast<HTHash_t>(i * 7),
+                             reinterpret_cast<HTKey_t>(i), &oldkv));
+  }
+  REQUIRE(HashTable_CheckpointDelta(table, delta3.c_str()));
+
+  // Restoring applies each delta in turn.
+  const char* deltas[] = {delta1.c_str(), delta2.c_str(), delta3.c_str()};
+  HashTable* restored = HashTable_OpenCheckpoint(base.c_str(), deltas, 1,
+                                                 ComparePointers);
+  REQUIRE(restored != nullptr);
+  REQUIRE(99 == HashTable_NumElements(restored));
+  REQUIRE(HashTable_Find(restored, 7, reinterpret_cast<HTKey_t>(1), &oldkv));
+  REQUIRE(1001 == reinterpret_cast<int64_t>(oldkv.value));
+  HashTable_Delete(restored, NoOpDelete);
+  restored = HashTable_OpenCheckpoint(base.c_str(), deltas, 3,
+                                      ComparePointers);
+  REQUIRE(restored != nullptr);
+  RequireSameContents(table, restored);
+  RequireSameContents(restored, table);
+  HashTable_Delete(restored, NoOpDelete);
+
+  // Deltas only apply in order, on top of the snapshot they followed.
+  REQUIRE(nullptr == HashTable_OpenCheckpoint(base.c_str(), deltas + 1, 2,
+                                              ComparePointers));
+  REQUIRE(HashTable_Save(table, base.c_str()));
+  REQUIRE(nullptr == HashTable_OpenCheckpoint(base.c_str(), deltas, 1,
+                                              ComparePointers));
+  CorruptByte(delta1, sizeof(HTDeltaHeader) + 20);
+  REQUIRE(nullptr == HashTable_OpenCheckpoint(base.c_str(), deltas, 1,
+                                              ComparePointers));
+  HashTable_Delete(table, NoOpDelete);
+
+  // String-key (compact) tables are tracked the same way.
+  table = HashTable_NewStringKeys(8);
+  REQUIRE(HashTable_TrackDirty(table, 1));
+  for (int i = 0; i < 20; i++) {
+    string keystr = "key" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    HashTable_Insert(table, {HashString(keystr), &key,
+                             reinterpret_cast<HTValue_t>(
+                                 static_cast<int64_t>(i))}, &oldkv);
+  }
+  REQUIRE(HashTable_Save(table, base.c_str()));
+  for (int i = 0; i < 200; i += 3) {
+    string keystr = "key" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    if (i < 20) {
+      REQUIRE(HashTable_Remove(table, HashString(keystr), &key, &oldkv));
+    } else {
+      HashTable_Insert(table, {HashString(keystr), &key, nullptr}, &oldkv);
+    }
+    if (i == 9) {
+      REQUIRE(HashTable_CheckpointDelta(table, delta1.c_str()));
+    }
+  }
+  REQUIRE(HashTable_CheckpointDelta(table, delta2.c_str()));
+  restored = HashTable_OpenCheckpoint(base.c_str(), deltas, 2, nullptr);
+  REQUIRE(restored != nullptr);
+  RequireSameContents(table, restored);
+  HashTable_Delete(restored, nullptr);
+  HashTable_Delete(table, nullptr);
+
+  remove(base.c_str());
+  remove(delta1.c_str());
+  remove(delta2.c_str());
+  remove(delta3.c_str());
+}
+
+TEST_CASE("WriteAheadLog", "[Test_HashTable]") {
+  const string path = TempPath();
+  HTKeyValue_t oldkv{};
+
+  // Log a mix of inserts, replacements and removes at every durability
+  // level, mirroring them in an unlogged table.
+  HashTable* table = HashTable_New(8, ComparePointers);
+  HashTable* expected = HashTable_New(8, ComparePointers);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 16, 1000, k_ht_wal_async));
+  REQUIRE_FALSE(HashTable_AttachLog(table, path.c_str(), 16, 1000,
+                                    k_ht_wal_async));
+  for (int64_t i = 0; i < 300; i++) {
+    const HTKeyValue_t kv{static_cast<HTHash_t>(i * 13),
+                          reinterpret_cast<HTKey_t>(i),
+                          reinterpret_cast<HTValue_t>(i * 2)};
+    REQUIRE_FALSE(HashTable_InsertDurable(table, kv, &oldkv, i % 3));
+    HashTable_Insert(expected, kv, &oldkv);
+  }
+  for (int64_t i = 0; i < 300; i += 7) {
+    const HTKeyValue_t kv{static_cast<HTHash_t>(i * 13),
+                          reinterpret_cast<HTKey_t>(i),
+                          reinterpret_cast<HTValue_t>(i * 3)};
+    REQUIRE(HashTable_Insert(table, kv, &oldkv));
+    HashTable_Insert(expected, kv, &oldkv);
+  }
+  for (int64_t i = 0; i < 300; i += 5) {
+    REQUIRE(HashTable_RemoveDurable(table, static_cast<HTHash_t>(i * 13),
+                                    reinterpret_cast<HTKey_t>(i), &oldkv,
+                                    k_ht_wal_group));
+    HashTable_Remove(expected, static_cast<HTHash_t>(i * 13),
+                     reinterpret_cast<HTKey_t>(i), &oldkv);
+  }
+  REQUIRE_FALSE(HashTable_RemoveDurable(table, 0, reinterpret_cast<HTKey_t>(0),
+                                        &oldkv, k_ht_wal_sync));
+  REQUIRE(HashTable_SyncLog(table));
+  HashTable_Delete(table, NoOpDelete);
+
+  // Attaching the log to a fresh table replays it.
+  table = HashTable_New(8, ComparePointers);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 16, 1000, k_ht_wal_sync));
+  RequireSameContents(expected, table);
+  RequireSameContents(table, expected);
+  HashTable_Delete(table, NoOpDelete);
+
+  // A torn record at the end is dropped, and later records follow the
+  // last good one.
+  FILE* f = fopen(path.c_str(), "ab");
+  REQUIRE(f != nullptr);
+  fwrite("partial", 1, 7, f);
+  fclose(f);
+  table = HashTable_New(8, ComparePointers);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 16, 0, k_ht_wal_sync));
+  RequireSameContents(expected, table);
+  const HTKeyValue_t extra{1, reinterpret_cast<HTKey_t>(1000), nullptr};
+  HashTable_Insert(table, extra, &oldkv);
+  HashTable_Insert(expected, extra, &oldkv);
+  HashTable_Delete(table, NoOpDelete);
+  table = HashTable_New(8, ComparePointers);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 16, 0, k_ht_wal_sync));
+  RequireSameContents(expected, table);
+
+  // Once truncated, the log starts over.
+  REQUIRE(HashTable_TruncateLog(table));
+  HashTable_Delete(table, NoOpDelete);
+  table = HashTable_New(8, ComparePointers);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 16, 0, k_ht_wal_sync));
+  REQUIRE(0 == HashTable_NumElements(table));
+  HashTable_Delete(table, NoOpDelete);
+  HashTable_Delete(expected, NoOpDelete);
+
+  // The log remembers what kind of keys it holds.
+  table = HashTable_NewStringKeys(8);
+  REQUIRE_FALSE(HashTable_AttachLog(table, path.c_str(), 16, 0,
+                                    k_ht_wal_sync));
+  REQUIRE_FALSE(HashTable_SyncLog(table));
+  HashTable_Delete(table, nullptr);
+  remove(path.c_str());
+
+  // String keys are logged by value, and group commits are shared between
+  // threads.
+  table = HashTable_NewStringKeys(8);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 1000000, 0,
+                              k_ht_wal_group));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([table, t] {
+      HTKeyValue_t old;
+      for (int i = 0; i < 100; i++) {
+        string keystr = "t" + to_string(t) + "/" + to_string(i);
+        HTStringKey_t key{keystr.data(), keystr.size()};
+        HashTable_Insert(table, {HashString(keystr), &key,
+                                 reinterpret_cast<HTValue_t>(
+                                     static_cast<int64_t>(i))}, &old);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  HashTable_Delete(table, nullptr);
+  table = HashTable_NewStringKeys(8);
+  REQUIRE(HashTable_AttachLog(table, path.c_str(), 16, 0, k_ht_wal_sync));
+  REQUIRE(400 == HashTable_NumElements(table));
+  string keystr = "t3/99";
+  HTStringKey_t key{keystr.data(), keystr.size()};
+  REQUIRE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+  REQUIRE(99 == reinterpret_cast<int64_t>(oldkv.value));
+  HashTable_Delete(table, nullptr);
+  remove(path.c_str());
+}
+
+// The clock of the tables in the expiry test, which it sets by hand.
+static uint64_t g_clock = 0;
+
+static uint64_t TestClock() {
+  return g_clock;
+}
+
+static std::vector<int64_t> g_expired;
+
+static void RecordExpired(HTKeyValue_t kv) {
+  g_expired.push_back(reinterpret_cast<int64_t>(kv.key));
+}
+
+static void CheckSessionKey(HTKeyValue_t kv) {
+  const HTStringKey_t* key = static_cast<const HTStringKey_t*>(kv.key);
+  REQUIRE(string(static_cast<const char*>(key->bytes), 7) == "session");
+  g_free_invocations++;
+}
+
+static HTKeyValue_t InlineKV(int64_t i) {
+  return HTKeyValue_t{static_cast<HTHash_t>(i * 0x9e3779b97f4a7c15ULL),
+                      reinterpret_cast<HTKey_t>(i),
+                      reinterpret_cast<HTValue_t>(i * 2)};
+}
+
+TEST_CASE("Expiry", "[Test_HashTable]") {
+  HashTable* chained = HashTable_New(8, ComparePointers);
+  REQUIRE_FALSE(HashTable_EnableExpiry(chained, &TestClock, NoOpDelete));
+  REQUIRE(0 == HashTable_Expire(chained, 100));
+  HashTable_Delete(chained, NoOpDelete);
+
+  g_clock = 1000;
+  g_expired.clear();
+  HashTable* table = HashTable_NewCompact(8, ComparePointers);
+  REQUIRE(HashTable_EnableExpiry(table, &TestClock, &RecordExpired));
+  REQUIRE_FALSE(HashTable_EnableExpiry(table, &TestClock, &RecordExpired));
+
+  // Odd keys get TTLs spread over every level of the wheel and beyond it;
+  // even keys get none.
+  HTKeyValue_t oldkv{};
+  std::map<uint64_t, std::vector<int64_t>> due;  // deadline -> keys
+  const int64_t k_keys = 4000;
+  for (int64_t i = 1; i <= k_keys; i++) {
+    if (i % 2 == 0) {
+      REQUIRE_FALSE(HashTable_Insert(table, InlineKV(i), &oldkv));
+      continue;
+    }
+    const uint64_t ttl = (static_cast<uint64_t>(i) * 2654435761ULL) >>
+                         (i % 32);
+    REQUIRE_FALSE(HashTable_InsertWithTTL(table, InlineKV(i), ttl, &oldkv));
+    due[g_clock + ttl].push_back(i);
+  }
+  REQUIRE(k_keys == HashTable_NumElements(table));
+  REQUIRE(k_keys / 2 == table->expiry->num_timers);
+
+  // Replacing an entry with HashTable_Insert cancels its TTL; replacing it
+  // with a TTL moves its deadline; removing it cancels its timer without
+  // freeing it.
+  for (auto it = due.begin(); it != due.end();) {
+    const int64_t i = it->second.back();
+    if (i % 3 == 0) {
+      REQUIRE(HashTable_Insert(table, InlineKV(i), &oldkv));
+    } else if (i % 5 == 0) {
+      REQUIRE(HashTable_InsertWithTTL(table, InlineKV(i), 77, &oldkv));
+      due[g_clock + 77].push_back(i);
+    } else if (i % 7 == 0) {
+      REQUIRE(HashTable_Remove(table, InlineKV(i).hash,
+                               reinterpret_cast<HTKey_t>(i), &oldkv));
+    } else {
+      ++it;
+      continue;
+    }
+    it->second.pop_back();
+    it = it->second.empty() ? due.erase(it) : it;
+  }
+
+  // Advance the clock in jumps of every size.  Entries that are due read
+  // as missing straight away, and HashTable_Expire removes exactly those.
+  uint64_t rng = 42;
+  size_t remaining = HashTable_NumElements(table);
+  while (!due.empty()) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    g_clock += (rng % 1000) << (rng % 28);
+
+    std::vector<int64_t> expected;
+    for (auto it = due.begin(); it != due.end() && it->first <= g_clock;) {
+      for (int64_t i : it->second) {
+        expected.push_back(i);
+        REQUIRE_FALSE(HashTable_Find(table, InlineKV(i).hash,
+                                     reinterpret_cast<HTKey_t>(i), &oldkv));
+      }
+      it = due.erase(it);
+    }
+    if (!due.empty()) {
+      const int64_t i = due.begin()->second.front();
+      REQUIRE(HashTable_Find(table, InlineKV(i).hash,
+                             reinterpret_cast<HTKey_t>(i), &oldkv));
+      REQUIRE(i * 2 == reinterpret_cast<int64_t>(oldkv.value));
+    }
+
+    g_expired.clear();
+    REQUIRE(expected.size() == HashTable_Expire(table, g_clock));
+    std::sort(expected.begin(), expected.end());
+    std::sort(g_expired.begin(), g_expired.end());
+    REQUIRE(expected == g_expired);
+    remaining -= expected.size();
+    REQUIRE(remaining == HashTable_NumElements(table));
+  }
+  REQUIRE(0 == table->expiry->num_timers);
+
+  // Everything left has no TTL.  A TTL of 0 is due at once.
+  REQUIRE(0 == HashTable_Expire(table, g_clock + (1ULL << 40)));
+  REQUIRE(HashTable_Find(table, InlineKV(2).hash,
+                         reinterpret_cast<HTKey_t>(2), &oldkv));
+  REQUIRE(HashTable_InsertWithTTL(table, InlineKV(2), 0, &oldkv));
+  REQUIRE_FALSE(HashTable_Find(table, InlineKV(2).hash,
+                               reinterpret_cast<HTKey_t>(2), &oldkv));
+  g_expired.clear();
+  REQUIRE(1 == HashTable_Expire(table, g_clock));
+  REQUIRE(std::vector<int64_t>{2} == g_expired);
+  HashTable_Delete(table, NoOpDelete);
+
+  // String keys expire too, and the free function sees the key's bytes.
+  HashTable* strings = HashTable_NewStringKeys(4);
+  REQUIRE(HashTable_EnableExpiry(strings, &TestClock, &CheckSessionKey));
+  for (int i = 0; i < 50; i++) {
+    string keystr = "session" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    REQUIRE_FALSE(HashTable_InsertWithTTL(
+        strings, {HashString(keystr), &key, nullptr}, 10 + i, &oldkv));
+  }
+  REQUIRE(20 == HashTable_Expire(strings, g_clock + 29));
+  REQUIRE(20 == g_free_invocations);
+  for (int i = 0; i < 50; i++) {
+    string keystr = "session" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    REQUIRE((i >= 20) == HashTable_Find(strings, HashString(keystr), &key,
+                                        &oldkv));
+  }
+  HashTable_Delete(strings, nullptr);
+}
+
+// Returns the keys of a table of InlineKVs, in the order an iterator
+// visits them.
+static std::vector<int64_t> IterationOrder(HashTable* table) {
+  std::vector<int64_t> keys;
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    REQUIRE(HTIterator_Get(it, &kv));
+    keys.push_back(reinterpret_cast<int64_t>(kv.key));
+  }
+  HTIterator_Delete(it);
+  return keys;
+}
+
+TEST_CASE("Ordered", "[Test_HashTable]") {
+  HashTable* chained = HashTable_New(4, ComparePointers);
+  REQUIRE_FALSE(HashTable_EnableOrder(chained, k_ht_order_insertion));
+  HashTable_Delete(chained, NoOpDelete);
+
+  HashTable* table = HashTable_NewCompact(2, ComparePointers);
+  REQUIRE_FALSE(HashTable_EnableOrder(table, 0));
+  REQUIRE(HashTable_EnableOrder(table, k_ht_order_insertion));
+  REQUIRE_FALSE(HashTable_EnableOrder(table, k_ht_order_insertion));
+  REQUIRE(IterationOrder(table).empty());
+
+  // Mix inserts, replacements and removes through several resizes, and
+  // check the order against a model after each round.
+  HTKeyValue_t oldkv;
+  std::vector<int64_t> model;
+  uint64_t rng = 99;
+  for (int round = 0; round < 20; round++) {
+    for (int op = 0; op < 200; op++) {
+      rng ^= rng << 13;
+      rng ^= rng >> 7;
+      rng ^= rng << 17;
+      const int64_t i = 1 + rng % 500;
+      auto pos = std::find(model.begin(), model.end(), i);
+      if (rng % 4 == 0) {
+        REQUIRE((pos != model.end()) ==
+                HashTable_Remove(table, InlineKV(i).hash,
+                                 reinterpret_cast<HTKey_t>(i), &oldkv));
+        if (pos != model.end()) {
+          model.erase(pos);
+        }
+      } else {
+        REQUIRE((pos != model.end()) ==
+                HashTable_Insert(table, InlineKV(i), &oldkv));
+        if (pos == model.end()) {
+          model.push_back(i);
+        }
+      }
+    }
+    REQUIRE(model == IterationOrder(table));
+  }
+
+  // Removing through an iterator carries on to the next key in order.
+  HTIterator* it = HTIterator_New(table);
+  for (size_t n = 0; HTIterator_IsValid(it); n++) {
+    if (n % 3 == 0) {
+      REQUIRE(HTIterator_Remove(it, &oldkv));
+      model.erase(std::find(model.begin(), model.end(),
+                            reinterpret_cast<int64_t>(oldkv.key)));
+    } else {
+      HTIterator_Next(it);
+    }
+  }
+  HTIterator_Delete(it);
+  REQUIRE(model == IterationOrder(table));
+  HashTable_Delete(table, NoOpDelete);
+
+  // In access order, finds and replacements move keys to the end.  Keys
+  // already in the table keep the order an iterator gave them.
+  table = HashTable_NewCompact(8, ComparePointers);
+  for (int64_t i = 1; i <= 5; i++) {
+    HashTable_Insert(table, InlineKV(i), &oldkv);
+  }
+  const std::vector<int64_t> before = IterationOrder(table);
+  REQUIRE(HashTable_EnableOrder(table, k_ht_order_access));
+  REQUIRE(before == IterationOrder(table));
+  REQUIRE(HashTable_Find(table, InlineKV(before[1]).hash,
+                         reinterpret_cast<HTKey_t>(before[1]), &oldkv));
+  REQUIRE(HashTable_Insert(table, InlineKV(before[0]), &oldkv));
+  REQUIRE((std::vector<int64_t>{before[2], before[3], before[4], before[1],
+                                before[0]}) == IterationOrder(table));
+  HashTable_Delete(table, NoOpDelete);
+
+  // Expiring entries keeps the rest in order.
+  table = HashTable_NewCompact(8, ComparePointers);
+  REQUIRE(HashTable_EnableOrder(table, k_ht_order_insertion));
+  REQUIRE(HashTable_EnableExpiry(table, &TestClock, &NoOpDelete));
+  model.clear();
+  for (int64_t i = 1; i <= 100; i++) {
+    if (i % 3 == 0) {
+      HashTable_InsertWithTTL(table, InlineKV(i), 5, &oldkv);
+    } else {
+      HashTable_Insert(table, InlineKV(i), &oldkv);
+      model.push_back(i);
+    }
+  }
+  REQUIRE(33 == HashTable_Expire(table, g_clock + 5));
+  REQUIRE(model == IterationOrder(table));
+  HashTable_Delete(table, NoOpDelete);
+
+  // String keys stay in order through resizes and arena compactions.
+  HashTable* strings = HashTable_NewStringKeys(1);
+  REQUIRE(HashTable_EnableOrder(strings, k_ht_order_insertion));
+  for (int i = 0; i < 300; i++) {
+    string keystr = "key" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    HashTable_Insert(strings, {HashString(keystr), &key, nullptr}, &oldkv);
+    if (i % 2 == 1) {
+      keystr = "key" + to_string(i - 1);
+      HashTable_Remove(strings, HashString(keystr), &key, &oldkv);
+    }
+  }
+  it = HTIterator_New(strings);
+  for (int i = 1; i < 300; i += 2) {
+    REQUIRE(HTIterator_IsValid(it));
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    const HTStringKey_t* key = static_cast<const HTStringKey_t*>(kv.key);
+    REQUIRE("key" + to_string(i) ==
+            string(static_cast<const char*>(key->bytes), key->len));
+    HTIterator_Next(it);
+  }
+  REQUIRE_FALSE(HTIterator_IsValid(it));
+  HTIterator_Delete(it);
+  HashTable_Delete(strings, nullptr);
+}
+
+// Returns the values of every (key,value) with key i in a table of
+// InlineKVs, in the order HashTable_FindAll visits them.
+static std::vector<int64_t> ValuesOf(HashTable* table, int64_t i) {
+  std::vector<int64_t> values;
+  HTCursor_t cursor = HashTable_FindAll(table, InlineKV(i).hash,
+                                        reinterpret_cast<HTKey_t>(i));
+  for (; HTCursor_IsValid(&cursor); HTCursor_Next(&cursor)) {
+    HTKeyValue_t kv;
+    REQUIRE(HTCursor_Get(&cursor, &kv));
+    REQUIRE(i == reinterpret_cast<int64_t>(kv.key));
+    values.push_back(reinterpret_cast<int64_t>(kv.value));
+  }
+  REQUIRE_FALSE(HTCursor_Next(&cursor));
+  REQUIRE(values.size() == HashTable_Count(table, InlineKV(i).hash,
+                                           reinterpret_cast<HTKey_t>(i)));
+  return values;
+}
+
+// The (key,value) that a multimap test stores as the j'th value of key i.
+static HTKeyValue_t MultiKV(int64_t i, int64_t j) {
+  HTKeyValue_t kv = InlineKV(i);
+  kv.value = reinterpret_cast<HTValue_t>(i * 1000 + j);
+  return kv;
+}
+
+TEST_CASE("Multimap", "[Test_HashTable]") {
+  HTKeyValue_t oldkv{};
+  HashTable* chained = HashTable_New(4, ComparePointers);
+  REQUIRE_FALSE(HashTable_EnableMultimap(chained));
+  HashTable_Insert(chained, InlineKV(1), &oldkv);
+  REQUIRE(1 == HashTable_Count(chained, InlineKV(1).hash,
+                               reinterpret_cast<HTKey_t>(1)));
+  HashTable_Delete(chained, NoOpDelete);
+
+  HashTable* table = HashTable_NewCompact(1, ComparePointers);
+  HashTable_Insert(table, InlineKV(1), &oldkv);
+  REQUIRE_FALSE(HashTable_EnableMultimap(table));
+  HashTable_Remove(table, InlineKV(1).hash, reinterpret_cast<HTKey_t>(1),
+                   &oldkv);
+  REQUIRE(HashTable_EnableMultimap(table));
+  REQUIRE_FALSE(HashTable_EnableMultimap(table));
+  const string log = TempPath();
+  REQUIRE_FALSE(HashTable_AttachLog(table, log.c_str(), 1, 0,
+                                    k_ht_wal_async));
+  remove(log.c_str());
+
+  // Add values round-robin over many keys, through several resizes; each
+  // key's values stay together, newest first.
+  const int64_t k_keys = 300;
+  for (int64_t j = 0; j < 5; j++) {
+    for (int64_t i = 1; i <= k_keys; i++) {
+      if (j < i % 6) {
+        REQUIRE_FALSE(HashTable_Insert(table, MultiKV(i, j), &oldkv));
+      }
+    }
+  }
+  for (int64_t i = 1; i <= k_keys; i++) {
+    std::vector<int64_t> expected;
+    for (int64_t j = i % 6 - 1; j >= 0; j--) {
+      expected.push_back(i * 1000 + j);
+    }
+    REQUIRE(expected == ValuesOf(table, i));
+  }
+
+  // Find and remove take the newest value.
+  REQUIRE(HashTable_Find(table, InlineKV(5).hash, reinterpret_cast<HTKey_t>(5),
+                         &oldkv));
+  REQUIRE(5004 == reinterpret_cast<int64_t>(oldkv.value));
+  REQUIRE(HashTable_Remove(table, InlineKV(5).hash,
+                           reinterpret_cast<HTKey_t>(5), &oldkv));
+  REQUIRE(5004 == reinterpret_cast<int64_t>(oldkv.value));
+  REQUIRE((std::vector<int64_t>{5003, 5002, 5001, 5000}) ==
+          ValuesOf(table, 5));
+
+  // Removing through an iterator removes exactly the current value.
+  HTIterator* it = HTIterator_New(table);
+  while (HTIterator_IsValid(it)) {
+    HTKeyValue_t kv;
+    HTIterator_Get(it, &kv);
+    if (reinterpret_cast<int64_t>(kv.value) % 2 == 1) {
+      REQUIRE(HTIterator_Remove(it, &oldkv));
+      REQUIRE(kv.value == oldkv.value);
+    } else {
+      HTIterator_Next(it);
+    }
+  }
+  HTIterator_Delete(it);
+  REQUIRE((std::vector<int64_t>{5002, 5000}) == ValuesOf(table, 5));
+  REQUIRE(ValuesOf(table, 6).empty());
+
+  // Snapshots and deltas bring multimaps back as multimaps, with each
+  // key's values in the same order.
+  const string base = TempPath();
+  const string delta1 = TempPath();
+  const string delta2 = TempPath();
+  REQUIRE(HashTable_TrackDirty(table, 4));
+  REQUIRE(HashTable_Save(table, base.c_str()));
+  for (int64_t j = 10; j < 13; j++) {
+    HashTable_Insert(table, MultiKV(7, j), &oldkv);
+  }
+  REQUIRE(HashTable_CheckpointDelta(table, delta1.c_str()));
+  for (int64_t i = k_keys + 1; i <= 10 * k_keys; i++) {
+    HashTable_Insert(table, MultiKV(i, 0), &oldkv);
+    HashTable_Insert(table, MultiKV(i, 1), &oldkv);
+  }
+  REQUIRE(HashTable_CheckpointDelta(table, delta2.c_str()));
+  const char* delta_paths[] = {delta1.c_str(), delta2.c_str()};
+  for (size_t num_deltas = 0; num_deltas <= 2; num_deltas++) {
+    HashTable* restored = HashTable_OpenCheckpoint(
+        base.c_str(), delta_paths, num_deltas, ComparePointers);
+    REQUIRE(restored != nullptr);
+    REQUIRE((num_deltas == 0 ? std::vector<int64_t>{7000}
+                              : std::vector<int64_t>{7012, 7011, 7010, 7000}) ==
+            ValuesOf(restored, 7));
+    HashTable_Insert(restored, MultiKV(8, 99), &oldkv);
+    REQUIRE(8099 == reinterpret_cast<int64_t>(ValuesOf(restored, 8)[0]));
+    HashTable_Remove(restored, InlineKV(8).hash, reinterpret_cast<HTKey_t>(8),
+                     &oldkv);
+    if (num_deltas == 2) {
+      for (int64_t i = 1; i <= 10 * k_keys; i += 7) {
+        REQUIRE(ValuesOf(table, i) == ValuesOf(restored, i));
+      }
+    }
+    HashTable_Delete(restored, NoOpDelete);
+  }
+  remove(base.c_str());
+  remove(delta1.c_str());
+  remove(delta2.c_str());
+  HashTable_Delete(table, NoOpDelete);
+
+  // FindAll and Count skip values past their deadline.
+  table = HashTable_NewCompact(4, ComparePointers);
+  REQUIRE(HashTable_EnableMultimap(table));
+  REQUIRE(HashTable_EnableExpiry(table, &TestClock, &NoOpDelete));
+  HashTable_Insert(table, MultiKV(1, 0), &oldkv);
+  HashTable_InsertWithTTL(table, MultiKV(1, 1), 10, &oldkv);
+  HashTable_Insert(table, MultiKV(1, 2), &oldkv);
+  HashTable_InsertWithTTL(table, MultiKV(1, 3), 10, &oldkv);
+  REQUIRE((std::vector<int64_t>{1003, 1002, 1001, 1000}) ==
+          ValuesOf(table, 1));
+  g_clock += 10;
+  REQUIRE((std::vector<int64_t>{1002, 1000}) == ValuesOf(table, 1));
+  REQUIRE(2 == HashTable_Expire(table, g_clock));
+  REQUIRE((std::vector<int64_t>{1002, 1000}) == ValuesOf(table, 1));
+  HashTable_Delete(table, NoOpDelete);
+
+  // String keys, with equal keys held in separate buffers.
+  HashTable* strings = HashTable_NewStringKeys(1);
+  REQUIRE(HashTable_EnableMultimap(strings));
+  for (int j = 0; j < 3; j++) {
+    for (int i = 0; i < 50; i++) {
+      string keystr = "key" + to_string(i);
+      HTStringKey_t key{keystr.data(), keystr.size()};
+      HashTable_Insert(strings,
+                       {HashString(keystr), &key,
+                        reinterpret_cast<HTValue_t>(static_cast<int64_t>(j))},
+                       &oldkv);
+    }
+  }
+  REQUIRE(150 == HashTable_NumElements(strings));
+  string keystr = "key17";
+  HTStringKey_t key{keystr.data(), keystr.size()};
+  REQUIRE(3 == HashTable_Count(strings, HashString(keystr), &key));
+  HTCursor_t cursor = HashTable_FindAll(strings, HashString(keystr), &key);
+  for (int64_t j = 2; j >= 0; j--) {
+    HTKeyValue_t kv;
+    REQUIRE(HTCursor_Get(&cursor, &kv));
+    const HTStringKey_t* found = static_cast<const HTStringKey_t*>(kv.key);
+    REQUIRE(keystr ==
+            string(static_cast<const char*>(found->bytes), found->len));
+    REQUIRE(j == reinterpret_cast<int64_t>(kv.value));
+    HTCursor_Next(&cursor);
+  }
+  REQUIRE_FALSE(HTCursor_IsValid(&cursor));
+  HashTable_Delete(strings, nullptr);
+}
+
+TEST_CASE("PerfectHash", "[Test_HashTable]") {
+  // Every hash gets a slot of its own, however many there are and however
+  // regular they are.
+  for (size_t n : {0, 1, 2, 7, 1000, 100000}) {
+    std::vector<HTHash_t> hashes;
+    for (size_t i = 0; i < n; i++) {
+      hashes.push_back(i * 64);
+    }
+    CTPerfectHash mph;
+    REQUIRE(PerfectHash_Build(hashes.data(), n, &mph));
+    REQUIRE(n == mph.num_keys);
+    REQUIRE(n <= mph.num_slots);
+    std::vector<bool> used(n, false);
+    for (HTHash_t hash : hashes) {
+      const size_t slot = PerfectHash_Slot(&mph, hash);
+      REQUIRE(slot < n);
+      REQUIRE_FALSE(used[slot]);
+      used[slot] = true;
+    }
+    // About a byte per key.
+    REQUIRE(PerfectHash_MemoryBytes(&mph) <= sizeof(CTPerfectHash) + 16 + n);
+    delete[] mph.pilots;
+    delete[] mph.remap;
+  }
+
+  // Equal hashes can't be told apart.
+  const HTHash_t equal[] = {1, 2, 3, 2};
+  CTPerfectHash mph;
+  REQUIRE_FALSE(PerfectHash_Build(equal, 4, &mph));
+}
+
+TEST_CASE("Freeze", "[Test_HashTable]") {
+  HTKeyValue_t oldkv{};
+
+  // A chained table is frozen into a compact one.
+  HashTable* table = HashTable_New(7, ComparePointers);
+  for (int64_t i = 0; i < 1000; i++) {
+    HashTable_Insert(table, InlineKV(i), &oldkv);
+  }
+  const size_t chained_bytes = HashTable_MemoryBytes(table);
+  REQUIRE(HashTable_Freeze(table));
+  REQUIRE(table->compact != nullptr);
+  REQUIRE(table->compact->mph != nullptr);
+  REQUIRE(table->buckets == nullptr);
+  REQUIRE_FALSE(HashTable_Freeze(table));
+  REQUIRE(1000 == HashTable_NumElements(table));
+  REQUIRE(HashTable_MemoryBytes(table) < chained_bytes / 2);
+  REQUIRE(HashTable_MemoryBytes(table) <=
+          sizeof(HashTable) + sizeof(CompactTable) + sizeof(CTPerfectHash) +
+              1000 * (sizeof(HTKeyValue_t) + 2));
+  for (int64_t i = 0; i < 1100; i++) {
+    const HTKeyValue_t kv = InlineKV(i);
+    if (i < 1000) {
+      REQUIRE(HashTable_Find(table, kv.hash, kv.key, &oldkv));
+      REQUIRE(kv.value == oldkv.value);
+      REQUIRE(1 == HashTable_Count(table, kv.hash, kv.key));
+    } else {
+      REQUIRE_FALSE(HashTable_Find(table, kv.hash, kv.key, &oldkv));
+      REQUIRE(0 == HashTable_Count(table, kv.hash, kv.key));
+    }
+  }
+  std::vector<bool> seen(1000, false);
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    REQUIRE(HTIterator_Get(it, &oldkv));
+    const int64_t i = reinterpret_cast<int64_t>(oldkv.key);
+    REQUIRE_FALSE(seen[i]);
+    seen[i] = true;
+  }
+  REQUIRE(std::find(seen.begin(), seen.end(), false) == seen.end());
+  REQUIRE_FALSE(HTIterator_Remove(it, &oldkv));
+  HTIterator_Delete(it);
+
+  // A frozen table is read-only for good.
+  REQUIRE_FALSE(HashTable_Insert(table, InlineKV(5), &oldkv));
+  REQUIRE_FALSE(HashTable_Insert(table, InlineKV(5000), &oldkv));
+  REQUIRE_FALSE(HashTable_Remove(table, InlineKV(5).hash, InlineKV(5).key,
+                                 &oldkv));
+  REQUIRE_FALSE(HashTable_EnableOrder(table, k_ht_order_insertion));
+  REQUIRE_FALSE(HashTable_EnableMultimap(table));
+  REQUIRE_FALSE(HashTable_EnableExpiry(table, &TestClock, &NoOpDelete));
+  REQUIRE_FALSE(HashTable_TrackDirty(table, 4));
+  REQUIRE(1000 == HashTable_NumElements(table));
+  HashTable_Delete(table, NoOpDelete);
+
+  // Tables with more structure than a frozen table keeps can't be frozen,
+  // nor can tables with colliding hashes; they're left as they were.
+  table = HashTable_NewCompact(4, ComparePointers);
+  REQUIRE(HashTable_EnableMultimap(table));
+  REQUIRE_FALSE(HashTable_Freeze(table));
+  HashTable_Delete(table, NoOpDelete);
+  table = HashTable_NewCompact(4, ComparePointers);
+  REQUIRE(HashTable_EnableOrder(table, k_ht_order_access));
+  REQUIRE_FALSE(HashTable_Freeze(table));
+  HashTable_Delete(table, NoOpDelete);
+  table = HashTable_NewCompact(4, ComparePointers);
+  REQUIRE(HashTable_TrackDirty(table, 4));
+  REQUIRE_FALSE(HashTable_Freeze(table));
+  HashTable_Delete(table, NoOpDelete);
+  table = HashTable_New(4, ComparePointers);
+  HashTable_Insert(table, {42, reinterpret_cast<HTKey_t>(1), nullptr}, &oldkv);
+  HashTable_Insert(table, {42, reinterpret_cast<HTKey_t>(2), nullptr}, &oldkv);
+  REQUIRE_FALSE(HashTable_Freeze(table));
+  REQUIRE(table->compact == nullptr);
+  REQUIRE(HashTable_Find(table, 42, reinterpret_cast<HTKey_t>(2), &oldkv));
+  HashTable_Delete(table, NoOpDelete);
+
+  // An empty table freezes too.
+  table = HashTable_NewCompact(4, ComparePointers);
+  REQUIRE(HashTable_Freeze(table));
+  REQUIRE_FALSE(HashTable_Find(table, 0, nullptr, &oldkv));
+  it = HTIterator_New(table);
+  REQUIRE_FALSE(HTIterator_IsValid(it));
+  HTIterator_Delete(it);
+  HashTable_Delete(table, NoOpDelete);
+}
+
+TEST_CASE("FreezeSaveOpen", "[Test_HashTable]") {
+  const string path = TempPath();
+  HTKeyValue_t oldkv{};
+
+  // Freeze a string-key table with garbage in its arena, which freezing
+  // leaves behind.
+  HashTable* table = HashTable_NewStringKeys(4);
+  for (int i = 0; i < 3000; i++) {
+    string keystr = "frozen" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    HashTable_Insert(table, {HashString(keystr), &key,
+                             reinterpret_cast<HTValue_t>(
+                                 static_cast<int64_t>(i))}, &oldkv);
+  }
+  for (int i = 0; i < 3000; i += 3) {
+    string keystr = "frozen" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    HashTable_Remove(table, HashString(keystr), &key, &oldkv);
+  }
+  REQUIRE(HashTable_Freeze(table));
+  REQUIRE(table->compact->arena_used == table->compact->arena_live);
+
+  // Frozen snapshots come back frozen, straight from the file, even when
+  // asked to be writable.
+  REQUIRE(HashTable_Save(table, path.c_str()));
+  HashTable_Delete(table, nullptr);
+  for (int flags : {0, k_ht_open_verify,
+                    k_ht_open_writable | k_ht_open_verify}) {
+    table = HashTable_Open(path.c_str(), nullptr, flags);
+    REQUIRE(table != nullptr);
+    REQUIRE(table->compact->mph != nullptr);
+    REQUIRE(table->compact->map_base != nullptr);
+    REQUIRE(2000 == HashTable_NumElements(table));
+    for (int i = 0; i < 3000; i++) {
+      string keystr = "frozen" + to_string(i);
+      HTStringKey_t key{keystr.data(), keystr.size()};
+      if (i % 3 == 0) {
+        REQUIRE_FALSE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+      } else {
+        REQUIRE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+        REQUIRE(i == reinterpret_cast<int64_t>(oldkv.value));
+      }
+    }
+    int num_seen = 0;
+    HTIterator* it = HTIterator_New(table);
+    for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+      REQUIRE(HTIterator_Get(it, &oldkv));
+      const HTStringKey_t* key = static_cast<HTStringKey_t*>(oldkv.key);
+      const string keystr(static_cast<const char*>(key->bytes), key->len);
+      REQUIRE("frozen" + to_string(reinterpret_cast<int64_t>(oldkv.value)) ==
+              keystr);
+      num_seen++;
+    }
+    HTIterator_Delete(it);
+    REQUIRE(2000 == num_seen);
+    string keystr = "frozen1";
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    REQUIRE_FALSE(HashTable_Insert(table, {HashString(keystr), &key, nullptr},
+                                   &oldkv));
+    REQUIRE_FALSE(HashTable_Remove(table, HashString(keystr), &key, &oldkv));
+
+    // Saving it again gives an equivalent snapshot.
+    const string copy = TempPath();
+    REQUIRE(HashTable_Save(table, copy.c_str()));
+    HashTable* reopened = HashTable_Open(copy.c_str(), nullptr,
+                                         k_ht_open_verify);
+    REQUIRE(reopened != nullptr);
+    RequireSameContents(table, reopened);
+    HashTable_Delete(reopened, nullptr);
+    remove(copy.c_str());
+    HashTable_Delete(table, nullptr);
+  }
+
+  // A mapped snapshot can be frozen in place of the mapping.
+  table = HashTable_NewStringKeys(4);
+  for (int i = 0; i < 100; i++) {
+    string keystr = "mapped" + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    HashTable_Insert(table, {HashString(keystr), &key, nullptr}, &oldkv);
+  }
+  const string unfrozen = TempPath();
+  REQUIRE(HashTable_Save(table, unfrozen.c_str()));
+  HashTable_Delete(table, nullptr);
+  table = HashTable_Open(unfrozen.c_str(), nullptr, 0);
+  REQUIRE(HashTable_Freeze(table));
+  REQUIRE(table->compact->map_base == nullptr);
+  string keystr = "mapped42";
+  HTStringKey_t key{keystr.data(), keystr.size()};
+  REQUIRE(HashTable_Find(table, HashString(keystr), &key, &oldkv));
+  HashTable_Delete(table, nullptr);
+  remove(unfrozen.c_str());
+
+  // Damage past the header is caught when verifying.
+  CorruptByte(path, sizeof(HTFrozenHeader) + 5);
+  table = HashTable_Open(path.c_str(), nullptr, 0);
+  REQUIRE(table != nullptr);
+  HashTable_Delete(table, nullptr);
+  REQUIRE(nullptr == HashTable_Open(path.c_str(), nullptr, k_ht_open_verify));
+  CorruptByte(path, 20);
+  REQUIRE(nullptr == HashTable_Open(path.c_str(), nullptr, 0));
+  remove(path.c_str());
+}
+
+// Returns the sum of the values in a table of InlineKVs, checking that each
+// key is visited once and has the value InlineKV gave it.
+static int64_t SumInlineKVs(HashTable* table) {
+  int64_t sum = 0;
+  std::vector<bool> seen(HashTable_NumElements(table) * 4, false);
+  HTIterator* it = HTIterator_New(table);
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    HTKeyValue_t kv;
+    REQUIRE(HTIterator_Get(it, &kv));
+    const int64_t i = reinterpret_cast<int64_t>(kv.key);
+    REQUIRE(InlineKV(i).value == kv.value);
+    REQUIRE_FALSE(seen[i]);
+    seen[i] = true;
+    sum += i;
+  }
+  HTIterator_Delete(it);
+  return sum;
+}
+
+TEST_CASE("Snapshot", "[Test_HashTable]") {
+  HTKeyValue_t oldkv{};
+  HashTable* table = HashTable_New(7, ComparePointers);
+  for (int64_t i = 0; i < 1000; i++) {
+    HashTable_Insert(table, InlineKV(i), &oldkv);
+  }
+
+  // Taking a snapshot shares the buckets, and copies nothing.
+  HashTable* snapshot = HashTable_Snapshot(table);
+  REQUIRE(snapshot != nullptr);
+  REQUIRE(snapshot->buckets == table->buckets);
+  REQUIRE(snapshot->shared == table->shared);
+  REQUIRE(2 == table->shared->refs.load());
+  REQUIRE(1000 == HashTable_NumElements(snapshot));
+
+  // The first write copies the array, then just the bucket written to.
+  const size_t num_buckets = table->num_buckets;
+  HTKeyValue_t newkv = InlineKV(5000);
+  REQUIRE_FALSE(HashTable_Insert(table, newkv, &oldkv));
+  REQUIRE(snapshot->buckets != table->buckets);
+  REQUIRE(table->shared->parent == snapshot->shared);
+  REQUIRE(num_buckets - 1 == table->shared->num_borrowed);
+  size_t copied = 0;
+  for (size_t i = 0; i < num_buckets; i++) {
+    copied += table->buckets[i] != snapshot->buckets[i] ? 1 : 0;
+  }
+  REQUIRE(1 == copied);
+  REQUIRE(HashTable_Find(table, newkv.hash, newkv.key, &oldkv));
+  REQUIRE_FALSE(HashTable_Find(snapshot, newkv.hash, newkv.key, &oldkv));
+  REQUIRE(HashTable_Remove(table, newkv.hash, newkv.key, &oldkv));
+
+  // A snapshot's iterator stays valid through replaces, removes, inserts
+  // and resizes, and sees the table as it was.
+  HTIterator* it = HTIterator_New(snapshot);
+  for (int i = 0; i < 500; i++) {
+    REQUIRE(HTIterator_Next(it));
+  }
+  for (int64_t i = 0; i < 100; i++) {
+    HTKeyValue_t kv = InlineKV(i);
+    kv.value = reinterpret_cast<HTValue_t>(i * 3);
+    REQUIRE(HashTable_Insert(table, kv, &oldkv));
+  }
+  for (int64_t i = 100; i < 200; i++) {
+    REQUIRE(HashTable_Remove(table, InlineKV(i).hash, InlineKV(i).key,
+                             &oldkv));
+  }
+  for (int64_t i = 1000; i < 2000; i++) {
+    HashTable_Insert(table, InlineKV(i), &oldkv);
+  }
+  REQUIRE(table->num_buckets > num_buckets);
+  size_t visited = 500;
+  for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+    REQUIRE(HTIterator_Get(it, &oldkv));
+    const int64_t i = reinterpret_cast<int64_t>(oldkv.key);
+    REQUIRE(i < 1000);
+    REQUIRE(InlineKV(i).value == oldkv.value);
+    visited++;
+  }
+  HTIterator_Delete(it);
+  REQUIRE(1000 == visited);
+  REQUIRE(999 * 1000 / 2 == SumInlineKVs(snapshot));
+
+  REQUIRE(HashTable_Find(snapshot, InlineKV(50).hash, InlineKV(50).key,
+                         &oldkv));
+  REQUIRE(InlineKV(50).value == oldkv.value);
+  REQUIRE(HashTable_Find(snapshot, InlineKV(150).hash, InlineKV(150).key,
+                         &oldkv));
+  REQUIRE(HashTable_Find(table, InlineKV(50).hash, InlineKV(50).key, &oldkv));
+  REQUIRE(reinterpret_cast<HTValue_t>(150) == oldkv.value);
+  REQUIRE_FALSE(
+      HashTable_Find(table, InlineKV(150).hash, InlineKV(150).key, &oldkv));
+  REQUIRE(1900 == HashTable_NumElements(table));
+
+  // A snapshot is read-only.
+  REQUIRE_FALSE(HashTable_Insert(snapshot, InlineKV(7000), &oldkv));
+  REQUIRE_FALSE(HashTable_Find(snapshot, InlineKV(7000).hash,
+                               InlineKV(7000).key, &oldkv));
+  REQUIRE_FALSE(HashTable_Remove(snapshot, InlineKV(5).hash, InlineKV(5).key,
+                                 &oldkv));
+  it = HTIterator_New(snapshot);
+  REQUIRE_FALSE(HTIterator_Remove(it, &oldkv));
+  HTIterator_Delete(it);
+  REQUIRE_FALSE(HashTable_Freeze(snapshot));
+  REQUIRE_FALSE(HashTable_TrackDirty(snapshot, 4));
+  REQUIRE(1000 == HashTable_NumElements(snapshot));
+
+  // Snapshots of snapshots share the same buckets.
+  HashTable* second = HashTable_Snapshot(snapshot);
+  REQUIRE(second->buckets == snapshot->buckets);
+  HashTable_Delete(snapshot, &NoOpDelete);
+  REQUIRE(999 * 1000 / 2 == SumInlineKVs(second));
+  HashTable_Delete(second, &NoOpDelete);
+  for (int64_t i = 0; i < 100; i++) {
+    REQUIRE(HashTable_Insert(table, InlineKV(i), &oldkv));
+  }
+
+  // Removing through the table's own iterator, with a snapshot around,
+  // removes from the table's copies of the chains.
+  snapshot = HashTable_Snapshot(table);
+  const int64_t table_sum = SumInlineKVs(table);
+  int64_t removed_sum = 0;
+  it = HTIterator_New(table);
+  while (HTIterator_IsValid(it)) {
+    REQUIRE(HTIterator_Get(it, &oldkv));
+    const int64_t i = reinterpret_cast<int64_t>(oldkv.key);
+    if (i % 2 == 0) {
+      REQUIRE(HTIterator_Remove(it, &oldkv));
+      REQUIRE(i == reinterpret_cast<int64_t>(oldkv.key));
+      removed_sum += i;
+    } else {
+      HTIterator_Next(it);
+    }
+  }
+  HTIterator_Delete(it);
+  REQUIRE(950 == HashTable_NumElements(table));
+  REQUIRE(table_sum - removed_sum == SumInlineKVs(table));
+  REQUIRE(1900 == HashTable_NumElements(snapshot));
+  HashTable_Delete(snapshot, &NoOpDelete);
+
+  // With the snapshots gone, the next write stops sharing altogether.
+  REQUIRE(table->shared != nullptr);
+  HashTable_Insert(table, InlineKV(0), &oldkv);
+  REQUIRE(table->shared == nullptr);
+  HashTable_Delete(table, &NoOpDelete);
+
+  // Compact tables can't be snapshotted.
+  table = HashTable_NewCompact(7, ComparePointers);
+  REQUIRE(nullptr == HashTable_Snapshot(table));
+  HashTable_Delete(table, &NoOpDelete);
+}
+
+TEST_CASE("SnapshotOwnership", "[Test_HashTable]") {
+  // The table frees its keys and values; snapshots never do, even if they
+  // outlive the table's chains.
+  HashTable* table = HashTable_New(4, CompareKeys);
+  HTKeyValue_t oldkv;
+  for (int i = 0; i < 50; i++) {
+    string* key = new string("key" + to_string(i));
+    Payload* value = new Payload{k_magic_num, i};
+    HashTable_Insert(table, {HashString(*key), key, value}, &oldkv);
+  }
+  HashTable* snapshot = HashTable_Snapshot(table);
+
+  // The removed (key,value) is still in the snapshot, so isn't freed yet.
+  string keystr = "key7";
+  REQUIRE(HashTable_Remove(table, HashString(keystr), &keystr, &oldkv));
+  HTKeyValue_t removed = oldkv;
+  REQUIRE(HashTable_Find(snapshot, HashString(keystr), &keystr, &oldkv));
+  REQUIRE(7 == static_cast<Payload*>(oldkv.value)->payload_num);
+
+  g_free_invocations = 0;
+  HashTable_Delete(snapshot, &InstrumentedDelete);
+  REQUIRE(0 == g_free_invocations);
+  VerifiedDelete(removed);
+  snapshot = HashTable_Snapshot(table);
+  HashTable_Delete(table, &InstrumentedDelete);
+  REQUIRE(49 == g_free_invocations);
+  HashTable_Delete(snapshot, &NoOpDelete);
+}
+
+TEST_CASE("SnapshotConcurrent", "[Test_HashTable]") {
+  // Readers go through a snapshot while the table is rewritten, resized and
+  // snapshotted again underneath them.
+  HashTable* table = HashTable_New(16, ComparePointers);
+  HTKeyValue_t oldkv;
+  for (int64_t i = 0; i < 2000; i++) {
+    HashTable_Insert(table, InlineKV(i), &oldkv);
+  }
+  HashTable* snapshot = HashTable_Snapshot(table);
+
+  std::vector<std::thread> readers;
+  std::vector<int> failures(2, 0);
+  for (int r = 0; r < 2; r++) {
+    readers.emplace_back([snapshot, &failures, r]() {
+      for (int pass = 0; pass < 20; pass++) {
+        int64_t sum = 0;
+        size_t count = 0;
+        HTIterator* it = HTIterator_New(snapshot);
+        for (; HTIterator_IsValid(it); HTIterator_Next(it)) {
+          HTKeyValue_t kv;
+          HTIterator_Get(it, &kv);
+          sum += reinterpret_cast<int64_t>(kv.key);
+          count++;
+        }
+        HTIterator_Delete(it);
+        HTKeyValue_t kv;
+        const HTKeyValue_t probe = InlineKV(pass * 97);
+        if (sum != 1999 * 2000 / 2 || count != 2000 ||
+            !HashTable_Find(snapshot, probe.hash, probe.key, &kv) ||
+            kv.value != probe.value) {
+          failures[r]++;
+        }
+      }
+    });
+  }
+
+  for (int round = 0; round < 5; round++) {
+    for (int64_t i = 0; i < 2000; i += 3) {
+      HashTable_Remove(table, InlineKV(i).hash, InlineKV(i).key, &oldkv);
+    }
+    for (int64_t i = 2000 + round * 3000; i < 5000 + round * 3000; i++) {
+      HashTable_Insert(table, InlineKV(i), &oldkv);
+    }
+    HashTable_Delete(HashTable_Snapshot(table), &NoOpDelete);
+  }
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  REQUIRE(0 == failures[0] + failures[1]);
+  REQUIRE(1999 * 2000 / 2 == SumInlineKVs(snapshot));
+  HashTable_Delete(snapshot, &NoOpDelete);
+  HashTable_Delete(table, &NoOpDelete);
+}
@@ -0,0 +1,174 @@
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "./IntrusiveList.hpp"
+#include "./IntrusiveList_priv.hpp"
+
+#include "./catch.hpp"
+
+// An object that can be on two lists at once.
+typedef struct {
+  uint64_t key;
+  ILLink by_key;
+  ILLink by_parity;
+} Entry;
+
+static int g_il_free_invocations = 0;
+
+static void CountedFree(ILLink* link) {
+  REQUIRE(nullptr == ILLink_List(link));
+  g_il_free_invocations++;
+}
+
+// Requires that list holds exactly the entries whose keys are in expected,
+// in order, linked through their by_key links.
+static void RequireKeys(IntrusiveList* list,
+                        const std::vector<uint64_t>& expected) {
+  REQUIRE(expected.size() == IntrusiveList_NumElements(list));
+  ILIterator* iter = ILIterator_New(list);
+  ILLink* link = nullptr;
+  for (size_t i = 0; i < expected.size(); i++) {
+    REQUIRE(ILIterator_IsValid(iter));
+    ILIterator_Get(iter, &link);
+    REQUIRE(list == ILLink_List(link));
+    REQUIRE(expected[i] == IL_CONTAINER_OF(link, Entry, by_key)->key);
+    REQUIRE((i + 1 < expected.size()) == ILIterator_Next(iter));
+  }
+  REQUIRE_FALSE(ILIterator_IsValid(iter));
+  REQUIRE(link == list->tail);
+  ILIterator_Delete(iter);
+}
+
+TEST_CASE("PushPopAppendSlice", "[Test_IntrusiveList]") {
+  Entry entries[6];
+  for (uint64_t i = 0; i < 6; i++) {
+    entries[i].key = i;
+    ILLink_Init(&entries[i].by_key);
+    REQUIRE(nullptr == ILLink_List(&entries[i].by_key));
+  }
+
+  IntrusiveList* list = IntrusiveList_New();
+  ILLink* link;
+  REQUIRE_FALSE(IntrusiveList_Pop(list, &link));
+  REQUIRE_FALSE(IntrusiveList_Slice(list, &link));
+  RequireKeys(list, {});
+
+  IntrusiveList_Push(list, &entries[1].by_key);
+  IntrusiveList_Push(list, &entries[0].by_key);
+  IntrusiveList_Append(list, &entries[2].by_key);
+  IntrusiveList_Append(list, &entries[3].by_key);
+  RequireKeys(list, {0, 1, 2, 3});
+  REQUIRE(&entries[0].by_key == list->head);
+
+  REQUIRE(IntrusiveList_Pop(list, &link));
+  REQUIRE(&entries[0] == IL_CONTAINER_OF(link, Entry, by_key));
+  REQUIRE(nullptr == ILLink_List(link));
+  REQUIRE(IntrusiveList_Slice(list, &link));
+  REQUIRE(&entries[3] == IL_CONTAINER_OF(link, Entry, by_key));
+  RequireKeys(list, {1, 2});
+
+  // A popped link can go straight back on.
+  IntrusiveList_Append(list, link);
+  RequireKeys(list, {1, 2, 3});
+
+  // Deleting the list unlinks everything still on it.
+  g_il_free_invocations = 0;
+  IntrusiveList_Delete(list, &CountedFree);
+  REQUIRE(3 == g_il_free_invocations);
+  for (const Entry& entry : entries) {
+    REQUIRE(nullptr == ILLink_List(&entry.by_key));
+  }
+}
+
+TEST_CASE("RemoveByObject", "[Test_IntrusiveList]") {
+  // Put every entry on one list by key and on one of two lists by parity,
+  // then remove entries from the middle, ends and both kinds of list
+  // directly, without iterating to them.
+  std::vector<Entry> entries(10);
+  IntrusiveList* by_key = IntrusiveList_New();
+  IntrusiveList* by_parity[2] = {IntrusiveList_New(), IntrusiveList_New()};
+  for (uint64_t i = 0; i < entries.size(); i++) {
+    entries[i].key = i;
+    ILLink_Init(&entries[i].by_key);
+    ILLink_Init(&entries[i].by_parity);
+    IntrusiveList_Append(by_key, &entries[i].by_key);
+    IntrusiveList_Append(by_parity[i % 2], &entries[i].by_parity);
+  }
+  REQUIRE(by_parity[1] == ILLink_List(&entries[3].by_parity));
+
+  for (uint64_t i : {4, 0, 9, 5}) {
+    REQUIRE(IntrusiveList_Remove(&entries[i].by_key));
+  }
+  REQUIRE_FALSE(IntrusiveList_Remove(&entries[4].by_key));
+  RequireKeys(by_key, {1, 2, 3, 6, 7, 8});
+  REQUIRE(by_parity[0] == ILLink_List(&entries[4].by_parity));
+
+  REQUIRE(IntrusiveList_Remove(&entries[3].by_parity));
+  REQUIRE(IntrusiveList_Remove(&entries[1].by_parity));
+  REQUIRE(3 == IntrusiveList_NumElements(by_parity[1]));
+  REQUIRE(by_key == ILLink_List(&entries[3].by_key));
+
+  // Emptying a list through Remove leaves it usable.
+  for (uint64_t i = 0; i < entries.size(); i++) {
+    IntrusiveList_Remove(&entries[i].by_key);
+  }
+  RequireKeys(by_key, {});
+  REQUIRE(nullptr == by_key->head);
+  IntrusiveList_Push(by_key, &entries[7].by_key);
+  RequireKeys(by_key, {7});
+
+  IntrusiveList_Delete(by_key, nullptr);
+  IntrusiveList_Delete(by_parity[0], nullptr);
+  IntrusiveList_Delete(by_parity[1], nullptr);
+}
+
+TEST_CASE("IteratorRemove", "[Test_IntrusiveList]") {
+  // Remove random entries through an iterator, checking that it moves on
+  // exactly as an LLIterator does.
+  srand(1234);
+  std::vector<Entry> entries(200);
+  IntrusiveList* list = IntrusiveList_New();
+  std::vector<uint64_t> expected;
+  for (uint64_t i = 0; i < entries.size(); i++) {
+    entries[i].key = i;
+    ILLink_Init(&entries[i].by_key);
+    IntrusiveList_Append(list, &entries[i].by_key);
+    expected.push_back(i);
+  }
+
+  g_il_free_invocations = 0;
+  ILIterator* iter = ILIterator_New(list);
+  ILLink* link;
+  while (!expected.empty()) {
+    ILIterator_Rewind(iter);
+    size_t pos = rand() % expected.size();
+    if (rand() % 8 == 0) {
+      pos = expected.size() - 1;
+    }
+    for (size_t i = 0; i < pos; i++) {
+      ILIterator_Next(iter);
+    }
+    ILIterator_Get(iter, &link);
+    REQUIRE(expected[pos] == IL_CONTAINER_OF(link, Entry, by_key)->key);
+
+    REQUIRE((expected.size() > 1) == ILIterator_Remove(iter, &CountedFree));
+    expected.erase(expected.begin() + pos);
+    if (expected.empty()) {
+      REQUIRE_FALSE(ILIterator_IsValid(iter));
+    } else {
+      ILIterator_Get(iter, &link);
+      const size_t now = pos < expected.size() ? pos : pos - 1;
+      REQUIRE(expected[now] == IL_CONTAINER_OF(link, Entry, by_key)->key);
+    }
+    if (expected.size() % 50 == 0) {
+      RequireKeys(list, expected);
+    }
+  }
+  REQUIRE(200 == g_il_free_invocations);
+  REQUIRE(nullptr == list->head);
+  REQUIRE(nullptr == list->tail);
+  ILIterator_Delete(iter);
+  IntrusiveList_Delete(list, &CountedFree);
+  REQUIRE(200 == g_il_free_invocations);
+}
@@ -1,6 +1,12 @@
 #include <unistd.h>
+#include <algorithm>
 #include <bit>
 #include <cerrno>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "./LinkedList.hpp"
 #include "./LinkedList_priv.hpp"
@@ -271,3 +277,434 @@ TEST_CASE("Iterator", "[Test_LinkedList]") {
   // Free the list.
   LinkedList_Delete(llp, &StubbedDelete);
 }
+
+// Sort tests order payloads by their upper 32 bits only, and keep a
+// sequence number in the lower 32 so that stability can be checked.
+static int CompareUpperHalves(LLPayload_t a, LLPayload_t b) {
+  const uint64_t ka = std::bit_cast<uint64_t>(a) >> 32;
+  const uint64_t kb = std::bit_cast<uint64_t>(b) >> 32;
+  return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+static bool UpperHalfLess(uint64_t a, uint64_t b) {
+  return (a >> 32) < (b >> 32);
+}
+
+// Appends n payloads with random keys below num_keys and sequence numbers
+// starting at first_seq, recording them in expected too.
+static void AppendRandom(LinkedList* llp, size_t n, int num_keys,
+                         uint64_t first_seq, std::vector<uint64_t>* expected) {
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t v =
+        (static_cast<uint64_t>(rand() % num_keys) << 32) | (first_seq + i);
+    LinkedList_Append(llp, std::bit_cast<LLPayload_t>(v));
+    expected->push_back(v);
+  }
+}
+
+// Requires that the list holds exactly expected, in order, in both
+// directions.
+static void RequireList(LinkedList* llp, const std::vector<uint64_t>& expected) {
+  REQUIRE(expected.size() == LinkedList_NumElements(llp));
+  LinkedListNode* prev = nullptr;
+  size_t i = 0;
+  for (LinkedListNode* node = llp->head; node != nullptr; node = node->next) {
+    REQUIRE(i < expected.size());
+    REQUIRE(prev == node->prev);
+    if (std::bit_cast<uint64_t>(node->payload) != expected[i]) {
+      FAIL("element " << i << " is out of place");
+    }
+    prev = node;
+    i++;
+  }
+  REQUIRE(prev == llp->tail);
+  REQUIRE(expected.size() == i);
+}
+
+TEST_CASE("SortMerge", "[Test_LinkedList]") {
+  srand(7);
+
+  // Empty and one-element lists are left alone.
+  LinkedList* llp = LinkedList_New();
+  LinkedList_Sort(llp, &CompareUpperHalves);
+  REQUIRE(nullptr == llp->head);
+  std::vector<uint64_t> expected;
+  AppendRandom(llp, 1, 10, 0, &expected);
+  LinkedList_Sort(llp, &CompareUpperHalves);
+  RequireList(llp, expected);
+  LinkedList_Delete(llp, &StubbedDelete);
+
+  // Sorting relinks the same nodes, stably.
+  llp = LinkedList_New();
+  expected.clear();
+  AppendRandom(llp, 1000, 50, 1, &expected);
+  std::vector<LinkedListNode*> nodes;
+  for (LinkedListNode* node = llp->head; node != nullptr; node = node->next) {
+    nodes.push_back(node);
+  }
+  LinkedList_Sort(llp, &CompareUpperHalves);
+  std::stable_sort(expected.begin(), expected.end(), UpperHalfLess);
+  RequireList(llp, expected);
+  std::vector<LinkedListNode*> sorted_nodes;
+  for (LinkedListNode* node = llp->head; node != nullptr; node = node->next) {
+    sorted_nodes.push_back(node);
+  }
+  std::sort(nodes.begin(), nodes.end());
+  std::sort(sorted_nodes.begin(), sorted_nodes.end());
+  REQUIRE(nodes == sorted_nodes);
+
+  // Merging in another sorted list keeps dst's elements first on ties, and
+  // leaves src empty.
+  LinkedList* src = LinkedList_New();
+  std::vector<uint64_t> src_expected;
+  AppendRandom(src, 500, 50, 5000, &src_expected);
+  LinkedList_Sort(src, &CompareUpperHalves);
+  LinkedList_Merge(llp, src, &CompareUpperHalves);
+  expected.insert(expected.end(), src_expected.begin(), src_expected.end());
+  std::stable_sort(expected.begin(), expected.end(), UpperHalfLess);
+  RequireList(llp, expected);
+  REQUIRE(0 == LinkedList_NumElements(src));
+  REQUIRE(nullptr == src->head);
+  REQUIRE(nullptr == src->tail);
+
+  // Merging with an empty list, either way around.
+  LinkedList_Merge(llp, src, &CompareUpperHalves);
+  RequireList(llp, expected);
+  LinkedList_Merge(src, llp, &CompareUpperHalves);
+  RequireList(src, expected);
+  RequireList(llp, {});
+  LinkedList_Delete(llp, &StubbedDelete);
+  LinkedList_Delete(src, &StubbedDelete);
+
+  // A parallel sort of a list long enough to be cut into (uneven) chunks
+  // gives the same result as a sequential one.
+  llp = LinkedList_New();
+  expected.clear();
+  AppendRandom(llp, 200003, 1000, 1, &expected);
+  LinkedList_SortParallel(llp, &CompareUpperHalves, 3);
+  std::stable_sort(expected.begin(), expected.end(), UpperHalfLess);
+  RequireList(llp, expected);
+  LinkedList_Delete(llp, &StubbedDelete);
+}
+
+// Returns a list of the payloads first, first + 1, ..., last - 1, recording
+// them in expected too.
+static LinkedList* RangeList(uint64_t first, uint64_t last,
+                             std::vector<uint64_t>* expected) {
+  LinkedList* llp = LinkedList_New();
+  for (uint64_t v = first; v < last; v++) {
+    LinkedList_Append(llp, std::bit_cast<LLPayload_t>(v));
+    expected->push_back(v);
+  }
+  return llp;
+}
+
+TEST_CASE("SpliceSplit", "[Test_LinkedList]") {
+  // Concatenating moves the nodes themselves and empties src.
+  std::vector<uint64_t> expected, src_expected;
+  LinkedList* llp = RangeList(1, 4, &expected);
+  LinkedList* src = RangeList(4, 7, &expected);
+  LinkedListNode* src_head = src->head;
+  LinkedList_Concat(llp, src);
+  RequireList(llp, expected);
+  RequireList(src, {});
+  REQUIRE(src_head == llp->head->next->next->next);
+
+  // Concatenating onto (or from) an empty list.
+  LinkedList_Concat(src, llp);
+  RequireList(src, expected);
+  RequireList(llp, {});
+  LinkedList_Concat(src, llp);
+  RequireList(src, expected);
+  LinkedList_Delete(llp, &StubbedDelete);
+  llp = src;
+
+  // Splice into the middle, at the head, and past the end; the iterator
+  // stays on the same element.
+  LLIterator* lli = LLIterator_New(llp);
+  REQUIRE(LLIterator_Next(lli));
+  LinkedListNode* at = lli->node;
+  src = RangeList(10, 13, &src_expected);
+  LinkedList_SpliceAt(lli, src);
+  expected.insert(expected.begin() + 1, src_expected.begin(),
+                  src_expected.end());
+  RequireList(llp, expected);
+  RequireList(src, {});
+  REQUIRE(at == lli->node);
+
+  LLIterator_Rewind(lli);
+  src_expected.clear();
+  LinkedList_Delete(src, &StubbedDelete);
+  src = RangeList(20, 22, &src_expected);
+  LinkedList_SpliceAt(lli, src);
+  expected.insert(expected.begin(), src_expected.begin(), src_expected.end());
+  RequireList(llp, expected);
+
+  while (LLIterator_IsValid(lli)) {
+    LLIterator_Next(lli);
+  }
+  src_expected.clear();
+  LinkedList_Delete(src, &StubbedDelete);
+  src = RangeList(30, 31, &src_expected);
+  LinkedList_SpliceAt(lli, src);
+  expected.push_back(30);
+  RequireList(llp, expected);
+  REQUIRE(0 == g_free_invocations);
+  LinkedList_Delete(src, &StubbedDelete);
+
+  // Split near the end, near the front, and at the head; each split counts
+  // both halves correctly whichever side is shorter.
+  std::vector<LinkedList*> parts;
+  for (int skip : {9, 2, 0}) {
+    LLIterator_Rewind(lli);
+    for (int i = 0; i < skip; i++) {
+      REQUIRE(LLIterator_Next(lli));
+    }
+    LinkedList* rest = LinkedList_SplitAt(lli);
+    REQUIRE_FALSE(LLIterator_IsValid(lli));
+    RequireList(rest, std::vector<uint64_t>(expected.begin() + skip,
+                                            expected.end()));
+    expected.resize(skip);
+    RequireList(llp, expected);
+    parts.push_back(rest);
+  }
+
+  // Splitting past the end detaches nothing.
+  LinkedList* rest = LinkedList_SplitAt(lli);
+  RequireList(rest, {});
+  RequireList(llp, {});
+  LLIterator_Delete(lli);
+
+  // Reassemble the pieces in order.
+  for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+    LinkedList_Concat(rest, *it);
+    LinkedList_Delete(*it, &StubbedDelete);
+  }
+  REQUIRE(12 == LinkedList_NumElements(rest));
+  REQUIRE(0 == g_free_invocations);
+  LinkedList_Delete(rest, &StubbedDelete);
+  LinkedList_Delete(llp, &StubbedDelete);
+  REQUIRE(12 == g_free_invocations);
+}
+
+static int CompareRaw(LLPayload_t a, LLPayload_t b) {
+  const uint64_t ka = std::bit_cast<uint64_t>(a);
+  const uint64_t kb = std::bit_cast<uint64_t>(b);
+  return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+// Requires that the list's skip-list index is consistent with its nodes:
+// every level visits towers in list order, and every link's width is the
+// distance between the towers' positions.
+static void RequireIndex(LinkedList* llp) {
+  REQUIRE(llp->index != nullptr);
+  std::unordered_map<LinkedListNode*, size_t> positions;
+  size_t pos = 0;
+  for (LinkedListNode* node = llp->head; node != nullptr; node = node->next) {
+    positions[node] = ++pos;
+  }
+  const LLSkipTower* head = &llp->index->head;
+  for (int level = 0; level < k_ll_skip_max_height; level++) {
+    const LLSkipTower* tower = head;
+    size_t tower_pos = 0;
+    while (tower->links[level].next != nullptr) {
+      REQUIRE(level < llp->index->height);
+      const LLSkipTower* next = tower->links[level].next;
+      REQUIRE(level < next->height);
+      REQUIRE(positions.count(next->node) == 1);
+      const size_t next_pos = positions[next->node];
+      if (next_pos - tower_pos != tower->links[level].width) {
+        FAIL("bad width at level " << level << ", position " << tower_pos);
+      }
+      tower = next;
+      tower_pos = next_pos;
+    }
+  }
+}
+
+TEST_CASE("SkipIndex", "[Test_LinkedList]") {
+  srand(99);
+
+  // Build a sorted list of even numbers, and index it.
+  LinkedList* llp = LinkedList_New();
+  std::deque<uint64_t> expected;
+  for (uint64_t i = 0; i < 3000; i++) {
+    LinkedList_Append(llp, std::bit_cast<LLPayload_t>(2 * i));
+    expected.push_back(2 * i);
+  }
+  LinkedList_AddIndex(llp);
+  RequireIndex(llp);
+
+  // Seeking by key finds the first element not less than the key, with or
+  // without the index.
+  LLIterator* lli = LLIterator_New(llp);
+  for (int round = 0; round < 2; round++) {
+    for (uint64_t key : {0, 1, 2, 777, 3000, 5997, 5998, 5999, 100000}) {
+      const auto it = std::lower_bound(expected.begin(), expected.end(), key);
+      const bool found = it != expected.end();
+      REQUIRE(found == LLIterator_Seek(lli, std::bit_cast<LLPayload_t>(key),
+                                       &CompareRaw));
+      REQUIRE(found == LLIterator_IsValid(lli));
+      if (found) {
+        LLPayload_t payload;
+        LLIterator_Get(lli, &payload);
+        REQUIRE(*it == std::bit_cast<uint64_t>(payload));
+        REQUIRE(static_cast<size_t>(it - expected.begin()) == lli->pos);
+      }
+    }
+    LinkedList_DropIndex(llp);
+    REQUIRE(nullptr == llp->index);
+  }
+  LinkedList_AddIndex(llp);
+
+  // Check a long random sequence of mutations, each followed by a seek to a
+  // random index, against a std::deque.
+  LLPayload_t payload;
+  uint64_t next = 1;
+  for (int round = 0; round < 4000; round++) {
+    switch (rand() % 5) {
+      case 0:
+        LinkedList_Push(llp, std::bit_cast<LLPayload_t>(next));
+        expected.push_front(next++);
+        break;
+      case 1:
+        LinkedList_Append(llp, std::bit_cast<LLPayload_t>(next));
+        expected.push_back(next++);
+        break;
+      case 2:
+        if (!expected.empty()) {
+          REQUIRE(LinkedList_Pop(llp, &payload));
+          expected.pop_front();
+        }
+        break;
+      case 3:
+        if (!expected.empty()) {
+          REQUIRE(LinkedList_Slice(llp, &payload));
+          expected.pop_back();
+        }
+        break;
+      default:
+        // Remove an element from the middle, the head or the tail.
+        if (expected.size() > 1) {
+          const size_t k = (rand() % 4 == 0) ? expected.size() - 1
+                                             : rand() % expected.size();
+          REQUIRE(LLIterator_SeekIndex(lli, k));
+          REQUIRE(LLIterator_Remove(lli, &StubbedDelete));
+          expected.erase(expected.begin() + k);
+          REQUIRE((k < expected.size() ? k : k - 1) == lli->pos);
+          LLIterator_Get(lli, &payload);
+          REQUIRE(expected[lli->pos] == std::bit_cast<uint64_t>(payload));
+        }
+        break;
+    }
+    if (!expected.empty()) {
+      const size_t k = rand() % expected.size();
+      REQUIRE(LLIterator_SeekIndex(lli, k));
+      LLIterator_Get(lli, &payload);
+      REQUIRE(expected[k] == std::bit_cast<uint64_t>(payload));
+    }
+    REQUIRE_FALSE(LLIterator_SeekIndex(lli, expected.size()));
+    REQUIRE_FALSE(LLIterator_IsValid(lli));
+    if (round % 500 == 0) {
+      RequireIndex(llp);
+    }
+  }
+  RequireIndex(llp);
+
+  // Iterating keeps track of the position too.
+  LLIterator_Rewind(lli);
+  for (size_t i = 0; i < 10; i++) {
+    REQUIRE(i == lli->pos);
+    LLIterator_Next(lli);
+  }
+
+  // Sorting and splitting rebuild the index.
+  LinkedList_Sort(llp, &CompareRaw);
+  RequireIndex(llp);
+  REQUIRE(LLIterator_SeekIndex(lli, expected.size() / 2));
+  LinkedList* rest = LinkedList_SplitAt(lli);
+  RequireIndex(llp);
+  REQUIRE(expected.size() / 2 == LinkedList_NumElements(llp));
+  LinkedList_AddIndex(rest);
+  LinkedList_Concat(rest, llp);
+  RequireIndex(rest);
+  RequireIndex(llp);
+  REQUIRE(expected.size() == LinkedList_NumElements(rest));
+
+  LLIterator_Delete(lli);
+  LinkedList_Delete(llp, &StubbedDelete);
+  LinkedList_Delete(rest, &StubbedDelete);
+}
+
+TEST_CASE("AppendManyToArray", "[Test_LinkedList]") {
+  std::vector<LLPayload_t> payloads;
+  for (uint64_t i = 1; i <= 1000; i++) {
+    payloads.push_back(std::bit_cast<LLPayload_t>(i));
+  }
+
+  // A short run is appended one node at a time; a long one goes into one
+  // block, laid out in list order, after whatever was already there.
+  LinkedList* llp = LinkedList_New();
+  LinkedList_AppendMany(llp, payloads.data(), 0);
+  REQUIRE(nullptr == llp->head);
+  LinkedList_AppendMany(llp, payloads.data(), 3);
+  LinkedList_AppendMany(llp, payloads.data() + 3, 997);
+  REQUIRE(1000 == LinkedList_NumElements(llp));
+  LinkedListNode* prev = nullptr;
+  LinkedListNode* node = llp->head;
+  for (size_t i = 0; i < 1000; i++, prev = node, node = node->next) {
+    REQUIRE(payloads[i] == node->payload);
+    REQUIRE(prev == node->prev);
+    if (i >= 3 && i + 1 < 1000) {
+      REQUIRE(node + 1 == node->next);
+    }
+  }
+  REQUIRE(nullptr == node);
+  REQUIRE(payloads.back() == llp->tail->payload);
+
+  std::vector<LLPayload_t> out(1200, nullptr);
+  REQUIRE(1000 == LinkedList_ToArray(llp, out.data(), out.size()));
+  REQUIRE(std::equal(payloads.begin(), payloads.end(), out.begin()));
+  REQUIRE(nullptr == out[1000]);
+  std::fill(out.begin(), out.end(), nullptr);
+  REQUIRE(5 == LinkedList_ToArray(llp, out.data(), 5));
+  REQUIRE(std::equal(payloads.begin(), payloads.begin() + 5, out.begin()));
+  REQUIRE(nullptr == out[5]);
+
+  // Block nodes are freed one at a time like any others, from any list
+  // they end up on.
+  LLPayload_t payload;
+  REQUIRE(LinkedList_Pop(llp, &payload));
+  REQUIRE(LinkedList_Slice(llp, &payload));
+  REQUIRE(payloads[999] == payload);
+  LLIterator* lli = LLIterator_New(llp);
+  for (int i = 0; i < 500; i++) {
+    LLIterator_Next(lli);
+  }
+  REQUIRE(LLIterator_Remove(lli, &StubbedDelete));
+  LinkedList* rest = LinkedList_SplitAt(lli);
+  LLIterator_Delete(lli);
+  LinkedList_AppendMany(rest, payloads.data(), 100);
+  LinkedList_Push(rest, payloads[0]);
+  REQUIRE(598 == LinkedList_NumElements(rest));
+  LinkedList_Delete(llp, &StubbedDelete);
+  REQUIRE(501 == g_free_invocations);
+
+  // Lists sharing blocks can be freed on different threads.
+  LinkedList* other = LinkedList_New();
+  LinkedList_AppendMany(other, payloads.data(), 1000);
+  lli = LLIterator_New(other);
+  for (int i = 0; i < 300; i++) {
+    LLIterator_Next(lli);
+  }
+  LinkedList_SpliceAt(lli, rest);
+  LinkedList_Delete(rest, &StubbedDelete);
+  LinkedList* tail = LinkedList_SplitAt(lli);
+  LLIterator_Delete(lli);
+  REQUIRE(898 == LinkedList_NumElements(other));
+  REQUIRE(700 == LinkedList_NumElements(tail));
+  std::thread thread(
+      [tail] { LinkedList_Delete(tail, [](LLPayload_t payload) {}); });
+  LinkedList_Delete(other, [](LLPayload_t payload) {});
+  thread.join();
+}
@@ -0,0 +1,213 @@
+#include <cstdint>
+#include <cstdlib>
+#include <list>
+#include <vector>
+
+#include "./IntrusiveList_priv.hpp"
+#include "./LRUCache.hpp"
+#include "./LRUCache_priv.hpp"
+
+#include "./catch.hpp"
+
+// The tests store small integers directly in the key and value slots, and
+// use each key as its own hash.
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+static HTKeyValue_t KeyValue(uint64_t key, uint64_t value) {
+  return HTKeyValue_t{key, reinterpret_cast<HTKey_t>(key),
+                      reinterpret_cast<HTValue_t>(value)};
+}
+
+static uint64_t KeyOf(HTKeyValue_t kv) {
+  return reinterpret_cast<uint64_t>(kv.key);
+}
+
+static uint64_t ValueOf(HTKeyValue_t kv) {
+  return reinterpret_cast<uint64_t>(kv.value);
+}
+
+// The keys evicted so far, in order.
+static std::vector<uint64_t> g_evicted;
+
+static void RecordEviction(HTKeyValue_t kv) {
+  g_evicted.push_back(KeyOf(kv));
+}
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+// Sizes an entry by its value.
+static size_t ValueSize(HTKeyValue_t kv) {
+  return ValueOf(kv);
+}
+
+static bool Get(LRUCache* cache, uint64_t key, uint64_t* value) {
+  HTKeyValue_t kv;
+  if (!LRUCache_Get(cache, key, reinterpret_cast<HTKey_t>(key), &kv)) {
+    return false;
+  }
+  REQUIRE(key == KeyOf(kv));
+  *value = ValueOf(kv);
+  return true;
+}
+
+// Requires that the cache holds exactly the keys in expected, least
+// recently used first.
+static void RequireRecency(LRUCache* cache,
+                           const std::list<uint64_t>& expected) {
+  REQUIRE(expected.size() == LRUCache_NumElements(cache));
+  ILLink* link = cache->recency->head;
+  for (uint64_t key : expected) {
+    REQUIRE(link != nullptr);
+    REQUIRE(key == KeyOf(IL_CONTAINER_OF(link, LRUEntry, recency)->kv));
+    link = link->next;
+  }
+  REQUIRE(nullptr == link);
+}
+
+TEST_CASE("GetPutEvict", "[Test_LRUCache]") {
+  g_evicted.clear();
+  REQUIRE(nullptr ==
+          LRUCache_New(0, &CompareInlineKeys, nullptr, &RecordEviction));
+  LRUCache* cache =
+      LRUCache_New(3, &CompareInlineKeys, nullptr, &RecordEviction);
+  HTKeyValue_t old;
+  uint64_t value;
+  for (uint64_t key = 1; key <= 3; key++) {
+    REQUIRE_FALSE(LRUCache_Put(cache, KeyValue(key, key * 10), &old));
+  }
+  RequireRecency(cache, {1, 2, 3});
+  REQUIRE(3 == LRUCache_Used(cache));
+
+  // A hit makes its entry the most recently used, so 2 goes first.
+  REQUIRE(Get(cache, 1, &value));
+  REQUIRE(10 == value);
+  REQUIRE_FALSE(Get(cache, 9, &value));
+  RequireRecency(cache, {2, 3, 1});
+  REQUIRE_FALSE(LRUCache_Put(cache, KeyValue(4, 40), &old));
+  RequireRecency(cache, {3, 1, 4});
+  REQUIRE(std::vector<uint64_t>{2} == g_evicted);
+  REQUIRE_FALSE(Get(cache, 2, &value));
+
+  // Replacing a key hands back the old (key,value) and evicts nothing.
+  REQUIRE(LRUCache_Put(cache, KeyValue(3, 33), &old));
+  REQUIRE(30 == ValueOf(old));
+  RequireRecency(cache, {1, 4, 3});
+  REQUIRE(Get(cache, 3, &value));
+  REQUIRE(33 == value);
+  REQUIRE(1 == g_evicted.size());
+
+  // Removing isn't an eviction.
+  REQUIRE(LRUCache_Remove(cache, 4, reinterpret_cast<HTKey_t>(4), &old));
+  REQUIRE(40 == ValueOf(old));
+  REQUIRE_FALSE(LRUCache_Remove(cache, 4, reinterpret_cast<HTKey_t>(4), &old));
+  RequireRecency(cache, {1, 3});
+
+  LRUStats_t stats;
+  LRUCache_GetStats(cache, &stats);
+  REQUIRE(2 == stats.hits);
+  REQUIRE(2 == stats.misses);
+  REQUIRE(1 == stats.evictions);
+  LRUCache_Delete(cache, &NoOpFree);
+  REQUIRE(1 == g_evicted.size());
+}
+
+TEST_CASE("ByteBudget", "[Test_LRUCache]") {
+  // Size each entry by its value, within a budget of 100.
+  g_evicted.clear();
+  LRUCache* cache =
+      LRUCache_New(100, &CompareInlineKeys, &ValueSize, &RecordEviction);
+  HTKeyValue_t old;
+  uint64_t value;
+  LRUCache_Put(cache, KeyValue(1, 30), &old);
+  LRUCache_Put(cache, KeyValue(2, 30), &old);
+  LRUCache_Put(cache, KeyValue(3, 30), &old);
+  REQUIRE(90 == LRUCache_Used(cache));
+  REQUIRE(Get(cache, 1, &value));
+
+  // Adding 50 has to evict the two least recently used entries.
+  LRUCache_Put(cache, KeyValue(4, 50), &old);
+  REQUIRE(std::vector<uint64_t>{2, 3} == g_evicted);
+  RequireRecency(cache, {1, 4});
+  REQUIRE(80 == LRUCache_Used(cache));
+
+  // Growing an entry in place can evict the others.
+  REQUIRE(LRUCache_Put(cache, KeyValue(1, 60), &old));
+  REQUIRE(std::vector<uint64_t>{2, 3, 4} == g_evicted);
+  REQUIRE(60 == LRUCache_Used(cache));
+
+  // An entry bigger than the whole budget doesn't stay.
+  LRUCache_Put(cache, KeyValue(5, 101), &old);
+  REQUIRE(std::vector<uint64_t>{2, 3, 4, 1, 5} == g_evicted);
+  REQUIRE(0 == LRUCache_NumElements(cache));
+  REQUIRE(0 == LRUCache_Used(cache));
+  LRUCache_Delete(cache, &NoOpFree);
+}
+
+TEST_CASE("RandomOperations", "[Test_LRUCache]") {
+  // Check a long random sequence of operations against a simple model: a
+  // std::list of keys, least recently used first.
+  srand(777);
+  g_evicted.clear();
+  const size_t k_capacity = 50;
+  LRUCache* cache =
+      LRUCache_New(k_capacity, &CompareInlineKeys, nullptr, &RecordEviction);
+  std::list<uint64_t> model;
+  std::vector<uint64_t> model_evicted;
+  HTKeyValue_t old;
+  uint64_t value;
+  LRUStats_t expected_stats{0, 0, 0};
+  for (int round = 0; round < 20000; round++) {
+    const uint64_t key = 1 + rand() % 150;
+    auto it = model.begin();
+    while (it != model.end() && *it != key) {
+      ++it;
+    }
+    const bool present = it != model.end();
+    switch (rand() % 3) {
+      case 0:
+        REQUIRE(present == Get(cache, key, &value));
+        if (present) {
+          REQUIRE(key + 1000 == value);
+          model.splice(model.end(), model, it);
+          expected_stats.hits++;
+        } else {
+          expected_stats.misses++;
+        }
+        break;
+      case 1:
+        REQUIRE(present ==
+                LRUCache_Put(cache, KeyValue(key, key + 1000), &old));
+        if (present) {
+          model.erase(it);
+        }
+        model.push_back(key);
+        if (model.size() > k_capacity) {
+          model_evicted.push_back(model.front());
+          model.pop_front();
+          expected_stats.evictions++;
+        }
+        break;
+      default:
+        REQUIRE(present == LRUCache_Remove(cache, key,
+                                           reinterpret_cast<HTKey_t>(key),
+                                           &old));
+        if (present) {
+          model.erase(it);
+        }
+        break;
+    }
+    if (round % 1000 == 0) {
+      RequireRecency(cache, model);
+    }
+  }
+  RequireRecency(cache, model);
+  REQUIRE(model_evicted == g_evicted);
+  LRUStats_t stats;
+  LRUCache_GetStats(cache, &stats);
+  REQUIRE(expected_stats.hits == stats.hits);
+  REQUIRE(expected_stats.misses == stats.misses);
+  REQUIRE(expected_stats.evictions == stats.evictions);
+  LRUCache_Delete(cache, &NoOpFree);
+}
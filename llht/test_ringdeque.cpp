@@ -0,0 +1,159 @@
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+
+#include "./RingDeque.hpp"
+#include "./RingDeque_priv.hpp"
+
+#include "./catch.hpp"
+
+static LLPayload_t Payload(uint64_t i) {
+  return std::bit_cast<LLPayload_t>(i);
+}
+
+static int g_rd_free_invocations = 0;
+
+static void CountedDelete(LLPayload_t payload) {
+  g_rd_free_invocations++;
+}
+
+// Requires that deque holds exactly the payloads in expected, in order,
+// checking both through an iterator and against the array directly.
+static void RequireContents(RingDeque* deque,
+                            const std::deque<uint64_t>& expected) {
+  REQUIRE(expected.size() == RingDeque_NumElements(deque));
+  REQUIRE(expected.size() <= deque->capacity);
+  RDIterator* iter = RDIterator_New(deque);
+  LLPayload_t payload;
+  for (size_t i = 0; i < expected.size(); i++) {
+    REQUIRE(RDIterator_IsValid(iter));
+    RDIterator_Get(iter, &payload);
+    REQUIRE(Payload(expected[i]) == payload);
+    REQUIRE(Payload(expected[i]) ==
+            deque->slots[(deque->head + i) & (deque->capacity - 1)]);
+    REQUIRE((i + 1 < expected.size()) == RDIterator_Next(iter));
+  }
+  REQUIRE_FALSE(RDIterator_IsValid(iter));
+  REQUIRE_FALSE(RDIterator_Next(iter));
+  RDIterator_Rewind(iter);
+  REQUIRE(!expected.empty() == RDIterator_IsValid(iter));
+  RDIterator_Delete(iter);
+}
+
+TEST_CASE("PushPopAppendSlice", "[Test_RingDeque]") {
+  RingDeque* deque = RingDeque_New();
+  REQUIRE(0 == RingDeque_NumElements(deque));
+  REQUIRE(nullptr == deque->slots);
+  LLPayload_t payload;
+  REQUIRE_FALSE(RingDeque_Pop(deque, &payload));
+  REQUIRE_FALSE(RingDeque_Slice(deque, &payload));
+  RequireContents(deque, {});
+
+  // Fill from both ends, so the payloads wrap around the array while it
+  // grows.
+  std::deque<uint64_t> expected;
+  for (uint64_t i = 1; i <= 100; i++) {
+    REQUIRE(RingDeque_Push(deque, Payload(i)));
+    expected.push_front(i);
+    REQUIRE(RingDeque_Append(deque, Payload(i + 1000)));
+    expected.push_back(i + 1000);
+  }
+  RequireContents(deque, expected);
+  REQUIRE(256 == deque->capacity);
+
+  for (int i = 0; i < 150; i++) {
+    REQUIRE(RingDeque_Pop(deque, &payload));
+    REQUIRE(Payload(expected.front()) == payload);
+    expected.pop_front();
+  }
+  RequireContents(deque, expected);
+  while (!expected.empty()) {
+    REQUIRE(RingDeque_Slice(deque, &payload));
+    REQUIRE(Payload(expected.back()) == payload);
+    expected.pop_back();
+  }
+  REQUIRE_FALSE(RingDeque_Pop(deque, &payload));
+
+  // Deleting frees every remaining payload.
+  g_rd_free_invocations = 0;
+  for (uint64_t i = 1; i <= 30; i++) {
+    RingDeque_Append(deque, Payload(i));
+  }
+  RingDeque_Delete(deque, &CountedDelete);
+  REQUIRE(30 == g_rd_free_invocations);
+}
+
+TEST_CASE("Bounded", "[Test_RingDeque]") {
+  // A bounded deque refuses payloads once full, at either end, and accepts
+  // them again once there's room.
+  RingDeque* deque = RingDeque_NewBounded(5);
+  REQUIRE(8 == deque->capacity);
+  std::deque<uint64_t> expected;
+  for (uint64_t i = 1; i <= 5; i++) {
+    REQUIRE(RingDeque_Append(deque, Payload(i)));
+    expected.push_back(i);
+  }
+  REQUIRE_FALSE(RingDeque_Append(deque, Payload(6)));
+  REQUIRE_FALSE(RingDeque_Push(deque, Payload(6)));
+  RequireContents(deque, expected);
+  REQUIRE(8 == deque->capacity);
+
+  LLPayload_t payload;
+  REQUIRE(RingDeque_Pop(deque, &payload));
+  expected.pop_front();
+  REQUIRE(RingDeque_Push(deque, Payload(7)));
+  expected.push_front(7);
+  REQUIRE_FALSE(RingDeque_Push(deque, Payload(8)));
+  RequireContents(deque, expected);
+  RingDeque_Delete(deque, &CountedDelete);
+}
+
+TEST_CASE("RandomOperations", "[Test_RingDeque]") {
+  // Check a long random sequence of operations against a std::deque, on a
+  // growable deque and a bounded one.
+  srand(54321);
+  for (size_t bound : {0, 37}) {
+    RingDeque* deque =
+        bound == 0 ? RingDeque_New() : RingDeque_NewBounded(bound);
+    std::deque<uint64_t> expected;
+    LLPayload_t payload;
+    uint64_t next = 1;
+    for (int round = 0; round < 5000; round++) {
+      const bool full = bound != 0 && expected.size() == bound;
+      switch (rand() % 4) {
+        case 0:
+          REQUIRE(!full == RingDeque_Push(deque, Payload(next)));
+          if (!full) {
+            expected.push_front(next++);
+          }
+          break;
+        case 1:
+          REQUIRE(!full == RingDeque_Append(deque, Payload(next)));
+          if (!full) {
+            expected.push_back(next++);
+          }
+          break;
+        case 2:
+          REQUIRE(!expected.empty() == RingDeque_Pop(deque, &payload));
+          if (!expected.empty()) {
+            REQUIRE(Payload(expected.front()) == payload);
+            expected.pop_front();
+          }
+          break;
+        default:
+          REQUIRE(!expected.empty() == RingDeque_Slice(deque, &payload));
+          if (!expected.empty()) {
+            REQUIRE(Payload(expected.back()) == payload);
+            expected.pop_back();
+          }
+          break;
+      }
+      if (round % 100 == 0) {
+        RequireContents(deque, expected);
+      }
+    }
+    RequireContents(deque, expected);
+    RingDeque_Delete(deque, &CountedDelete);
+  }
+}
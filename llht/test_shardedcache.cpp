@@ -0,0 +1,269 @@
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "./ShardedCache.hpp"
+#include "./ShardedCache_priv.hpp"
+
+#include "./catch.hpp"
+
+// The tests store small integers directly in the key and value slots.
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+// Spreads keys over every bit of the hash, so that they spread over the
+// shards too.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static HTKeyValue_t KeyValue(uint64_t key, uint64_t value) {
+  return HTKeyValue_t{MixHash(key), reinterpret_cast<HTKey_t>(key),
+                      reinterpret_cast<HTValue_t>(value)};
+}
+
+static uint64_t ValueOf(HTKeyValue_t kv) {
+  return reinterpret_cast<uint64_t>(kv.value);
+}
+
+static void NoOpFree(HTKeyValue_t kv) {}
+
+static std::vector<uint64_t> g_sc_evicted;
+
+static void RecordEviction(HTKeyValue_t kv) {
+  g_sc_evicted.push_back(reinterpret_cast<uint64_t>(kv.key));
+}
+
+static bool Get(ShardedCache* cache, uint64_t key, uint64_t* value) {
+  HTKeyValue_t kv;
+  if (!ShardedCache_Get(cache, MixHash(key), reinterpret_cast<HTKey_t>(key),
+                        &kv)) {
+    return false;
+  }
+  *value = ValueOf(kv);
+  return true;
+}
+
+static void Put(ShardedCache* cache, uint64_t key, uint64_t value) {
+  HTKeyValue_t old;
+  ShardedCache_Put(cache, KeyValue(key, value), &old);
+}
+
+// Returns the entry for key, which must be in the single-shard cache.
+static SCEntry* EntryFor(ShardedCache* cache, uint64_t key) {
+  HTKeyValue_t kv;
+  REQUIRE(HashTable_Find(cache->shards[0].table, MixHash(key),
+                         reinterpret_cast<HTKey_t>(key), &kv));
+  return static_cast<SCEntry*>(kv.value);
+}
+
+TEST_CASE("GetPutRemove", "[Test_ShardedCache]") {
+  SCOptions_t options{4, 10, nullptr, nullptr, nullptr};
+  ShardedCache* cache = ShardedCache_New(&options, &CompareInlineKeys);
+  REQUIRE(4 == cache->num_shards);
+  options.num_shards = 5;
+  ShardedCache* rounded = ShardedCache_New(&options, &CompareInlineKeys);
+  REQUIRE(8 == rounded->num_shards);
+  ShardedCache_Delete(rounded, &NoOpFree);
+  options.shard_capacity = 0;
+  REQUIRE(nullptr == ShardedCache_New(&options, &CompareInlineKeys));
+
+  uint64_t value;
+  for (uint64_t key = 1; key <= 8; key++) {
+    Put(cache, key, key * 10);
+  }
+  REQUIRE(8 == ShardedCache_NumElements(cache));
+  for (uint64_t key = 1; key <= 8; key++) {
+    REQUIRE(Get(cache, key, &value));
+    REQUIRE(key * 10 == value);
+  }
+  REQUIRE_FALSE(Get(cache, 99, &value));
+
+  HTKeyValue_t old;
+  REQUIRE(ShardedCache_Put(cache, KeyValue(3, 33), &old));
+  REQUIRE(30 == ValueOf(old));
+  REQUIRE(Get(cache, 3, &value));
+  REQUIRE(33 == value);
+  REQUIRE(ShardedCache_Remove(cache, MixHash(3), reinterpret_cast<HTKey_t>(3),
+                              &old));
+  REQUIRE(33 == ValueOf(old));
+  REQUIRE_FALSE(ShardedCache_Remove(cache, MixHash(3),
+                                    reinterpret_cast<HTKey_t>(3), &old));
+  REQUIRE(7 == ShardedCache_NumElements(cache));
+
+  SCStats_t stats;
+  ShardedCache_GetStats(cache, &stats);
+  REQUIRE(9 == stats.hits);
+  REQUIRE(1 == stats.misses);
+  REQUIRE(0 == stats.evictions);
+  REQUIRE(0 == stats.rejections);
+  ShardedCache_Delete(cache, &NoOpFree);
+}
+
+TEST_CASE("ScanResistance", "[Test_ShardedCache]") {
+  // Fill a shard with a working set that is hit once each, then scan a
+  // long run of keys that are never seen again.  The scan passes through
+  // the small queue without displacing any of the working set.
+  g_sc_evicted.clear();
+  SCOptions_t options{1, 100, nullptr, &RecordEviction, nullptr};
+  ShardedCache* cache = ShardedCache_New(&options, &CompareInlineKeys);
+  uint64_t value;
+  for (uint64_t key = 1; key <= 80; key++) {
+    Put(cache, key, key);
+    REQUIRE(Get(cache, key, &value));
+  }
+  for (uint64_t key = 1000; key < 3000; key++) {
+    Put(cache, key, key);
+  }
+  for (uint64_t key = 1; key <= 80; key++) {
+    REQUIRE(Get(cache, key, &value));
+    REQUIRE(EntryFor(cache, key)->in_main);
+  }
+  REQUIRE(100 == ShardedCache_NumElements(cache));
+  for (uint64_t key : g_sc_evicted) {
+    REQUIRE(key >= 1000);
+  }
+
+  // The cache stays within its budget, and the small queue within its
+  // share of it once the main queue has filled.
+  SCShard* shard = &cache->shards[0];
+  REQUIRE(100 == shard->small_used + shard->main_used);
+  REQUIRE(shard->small_used <= 20);
+
+  // Entries in the main queue that stop being hit eventually go: each
+  // scan key that comes back soon after being evicted is promoted.
+  g_sc_evicted.clear();
+  for (int round = 0; round < 3; round++) {
+    for (uint64_t key = 5000; key < 5100; key++) {
+      Put(cache, key, key);
+    }
+  }
+  size_t working_set_evicted = 0;
+  for (uint64_t key : g_sc_evicted) {
+    working_set_evicted += (key <= 80);
+  }
+  REQUIRE(working_set_evicted > 0);
+  ShardedCache_Delete(cache, &NoOpFree);
+}
+
+TEST_CASE("GhostPromotion", "[Test_ShardedCache]") {
+  SCOptions_t options{1, 20, nullptr, nullptr, nullptr};
+  ShardedCache* cache = ShardedCache_New(&options, &CompareInlineKeys);
+  uint64_t value;
+  for (uint64_t key = 1; key <= 20; key++) {
+    Put(cache, key, key);
+  }
+  REQUIRE_FALSE(EntryFor(cache, 1)->in_main);
+
+  // Key 1 was never hit, so it is evicted from the small queue and leaves
+  // its hash behind; coming back, it goes straight into the main queue.
+  Put(cache, 21, 21);
+  REQUIRE_FALSE(Get(cache, 1, &value));
+  HTHash_t* ghosts = cache->shards[0].ghosts;
+  REQUIRE(32 == cache->ghost_mask + 1);
+  REQUIRE((MixHash(1) | 1) == ghosts[MixHash(1) & cache->ghost_mask]);
+  Put(cache, 1, 1);
+  REQUIRE(EntryFor(cache, 1)->in_main);
+  REQUIRE(0 == ghosts[MixHash(1) & cache->ghost_mask]);
+
+  // A key that merely shares a ghost's slot isn't promoted.
+  uint64_t other = 100;
+  while ((MixHash(other) & cache->ghost_mask) !=
+         (MixHash(2) & cache->ghost_mask)) {
+    other++;
+  }
+  Put(cache, 23, 23);
+  REQUIRE((MixHash(2) | 1) == ghosts[MixHash(2) & cache->ghost_mask]);
+  Put(cache, other, other);
+  REQUIRE_FALSE(EntryFor(cache, other)->in_main);
+  ShardedCache_Delete(cache, &NoOpFree);
+}
+
+// Sizes an entry by its value.
+static size_t ValueSize(HTKeyValue_t kv) {
+  return ValueOf(kv);
+}
+
+// Admits only even keys.
+static bool AdmitEven(HTKeyValue_t kv, size_t size) {
+  return reinterpret_cast<uint64_t>(kv.key) % 2 == 0;
+}
+
+TEST_CASE("Admission", "[Test_ShardedCache]") {
+  g_sc_evicted.clear();
+  SCOptions_t options{1, 100, &ValueSize, &RecordEviction, &AdmitEven};
+  ShardedCache* cache = ShardedCache_New(&options, &CompareInlineKeys);
+  uint64_t value;
+  Put(cache, 2, 40);
+  Put(cache, 3, 40);
+  Put(cache, 4, 101);
+  REQUIRE(Get(cache, 2, &value));
+  REQUIRE_FALSE(Get(cache, 3, &value));
+  REQUIRE_FALSE(Get(cache, 4, &value));
+  REQUIRE(std::vector<uint64_t>{3, 4} == g_sc_evicted);
+
+  // A rejected replacement leaves the old value in place.
+  HTKeyValue_t old;
+  REQUIRE_FALSE(ShardedCache_Put(cache, KeyValue(2, 500), &old));
+  REQUIRE(Get(cache, 2, &value));
+  REQUIRE(40 == value);
+
+  // Sizes count against the budget.
+  Put(cache, 6, 30);
+  Put(cache, 8, 50);
+  REQUIRE(cache->shards[0].small_used + cache->shards[0].main_used <= 100);
+  SCStats_t stats;
+  ShardedCache_GetStats(cache, &stats);
+  REQUIRE(3 == stats.rejections);
+  REQUIRE(stats.evictions >= 1);
+  ShardedCache_Delete(cache, &NoOpFree);
+}
+
+TEST_CASE("ManyThreads", "[Test_ShardedCache]") {
+  // Several threads get and put overlapping keys; every hit returns the
+  // key's value, and the counters add up.
+  SCOptions_t options{8, 64, nullptr, nullptr, nullptr};
+  ShardedCache* cache = ShardedCache_New(&options, &CompareInlineKeys);
+  const int k_threads = 4;
+  const int k_ops = 20000;
+  std::vector<int> bad(k_threads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < k_threads; t++) {
+    threads.emplace_back([cache, t, &bad] {
+      uint64_t rng = 12345 + t;
+      for (int i = 0; i < k_ops; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        const uint64_t key = 1 + (rng % 1000) % (1 + rng % 1000);
+        HTKeyValue_t kv;
+        if (ShardedCache_Get(cache, MixHash(key),
+                             reinterpret_cast<HTKey_t>(key), &kv)) {
+          bad[t] += (ValueOf(kv) != key * 2);
+        } else {
+          HTKeyValue_t old;
+          ShardedCache_Put(cache, KeyValue(key, key * 2), &old);
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (int count : bad) {
+    REQUIRE(0 == count);
+  }
+  SCStats_t stats;
+  ShardedCache_GetStats(cache, &stats);
+  REQUIRE(k_threads * k_ops == stats.hits + stats.misses);
+  REQUIRE(stats.hits > 0);
+  REQUIRE(ShardedCache_NumElements(cache) <= 8 * 64);
+  ShardedCache_Delete(cache, &NoOpFree);
+}
@@ -0,0 +1,251 @@
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "./HashTable.hpp"
+#include "./SpillTable.hpp"
+#include "./SpillTable_priv.hpp"
+
+#include "./catch.hpp"
+
+using std::string;
+using std::to_string;
+
+// The tests store small integers directly in the key and value slots.
+static bool CompareInlineKeys(HTKey_t lhs, HTKey_t rhs) {
+  return lhs == rhs;
+}
+
+// Spreads keys over every bit of the hash, so that they spread over the
+// partitions too.
+static HTHash_t MixHash(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static HTKeyValue_t KeyValue(uint64_t key, uint64_t value) {
+  return HTKeyValue_t{MixHash(key), reinterpret_cast<HTKey_t>(key),
+                      reinterpret_cast<HTValue_t>(value)};
+}
+
+static uint64_t ValueOf(HTKeyValue_t kv) {
+  return reinterpret_cast<uint64_t>(kv.value);
+}
+
+static bool FindValue(SpillTable* table, uint64_t key, uint64_t* value) {
+  HTKeyValue_t kv;
+  if (!SpillTable_Find(table, MixHash(key), reinterpret_cast<HTKey_t>(key),
+                       &kv)) {
+    return false;
+  }
+  *value = ValueOf(kv);
+  return true;
+}
+
+// Returns the keys [0, n), grouped by the partition of table they fall in.
+// Spilling pays off when a table's keys arrive in clusters like this;
+// visiting keys in no particular order reloads partitions all the time.
+static std::vector<uint64_t> ClusteredKeys(SpillTable* table, uint64_t n) {
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < n; i++) {
+    keys.push_back(i);
+  }
+  std::stable_sort(keys.begin(), keys.end(), [table](uint64_t a, uint64_t b) {
+    return SpillTable_PartitionOf(table, MixHash(a)) <
+           SpillTable_PartitionOf(table, MixHash(b));
+  });
+  return keys;
+}
+
+static bool DirExists(const string& path) {
+  struct stat st{};
+  return stat(path.c_str(), &st) == 0;
+}
+
+TEST_CASE("Spill", "[Test_SpillTable]") {
+  const STOptions_t options{256 * 1024, 4, nullptr, false};
+  SpillTable* table = SpillTable_New(&options, CompareInlineKeys);
+  REQUIRE(table != nullptr);
+  REQUIRE(16 == SpillTable_NumPartitions(table));
+  const string dir = table->dir;
+  REQUIRE(DirExists(dir));
+
+  const std::vector<uint64_t> keys = ClusteredKeys(table, 100000);
+
+  // 100000 elements take several times the budget, so most partitions
+  // have to be spilled, and the table stays within its budget plus (at
+  // most) the partition it is using.
+  HTKeyValue_t old;
+  for (uint64_t i : keys) {
+    REQUIRE_FALSE(SpillTable_Insert(table, KeyValue(i, i * 2), &old));
+    const size_t p = SpillTable_PartitionOf(table, MixHash(i));
+    REQUIRE(table->memory_bytes <=
+            options.memory_limit + table->partitions[p].memory_bytes);
+  }
+  REQUIRE(100000 == SpillTable_NumElements(table));
+  STStats_t stats;
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(stats.spills > 0);
+  REQUIRE(stats.spill_bytes > 0);
+  REQUIRE(stats.num_spilled > 0);
+  REQUIRE(stats.memory_bytes == table->memory_bytes);
+  REQUIRE(0 == stats.reloads);
+  REQUIRE(0 == stats.buffered_ops);
+  REQUIRE(0 == stats.failures);
+
+  // Everything can be found again, reloading partitions as needed, even
+  // in no particular order.
+  uint64_t value;
+  for (uint64_t i = 0; i < 100000; i += 331) {
+    REQUIRE(FindValue(table, i, &value));
+    REQUIRE(i * 2 == value);
+  }
+  REQUIRE_FALSE(FindValue(table, 100000, &value));
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(stats.reloads > 0);
+  REQUIRE(stats.reload_bytes > 0);
+
+  // Replacing and removing elements work on reloaded partitions too.
+  for (uint64_t i : keys) {
+    if (i % 2 == 0) {
+      REQUIRE(SpillTable_Insert(table, KeyValue(i, i * 3), &old));
+      REQUIRE(i * 2 == ValueOf(old));
+    }
+  }
+  for (uint64_t i : keys) {
+    if (i % 5 == 0) {
+      HTKeyValue_t removed;
+      REQUIRE(SpillTable_Remove(table, MixHash(i),
+                                reinterpret_cast<HTKey_t>(i), &removed));
+      REQUIRE((i % 2 == 0 ? i * 3 : i * 2) == ValueOf(removed));
+    }
+  }
+  REQUIRE(80000 == SpillTable_NumElements(table));
+  for (uint64_t i : keys) {
+    if (i % 5 == 0) {
+      REQUIRE_FALSE(FindValue(table, i, &value));
+    } else {
+      REQUIRE(FindValue(table, i, &value));
+      REQUIRE((i % 2 == 0 ? i * 3 : i * 2) == value);
+    }
+  }
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(0 == stats.failures);
+
+  // Deleting the table cleans up after it.
+  SpillTable_Delete(table);
+  REQUIRE_FALSE(DirExists(dir));
+}
+
+TEST_CASE("SpillBuffered", "[Test_SpillTable]") {
+  const STOptions_t options{128 * 1024, 3, nullptr, true};
+  SpillTable* table = SpillTable_New(&options, CompareInlineKeys);
+  REQUIRE(table != nullptr);
+
+  // Once partitions are spilled, inserts into them are logged rather than
+  // reloading them, so the table never reloads anything.
+  HTKeyValue_t old;
+  for (uint64_t i = 0; i < 60000; i++) {
+    SpillTable_Insert(table, KeyValue(i, i), &old);
+  }
+  // Replace some values; the later record wins when replayed.
+  for (uint64_t i = 0; i < 60000; i += 3) {
+    SpillTable_Insert(table, KeyValue(i, i + 1), &old);
+  }
+  STStats_t stats;
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(stats.spills > 0);
+  REQUIRE(stats.buffered_ops > 0);
+  REQUIRE(0 == stats.reloads);
+  REQUIRE(SpillTable_NumElements(table) < 60000);
+
+  // A find reloads its partition, replaying the partition's log.
+  uint64_t value;
+  REQUIRE(FindValue(table, 59999, &value));
+  REQUIRE(59999 == value);
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(stats.reloads > 0);
+
+  // Merging replays every other partition's log.
+  REQUIRE(SpillTable_Merge(table));
+  REQUIRE(60000 == SpillTable_NumElements(table));
+  for (size_t p = 0; p < SpillTable_NumPartitions(table); p++) {
+    REQUIRE((table->partitions[p].table != nullptr ||
+             table->partitions[p].log_end == 0));
+  }
+  REQUIRE(table->memory_bytes <= options.memory_limit);
+  for (uint64_t i : ClusteredKeys(table, 60000)) {
+    REQUIRE(FindValue(table, i, &value));
+    REQUIRE((i % 3 == 0 ? i + 1 : i) == value);
+  }
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(0 == stats.failures);
+  SpillTable_Delete(table);
+}
+
+TEST_CASE("SpillStringKeys", "[Test_SpillTable]") {
+  const STOptions_t options{64 * 1024, 2, nullptr, true};
+  SpillTable* table = SpillTable_NewStringKeys(&options);
+  REQUIRE(table != nullptr);
+
+  HTKeyValue_t kv;
+  for (int i = 0; i < 20000; i++) {
+    string keystr = "spilled key " + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    SpillTable_Insert(table,
+                      {MixHash(i), &key, reinterpret_cast<HTValue_t>(i)}, &kv);
+    keystr.assign("clobbered");
+  }
+  STStats_t stats;
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(stats.spills > 0);
+  REQUIRE(stats.buffered_ops > 0);
+
+  for (uint64_t i : ClusteredKeys(table, 20000)) {
+    string keystr = "spilled key " + to_string(i);
+    HTStringKey_t key{keystr.data(), keystr.size()};
+    REQUIRE(SpillTable_Find(table, MixHash(i), &key, &kv));
+    REQUIRE(i == ValueOf(kv));
+  }
+  REQUIRE(20000 == SpillTable_NumElements(table));
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(0 == stats.failures);
+  SpillTable_Delete(table);
+}
+
+TEST_CASE("SpillErrors", "[Test_SpillTable]") {
+  const STOptions_t missing{1024, 0, "/nonexistent/spill/dir", false};
+  REQUIRE(nullptr == SpillTable_New(&missing, CompareInlineKeys));
+
+  // Out-of-range radix bits are clamped or defaulted.
+  STOptions_t options{1024, 0, nullptr, false};
+  SpillTable* table = SpillTable_New(&options, CompareInlineKeys);
+  REQUIRE(k_st_default_radix_bits == table->radix_bits);
+  SpillTable_Delete(table);
+  options.radix_bits = 40;
+  table = SpillTable_New(&options, CompareInlineKeys);
+  REQUIRE(k_st_max_radix_bits == table->radix_bits);
+
+  // A partition whose snapshot has gone missing can't be reloaded, and
+  // behaves as if empty.
+  HTKeyValue_t old;
+  REQUIRE_FALSE(SpillTable_Insert(table, KeyValue(1, 1), &old));
+  const size_t p = SpillTable_PartitionOf(table, MixHash(1));
+  if (table->partitions[p].table != nullptr) {
+    REQUIRE(SpillTable_Spill(table, p));
+  }
+  remove((table->dir + "/" + to_string(p) + ".snap").c_str());
+  uint64_t value;
+  REQUIRE_FALSE(FindValue(table, 1, &value));
+  STStats_t stats;
+  SpillTable_GetStats(table, &stats);
+  REQUIRE(1 == stats.failures);
+  SpillTable_Delete(table);
+}
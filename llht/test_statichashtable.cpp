@@ -0,0 +1,166 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "./HashTable.hpp"
+#include "./StaticHashTable.hpp"
+
+#include "./catch.hpp"
+
+using std::string;
+using std::to_string;
+
+// The keywords of C, numbered in order.
+static constexpr SHTEntry_t k_keywords[] = {
+    {"auto", 0},      {"break", 1},     {"case", 2},     {"char", 3},
+    {"const", 4},     {"continue", 5},  {"default", 6},  {"do", 7},
+    {"double", 8},    {"else", 9},      {"enum", 10},    {"extern", 11},
+    {"float", 12},    {"for", 13},      {"goto", 14},    {"if", 15},
+    {"inline", 16},   {"int", 17},      {"long", 18},    {"register", 19},
+    {"restrict", 20}, {"return", 21},   {"short", 22},   {"signed", 23},
+    {"sizeof", 24},   {"static", 25},   {"struct", 26},  {"switch", 27},
+    {"typedef", 28},  {"union", 29},    {"unsigned", 30}, {"void", 31},
+    {"volatile", 32}, {"while", 33},
+};
+static constexpr auto k_keyword_table = StaticHashTable_Build(k_keywords);
+static_assert(k_keyword_table.built);
+
+// Looks a NUL-terminated key up, returning its value or -1.
+template <size_t N>
+static constexpr int64_t FindValue(const StaticHashTable<N>& table,
+                                   const char* key) {
+  uint64_t value = 0;
+  return StaticHashTable_Find(table, key, std::char_traits<char>::length(key),
+                              &value)
+             ? static_cast<int64_t>(value)
+             : -1;
+}
+
+// Lookups work at compile time too.
+static_assert(FindValue(k_keyword_table, "auto") == 0);
+static_assert(FindValue(k_keyword_table, "while") == 33);
+static_assert(FindValue(k_keyword_table, "whilst") == -1);
+static_assert(FindValue(k_keyword_table, "") == -1);
+
+static constexpr SHTEntry_t k_one[] = {{"only", 7}};
+static constexpr auto k_one_table = StaticHashTable_Build(k_one);
+static_assert(k_one_table.built);
+static_assert(FindValue(k_one_table, "only") == 7);
+static_assert(FindValue(k_one_table, "other") == -1);
+
+static constexpr SHTEntry_t k_duplicates[] = {{"a", 1}, {"b", 2}, {"a", 3}};
+static_assert(!StaticHashTable_Build(k_duplicates).built);
+
+// Generates n keys, "k0" through "k<n-1>", at compile time.
+template <size_t N>
+struct GeneratedKeys {
+  char keys[N][8];
+};
+
+template <size_t N>
+struct GeneratedEntries {
+  SHTEntry_t entries[N];
+};
+
+template <size_t N>
+static constexpr GeneratedKeys<N> GenerateKeys() {
+  GeneratedKeys<N> gen{};
+  for (size_t i = 0; i < N; i++) {
+    size_t len = 1;
+    for (size_t x = i; x >= 10; x /= 10) {
+      len++;
+    }
+    gen.keys[i][0] = 'k';
+    size_t x = i;
+    for (size_t j = len; j > 0; j--, x /= 10) {
+      gen.keys[i][j] = static_cast<char>('0' + x % 10);
+    }
+  }
+  return gen;
+}
+
+// The entries point into the keys, so those have to be built first.
+template <size_t N>
+static constexpr GeneratedEntries<N> GenerateEntries(
+    const GeneratedKeys<N>& gen) {
+  GeneratedEntries<N> entries{};
+  for (size_t i = 0; i < N; i++) {
+    entries.entries[i] = {gen.keys[i], i * 3};
+  }
+  return entries;
+}
+
+static constexpr auto k_generated = GenerateKeys<500>();
+static constexpr auto k_generated_entries = GenerateEntries(k_generated);
+static constexpr auto k_generated_table =
+    StaticHashTable_Build(k_generated_entries.entries);
+static_assert(k_generated_table.built);
+
+TEST_CASE("FNVHash64Constexpr", "[Test_StaticHashTable]") {
+  static_assert(FNVHash64Constexpr("", 0) == 0xcbf29ce484222325ULL);
+
+  // Matches FNVHash64 byte for byte, including high-bit bytes.
+  string str;
+  for (int i = 0; i < 300; i++) {
+    HTHash_t expected =
+        FNVHash64(reinterpret_cast<unsigned char*>(str.data()),
+                  static_cast<int>(str.size()));
+    REQUIRE(FNVHash64Constexpr(str.data(), str.size()) == expected);
+    str.push_back(static_cast<char>(i * 37));
+  }
+}
+
+TEST_CASE("Find", "[Test_StaticHashTable]") {
+  // Every keyword is found, with its value, whatever buffer it's in.
+  for (const SHTEntry_t& entry : k_keywords) {
+    string key(entry.key);
+    uint64_t value = 999;
+    REQUIRE(StaticHashTable_Find(k_keyword_table, key.data(), key.size(),
+                                 &value));
+    REQUIRE(value == entry.value);
+
+    // Extensions and prefixes of keywords are misses.
+    string longer = key + "x";
+    REQUIRE_FALSE(StaticHashTable_Find(k_keyword_table, longer.data(),
+                                       longer.size(), &value));
+    REQUIRE_FALSE(StaticHashTable_Find(k_keyword_table, key.data(),
+                                       key.size() - 1, &value));
+  }
+
+  // Misses leave the value alone.
+  uint64_t value = 999;
+  for (const char* miss : {"", "Auto", "AUTO", "bool", "class", "x"}) {
+    REQUIRE_FALSE(
+        StaticHashTable_Find(k_keyword_table, miss, strlen(miss), &value));
+  }
+  REQUIRE(value == 999);
+
+  // A table of one.
+  REQUIRE(StaticHashTable_Find(k_one_table, "only", 4, &value));
+  REQUIRE(value == 7);
+  REQUIRE_FALSE(StaticHashTable_Find(k_one_table, "onl", 3, &value));
+}
+
+TEST_CASE("Generated", "[Test_StaticHashTable]") {
+  // The keys fill at most 80% of the slots, and every key has its own.
+  REQUIRE(sizeof(k_generated_table.slots) / sizeof(SHTSlot_t) >=
+          500 + 500 / 4);
+  size_t used = 0;
+  for (const SHTSlot_t& slot : k_generated_table.slots) {
+    used += slot.key != nullptr ? 1 : 0;
+  }
+  REQUIRE(used == 500);
+
+  for (size_t i = 0; i < 500; i++) {
+    const char* key = k_generated.keys[i];
+    uint64_t value = 0;
+    REQUIRE(StaticHashTable_Find(k_generated_table, key, strlen(key), &value));
+    REQUIRE(value == i * 3);
+  }
+  for (size_t i = 500; i < 5000; i++) {
+    string key = "k" + to_string(i);
+    uint64_t value = 0;
+    REQUIRE_FALSE(StaticHashTable_Find(k_generated_table, key.data(),
+                                       key.size(), &value));
+  }
+}
@@ -0,0 +1,212 @@
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+
+#include "./UnrolledList.hpp"
+#include "./UnrolledList_priv.hpp"
+
+#include "./catch.hpp"
+
+static LLPayload_t Payload(uint64_t i) {
+  return std::bit_cast<LLPayload_t>(i);
+}
+
+static int g_ul_free_invocations = 0;
+
+static void CountedDelete(LLPayload_t payload) {
+  g_ul_free_invocations++;
+}
+
+// Requires that list holds exactly the payloads in expected, in order, and
+// that its nodes are well-formed.
+static void RequireContents(UnrolledList* list,
+                            const std::deque<uint64_t>& expected) {
+  REQUIRE(expected.size() == UnrolledList_NumElements(list));
+  size_t num_seen = 0;
+  UnrolledListNode* prev = nullptr;
+  for (UnrolledListNode* node = list->head; node != nullptr;
+       node = node->next) {
+    REQUIRE(prev == node->prev);
+    REQUIRE(node->begin < node->end);
+    REQUIRE(node->end <= k_ul_node_capacity);
+    for (uint32_t i = node->begin; i < node->end; i++) {
+      REQUIRE(Payload(expected[num_seen++]) == node->payloads[i]);
+    }
+    prev = node;
+  }
+  REQUIRE(prev == list->tail);
+  REQUIRE(expected.size() == num_seen);
+}
+
+TEST_CASE("PushPopAppendSlice", "[Test_UnrolledList]") {
+  UnrolledList* list = UnrolledList_New();
+  REQUIRE(0 == UnrolledList_NumElements(list));
+  REQUIRE(nullptr == list->head);
+  REQUIRE(nullptr == list->tail);
+  LLPayload_t payload;
+  REQUIRE_FALSE(UnrolledList_Pop(list, &payload));
+  REQUIRE_FALSE(UnrolledList_Slice(list, &payload));
+
+  // Fill several nodes from each end.
+  std::deque<uint64_t> expected;
+  for (uint64_t i = 1; i <= 100; i++) {
+    UnrolledList_Push(list, Payload(i));
+    expected.push_front(i);
+    UnrolledList_Append(list, Payload(i + 1000));
+    expected.push_back(i + 1000);
+  }
+  RequireContents(list, expected);
+  REQUIRE(list->head != list->tail);
+
+  // Popping and slicing empties nodes from either end, and then crosses
+  // into the nodes filled from the other end.
+  for (int i = 0; i < 150; i++) {
+    REQUIRE(UnrolledList_Pop(list, &payload));
+    REQUIRE(Payload(expected.front()) == payload);
+    expected.pop_front();
+  }
+  RequireContents(list, expected);
+  while (!expected.empty()) {
+    REQUIRE(UnrolledList_Slice(list, &payload));
+    REQUIRE(Payload(expected.back()) == payload);
+    expected.pop_back();
+  }
+  REQUIRE(0 == UnrolledList_NumElements(list));
+  REQUIRE(nullptr == list->head);
+  REQUIRE(nullptr == list->tail);
+
+  // Deleting frees every remaining payload.
+  g_ul_free_invocations = 0;
+  for (uint64_t i = 1; i <= 30; i++) {
+    UnrolledList_Append(list, Payload(i));
+  }
+  UnrolledList_Delete(list, &CountedDelete);
+  REQUIRE(30 == g_ul_free_invocations);
+}
+
+TEST_CASE("Iterator", "[Test_UnrolledList]") {
+  UnrolledList* list = UnrolledList_New();
+  ULIterator* iter = ULIterator_New(list);
+  REQUIRE_FALSE(ULIterator_IsValid(iter));
+  REQUIRE_FALSE(ULIterator_Next(iter));
+  ULIterator_Delete(iter);
+
+  std::deque<uint64_t> expected;
+  for (uint64_t i = 0; i < 40; i++) {
+    UnrolledList_Append(list, Payload(i));
+    expected.push_back(i);
+  }
+
+  // Walk the whole list.
+  iter = ULIterator_New(list);
+  LLPayload_t payload;
+  for (uint64_t i = 0; i < 40; i++) {
+    REQUIRE(ULIterator_IsValid(iter));
+    ULIterator_Get(iter, &payload);
+    REQUIRE(Payload(i) == payload);
+    REQUIRE((i < 39) == ULIterator_Next(iter));
+  }
+  REQUIRE_FALSE(ULIterator_IsValid(iter));
+
+  // Remove every third element; the iterator moves on to the successor,
+  // and emptied nodes get merged away.
+  g_ul_free_invocations = 0;
+  ULIterator_Rewind(iter);
+  size_t pos = 0;
+  while (pos < expected.size()) {
+    ULIterator_Get(iter, &payload);
+    REQUIRE(Payload(expected[pos]) == payload);
+    if (expected[pos] % 3 == 0) {
+      REQUIRE(ULIterator_Remove(iter, &CountedDelete));
+      expected.erase(expected.begin() + pos);
+    } else {
+      ULIterator_Next(iter);
+      pos++;
+    }
+  }
+  REQUIRE(14 == g_ul_free_invocations);
+  RequireContents(list, expected);
+
+  // Removing the tail moves the iterator back to the predecessor.
+  ULIterator_Rewind(iter);
+  while (ULIterator_Next(iter)) {
+  }
+  ULIterator_Rewind(iter);
+  for (size_t i = 1; i < expected.size(); i++) {
+    ULIterator_Next(iter);
+  }
+  REQUIRE(ULIterator_Remove(iter, &CountedDelete));
+  expected.pop_back();
+  ULIterator_Get(iter, &payload);
+  REQUIRE(Payload(expected.back()) == payload);
+
+  // Removing everything leaves the iterator invalid.
+  while (UnrolledList_NumElements(list) > 1) {
+    REQUIRE(ULIterator_Remove(iter, &CountedDelete));
+  }
+  REQUIRE_FALSE(ULIterator_Remove(iter, &CountedDelete));
+  REQUIRE_FALSE(ULIterator_IsValid(iter));
+  REQUIRE(nullptr == list->head);
+  REQUIRE(nullptr == list->tail);
+  REQUIRE(40 == g_ul_free_invocations);
+  ULIterator_Delete(iter);
+  UnrolledList_Delete(list, &CountedDelete);
+}
+
+TEST_CASE("RandomOperations", "[Test_UnrolledList]") {
+  // Check a long random sequence of operations against a std::deque.
+  srand(12345);
+  UnrolledList* list = UnrolledList_New();
+  std::deque<uint64_t> expected;
+  LLPayload_t payload;
+  uint64_t next = 1;
+  for (int round = 0; round < 2000; round++) {
+    switch (rand() % 5) {
+      case 0:
+        UnrolledList_Push(list, Payload(next));
+        expected.push_front(next++);
+        break;
+      case 1:
+        UnrolledList_Append(list, Payload(next));
+        expected.push_back(next++);
+        break;
+      case 2:
+        REQUIRE(!expected.empty() == UnrolledList_Pop(list, &payload));
+        if (!expected.empty()) {
+          REQUIRE(Payload(expected.front()) == payload);
+          expected.pop_front();
+        }
+        break;
+      case 3:
+        REQUIRE(!expected.empty() == UnrolledList_Slice(list, &payload));
+        if (!expected.empty()) {
+          REQUIRE(Payload(expected.back()) == payload);
+          expected.pop_back();
+        }
+        break;
+      default: {
+        // Remove a random element through an iterator.
+        if (expected.empty()) {
+          break;
+        }
+        const size_t pos = rand() % expected.size();
+        ULIterator* iter = ULIterator_New(list);
+        for (size_t i = 0; i < pos; i++) {
+          REQUIRE(ULIterator_Next(iter));
+        }
+        ULIterator_Remove(iter, &CountedDelete);
+        expected.erase(expected.begin() + pos);
+        if (!expected.empty()) {
+          const size_t now = pos < expected.size() ? pos : pos - 1;
+          ULIterator_Get(iter, &payload);
+          REQUIRE(Payload(expected[now]) == payload);
+        }
+        ULIterator_Delete(iter);
+        break;
+      }
+    }
+    RequireContents(list, expected);
+  }
+  UnrolledList_Delete(list, &CountedDelete);
+}
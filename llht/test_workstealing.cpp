@@ -0,0 +1,155 @@
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "./WorkStealing.hpp"
+#include "./WorkStealing_priv.hpp"
+
+#include "./catch.hpp"
+
+static LLPayload_t Payload(uint64_t i) {
+  return std::bit_cast<LLPayload_t>(i);
+}
+
+static int g_ws_free_invocations = 0;
+
+static void CountedDelete(LLPayload_t payload) {
+  g_ws_free_invocations++;
+}
+
+TEST_CASE("DequeBasic", "[Test_WorkStealing]") {
+  WorkDeque* deque = WorkDeque_New();
+  LLPayload_t payload;
+  REQUIRE_FALSE(WorkDeque_Pop(deque, &payload));
+  REQUIRE_FALSE(WorkDeque_Steal(deque, &payload));
+
+  // The owner's end is LIFO, the thieves' end FIFO.  Push enough to make
+  // the array grow three times.
+  const uint64_t n = 4 * k_ws_initial_capacity + 3;
+  for (uint64_t i = 1; i <= n; i++) {
+    WorkDeque_Push(deque, Payload(i));
+  }
+  REQUIRE(deque->array.load()->capacity >= static_cast<int64_t>(n));
+  REQUIRE(3 == deque->old_arrays.size());
+  REQUIRE(WorkDeque_Steal(deque, &payload));
+  REQUIRE(Payload(1) == payload);
+  REQUIRE(WorkDeque_Pop(deque, &payload));
+  REQUIRE(Payload(n) == payload);
+  REQUIRE(WorkDeque_Steal(deque, &payload));
+  REQUIRE(Payload(2) == payload);
+
+  // Drain it from the bottom; the last payload goes through the race with
+  // thieves, unopposed.
+  for (uint64_t i = n - 1; i >= 3; i--) {
+    REQUIRE(WorkDeque_Pop(deque, &payload));
+    REQUIRE(Payload(i) == payload);
+  }
+  REQUIRE_FALSE(WorkDeque_Pop(deque, &payload));
+  REQUIRE_FALSE(WorkDeque_Steal(deque, &payload));
+  REQUIRE(deque->top.load() == deque->bottom.load());
+
+  // Deleting frees what's left.
+  g_ws_free_invocations = 0;
+  WorkDeque_Push(deque, Payload(1));
+  WorkDeque_Push(deque, Payload(2));
+  WorkDeque_Delete(deque, &CountedDelete);
+  REQUIRE(2 == g_ws_free_invocations);
+}
+
+TEST_CASE("DequeThieves", "[Test_WorkStealing]") {
+  // The owner pushes payloads and pops some of them back, while thieves
+  // steal the rest.  Every payload must come out exactly once.
+  constexpr int k_thieves = 3;
+  constexpr uint64_t k_total = 200000;
+  WorkDeque* deque = WorkDeque_New();
+  std::atomic<bool> done{false};
+  std::vector<std::vector<uint64_t>> taken(k_thieves + 1);
+
+  std::vector<std::thread> thieves;
+  for (int t = 1; t <= k_thieves; t++) {
+    thieves.emplace_back([deque, t, &done, &taken] {
+      LLPayload_t payload;
+      while (!done.load()) {
+        if (WorkDeque_Steal(deque, &payload)) {
+          taken[t].push_back(std::bit_cast<uint64_t>(payload));
+        }
+      }
+    });
+  }
+  LLPayload_t payload;
+  for (uint64_t i = 0; i < k_total; i++) {
+    WorkDeque_Push(deque, Payload(i));
+    if (i % 3 == 0 && WorkDeque_Pop(deque, &payload)) {
+      taken[0].push_back(std::bit_cast<uint64_t>(payload));
+    }
+  }
+  while (WorkDeque_Pop(deque, &payload)) {
+    taken[0].push_back(std::bit_cast<uint64_t>(payload));
+  }
+  done.store(true);
+  for (std::thread& thief : thieves) {
+    thief.join();
+  }
+
+  std::vector<int> counts(k_total, 0);
+  for (const std::vector<uint64_t>& values : taken) {
+    for (uint64_t v : values) {
+      REQUIRE(v < k_total);
+      counts[v]++;
+    }
+  }
+  for (int count : counts) {
+    REQUIRE(1 == count);
+  }
+  WorkDeque_Delete(deque, &CountedDelete);
+}
+
+// Each index adds its number to the sum and bumps its own counter.
+struct ForEachState {
+  std::vector<std::atomic<int>> counts;
+  std::atomic<uint64_t> sum;
+  std::atomic<size_t> max_range;
+};
+
+static void CountRange(size_t begin, size_t end, void* arg) {
+  ForEachState* state = static_cast<ForEachState*>(arg);
+  size_t seen = state->max_range.load();
+  while (end - begin > seen &&
+         !state->max_range.compare_exchange_weak(seen, end - begin)) {
+  }
+  for (size_t i = begin; i < end; i++) {
+    state->counts[i].fetch_add(1);
+    state->sum.fetch_add(i);
+  }
+}
+
+TEST_CASE("ParallelFor", "[Test_WorkStealing]") {
+  constexpr size_t k_n = 100000;
+  for (int num_threads : {1, 4}) {
+    ForkJoinPool* pool = ForkJoinPool_New(num_threads);
+    REQUIRE(num_threads == pool->num_threads);
+
+    // Run many loops back to back, over varying ranges and grains.
+    for (size_t round = 0; round < 50; round++) {
+      ForEachState state{std::vector<std::atomic<int>>(k_n), {0}, {0}};
+      const size_t begin = round * 7;
+      const size_t grain = 1 + round * 13;
+      ForkJoinPool_ParallelFor(pool, begin, k_n, grain, &CountRange, &state);
+      for (size_t i = 0; i < k_n; i++) {
+        if (state.counts[i].load() != (i >= begin ? 1 : 0)) {
+          FAIL("index " << i << " was handled " << state.counts[i].load()
+                        << " times");
+        }
+      }
+      const uint64_t sum_below_begin = begin > 0 ? (begin - 1) * begin / 2 : 0;
+      REQUIRE((k_n - 1) * k_n / 2 - sum_below_begin == state.sum.load());
+      REQUIRE(state.max_range.load() <= grain);
+    }
+
+    // An empty range does nothing.
+    ForkJoinPool_ParallelFor(pool, 5, 5, 1, &CountRange, nullptr);
+    ForkJoinPool_Delete(pool);
+  }
+}